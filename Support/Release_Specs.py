@@ -18,8 +18,15 @@ release_specs = [
             '__init__.py',
             'Main.py',
             'Classes/__init__.py',
+            'Classes/Metrics.py',
+            'Classes/Misc.py',
             'Classes/Pipe.py',
+            'Classes/Pipe_Capture.py',
+            'Classes/Series_Store.py',
+            'Classes/Stats.py',
             'Classes/Server_Thread.py',
+            'Classes/Async_Pipe.py',
+            'Classes/Async_Server.py',
         ],
         ),
     
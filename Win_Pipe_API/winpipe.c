@@ -9,6 +9,7 @@
  *   file:write_pipe(data)           → (bytes_written) or (nil, err)
  *   file:close_pipe()               → (true)
  *   winpipe.peek_pipe(file)         → (bytes_available) or (nil, err)
+ *   winpipe.set_capture(path | nil) → (true) or (nil, err)
  *
  * Author: Mateusz “iomatix” Wypchlak
  * Refactored for non-blocking I/O, inspired by Microsoft best practices.
@@ -18,6 +19,7 @@
 #include <windows.h>
 #include <lua.h>
 #include <lauxlib.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -96,8 +98,101 @@ typedef struct {
     char* buffer;
     DWORD       buf_size;
     OVERLAPPED  ov;
+    char* path;                 // pipe path, for capture records
+    unsigned short capture_id;  // id in the current capture file
+    unsigned int capture_gen;   // capture_generation when id was given
 } PipeFile;
 
+//------------------------------------------------------------------------------
+// Traffic capture
+// While enabled by winpipe.set_capture(path), every message read or written
+// is appended to a binary log, in the format of the python server's
+// Classes/Pipe_Capture.py, so both sides of a session can be replayed.
+//
+// File header: "X4PC", u16 version, u16 reserved.
+// Records (little-endian): u8 kind, u8 flags, u16 pipe_id,
+//   u64 unix time in ns, u32 payload length, payload.
+// Kind 1 declares the path of a pipe_id; kind 2 is a message.
+//
+// The file is written through a large buffer, flushed at most every
+// CAPTURE_FLUSH_MS so a crash loses little, and closed along with the lua
+// state that loaded this module.
+//------------------------------------------------------------------------------
+#define CAPTURE_MAGIC       "X4PC"
+#define CAPTURE_VERSION     1
+#define CAPTURE_KIND_PIPE   1
+#define CAPTURE_KIND_MSG    2
+#define CAPTURE_TO_CLIENT   0x01    // flag: server -> client direction
+#define CAPTURE_NATIVE      0x02    // flag: recorded by this dll
+#define CAPTURE_BUFFER_SIZE 65536
+#define CAPTURE_FLUSH_MS    1000
+#define CAPTURE_SENTINEL    "WinPipe.Capture_Sentinel"
+
+static FILE* capture_file = NULL;
+static unsigned short capture_next_id = 1;
+// Bumped per capture file, so open pipes redeclare their path in the new one.
+static unsigned int capture_generation = 1;
+static ULONGLONG capture_last_flush = 0;
+
+static void capture_write(unsigned char kind, unsigned char flags,
+                          unsigned short id, const char* data, DWORD len) {
+    unsigned char header[16];
+    FILETIME ft;
+    ULARGE_INTEGER t;
+    unsigned long long ns;
+    int i;
+
+    GetSystemTimePreciseAsFileTime(&ft);
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+    // 100ns ticks since 1601 -> ns since 1970.
+    ns = (t.QuadPart - 116444736000000000ULL) * 100ULL;
+
+    header[0] = kind;
+    header[1] = flags;
+    header[2] = (unsigned char)(id & 0xFF);
+    header[3] = (unsigned char)(id >> 8);
+    for (i = 0; i < 8; i++)
+        header[4 + i] = (unsigned char)(ns >> (8 * i));
+    for (i = 0; i < 4; i++)
+        header[12 + i] = (unsigned char)(len >> (8 * i));
+
+    fwrite(header, 1, sizeof(header), capture_file);
+    if (len)
+        fwrite(data, 1, len, capture_file);
+}
+
+static void capture_message(PipeFile* pf, const char* data, DWORD len, unsigned char flags) {
+    if (pf->capture_gen != capture_generation) {
+        pf->capture_id = capture_next_id++;
+        pf->capture_gen = capture_generation;
+        capture_write(CAPTURE_KIND_PIPE, CAPTURE_NATIVE, pf->capture_id,
+                      pf->path, (DWORD)strlen(pf->path));
+    }
+    capture_write(CAPTURE_KIND_MSG, (unsigned char)(flags | CAPTURE_NATIVE),
+                  pf->capture_id, data, len);
+
+    ULONGLONG now = GetTickCount64();
+    if (now - capture_last_flush >= CAPTURE_FLUSH_MS) {
+        fflush(capture_file);
+        capture_last_flush = now;
+    }
+}
+
+static void capture_close(void) {
+    if (capture_file) {
+        fclose(capture_file);
+        capture_file = NULL;
+    }
+}
+
+// __gc of a registry-held sentinel, run when the lua state closes.
+static int capture_sentinel_gc(lua_State* L) {
+    (void)L;
+    capture_close();
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 // Initialize a PipeFile: alloc buffer + create event for overlapped
 //------------------------------------------------------------------------------
@@ -105,6 +200,9 @@ static int init_pipefile(lua_State* L, PipeFile* pf, HANDLE h, BOOL is_read) {
     pf->handle = h;
     pf->is_read = is_read;
     pf->buf_size = FILE_BUFFER_SIZE;
+    pf->path = NULL;
+    pf->capture_id = 0;
+    pf->capture_gen = 0;
 
     pf->buffer = (char*)malloc(pf->buf_size);
     if (!pf->buffer) {
@@ -135,6 +233,7 @@ static int pipefile_gc(lua_State* L) {
         CloseHandle(pf->handle);
     if (pf->ov.hEvent) CloseHandle(pf->ov.hEvent);
     if (pf->buffer)   free(pf->buffer);
+    if (pf->path)     free(pf->path);
     return 0;
 }
 
@@ -167,6 +266,9 @@ static int pipefile_write(lua_State* L) {
         written = pf->ov.InternalHigh;
     }
 
+    if (capture_file)
+        capture_message(pf, data, written, 0);
+
     lua_pushinteger(L, written);
     return 1;
 }
@@ -198,6 +300,8 @@ static int pipefile_read(lua_State* L) {
     }
 
     pf->buffer[read] = '\0';
+    if (capture_file && read)
+        capture_message(pf, pf->buffer, read, CAPTURE_TO_CLIENT);
     lua_pushlstring(L, pf->buffer, read);
     return 1;
 }
@@ -278,9 +382,48 @@ static int l_open_pipe(lua_State* L) {
 
     if (init_pipefile(L, pf, h, is_read) != LUA_OK)
         return lua_error(L);
+    // Capture records name the pipe by this copy.
+    pf->path = _strdup(pname);
+    if (!pf->path) {
+        // Buffer and event are freed by __gc.
+        CloseHandle(pf->handle);
+        pf->handle = INVALID_HANDLE_VALUE;
+        lua_pushnil(L);
+        lua_pushstring(L, "Memory allocation failed for pipe path");
+        return 2;
+    }
 	return 1;
 }
 
+//------------------------------------------------------------------------------
+// Global: winpipe.set_capture(path)
+// Start capturing all pipe traffic to a new file at path, replacing any
+// earlier capture; nil stops capturing.
+//------------------------------------------------------------------------------
+static int l_set_capture(lua_State* L) {
+    const char* path = luaL_optstring(L, 1, NULL);
+    unsigned char header[8] = { 0 };
+
+    capture_close();
+    if (path) {
+        capture_file = fopen(path, "wb");
+        if (!capture_file) {
+            lua_pushnil(L);
+            lua_pushfstring(L, "Cannot open capture file: %s", path);
+            return 2;
+        }
+        setvbuf(capture_file, NULL, _IOFBF, CAPTURE_BUFFER_SIZE);
+        memcpy(header, CAPTURE_MAGIC, 4);
+        header[4] = CAPTURE_VERSION;
+        fwrite(header, 1, sizeof(header), capture_file);
+        capture_generation++;
+        capture_next_id = 1;
+        capture_last_flush = GetTickCount64();
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
 
 //------------------------------------------------------------------------------
 // Register everything with Lua
@@ -296,6 +439,7 @@ static const luaL_Reg pipefile_methods[] = {
 
 static const struct luaL_Reg winpipe_functions[] = {
     {"open_pipe", l_open_pipe},
+    {"set_capture", l_set_capture},
     {NULL, NULL}
 };
 
@@ -311,6 +455,18 @@ extern "C" {
         luaL_setfuncs(L, pipefile_methods, 0);
         lua_pop(L, 1);
 
+        // Close any capture with the lua state; created once per state.
+        lua_getfield(L, LUA_REGISTRYINDEX, CAPTURE_SENTINEL);
+        if (lua_isnil(L, -1)) {
+            lua_newuserdata(L, 1);
+            lua_newtable(L);
+            lua_pushcfunction(L, capture_sentinel_gc);
+            lua_setfield(L, -2, "__gc");
+            lua_setmetatable(L, -2);
+            lua_setfield(L, LUA_REGISTRYINDEX, CAPTURE_SENTINEL);
+        }
+        lua_pop(L, 1);
+
         // export module functions
         luaL_newlib(L, winpipe_functions);
         return 1;
@@ -0,0 +1,395 @@
+import asyncio
+import logging
+import struct
+import sys
+import tempfile
+import time
+from pathlib import Path
+from typing import Optional, Union
+from .Misc import Client_Garbage_Collected
+from . import Misc
+from . import Pipe_Capture
+from . import Metrics
+
+# Async_Pipe.py - Coroutine Pipes
+# Awaitable versions of Pipe_Server/Pipe_Client, for servers hosted on an
+# asyncio event loop (see Async_Server.py).
+#
+# On Windows these use the same pair of unidirectional message-mode named
+# pipes as Pipe.py (so X4 sees no difference), opened with
+# FILE_FLAG_OVERLAPPED and serviced through the ProactorEventLoop's IOCP.
+# No thread is parked in a blocking ReadFile; an idle pipe costs only a
+# pending overlapped request.
+#
+# Elsewhere (eg. Linux, for developing and load-testing servers without
+# the game) an AF_UNIX stream socket stands in for the pipe pair, with a
+# 4-byte length prefix on each message to keep message-mode boundaries.
+
+IS_WINDOWS = sys.platform == 'win32'
+
+if IS_WINDOWS:
+    import win32con
+    import win32file
+    import win32pipe
+    import winerror
+    from asyncio.windows_utils import PipeHandle
+    from pywintypes import error as Win32Error
+
+# Folder holding the AF_UNIX sockets on non-Windows hosts.
+UNIX_SOCKET_DIR = Path(tempfile.gettempdir())
+
+# Framing header for the AF_UNIX transport: little-endian message length.
+_header = struct.Struct('<I')
+
+
+class Async_Pipe:
+    """
+    Base class for coroutine pipe communication.
+
+    Mirrors Pipe: `read()`/`write()` move UTF-8 messages, and the same
+    diagnostics dict is kept. Differences:
+    - `read()`, `write()` and `connect()` are coroutines.
+    - A disconnected peer raises BrokenPipeError (a ConnectionError) on
+      every platform, instead of a win32api.error, so hosts can restart
+      on `(ConnectionError, Client_Garbage_Collected)`.
+    - Cancelling a task awaiting `read()` aborts the pending I/O, which is
+      how hosts stop a server cooperatively.
+
+    Subclasses implement `connect()`.
+    """
+    # True for server ends; sets message direction in traffic captures.
+    is_server = False
+
+    def __init__(self, pipe_name: str, buffer_size: Optional[int] = None):
+        """
+        :param pipe_name: Base name for the pipe (e.g. 'x4_time')
+        :param buffer_size: Optional buffer size for pipe I/O; messages
+            longer than this are not supported on Windows, as with Pipe.
+        """
+        self.pipe_name = pipe_name
+        self.buffer_size = buffer_size or 65536
+        if IS_WINDOWS:
+            self.pipe_in_path = f"\\\\.\\pipe\\{pipe_name}_in"
+            self.pipe_out_path = f"\\\\.\\pipe\\{pipe_name}_out"
+        else:
+            self.socket_path = UNIX_SOCKET_DIR / f"{pipe_name}.sock"
+
+        # Windows: PipeHandle objects. Unix: stream reader/writer.
+        self.pipe_in = None
+        self.pipe_out = None
+
+        self.diagnostics = {
+            'reads': 0,
+            'writes': 0,
+            'last_read': None,
+            'last_write': None,
+            'last_error': None
+        }
+        # Metric series, looked up once rather than per message.
+        self.metric_read_bytes = Metrics.pipe_message_bytes.Labels(pipe=pipe_name, direction='read')
+        self.metric_write_bytes = Metrics.pipe_message_bytes.Labels(pipe=pipe_name, direction='write')
+        self.metric_handler = Metrics.pipe_handler_seconds.Labels(pipe=pipe_name)
+        self.metric_errors = Metrics.pipe_errors.Labels(pipe=pipe_name)
+        # perf_counter of the last read not yet answered by a write.
+        self.unanswered_read_time = None
+
+        self.logger = logging.getLogger(__name__)
+
+    def is_connected(self) -> bool:
+        return self.pipe_in is not None and self.pipe_out is not None
+
+    async def read_bytes(self) -> bytes:
+        """
+        Read one raw message.
+        Raises BrokenPipeError if the peer has gone away.
+        """
+        if not self.is_connected():
+            raise BrokenPipeError(f"Pipe {self.pipe_name} is not connected")
+        try:
+            if IS_WINDOWS:
+                data = await _proactor().recv(self.pipe_in, self.buffer_size)
+                # The proactor reports ERROR_BROKEN_PIPE as an empty read.
+                if not data:
+                    raise BrokenPipeError(f"Pipe {self.pipe_name} client disconnected")
+            else:
+                header = await self.pipe_in.readexactly(_header.size)
+                data = await self.pipe_in.readexactly(_header.unpack(header)[0])
+        except asyncio.IncompleteReadError as ex:
+            self.diagnostics['last_error'] = str(ex)
+            self.metric_errors.Inc()
+            raise BrokenPipeError(f"Pipe {self.pipe_name} client disconnected") from ex
+        except OSError as ex:
+            self.diagnostics['last_error'] = str(ex)
+            self.metric_errors.Inc()
+            raise
+
+        self.diagnostics['reads'] += 1
+        self.diagnostics['last_read'] = time.time()
+        if Pipe_Capture.active is not None:
+            Pipe_Capture.active.Record(self.pipe_name, not self.is_server, data)
+        self.metric_read_bytes.Observe(len(data))
+        self.unanswered_read_time = time.perf_counter()
+        return data
+
+    async def write_bytes(self, data: bytes) -> None:
+        """
+        Write one raw message.
+        Raises BrokenPipeError if the peer has gone away.
+        """
+        if not self.is_connected():
+            raise BrokenPipeError(f"Pipe {self.pipe_name} is not connected")
+        try:
+            if IS_WINDOWS:
+                await _proactor().send(self.pipe_out, data)
+            else:
+                self.pipe_out.write(_header.pack(len(data)) + data)
+                await self.pipe_out.drain()
+        except OSError as ex:
+            self.diagnostics['last_error'] = str(ex)
+            self.metric_errors.Inc()
+            raise
+
+        self.diagnostics['writes'] += 1
+        self.diagnostics['last_write'] = time.time()
+        if Pipe_Capture.active is not None:
+            Pipe_Capture.active.Record(self.pipe_name, self.is_server, data)
+        self.metric_write_bytes.Observe(len(data))
+        if self.unanswered_read_time is not None:
+            self.metric_handler.Observe(time.perf_counter() - self.unanswered_read_time)
+            self.unanswered_read_time = None
+
+    async def read(self) -> str:
+        """
+        Read a UTF-8 message.
+        Raises Client_Garbage_Collected if the X4 side was collected.
+        """
+        message = (await self.read_bytes()).decode('utf-8')
+        # Per-message; args are only formatted if the record is kept.
+        self.logger.debug("Read from pipe: %s", message)
+        if Misc.first_read_callback is not None:
+            Misc.Fire_First_Read(message)
+        if message == 'garbage_collected':
+            raise Client_Garbage_Collected()
+        return message
+
+    async def write(self, message: Union[str, bytes]) -> None:
+        """
+        Write a UTF-8 message. Non-string values are sent as their str().
+        """
+        if not isinstance(message, bytes):
+            message = str(message).encode('utf-8')
+        await self.write_bytes(message)
+        self.logger.debug("Wrote to pipe: %r", message)
+
+    async def connect(self) -> None:
+        raise NotImplementedError("Subclasses must implement connect().")
+
+    def _close_transport(self) -> None:
+        """
+        Close the per-connection handles or streams.
+        """
+        # On unix the writer owns the socket; the reader has no close().
+        pipes = (self.pipe_in, self.pipe_out) if IS_WINDOWS else (self.pipe_out,)
+        for pipe in pipes:
+            if pipe is None:
+                continue
+            try:
+                pipe.close()
+            except OSError as ex:
+                self.logger.warning(f"Error closing pipe: {ex}")
+        self.pipe_in = None
+        self.pipe_out = None
+
+    def close(self) -> None:
+        self._close_transport()
+
+    async def __aenter__(self):
+        return self
+
+    async def __aexit__(self, exc_type, exc_val, tb):
+        self.close()
+
+
+class Async_Pipe_Server(Async_Pipe):
+    """
+    Coroutine pipe server. Create it, `await connect()` for the client,
+    then `await read()`/`await write()`.
+
+    After a client disconnects, `await connect()` again to wait for the
+    next one; on Windows this recreates the pipe instances in place, so
+    a restart costs two handle creations instead of a new thread.
+    """
+    is_server = True
+
+    async def connect(self) -> None:
+        """
+        Wait for a client connection, dropping any earlier one.
+        """
+        self._close_transport()
+        if IS_WINDOWS:
+            await self._connect_windows()
+        else:
+            await self._connect_unix()
+        self.logger.info(f"Client connected on {self.pipe_name}.")
+
+    async def _connect_windows(self) -> None:
+        pipe_out = pipe_in = None
+        try:
+            pipe_in = self._create_pipe(self.pipe_in_path, win32con.PIPE_ACCESS_INBOUND)
+            pipe_out = self._create_pipe(self.pipe_out_path, win32con.PIPE_ACCESS_OUTBOUND)
+            # Client opens 'out' first, so server must listen 'out' first.
+            proactor = _proactor()
+            await proactor.accept_pipe(pipe_out)
+            await proactor.accept_pipe(pipe_in)
+        except BaseException:
+            # Includes cancellation while waiting on a client.
+            for pipe in (pipe_in, pipe_out):
+                if pipe is not None:
+                    pipe.close()
+            raise
+        self.pipe_in = pipe_in
+        self.pipe_out = pipe_out
+
+    def _create_pipe(self, path: str, access: int):
+        """
+        Create one overlapped message-mode pipe instance, returned as a
+        PipeHandle owned by this object.
+        """
+        try:
+            handle = win32pipe.CreateNamedPipe(
+                path,
+                access | win32file.FILE_FLAG_OVERLAPPED,
+                win32pipe.PIPE_TYPE_MESSAGE | win32pipe.PIPE_READMODE_MESSAGE | win32pipe.PIPE_WAIT,
+                1, self.buffer_size, self.buffer_size, 0, _security_attributes()
+            )
+        except Win32Error as ex:
+            self.diagnostics['last_error'] = str(ex)
+            self.logger.error(f"Failed to create named pipe {path}: {ex}")
+            raise
+        return PipeHandle(handle.Detach())
+
+    async def _connect_unix(self) -> None:
+        """
+        Listen only until one client arrives, then stop, so later clients
+        find no socket and retry, as with a busy single-instance pipe.
+        """
+        accepted = asyncio.get_running_loop().create_future()
+
+        def on_client(reader, writer):
+            if accepted.done():
+                # Raced in before the listener closed.
+                writer.close()
+            else:
+                accepted.set_result((reader, _Stream_Writer(writer)))
+
+        # Clear out a socket file left by an earlier run.
+        self._unlink_socket()
+        server = await asyncio.start_unix_server(on_client, path = str(self.socket_path))
+        self.logger.debug(f"Listening at {self.socket_path}")
+        try:
+            self.pipe_in, self.pipe_out = await accepted
+        finally:
+            server.close()
+            self._unlink_socket()
+
+    def _unlink_socket(self) -> None:
+        try:
+            self.socket_path.unlink()
+        except FileNotFoundError:
+            pass
+
+
+class Async_Pipe_Client(Async_Pipe):
+    """
+    Coroutine pipe client, used to mimic X4 in tests and load generation.
+    """
+
+    async def connect(self, timeout: float = 10.0, interval: float = 0.05) -> None:
+        """
+        Attempt to connect to the server with retry.
+
+        :param timeout: Max time in seconds to retry
+        :param interval: Delay between attempts
+        """
+        deadline = time.perf_counter() + timeout
+        while True:
+            try:
+                if IS_WINDOWS:
+                    # Server's 'out' is the client's input, and vice versa.
+                    self.pipe_in = self._open_pipe(self.pipe_out_path, win32con.GENERIC_READ)
+                    self.pipe_out = self._open_pipe(self.pipe_in_path, win32con.GENERIC_WRITE)
+                else:
+                    reader, writer = await asyncio.open_unix_connection(str(self.socket_path))
+                    self.pipe_in, self.pipe_out = reader, _Stream_Writer(writer)
+                self.logger.info(f"Connected to server {self.pipe_name}.")
+                return
+            except (FileNotFoundError, ConnectionRefusedError) as ex:
+                self._close_transport()
+                self.diagnostics['last_error'] = str(ex)
+            except OSError as ex:
+                self._close_transport()
+                if not (IS_WINDOWS and getattr(ex, 'winerror', None) == winerror.ERROR_PIPE_BUSY):
+                    raise
+            if time.perf_counter() >= deadline:
+                raise TimeoutError(f"Failed to connect to {self.pipe_name} within {timeout:.1f}s")
+            await asyncio.sleep(interval)
+
+    @staticmethod
+    def _open_pipe(path: str, access: int):
+        try:
+            handle = win32file.CreateFile(
+                path, access, 0, None,
+                win32con.OPEN_EXISTING, win32file.FILE_FLAG_OVERLAPPED, None
+            )
+        except Win32Error as ex:
+            # Re-raise as OSError so connect() can retry on it.
+            if ex.winerror == winerror.ERROR_FILE_NOT_FOUND:
+                raise FileNotFoundError(ex.strerror) from ex
+            raise OSError(None, ex.strerror, path, ex.winerror) from ex
+        return PipeHandle(handle.Detach())
+
+
+class _Stream_Writer:
+    """
+    StreamWriter wrapper giving it the close() that PipeHandle has.
+    """
+    def __init__(self, writer):
+        self.writer = writer
+        self.write = writer.write
+        self.drain = writer.drain
+
+    def close(self):
+        self.writer.close()
+
+
+def _proactor():
+    """
+    Return the IOCP proactor of the running loop.
+    Named pipe support needs the ProactorEventLoop (the Windows default).
+    """
+    proactor = getattr(asyncio.get_running_loop(), '_proactor', None)
+    if proactor is None:
+        raise RuntimeError("Async pipes on Windows require a ProactorEventLoop")
+    return proactor
+
+
+_security_attributes_cache = []
+
+def _security_attributes():
+    """
+    Security attributes matching Pipe_Server (null DACL), built once.
+    """
+    if not _security_attributes_cache:
+        import win32security
+        try:
+            sd = win32security.SECURITY_DESCRIPTOR()
+            sd.Initialize()
+            sd.SetSecurityDescriptorDacl(1, None, 0)
+            sa = win32security.SECURITY_ATTRIBUTES()
+            sa.SECURITY_DESCRIPTOR = sd
+        except Exception:
+            logging.getLogger(__name__).warning(
+                "Could not create pipe security attributes. Proceeding with default.")
+            sa = None
+        _security_attributes_cache.append(sa)
+    return _security_attributes_cache[0]
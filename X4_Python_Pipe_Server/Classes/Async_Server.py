@@ -0,0 +1,253 @@
+import asyncio
+import inspect
+import logging
+import threading
+import time
+from typing import Callable, Dict, Optional
+from .Misc import Client_Garbage_Collected
+from .Async_Pipe import IS_WINDOWS
+from . import Metrics
+
+# Async_Server.py - Event Loop Hosting
+# Runs many coroutine pipe servers on one asyncio event loop thread, as a
+# lightweight alternative to one Server_Thread (or process) per server.
+
+logger = logging.getLogger(__name__)
+
+
+class Async_Server_Record:
+    '''
+    Bookkeeping for one hosted coroutine server.
+
+    Attributes:
+    * name
+      - Unique name of the server within its host.
+    * entry_function
+      - The `async def` that sets up an Async_Pipe_Server and services it.
+    * stop_event
+      - asyncio.Event set when the server is asked to stop. Passed to the
+        entry_function if it accepts an argument.
+    * task
+      - The supervising asyncio.Task, or None once finished.
+    * starts
+      - Int, how many times the entry_function has been started.
+    * last_start
+      - time.perf_counter() of the latest start.
+    * last_restart_delay
+      - Float seconds between the latest disconnect and the following
+        start, or None if not restarted yet.
+    '''
+    def __init__(self, name: str, entry_function: Callable):
+        self.name = name
+        self.entry_function = entry_function
+        self.stop_event = None
+        self.task = None
+        self.starts = 0
+        self.last_start = None
+        self.last_restart_delay = None
+
+
+class Async_Server_Thread(threading.Thread):
+    '''
+    Hosts coroutine pipe servers on a single asyncio event loop, running
+    in this thread.
+
+    Each server is an `async def entry_function(stop_event)` (or with no
+    args) that creates an Async_Pipe_Server and awaits its reads/writes.
+    Since an idle server is just a suspended coroutine, hundreds can share
+    the thread.
+
+    A server is restarted as soon as its client disconnects (a
+    ConnectionError or Client_Garbage_Collected escaping the entry
+    function), unless in test mode or stopping. Any other exception is
+    logged and ends that server alone. A normal return also ends it.
+
+    Stopping is cooperative: the server's stop_event is set, then its
+    task is cancelled, raising CancelledError at whatever it is awaiting
+    (eg. a pipe read); entry functions should release their pipe in a
+    `finally` or `async with` block.
+
+    Attributes:
+    * test
+      - Bool, if True then in test mode, and servers will not reboot on a
+        disconnect.
+    * restart_delay
+      - Float seconds to wait before restarting a disconnected server.
+    * loop
+      - The event loop, available once the constructor returns.
+    * servers
+      - Dict of Async_Server_Record, keyed by name. Only touched from the
+        loop thread.
+    '''
+    def __init__(self, test: bool = False, restart_delay: float = 0.0, name: str = 'Async_Server_Thread'):
+        super().__init__(name=name, daemon=True)
+        self.test = test
+        self.restart_delay = restart_delay
+        self.loop = None
+        self.servers: Dict[str, Async_Server_Record] = {}
+        self._ready = threading.Event()
+        # Start the thread immediately, as Server_Thread does, and wait
+        # for the loop so servers can be added right away.
+        self.start()
+        self._ready.wait()
+
+    def run(self):
+        '''
+        Entry point for the thread; runs the loop until Close().
+        '''
+        # ProactorEventLoop is required for named pipes, and is already
+        # the Windows default; be explicit in case a policy changed it.
+        if IS_WINDOWS:
+            loop = asyncio.ProactorEventLoop()
+        else:
+            loop = asyncio.new_event_loop()
+        asyncio.set_event_loop(loop)
+        self.loop = loop
+        self._ready.set()
+        try:
+            loop.run_forever()
+        finally:
+            # Give any servers still running a chance to clean up.
+            tasks = asyncio.all_tasks(loop)
+            for task in tasks:
+                task.cancel()
+            if tasks:
+                loop.run_until_complete(asyncio.gather(*tasks, return_exceptions=True))
+            loop.run_until_complete(loop.shutdown_asyncgens())
+            loop.close()
+
+    def Add_Server(self, entry_function: Callable, name: Optional[str] = None) -> str:
+        '''
+        Start hosting a coroutine server. Thread safe.
+        Returns the server name, which defaults to the function's
+        qualified name; a numeric suffix is added if already in use.
+        '''
+        if not inspect.iscoroutinefunction(entry_function):
+            raise TypeError(f"{entry_function!r} is not an async function")
+        name = name or f"{entry_function.__module__}.{entry_function.__qualname__}"
+        return self._Call(self._Add_Server, entry_function, name)
+
+    def Remove_Server(self, name: str, timeout: float = 5.0) -> bool:
+        '''
+        Stop a hosted server and wait for it to finish. Thread safe.
+        Returns False if no server had that name.
+        '''
+        future = asyncio.run_coroutine_threadsafe(self._Stop_Server(name), self.loop)
+        return future.result(timeout)
+
+    def Get_Status(self) -> Dict[str, dict]:
+        '''
+        Return a dict of per-server status dicts, keyed by name:
+        'running', 'starts', 'last_restart_delay'. Thread safe.
+        '''
+        return self._Call(lambda: {
+            name: {
+                'running': record.task is not None,
+                'starts': record.starts,
+                'last_restart_delay': record.last_restart_delay,
+            } for name, record in self.servers.items()})
+
+    def Close(self):
+        '''
+        Stop all servers and then the loop. Returns without waiting;
+        use Join() to wait.
+        '''
+        if self.loop.is_closed():
+            return
+        try:
+            asyncio.run_coroutine_threadsafe(self._Shutdown(), self.loop)
+        except RuntimeError:
+            # Loop closed in the meantime.
+            pass
+
+    def Join(self, timeout: float = 5.0):
+        '''
+        Wait for the thread to terminate, with a timeout.
+        If the thread does not terminate within the timeout, log a warning.
+        '''
+        super().join(timeout)
+        if self.is_alive():
+            logger.warning(f"Thread {self.name} did not terminate within {timeout} seconds")
+
+    def _Call(self, function, *args):
+        '''
+        Run a plain function on the loop thread and return its result.
+        '''
+        if threading.current_thread() is self:
+            return function(*args)
+        future = asyncio.run_coroutine_threadsafe(self._Wrap(function, *args), self.loop)
+        return future.result()
+
+    @staticmethod
+    async def _Wrap(function, *args):
+        return function(*args)
+
+    def _Add_Server(self, entry_function, name):
+        base_name = name
+        suffix = 1
+        while name in self.servers:
+            suffix += 1
+            name = f"{base_name}_{suffix}"
+        record = Async_Server_Record(name, entry_function)
+        record.stop_event = asyncio.Event()
+        record.task = self.loop.create_task(self._Supervise(record), name=name)
+        self.servers[name] = record
+        logger.debug(f"{self.name}: added server {name}")
+        return name
+
+    async def _Supervise(self, record: Async_Server_Record):
+        '''
+        Run a server's entry function, restarting it on disconnects.
+        '''
+        pass_stop_event = len(inspect.signature(record.entry_function).parameters) >= 1
+        try:
+            while not record.stop_event.is_set():
+                disconnect_time = None
+                record.starts += 1
+                record.last_start = time.perf_counter()
+                try:
+                    if pass_stop_event:
+                        await record.entry_function(record.stop_event)
+                    else:
+                        await record.entry_function()
+                    logger.info(f"{record.name}: server returned.")
+                    return
+                except (ConnectionError, Client_Garbage_Collected) as ex:
+                    disconnect_time = time.perf_counter()
+                    if self.test:
+                        logger.info(f"{record.name}: pipe client disconnected; stopping test.")
+                        return
+                    if record.stop_event.is_set():
+                        return
+                    if isinstance(ex, Client_Garbage_Collected):
+                        logger.info(f"{record.name}: pipe client garbage collected, restarting server.")
+                    else:
+                        logger.info(f"{record.name}: pipe client disconnected, restarting server.")
+                except Exception as ex:
+                    logger.error(f"{record.name}: server failed: {ex}", exc_info=True)
+                    return
+
+                Metrics.server_restarts.Labels(server=record.name).Inc()
+                if self.restart_delay:
+                    await asyncio.sleep(self.restart_delay)
+                record.last_restart_delay = time.perf_counter() - disconnect_time
+        finally:
+            record.task = None
+
+    async def _Stop_Server(self, name):
+        record = self.servers.pop(name, None)
+        if record is None:
+            return False
+        task = record.task
+        record.stop_event.set()
+        if task is not None:
+            task.cancel()
+            await asyncio.gather(task, return_exceptions=True)
+        logger.debug(f"{self.name}: removed server {name}")
+        return True
+
+    async def _Shutdown(self):
+        names = list(self.servers)
+        logger.info(f"{self.name}: stopping {len(names)} servers")
+        await asyncio.gather(*[self._Stop_Server(name) for name in names])
+        self.loop.stop()
@@ -1,9 +1,120 @@
+import os
+import sys
 import time
+import select
+from collections import deque
 from pathlib import Path
-from typing import Optional
+from typing import List, Optional
 
 # Log_Reader.py - Logging Utility
 # Reads log files incrementally and trims them if they exceed a size limit.
+#
+# New data is read in large blocks and split into lines in a buffer. While
+# waiting for more, the reader sleeps on a file change notification
+# (inotify on Linux, a directory change notification on Windows), falling
+# back to polling where neither is available. Trimming streams the kept
+# tail through a fixed size buffer, so memory use doesn't grow with the log.
+
+# Bytes per read from the log.
+READ_BLOCK_SIZE = 64 * 1024
+# Bytes per copy step when trimming.
+TRIM_BLOCK_SIZE = 1024 * 1024
+
+
+class _Poll_Watcher:
+    '''
+    Fallback change waiter: sleeps for the poll interval.
+    '''
+    def __init__(self, path: Path, poll_interval: float):
+        self.max_wait = poll_interval
+
+    def wait(self, timeout: float) -> None:
+        time.sleep(timeout)
+
+    def close(self) -> None:
+        pass
+
+
+class _Inotify_Watcher:
+    '''
+    Change waiter using Linux inotify on the log file.
+    '''
+    # From sys/inotify.h.
+    IN_MODIFY      = 0x002
+    IN_ATTRIB      = 0x004
+    IN_CLOSE_WRITE = 0x008
+    IN_MOVE_SELF   = 0x800
+    IN_DELETE_SELF = 0x400
+
+    def __init__(self, path: Path, poll_interval: float):
+        import ctypes
+        libc = ctypes.CDLL(None, use_errno = True)
+        self.fd = libc.inotify_init1(os.O_NONBLOCK | os.O_CLOEXEC)
+        if self.fd < 0:
+            raise OSError(ctypes.get_errno(), 'inotify_init1 failed')
+        mask = (self.IN_MODIFY | self.IN_ATTRIB | self.IN_CLOSE_WRITE
+                | self.IN_MOVE_SELF | self.IN_DELETE_SELF)
+        if libc.inotify_add_watch(self.fd, os.fsencode(path), mask) < 0:
+            error = ctypes.get_errno()
+            os.close(self.fd)
+            raise OSError(error, f'inotify_add_watch failed for {path}')
+        # Notifications are reliable; recheck now and then regardless.
+        self.max_wait = 1.0
+
+    def wait(self, timeout: float) -> None:
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        if ready:
+            # Drain the queued events; only the wakeup matters.
+            try:
+                while os.read(self.fd, 4096):
+                    pass
+            except BlockingIOError:
+                pass
+
+    def close(self) -> None:
+        os.close(self.fd)
+
+
+class _Win32_Watcher:
+    '''
+    Change waiter using a Windows change notification on the log's folder.
+    Other files in the folder also wake it, which only costs a read attempt.
+    '''
+    def __init__(self, path: Path, poll_interval: float):
+        import win32file
+        import win32event
+        import win32con
+        self.win32file = win32file
+        self.win32event = win32event
+        self.handle = win32file.FindFirstChangeNotification(
+            str(path.resolve().parent), False,
+            win32con.FILE_NOTIFY_CHANGE_SIZE | win32con.FILE_NOTIFY_CHANGE_LAST_WRITE)
+        # Size changes of a file held open by its writer can be reported
+        # lazily, so keep a short recheck.
+        self.max_wait = 0.5
+
+    def wait(self, timeout: float) -> None:
+        result = self.win32event.WaitForSingleObject(self.handle, int(timeout * 1000))
+        if result == self.win32event.WAIT_OBJECT_0:
+            self.win32file.FindNextChangeNotification(self.handle)
+
+    def close(self) -> None:
+        self.win32file.FindCloseChangeNotification(self.handle)
+
+
+def _Make_Watcher(path: Path, poll_interval: float, notify: bool):
+    '''
+    Best available change waiter for the platform, else polling.
+    '''
+    if notify:
+        watcher_class = {'linux': _Inotify_Watcher, 'win32': _Win32_Watcher}.get(sys.platform)
+        if watcher_class:
+            try:
+                return watcher_class(path, poll_interval)
+            except Exception:
+                pass
+    return _Poll_Watcher(path, poll_interval)
+
 
 class Log_Reader:
     '''
@@ -12,18 +123,92 @@ class Log_Reader:
 
     Parameters:
     * log_path: Path to the log file (str or Path object).
+    * poll_interval: Seconds between checks when change notifications are unavailable.
+    * notify: If False, always poll.
+    * encoding: Text encoding of the log; undecodable bytes are replaced.
 
     Attributes:
-    * file: Open file instance, typically positioned at the end.
-    * partial_line: Partially read line for the current read attempt.
+    * file: Open binary file instance, typically positioned at the end.
+    * lines: Deque of complete lines read but not yet returned.
+    * partial: List of byte chunks of a line not yet terminated.
+    * watcher: Change waiter used while no new data is available.
     '''
-    def __init__(self, log_path: str | Path):
+    def __init__(self, log_path: str | Path, poll_interval: float = 0.1,
+                 notify: bool = True, encoding: str = 'utf-8'):
         # Convert to Path object if string is provided
-        log_path = Path(log_path) if isinstance(log_path, str) else log_path
-        self.file = log_path.open('r')
-        self.partial_line = ''
+        self.path = Path(log_path) if isinstance(log_path, str) else log_path
+        self.poll_interval = poll_interval
+        self.notify = notify
+        self.encoding = encoding
+        self.file = self.path.open('rb', buffering = 0)
+        self.lines = deque()
+        self.partial = []
         # Seek to the end of the file
         self.file.seek(0, 2)
+        self.watcher = _Make_Watcher(self.path, poll_interval, notify)
+
+    def _fill(self) -> bool:
+        '''
+        Read one block of new data into the line buffer.
+        Returns True if anything was read.
+        '''
+        data = self.file.read(READ_BLOCK_SIZE)
+        if not data:
+            self._check_replaced()
+            return False
+        end = data.rfind(b'\n')
+        if end < 0:
+            self.partial.append(data)
+            return True
+        head = data[:end]
+        if self.partial:
+            head = b''.join(self.partial) + head
+            self.partial = []
+        if end + 1 < len(data):
+            self.partial.append(data[end + 1:])
+        for line in head.split(b'\n'):
+            self.lines.append(line.rstrip(b'\r').decode(self.encoding, 'replace'))
+        return True
+
+    def _check_replaced(self) -> None:
+        '''
+        Handle the log being truncated, or replaced by a new file (eg. a
+        game restart), by starting over at the top of the current file.
+        '''
+        position = self.file.tell()
+        try:
+            path_stat = self.path.stat()
+        except OSError:
+            # Missing for the moment; keep waiting on the old file.
+            return
+        file_stat = os.fstat(self.file.fileno())
+        if (path_stat.st_ino, path_stat.st_dev) != (file_stat.st_ino, file_stat.st_dev):
+            self.file.close()
+            self.file = self.path.open('rb', buffering = 0)
+            self.watcher.close()
+            self.watcher = _Make_Watcher(self.path, self.poll_interval, self.notify)
+            self.partial = []
+        elif file_stat.st_size < position:
+            self.file.seek(0)
+            self.partial = []
+
+    def _wait_for_lines(self, timeout: Optional[float]) -> bool:
+        '''
+        Fill the line buffer until it has a line, or the timeout passes.
+        Returns True if a line is available.
+        '''
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while not self.lines:
+            if self._fill():
+                continue
+            wait = self.watcher.max_wait
+            if deadline is not None:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return False
+                wait = min(wait, remaining)
+            self.watcher.wait(wait)
+        return True
 
     def readline(self, timeout: Optional[float] = None) -> Optional[str]:
         '''
@@ -35,38 +220,76 @@ class Log_Reader:
         Returns:
         * str: The next log line, or None if timeout is reached.
         '''
-        start_time = time.time()
-        while True:
-            chunk = self.file.readline()
-            if chunk:
-                self.partial_line += chunk
-                if self.partial_line.endswith('\n'):
-                    line = self.partial_line[:-1]
-                    self.partial_line = ''
-                    return line
-            else:
-                if timeout is not None and (time.time() - start_time) > timeout:
-                    return None
-                time.sleep(0.1)
+        if not self._wait_for_lines(timeout):
+            return None
+        return self.lines.popleft()
+
+    def readlines(self, timeout: Optional[float] = None) -> List[str]:
+        '''
+        Read all complete lines available, waiting up to timeout for at
+        least one.
+
+        Returns:
+        * list: The lines, empty if timeout is reached.
+        '''
+        if not self._wait_for_lines(timeout):
+            return []
+        # Take whatever else has arrived as well.
+        while self._fill():
+            pass
+        lines = list(self.lines)
+        self.lines.clear()
+        return lines
 
     def trim_log(self, max_size: int = 1024 * 1024) -> None:
         '''
         Trim the log file to keep only the last part if it exceeds max_size.
+        The kept part starts on a line boundary, and is moved to the top of
+        the file a block at a time. Unread data stays unread.
 
         Args:
         * max_size: Maximum file size in bytes before trimming (default: 1MB).
         '''
-        current_pos = self.file.tell()
-        if current_pos > max_size:
-            # Read all data from the current position
-            self.file.seek(0)
-            data = self.file.read()
-            # Keep the last max_size bytes
-            trimmed_data = data[-max_size:]
-            # Truncate and rewrite
+        size = os.fstat(self.file.fileno()).st_size
+        if size <= max_size:
+            return
+
+        with self.path.open('r+b') as file:
+            # Start the kept tail after the first line break within it.
+            cut = size - max_size
+            file.seek(cut)
+            probe = file.read(min(max_size, TRIM_BLOCK_SIZE))
+            newline = probe.find(b'\n')
+            if newline >= 0:
+                cut += newline + 1
+
+            # Copy forward; the source always leads the destination.
+            source = cut
+            destination = 0
+            while True:
+                file.seek(source)
+                block = file.read(TRIM_BLOCK_SIZE)
+                if not block:
+                    break
+                file.seek(destination)
+                file.write(block)
+                source += len(block)
+                destination += len(block)
+            file.truncate(destination)
+            file.flush()
+
+        # Keep this reader's place in the moved data.
+        position = self.file.tell()
+        if position >= cut:
+            self.file.seek(position - cut)
+        else:
+            # Unread data was trimmed away; drop the partial line with it.
             self.file.seek(0)
-            self.file.truncate()
-            self.file.write(trimmed_data)
-            self.file.flush()
-            # Reset to end
-            self.file.seek(0, 2)
\ No newline at end of file
+            self.partial = []
+
+    def close(self) -> None:
+        '''
+        Close the log file and any change notification.
+        '''
+        self.watcher.close()
+        self.file.close()
@@ -0,0 +1,226 @@
+import threading
+from bisect import bisect_left
+from typing import Dict, Iterable, List, Optional, Tuple
+
+# Metrics.py - Metrics Registry
+# Counters, gauges and histograms with labels, kept per process and
+# rendered in the Prometheus text exposition format.
+#
+# Each process updates its own `registry`. Module processes send
+# Snapshot()s to the main server process (see Modules/metrics_exporter.py),
+# which renders them all, with a 'process' label added, into one export.
+#
+# Updates take a per-series lock, so series can be shared by threads; hot
+# paths should look up their labelled series once (Labels()) and keep it.
+
+# Message size buckets in bytes.
+SIZE_BUCKETS = (16, 64, 256, 1024, 4096, 16384, 65536)
+# Latency buckets in seconds.
+LATENCY_BUCKETS = (0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0, 5.0)
+
+
+class Counter_Series:
+    '''
+    One labelled counter value.
+    '''
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.value = 0
+
+    def Inc(self, amount: float = 1) -> None:
+        with self.lock:
+            self.value += amount
+
+    def Samples(self, name: str, labels: tuple) -> list:
+        return [(name + '_total', labels, self.value)]
+
+
+class Gauge_Series:
+    '''
+    One labelled gauge value.
+    '''
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.value = 0
+
+    def Set(self, value: float) -> None:
+        self.value = value
+
+    def Inc(self, amount: float = 1) -> None:
+        with self.lock:
+            self.value += amount
+
+    def Samples(self, name: str, labels: tuple) -> list:
+        return [(name, labels, self.value)]
+
+
+class Histogram_Series:
+    '''
+    One labelled histogram. Bucket counts are kept per bucket and made
+    cumulative when rendered.
+    '''
+    def __init__(self, buckets: Tuple[float, ...]):
+        self.lock = threading.Lock()
+        self.buckets = buckets
+        # One extra slot for +Inf.
+        self.counts = [0] * (len(buckets) + 1)
+        self.sum = 0.0
+
+    def Observe(self, value: float) -> None:
+        index = bisect_left(self.buckets, value)
+        with self.lock:
+            self.counts[index] += 1
+            self.sum += value
+
+    def Samples(self, name: str, labels: tuple) -> list:
+        with self.lock:
+            counts = list(self.counts)
+            total = self.sum
+        samples = []
+        cumulative = 0
+        for bound, count in zip(self.buckets + (float('inf'),), counts):
+            cumulative += count
+            samples.append((name + '_bucket', labels + (('le', _Format_Value(bound)),), cumulative))
+        samples.append((name + '_count', labels, cumulative))
+        samples.append((name + '_sum', labels, total))
+        return samples
+
+
+class Metric:
+    '''
+    A named metric family, holding one series per distinct label values.
+    Created through Registry.Counter/Gauge/Histogram.
+    '''
+    def __init__(self, kind: str, name: str, help: str, label_names: Iterable[str], buckets = None):
+        self.kind = kind
+        self.name = name
+        self.help = help
+        self.label_names = tuple(label_names)
+        self.buckets = tuple(buckets) if buckets else None
+        self.series = {}
+        self.lock = threading.Lock()
+
+    def Labels(self, **labels):
+        '''
+        Return the series for these label values, creating it on first use.
+        '''
+        key = tuple(str(labels[name]) for name in self.label_names)
+        series = self.series.get(key)
+        if series is None:
+            with self.lock:
+                series = self.series.get(key)
+                if series is None:
+                    if self.kind == 'counter':
+                        series = Counter_Series()
+                    elif self.kind == 'gauge':
+                        series = Gauge_Series()
+                    else:
+                        series = Histogram_Series(self.buckets)
+                    self.series[key] = series
+        return series
+
+    def Samples(self) -> list:
+        samples = []
+        for key, series in list(self.series.items()):
+            samples.extend(series.Samples(self.name, tuple(zip(self.label_names, key))))
+        return samples
+
+
+class Registry:
+    '''
+    The metrics of one process.
+    '''
+    def __init__(self):
+        self.metrics = {}
+        self.lock = threading.Lock()
+
+    def _Get(self, kind, name, help, labels, buckets = None) -> Metric:
+        with self.lock:
+            metric = self.metrics.get(name)
+            if metric is None:
+                metric = self.metrics[name] = Metric(kind, name, help, labels, buckets)
+            elif metric.kind != kind:
+                raise ValueError(f"Metric {name} already registered as a {metric.kind}")
+            return metric
+
+    def Counter(self, name: str, help: str, labels: Iterable[str] = ()) -> Metric:
+        return self._Get('counter', name, help, labels)
+
+    def Gauge(self, name: str, help: str, labels: Iterable[str] = ()) -> Metric:
+        return self._Get('gauge', name, help, labels)
+
+    def Histogram(self, name: str, help: str, labels: Iterable[str] = (), buckets = LATENCY_BUCKETS) -> Metric:
+        return self._Get('histogram', name, help, labels, buckets)
+
+    def Snapshot(self) -> List[tuple]:
+        '''
+        Picklable copy of all current values:
+        a list of (name, kind, help, [(sample name, labels, value)]).
+        '''
+        return [(metric.name, metric.kind, metric.help, metric.Samples())
+                for metric in list(self.metrics.values())]
+
+
+def _Format_Value(value: float) -> str:
+    if value == float('inf'):
+        return '+Inf'
+    if isinstance(value, float) and value.is_integer() and abs(value) < 1e15:
+        return str(int(value))
+    return repr(value)
+
+
+def _Format_Labels(labels: tuple) -> str:
+    if not labels:
+        return ''
+    parts = []
+    for name, value in labels:
+        value = str(value).replace('\\', '\\\\').replace('\n', '\\n').replace('"', '\\"')
+        parts.append(f'{name}="{value}"')
+    return '{' + ','.join(parts) + '}'
+
+
+def Render_Text(snapshots: Dict[Optional[str], List[tuple]]) -> str:
+    '''
+    Render snapshots in the Prometheus text format. `snapshots` maps a
+    process name (None for no label) to that process's Snapshot(); series
+    of the same metric from different processes are grouped under one
+    HELP/TYPE header. Families with no series yet are left out.
+    '''
+    families = {}
+    for process, snapshot in snapshots.items():
+        extra = (('process', process),) if process is not None else ()
+        for name, kind, help, samples in snapshot:
+            family = families.setdefault(name, (kind, help, []))
+            family[2].extend((sample_name, extra + labels, value) for sample_name, labels, value in samples)
+
+    lines = []
+    for name, (kind, help, samples) in sorted(families.items()):
+        if not samples:
+            continue
+        # The 0.0.4 text format types a sample only when the header names
+        # it exactly, so counter headers carry the _total suffix too.
+        if kind == 'counter':
+            name += '_total'
+        lines.append(f"# HELP {name} {help}")
+        lines.append(f"# TYPE {name} {kind}")
+        for sample_name, labels, value in samples:
+            lines.append(f"{sample_name}{_Format_Labels(labels)} {_Format_Value(value)}")
+    return '\n'.join(lines) + '\n'
+
+
+# Metrics of this process.
+registry = Registry()
+
+# Standard metrics, updated by the pipe classes and server hosts.
+# Message count and byte throughput are the _count and _sum of the size
+# histogram, so a message costs one Observe().
+pipe_message_bytes = registry.Histogram(
+    'x4_pipe_message_bytes', 'Size of pipe messages read or written.',
+    ('pipe', 'direction'), SIZE_BUCKETS)
+pipe_handler_seconds = registry.Histogram(
+    'x4_pipe_handler_seconds', 'Time from reading a message to writing the next reply.',
+    ('pipe',))
+pipe_errors = registry.Counter(
+    'x4_pipe_errors', 'Pipe read or write errors.', ('pipe',))
+server_restarts = registry.Counter(
+    'x4_server_restarts', 'Pipe server restarts after a client disconnect.', ('server',))
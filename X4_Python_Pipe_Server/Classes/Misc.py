@@ -5,4 +5,19 @@ class Client_Garbage_Collected(Exception):
     '''
     Custom exception raised when a client pipe is garbage collected.
     Used as an alternative to proper file closing due to crashes in X4 v3.0.
-    '''
\ No newline at end of file
+    '''
+
+# Callback run once, on the first message read by any pipe in this process,
+# given the message. Used to report module time-to-first-message.
+first_read_callback = None
+
+def Fire_First_Read(message):
+    '''
+    Run and clear first_read_callback. Pipes call this only while the
+    callback is set, so afterwards reads pay just the None check.
+    '''
+    global first_read_callback
+    callback = first_read_callback
+    first_read_callback = None
+    if callback is not None:
+        callback(message)
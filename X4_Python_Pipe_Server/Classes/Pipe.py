@@ -10,6 +10,9 @@ import ntsecuritycon as con
 from pywintypes import error as Win32Error
 from typing import Optional
 from .Misc import Client_Garbage_Collected
+from . import Misc
+from . import Pipe_Capture
+from . import Metrics
 
 
 class Pipe:
@@ -21,6 +24,8 @@ class Pipe:
     Shared diagnostics, logging, and read/write operations are implemented here.
     Subclasses must implement `connect()` (for clients) or `create()` (for servers), and `close()`.
     """
+    # True for server ends; sets message direction in traffic captures.
+    is_server = False
 
     def __init__(self, pipe_name: str, buffer_size: Optional[int] = None):
         """
@@ -45,6 +50,13 @@ class Pipe:
             'last_write': None,
             'last_error': None
         }
+        # Metric series, looked up once rather than per message.
+        self.metric_read_bytes = Metrics.pipe_message_bytes.Labels(pipe=pipe_name, direction='read')
+        self.metric_write_bytes = Metrics.pipe_message_bytes.Labels(pipe=pipe_name, direction='write')
+        self.metric_handler = Metrics.pipe_handler_seconds.Labels(pipe=pipe_name)
+        self.metric_errors = Metrics.pipe_errors.Labels(pipe=pipe_name)
+        # perf_counter of the last read not yet answered by a write.
+        self.unanswered_read_time = None
 
         self.logger = logging.getLogger(__name__)
 
@@ -55,11 +67,18 @@ class Pipe:
         """
         try:
             result, data = win32file.ReadFile(self.pipe_in, self.buffer_size)
+            if Pipe_Capture.active is not None:
+                Pipe_Capture.active.Record(self.pipe_name, not self.is_server, bytes(data))
+            self.metric_read_bytes.Observe(len(data))
+            self.unanswered_read_time = time.perf_counter()
             message = data.decode('utf-8')
             self.diagnostics['reads'] += 1
             self.diagnostics['last_read'] = time.time()
 
-            self.logger.debug(f"Read from pipe: {message}")
+            # Per-message; args are only formatted if the record is kept.
+            self.logger.debug("Read from pipe: %s", message)
+            if Misc.first_read_callback is not None:
+                Misc.Fire_First_Read(message)
             if message == 'garbage_collected':
                 raise Client_Garbage_Collected()
             return message
@@ -67,6 +86,7 @@ class Pipe:
             self.diagnostics['last_error'] = str(ex)
             if ex.winerror == winerror.ERROR_NO_DATA and self.nowait_set:
                 return None
+            self.metric_errors.Inc()
             self.logger.error(f"Read error: {ex}")
             raise
 
@@ -76,13 +96,21 @@ class Pipe:
         :param message: The message string to write.
         """
         try:
-            win32file.WriteFile(self.pipe_out, message.encode('utf-8'))
+            data = message.encode('utf-8')
+            win32file.WriteFile(self.pipe_out, data)
+            if Pipe_Capture.active is not None:
+                Pipe_Capture.active.Record(self.pipe_name, self.is_server, data)
+            self.metric_write_bytes.Observe(len(data))
+            if self.unanswered_read_time is not None:
+                self.metric_handler.Observe(time.perf_counter() - self.unanswered_read_time)
+                self.unanswered_read_time = None
             self.diagnostics['writes'] += 1
             self.diagnostics['last_write'] = time.time()
-            self.logger.debug(f"Wrote to pipe: {message}")
+            self.logger.debug("Wrote to pipe: %s", message)
             win32file.FlushFileBuffers(self.pipe_out)
         except Win32Error as ex:
             self.diagnostics['last_error'] = str(ex)
+            self.metric_errors.Inc()
             self.logger.error(f"Write error: {ex}")
             raise
 
@@ -144,6 +172,7 @@ class Pipe_Server(Pipe):
     """
     Named pipe server using unidirectional read/write pipes.
     """
+    is_server = True
 
     def __init__(self, pipe_name: str, buffer_size: Optional[int] = None, verbose: bool = False):
         """
@@ -0,0 +1,207 @@
+import atexit
+import os
+import struct
+import threading
+import time
+from collections import namedtuple
+from pathlib import Path
+from typing import Iterable, Iterator, Optional, Union
+
+# Pipe_Capture.py - Traffic Capture
+# Records every pipe message to a compact binary log, for replay by
+# Pipe_Replay.py. The lua side's winpipe dll writes the same format (see
+# winpipe.set_capture in Win_Pipe_API/winpipe.c), so a session can be
+# captured from either end.
+#
+# File header: b"X4PC", u16 version, u16 reserved.
+# Records (little-endian): u8 kind, u8 flags, u16 pipe_id,
+#   u64 unix time in ns, u32 payload length, payload.
+# Kind 1 declares the name of a pipe_id; kind 2 is a message.
+#
+# Capturing is per process. Start_Capture() enables it directly; or set the
+# X4_PIPE_CAPTURE environment variable to a base path, and each process
+# importing this module captures to "<base>_<pid>.x4cap", which lets the
+# server's module processes capture too. Files are only created once a
+# process has a message to record, so idle (eg. prewarmed) processes
+# leave none behind.
+
+MAGIC = b'X4PC'
+VERSION = 1
+KIND_PIPE = 1
+KIND_MESSAGE = 2
+# Flag bits.
+TO_CLIENT = 0x01
+NATIVE = 0x02
+
+_file_header = struct.Struct('<4sHH')
+_record_header = struct.Struct('<BBHQI')
+
+ENV_VAR = 'X4_PIPE_CAPTURE'
+
+# Capture_Writer of this process, or None when not capturing. Pipes check
+# this before doing any capture work.
+active = None
+
+Capture_Record = namedtuple('Capture_Record', ['time_ns', 'pipe', 'to_client', 'data', 'native'])
+Capture_Record.__doc__ = '''
+One captured message.
+* time_ns: unix time in nanoseconds.
+* pipe: pipe base name (eg. 'x4_time'), the same from both ends.
+* to_client: bool, True for server-to-x4 messages.
+* data: bytes.
+* native: bool, True if recorded by the winpipe dll.
+'''
+
+
+class Capture_Writer:
+    '''
+    Appends records to a capture file through a large buffer. Thread safe,
+    for servers with pipes in several threads. The file is created on the
+    first record.
+    '''
+    def __init__(self, path: Union[str, Path], flush_interval: float = 1.0):
+        self.path = Path(path)
+        self.file = None
+        self.closed = False
+        self.lock = threading.Lock()
+        self.pipe_ids = {}
+        self.flush_interval = flush_interval
+        self.last_flush = time.monotonic()
+        self.records = 0
+
+    def Record(self, pipe_name: str, to_client: bool, data: bytes) -> None:
+        with self.lock:
+            if self.file is None:
+                if self.closed:
+                    return
+                self.file = open(self.path, 'wb', buffering = 1 << 16)
+                self.file.write(_file_header.pack(MAGIC, VERSION, 0))
+            pipe_id = self.pipe_ids.get(pipe_name)
+            if pipe_id is None:
+                pipe_id = self.pipe_ids[pipe_name] = len(self.pipe_ids) + 1
+                name = pipe_name.encode('utf-8')
+                self.file.write(_record_header.pack(KIND_PIPE, 0, pipe_id, time.time_ns(), len(name)))
+                self.file.write(name)
+            self.file.write(_record_header.pack(
+                KIND_MESSAGE, TO_CLIENT if to_client else 0, pipe_id, time.time_ns(), len(data)))
+            self.file.write(data)
+            self.records += 1
+            # Bound how much a crash can lose.
+            now = time.monotonic()
+            if now - self.last_flush >= self.flush_interval:
+                self.last_flush = now
+                self.file.flush()
+
+    def Close(self) -> None:
+        with self.lock:
+            self.closed = True
+            if self.file is not None:
+                self.file.close()
+                self.file = None
+
+
+def Start_Capture(path: Union[str, Path]) -> Capture_Writer:
+    '''
+    Capture all pipe traffic of this process to a new file at path,
+    replacing any earlier capture.
+    '''
+    global active
+    Stop_Capture()
+    active = Capture_Writer(path)
+    return active
+
+
+def Stop_Capture() -> None:
+    global active
+    writer, active = active, None
+    if writer is not None:
+        writer.Close()
+
+
+def Process_Capture_Path(base: Union[str, Path], pid: Optional[int] = None) -> Path:
+    '''
+    Per-process capture file for a capture base path.
+    '''
+    base = Path(base)
+    return base.with_name(f"{base.stem}_{pid or os.getpid()}.x4cap")
+
+
+def Normalize_Pipe_Name(name: str) -> str:
+    '''
+    Reduce a native pipe path (eg. '\\\\.\\pipe\\x4_time_in') to the base
+    name python sides use ('x4_time').
+    '''
+    name = name.replace('/', '\\').rsplit('\\', 1)[-1]
+    for suffix in ('_in', '_out'):
+        if name.endswith(suffix):
+            return name[:-len(suffix)]
+    return name
+
+
+def Read_Capture(path: Union[str, Path]) -> Iterator[Capture_Record]:
+    '''
+    Yield the messages of one capture file, in file order.
+    A record cut short at the end (eg. by a crash) ends the iteration.
+    '''
+    with open(path, 'rb') as file:
+        header = file.read(_file_header.size)
+        if len(header) < _file_header.size:
+            return
+        magic, version, _ = _file_header.unpack(header)
+        if magic != MAGIC:
+            raise ValueError(f"{path} is not a pipe capture file")
+        if version > VERSION:
+            raise ValueError(f"{path} has unsupported capture version {version}")
+
+        names = {}
+        while True:
+            header = file.read(_record_header.size)
+            if len(header) < _record_header.size:
+                return
+            kind, flags, pipe_id, time_ns, length = _record_header.unpack(header)
+            data = file.read(length)
+            if len(data) < length:
+                return
+            if kind == KIND_PIPE:
+                names[pipe_id] = Normalize_Pipe_Name(data.decode('utf-8', 'replace'))
+            elif kind == KIND_MESSAGE:
+                yield Capture_Record(
+                    time_ns, names.get(pipe_id, f"pipe_{pipe_id}"),
+                    bool(flags & TO_CLIENT), data, bool(flags & NATIVE))
+
+
+def Read_Captures(paths: Iterable[Union[str, Path]]) -> list:
+    '''
+    Load and merge several capture files (eg. per process, or from both
+    ends), sorted by time.
+
+    A pipe captured from both ends holds every message twice, once per
+    end, and the ends stamp them at slightly different times. For such
+    pipes only one end's records are kept: the end with more of them
+    (eg. the one capturing longer), or the server end on a tie.
+    '''
+    records = []
+    for path in paths:
+        records.extend(Read_Capture(path))
+
+    # Record counts per pipe, as (server end, native end).
+    counts = {}
+    for record in records:
+        count = counts.setdefault(record.pipe, [0, 0])
+        count[record.native] += 1
+    # Native flag of the end dropped, for pipes captured at both.
+    dropped = {pipe: count[1] <= count[0] for pipe, count in counts.items()
+                   if count[0] and count[1]}
+    if dropped:
+        records = [record for record in records
+                   if record.pipe not in dropped
+                   or record.native != dropped[record.pipe]]
+
+    records.sort(key = lambda record: record.time_ns)
+    return records
+
+
+# Pick up capturing requested through the environment.
+if os.environ.get(ENV_VAR):
+    Start_Capture(Process_Capture_Path(os.environ[ENV_VAR]))
+    atexit.register(Stop_Capture)
@@ -0,0 +1,411 @@
+import os
+import json
+import mmap
+import time
+import struct
+from array import array
+from bisect import bisect_left, bisect_right
+from pathlib import Path
+from typing import Dict, Iterable, List, Optional, Tuple, Union
+from . import Stats
+
+# Series_Store.py - Session Time-Series Store
+# Append-only columnar storage for measurements taken during a session
+# (frame times, profiler counts, ...), written by module servers and
+# read back by Series_Tool.py.
+#
+# A session is a folder holding:
+# - time.f8, series.u4, value.f8: one fixed-width little-endian column
+#   each, one row per sample. Times never decrease.
+# - blocks.bin: per flushed block of rows, one summary record per series
+#   present in it (rows, times, count, sum, min, max). Summaries over any
+#   time range read these, and scan only the rows of the partial blocks
+#   at the range edges, so hours of data summarize in milliseconds.
+# - index.json: series names by id, and session details.
+#
+# Readers memory-map the columns, and see everything covered by a block
+# record at the time they open; rows written after the last block record
+# (eg. before a crash) are ignored.
+
+VERSION = 1
+
+TIME_FILE = 'time.f8'
+SERIES_FILE = 'series.u4'
+VALUE_FILE = 'value.f8'
+BLOCKS_FILE = 'blocks.bin'
+INDEX_FILE = 'index.json'
+
+# start_row, end_row, first_time, last_time, series id, count, sum, min, max
+_block_record = struct.Struct('<QQddIIddd')
+
+
+class Series_Writer:
+    '''
+    Appends samples to a new or existing session folder. Not thread safe.
+
+    * block_rows
+      - Rows buffered in memory before being written out as a block.
+    * flush_interval
+      - Seconds after which a partial block is written anyway, so readers
+        and crashes lose little.
+    * reorder_window
+      - Seconds of the newest buffered rows held back at each flush (but
+        not on Close), for samples that arrive late, eg. stamped from a
+        batch of past frames. Buffered rows are written in time order;
+        only rows older than what was already written are moved up to
+        the last written time.
+    '''
+    def __init__(self, path: Union[str, Path], block_rows: int = 4096,
+                 flush_interval: float = 10.0, info: Optional[dict] = None,
+                 reorder_window: float = 0.0):
+        self.path = Path(path)
+        self.path.mkdir(parents = True, exist_ok = True)
+        self.block_rows = block_rows
+        self.flush_interval = flush_interval
+        self.reorder_window = reorder_window
+
+        self.index = {'version': VERSION, 'series': [], 'created': time.time(), 'info': info or {}}
+        index_path = self.path / INDEX_FILE
+        if index_path.exists():
+            self.index = json.loads(index_path.read_text())
+            if info:
+                self.index['info'].update(info)
+        self.series_ids = {name: i for i, name in enumerate(self.index['series'])}
+        self._Write_Index()
+
+        # Resume after the last complete block, dropping any torn tail.
+        # last_time is the latest time written out.
+        blocks = _Read_Blocks(self.path / BLOCKS_FILE)
+        self.rows = max((block[1] for block in blocks), default = 0)
+        self.last_time = max((block[3] for block in blocks), default = float('-inf'))
+        self.files = {}
+        for name, size in [(TIME_FILE, 8), (SERIES_FILE, 4), (VALUE_FILE, 8)]:
+            file = open(self.path / name, 'ab')
+            file.truncate(self.rows * size)
+            self.files[name] = file
+        self.blocks_file = open(self.path / BLOCKS_FILE, 'ab')
+        self.blocks_file.truncate(len(blocks) * _block_record.size)
+
+        self.times = array('d')
+        self.ids = array('I')
+        self.values = array('d')
+        self.index_dirty = False
+        self.last_flush = time.monotonic()
+
+    def Series_Id(self, name: str) -> int:
+        series_id = self.series_ids.get(name)
+        if series_id is None:
+            series_id = self.series_ids[name] = len(self.index['series'])
+            self.index['series'].append(name)
+            self.index_dirty = True
+        return series_id
+
+    def Append(self, name: str, value: float, timestamp: Optional[float] = None) -> None:
+        '''
+        Add one sample, at time.time() unless a timestamp is given.
+        Samples may arrive out of time order (see reorder_window).
+        '''
+        if timestamp is None:
+            timestamp = time.time()
+        self._Add(name, value, timestamp)
+        self._Check_Flush()
+
+    def Append_Many(self, samples: Union[Dict[str, float], Iterable[Tuple[str, float]]],
+                    timestamp: Optional[float] = None) -> None:
+        '''
+        Add several samples taken at the same time.
+        '''
+        if timestamp is None:
+            timestamp = time.time()
+        items = samples.items() if isinstance(samples, dict) else samples
+        for name, value in items:
+            self._Add(name, value, timestamp)
+        self._Check_Flush()
+
+    def _Add(self, name, value, timestamp):
+        # Times column must not decrease across written rows.
+        if timestamp < self.last_time:
+            timestamp = self.last_time
+        self.times.append(timestamp)
+        self.ids.append(self.Series_Id(name))
+        self.values.append(value)
+
+    def _Check_Flush(self):
+        if (len(self.times) >= self.block_rows
+                or time.monotonic() - self.last_flush >= self.flush_interval):
+            self.Flush()
+
+    def Flush(self, hold_back: bool = True) -> None:
+        '''
+        Write buffered rows out as a block, in time order. Rows within
+        reorder_window of the newest are kept for the next flush, unless
+        hold_back is False.
+        '''
+        self.last_flush = time.monotonic()
+        if not self.times:
+            return
+
+        # Stable sort by time, so rows at equal times keep their order.
+        order = sorted(range(len(self.times)), key = self.times.__getitem__)
+        times = array('d', (self.times[i] for i in order))
+        ids = array('I', (self.ids[i] for i in order))
+        values = array('d', (self.values[i] for i in order))
+        count = len(times)
+        if hold_back and self.reorder_window > 0:
+            count = bisect_right(times, times[-1] - self.reorder_window)
+            # Hold back at most half a block, so a full buffer always
+            # writes something.
+            count = max(count, len(times) - self.block_rows // 2)
+        self.times, self.ids, self.values = times[count:], ids[count:], values[count:]
+        times, ids, values = times[:count], ids[:count], values[:count]
+        if not count:
+            return
+        if self.index_dirty:
+            # Series must be named before any block refers to them.
+            self._Write_Index()
+
+        for name, column in [(TIME_FILE, times), (SERIES_FILE, ids), (VALUE_FILE, values)]:
+            self.files[name].write(column.tobytes())
+            self.files[name].flush()
+
+        # Per-series summaries of the block.
+        summaries = {}
+        for timestamp, series_id, value in zip(times, ids, values):
+            summary = summaries.get(series_id)
+            if summary is None:
+                summaries[series_id] = [timestamp, timestamp, 1, value, value, value]
+            else:
+                summary[1] = timestamp
+                summary[2] += 1
+                summary[3] += value
+                if value < summary[4]:
+                    summary[4] = value
+                if value > summary[5]:
+                    summary[5] = value
+        start = self.rows
+        end = start + count
+        self.blocks_file.write(b''.join(
+            _block_record.pack(start, end, first, last, series_id, count, total, low, high)
+            for series_id, (first, last, count, total, low, high) in summaries.items()))
+        self.blocks_file.flush()
+
+        self.rows = end
+        self.last_time = times[-1]
+
+    def _Write_Index(self):
+        temp_path = self.path / (INDEX_FILE + '.tmp')
+        temp_path.write_text(json.dumps(self.index, indent = 1))
+        os.replace(temp_path, self.path / INDEX_FILE)
+        self.index_dirty = False
+
+    def Close(self) -> None:
+        if self.files:
+            self.Flush(hold_back = False)
+            for file in self.files.values():
+                file.close()
+            self.blocks_file.close()
+            self.files = {}
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.Close()
+
+
+def _Read_Blocks(path: Path) -> List[tuple]:
+    if not path.exists():
+        return []
+    data = path.read_bytes()
+    usable = len(data) - len(data) % _block_record.size
+    return list(_block_record.iter_unpack(data[:usable]))
+
+
+def _Map_Column(path: Path, typecode: str, rows: int):
+    '''
+    Memory-map a column file as a typed memoryview of `rows` items.
+    Returns (mmap or None, views); the last view is the column, and all
+    must be released before the mmap can close.
+    '''
+    if rows == 0:
+        return None, [memoryview(array(typecode))]
+    with open(path, 'rb') as file:
+        mapped = mmap.mmap(file.fileno(), 0, access = mmap.ACCESS_READ)
+    views = [memoryview(mapped)]
+    views.append(views[-1][:rows * array(typecode).itemsize])
+    views.append(views[-1].cast(typecode))
+    return mapped, views
+
+
+class Series_Summary:
+    '''
+    Aggregate of one series over a time range.
+    '''
+    __slots__ = ('count', 'sum', 'min', 'max', 'first_time', 'last_time')
+
+    def __init__(self):
+        self.count = 0
+        self.sum = 0.0
+        self.min = float('inf')
+        self.max = float('-inf')
+        self.first_time = None
+        self.last_time = None
+
+    def Add(self, count, total, low, high, first_time, last_time):
+        self.count += count
+        self.sum += total
+        if low < self.min:
+            self.min = low
+        if high > self.max:
+            self.max = high
+        if self.first_time is None or first_time < self.first_time:
+            self.first_time = first_time
+        if self.last_time is None or last_time > self.last_time:
+            self.last_time = last_time
+
+    @property
+    def mean(self):
+        return self.sum / self.count if self.count else 0.0
+
+
+class Series_Reader:
+    '''
+    Read-only view of a session, as of when it was opened.
+    Times are as written (time.time() seconds unless given otherwise).
+    '''
+    def __init__(self, path: Union[str, Path]):
+        self.path = Path(path)
+        self.index = json.loads((self.path / INDEX_FILE).read_text())
+        self.names = self.index['series']
+        self.ids = {name: i for i, name in enumerate(self.names)}
+        self.blocks = _Read_Blocks(self.path / BLOCKS_FILE)
+        self.rows = max((block[1] for block in self.blocks), default = 0)
+
+        self.maps = []
+        self.views = []
+        columns = {}
+        for name, typecode in [(TIME_FILE, 'd'), (SERIES_FILE, 'I'), (VALUE_FILE, 'd')]:
+            mapped, views = _Map_Column(self.path / name, typecode, self.rows)
+            if mapped is not None:
+                self.maps.append(mapped)
+            self.views.extend(reversed(views))
+            columns[name] = views[-1]
+        self.times = columns[TIME_FILE]
+        self.series = columns[SERIES_FILE]
+        self.values = columns[VALUE_FILE]
+
+        # Block boundaries, for locating the blocks a row range covers.
+        self.block_starts = sorted({block[0] for block in self.blocks})
+        self.blocks_by_start = {}
+        for block in self.blocks:
+            self.blocks_by_start.setdefault(block[0], []).append(block)
+
+    def Close(self) -> None:
+        self.times = self.series = self.values = None
+        for view in self.views:
+            view.release()
+        self.views = []
+        for mapped in self.maps:
+            mapped.close()
+        self.maps = []
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.Close()
+
+    @property
+    def start_time(self) -> Optional[float]:
+        return self.times[0] if self.rows else None
+
+    @property
+    def end_time(self) -> Optional[float]:
+        return self.times[self.rows - 1] if self.rows else None
+
+    def Row_Range(self, start: Optional[float] = None, end: Optional[float] = None) -> Tuple[int, int]:
+        '''
+        Rows with start <= time <= end, by binary search of the mapped
+        time column.
+        '''
+        first = 0 if start is None else bisect_left(self.times, start)
+        last = self.rows if end is None else bisect_right(self.times, end)
+        return first, max(first, last)
+
+    def Summarize(self, start: Optional[float] = None, end: Optional[float] = None,
+                  names: Optional[Iterable[str]] = None) -> Dict[str, Series_Summary]:
+        '''
+        Count, sum, min, max and mean per series over a time range.
+        Whole blocks inside the range use their stored summaries; only rows
+        in the partial blocks at the edges are scanned.
+        '''
+        wanted = None if names is None else {self.ids[name] for name in names if name in self.ids}
+        first, last = self.Row_Range(start, end)
+        summaries = {}
+
+        def Summary(series_id):
+            summary = summaries.get(series_id)
+            if summary is None:
+                summary = summaries[series_id] = Series_Summary()
+            return summary
+
+        def Scan(row_start, row_end):
+            times, series, values = self.times, self.series, self.values
+            for row in range(row_start, row_end):
+                series_id = series[row]
+                if wanted is None or series_id in wanted:
+                    value = values[row]
+                    Summary(series_id).Add(1, value, value, value, times[row], times[row])
+
+        for block_start in self.block_starts[max(0, bisect_right(self.block_starts, first) - 1):]:
+            if block_start >= last:
+                break
+            records = self.blocks_by_start[block_start]
+            block_end = records[0][1]
+            if block_start >= first and block_end <= last:
+                for _, _, first_time, last_time, series_id, count, total, low, high in records:
+                    if wanted is None or series_id in wanted:
+                        Summary(series_id).Add(count, total, low, high, first_time, last_time)
+            else:
+                Scan(max(first, block_start), min(last, block_end))
+
+        return {self.names[series_id]: summary for series_id, summary in summaries.items()}
+
+    def Values(self, name: str, start: Optional[float] = None,
+               end: Optional[float] = None) -> Tuple[array, array]:
+        '''
+        (times, values) arrays of one series over a time range. Skips
+        blocks not holding the series.
+        '''
+        series_id = self.ids.get(name)
+        times = array('d')
+        values = array('d')
+        if series_id is None:
+            return times, values
+        first, last = self.Row_Range(start, end)
+        for block_start in self.block_starts[max(0, bisect_right(self.block_starts, first) - 1):]:
+            if block_start >= last:
+                break
+            records = self.blocks_by_start[block_start]
+            if not any(record[4] == series_id for record in records):
+                continue
+            row_series = self.series
+            for row in range(max(first, block_start), min(last, records[0][1])):
+                if row_series[row] == series_id:
+                    times.append(self.times[row])
+                    values.append(self.values[row])
+        return times, values
+
+    def Percentiles(self, name: str, fractions: Iterable[float], start: Optional[float] = None,
+                    end: Optional[float] = None) -> List[float]:
+        '''
+        Nearest-rank percentiles of one series over a time range.
+        '''
+        return Stats.Percentiles(self.Values(name, start, end)[1], fractions)
+
+
+def New_Session_Path(base: Union[str, Path], prefix: str) -> Path:
+    '''
+    Folder for a new session under base, named by prefix and start time.
+    '''
+    return Path(base) / time.strftime(f"{prefix}_%Y%m%d_%H%M%S")
@@ -3,6 +3,7 @@ import logging
 import win32api
 import winerror
 from .Misc import Client_Garbage_Collected
+from . import Metrics
 
 # Server_Thread.py - Thread Management
 # Runs server logic in a thread with restart capabilities.
@@ -38,6 +39,7 @@ class Server_Thread(threading.Thread):
         unless the stop_event is set or in test mode.
         '''
         boot_server = True
+        restarts = Metrics.server_restarts.Labels(server=self.name)
         while boot_server and not self.stop_event.is_set():
             boot_server = False
             try:
@@ -52,6 +54,8 @@ class Server_Thread(threading.Thread):
                 elif ex.winerror == winerror.ERROR_BROKEN_PIPE:
                     logging.info('Pipe client disconnected, restarting server.')
                     boot_server = True
+                if boot_server:
+                    restarts.Inc()
 
     def Close(self):
         '''
@@ -0,0 +1,32 @@
+from math import ceil
+from typing import Iterable, List, Sequence
+
+# Stats.py - Shared Statistics
+# The one percentile definition used by the measuring modules and tools,
+# so their reports agree: nearest rank, the smallest sample with at least
+# the given fraction of samples at or below it. p0 is the min, p100 the max.
+
+
+def Nearest_Rank(count: int, fraction: float) -> int:
+    '''
+    1-based rank of the fraction's percentile among count samples.
+    '''
+    # Allow for float error, eg. 0.07 * 100 = 7.000000000000001.
+    rank = ceil(fraction * count - 1e-9)
+    return min(count, max(1, rank))
+
+
+def Percentiles(values: Iterable[float], fractions: Iterable[float],
+                is_sorted: bool = False) -> List[float]:
+    '''
+    Percentiles of values at the given fractions (eg. 0.99), nearest rank.
+    Either may be any iterable. Gives 0.0 per fraction if values is empty.
+    '''
+    fractions = list(fractions)
+    if not is_sorted:
+        values = sorted(values)
+    elif not isinstance(values, Sequence):
+        values = list(values)
+    if not values:
+        return [0.0 for _ in fractions]
+    return [values[Nearest_Rank(len(values), fraction) - 1] for fraction in fractions]
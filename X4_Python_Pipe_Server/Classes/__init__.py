@@ -1,6 +1,14 @@
 '''
 Support classes for the python server.
 '''
-from .Server_Thread import Server_Thread
+import sys
 from .Misc import Client_Garbage_Collected
-from .Pipe import Pipe_Server, Pipe_Client
\ No newline at end of file
+from .Async_Pipe import Async_Pipe_Server, Async_Pipe_Client
+from .Async_Server import Async_Server_Thread
+from .Series_Store import Series_Writer, Series_Reader, New_Session_Path
+from .Stats import Percentiles
+# The blocking pipes use pywin32 directly; the async pipes and host also
+# run elsewhere (over AF_UNIX), for developing servers without the game.
+if sys.platform == 'win32':
+    from .Server_Thread import Server_Thread
+    from .Pipe import Pipe_Server, Pipe_Client
@@ -1,18 +1,22 @@
 import signal
 import sys
+import os
 import json
 import logging
 import threading
 from pathlib import Path
 from importlib import machinery
 import traceback
+import ast
 import win32api
 import winerror
 from X4_Python_Pipe_Server.Modules.logging_utils import setup_main_logging, shutdown_logging
 from X4_Python_Pipe_Server.Modules.handlers import signal_handler, exception_hook, DEVELOPER_MODE
-from X4_Python_Pipe_Server.Modules.server_process import Server_Process
+from X4_Python_Pipe_Server.Modules.worker_pool import Worker_Pool
+from X4_Python_Pipe_Server.Modules.metrics_exporter import Metrics_Exporter
 from X4_Python_Pipe_Server.Modules.config import parse_args, load_permissions, setup_paths, check_permission, permissions_path
-from X4_Python_Pipe_Server.Classes import Pipe_Server, Pipe_Client, Client_Garbage_Collected
+from X4_Python_Pipe_Server.Classes import Pipe_Server, Pipe_Client, Client_Garbage_Collected, Async_Server_Thread
+from X4_Python_Pipe_Server.Classes import Pipe_Capture, Metrics
 
 VERSION = '2.2.0'
 PIPE_NAME = 'x4_python_host'
@@ -38,11 +42,44 @@ def write_server_info(args):
         else:
             logger.warning(f"X4.exe not found at expected test path: {x4exe}")
 
+def get_module_name(path):
+    """Name under which a module file is imported."""
+    return f"user_module_{path.name.replace(' ', '_')}"
+
+def find_main(path):
+    """
+    Kind of the module's top level main, without importing it: 'async'
+    for an `async def main`, 'sync' for any other main, or None if there
+    is none or the file fails to parse.
+    """
+    try:
+        tree = ast.parse(path.read_bytes(), filename=str(path))
+    except Exception as e:
+        logger.error(f"Failed to parse module {path}: {e}")
+        if DEVELOPER_MODE:
+            logger.debug(traceback.format_exc())
+        return None
+    kind = None
+    for node in tree.body:
+        if isinstance(node, ast.AsyncFunctionDef) and node.name == 'main':
+            kind = 'async'
+        elif isinstance(node, ast.FunctionDef) and node.name == 'main':
+            kind = 'sync'
+        elif isinstance(node, (ast.Import, ast.ImportFrom)):
+            # eg. `from .server import main`
+            if any((alias.asname or alias.name) == 'main' for alias in node.names):
+                kind = 'sync'
+        elif isinstance(node, ast.Assign):
+            # eg. `main = Server().Run`
+            if any(isinstance(t, ast.Name) and t.id == 'main' for t in node.targets):
+                kind = 'sync'
+    return kind
+
 def import_module(path):
     """Import a Python module from the given path."""
     try:
         logger.debug(f"Loading module from {path}")
-        module_name = f"user_module_{path.name.replace(' ', '_')}"
+        module_name = get_module_name(path)
         module = machinery.SourceFileLoader(module_name, str(path)).load_module()
         logger.info(f"Imported module {path}")
         return module
@@ -55,6 +92,17 @@ def import_module(path):
 def run_server(args):
     """Run the main server loop, managing module processes."""
     processes = []
+    # Host for modules whose main() is a coroutine; created on first use.
+    async_host = None
+    # Created before any module process, which then report to it.
+    exporter = None
+    if args.metrics_file or args.metrics_port:
+        exporter = Metrics_Exporter(args.metrics_file, args.metrics_port,
+                                    args.metrics_interval, lambda: processes)
+    # Processes already running the pipe server imports, waiting for a module.
+    # With no prewarmed workers, each module still gets a fresh worker, so
+    # modules are only ever imported in their own process.
+    pool = Worker_Pool(args.workers)
     seen_modules = []
     shutdown = False
 
@@ -121,20 +169,35 @@ def run_server(args):
                             continue
 
                         seen_modules.append(rel_path)
-                        mod = import_module(full)
-                        if not mod or not hasattr(mod, 'main'):
+                        main_kind = find_main(full)
+                        if not main_kind:
                             logger.warning(f"No `.main()` in module {rel_path}")
                             continue
 
-                        main_fn = mod.main
                         proc_name = f"Proc_{rel_path.as_posix().replace('/', '_')}"
-                        proc = Server_Process(target=main_fn, name=proc_name)
+
+                        # Coroutine servers share one in-process event loop,
+                        # instead of each getting a process, so only they
+                        # are imported here.
+                        if main_kind == 'async':
+                            mod = import_module(full)
+                            if not mod or not hasattr(mod, 'main'):
+                                logger.warning(f"No `.main()` in module {rel_path}")
+                                continue
+                            if async_host is None:
+                                async_host = Async_Server_Thread(test=args.test)
+                            async_host.Add_Server(mod.main, name=proc_name)
+                            logger.info(f"Hosting async server {proc_name} for module {rel_path}")
+                            continue
+
+                        proc = pool.Run_Module(full, get_module_name(full), proc_name)
                         processes.append(proc)
-                        proc.start()
                         logger.info(f"Started process {proc_name} for module {rel_path}")
 
         except (win32api.error, Client_Garbage_Collected) as e:
             shutdown = handle_win32_exception(e, args)
+            if not shutdown:
+                Metrics.server_restarts.Labels(server=PIPE_NAME).Inc()
         except KeyboardInterrupt:
             logger.info("KeyboardInterrupt received, shutting down")
             shutdown = True
@@ -154,6 +217,12 @@ def run_server(args):
                     p.Close()
                 for p in processes:
                     p.Join()
+                if async_host is not None:
+                    async_host.Close()
+                    async_host.Join()
+                pool.Close()
+                if exporter is not None:
+                    exporter.Close()
                 shutdown_logging()
 
 def handle_win32_exception(e, args):
@@ -200,11 +269,17 @@ def pipe_client_test(args):
 
 def main():
     setup_paths()
-    listener = setup_main_logging()
     args = parse_args()
+    listener = setup_main_logging(batched=args.batched_logging)
+    if args.capture:
+        # Module processes inherit the variable and capture to their own files.
+        os.environ[Pipe_Capture.ENV_VAR] = args.capture
+        writer = Pipe_Capture.Start_Capture(Pipe_Capture.Process_Capture_Path(args.capture))
+        logger.info(f"Capturing pipe traffic to {writer.path}")
     write_server_info(args)
     load_permissions(args)
     run_server(args)
+    Pipe_Capture.Stop_Capture()
     if listener:
         listener.stop()
 
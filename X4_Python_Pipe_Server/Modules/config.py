@@ -26,6 +26,18 @@ def parse_args():
     parser.add_argument('-m', '--module', help='Module path (test mode).')
     parser.add_argument('-v', '--verbose', action='store_true', help='Verbose output.')
     parser.add_argument('--no-restart', action='store_true', help='Disable auto-restart.')
+    parser.add_argument('--batched-logging', action='store_true',
+                        help='Batch, sample and buffer log records, for high message rates.')
+    parser.add_argument('-w', '--workers', type=int, default=0,
+                        help='Prewarmed worker processes kept ready for modules (0 to spawn on demand).')
+    parser.add_argument('--capture', metavar='PATH',
+                        help='Capture all pipe traffic, one file per process named PATH_<pid>.x4cap (see Pipe_Replay.py).')
+    parser.add_argument('--metrics-file', metavar='PATH',
+                        help='Periodically write metrics to this file in the Prometheus text format.')
+    parser.add_argument('--metrics-port', type=int,
+                        help='Serve metrics in the Prometheus text format on this localhost port.')
+    parser.add_argument('--metrics-interval', type=float, default=10.0,
+                        help='Seconds between metrics exports (default 10).')
 
     args = parser.parse_args()
 
@@ -1,32 +1,83 @@
 import logging
 from logging.handlers import RotatingFileHandler, QueueHandler, QueueListener
 from multiprocessing import Queue
+import queue
+from collections import deque
+import threading
+import time
 import atexit
 
 log_queue = Queue()
 queue_listener = None
 
-def setup_main_logging(log_file='X4_Python_Pipe_Server.log'):
-    """Set up logging with file rotation and console fallback."""
-    global queue_listener
+# Settings of the batched mode, or None when off. Handed to worker
+# processes (see get_worker_settings) so they log the same way.
+batch_settings = None
+
+# Debug loggers that fire per pipe message, and the 1-in-N rate at which
+# their debug records are kept in batched mode.
+DEFAULT_SAMPLE_RATES = {
+    'X4_Python_Pipe_Server.Classes.Pipe': 100,
+    'X4_Python_Pipe_Server.Classes.Async_Pipe': 100,
+}
+
+def setup_main_logging(log_file='X4_Python_Pipe_Server.log', batched=False,
+                       batch_size=256, flush_interval=0.25, max_pending=20000,
+                       sample_rates=None):
+    """
+    Set up logging with file rotation and console fallback.
+
+    With batched=True:
+    - Each process buffers records, handing them to the log queue in lists
+      of up to batch_size from a background thread, at least every
+      flush_interval seconds. Message formatting happens there, not in the
+      logging call.
+    - A process holding more than max_pending unsent records drops new ones,
+      and later logs how many were lost, so a log flood can't stall a server.
+    - Debug records of the loggers in sample_rates (default
+      DEFAULT_SAMPLE_RATES) are sampled 1 in N.
+    - The file is written through a large buffer, flushed every
+      flush_interval seconds; the console only shows INFO and up.
+    - Records skip the caller and thread lookups (unused by the format).
+    """
+    global queue_listener, batch_settings
     try:
-        file_handler = RotatingFileHandler(
-            log_file,
-            maxBytes=5_000_000,
-            backupCount=5
-        )
         formatter = logging.Formatter('%(asctime)s | %(processName)s | %(levelname)s | %(message)s')
+        if batched:
+            batch_settings = {
+                'batch_size': batch_size,
+                'flush_interval': flush_interval,
+                'max_pending': max_pending,
+                'sample_rates': DEFAULT_SAMPLE_RATES if sample_rates is None else sample_rates,
+            }
+            trim_record_creation()
+            file_handler = Buffered_File_Handler(
+                log_file,
+                maxBytes=5_000_000,
+                backupCount=5,
+                flush_interval=flush_interval
+            )
+        else:
+            file_handler = RotatingFileHandler(
+                log_file,
+                maxBytes=5_000_000,
+                backupCount=5
+            )
         file_handler.setFormatter(formatter)
 
         console_handler = logging.StreamHandler()
         console_handler.setFormatter(formatter)
+        if batched:
+            console_handler.setLevel(logging.INFO)
 
-        queue_listener = QueueListener(log_queue, file_handler, console_handler)
+        queue_listener = Batch_Queue_Listener(
+            log_queue, file_handler, console_handler,
+            respect_handler_level=batched, flush_interval=flush_interval)
         queue_listener.start()
 
         root_logger = logging.getLogger()
         root_logger.setLevel(logging.DEBUG)
-        root_logger.addHandler(QueueHandler(log_queue))
+        root_logger.addHandler(make_queue_handler(log_queue, batch_settings))
 
         atexit.register(shutdown_logging)
 
@@ -36,19 +87,255 @@ def setup_main_logging(log_file='X4_Python_Pipe_Server.log'):
         logging.basicConfig(level=logging.DEBUG, format='%(asctime)s | %(levelname)s | %(message)s')
         return None
 
-def setup_worker_logging(log_queue):
+def trim_record_creation():
+    """
+    Skip the LogRecord fields the log format doesn't show. The caller
+    lookup in particular walks the stack on every logging call.
+    """
+    logging._srcfile = None
+    logging.logThreads = False
+
+def get_worker_settings():
+    """Logging settings to pass to a worker process at creation."""
+    return batch_settings
+
+def make_queue_handler(log_queue, settings=None):
+    """Return the handler feeding log_queue: batching if settings are given."""
+    if settings:
+        return Batching_Queue_Handler(log_queue, **settings)
+    return QueueHandler(log_queue)
+
+def setup_worker_logging(log_queue, settings=None):
     """Set up logging for worker processes."""
+    if settings:
+        trim_record_creation()
     logger = logging.getLogger()
     logger.setLevel(logging.DEBUG)
     logger.handlers = []
-    logger.addHandler(QueueHandler(log_queue))
+    logger.addHandler(make_queue_handler(log_queue, settings))
 
 def shutdown_logging():
     """Ensure all logs are flushed and QueueListener is stopped."""
     global queue_listener
     if queue_listener:
         logging.info("Shutting down logging...")
+        # Push out any records still batched in this process.
+        for handler in logging.getLogger().handlers:
+            handler.flush()
         queue_listener.stop()
         queue_listener = None
     for handler in logging.getLogger().handlers:
-        handler.flush()
\ No newline at end of file
+        handler.flush()
+
+
+# 1-in-N debug sampling rates by logger name, once enable_sampling() ran.
+logger_sample_rates = {}
+
+class Sampling_Logger(logging.Logger):
+    """
+    Logger keeping only 1 in sample_rate debug calls. The rest return
+    before a LogRecord is built, which is most of the cost of a call.
+    enable_sampling() makes this the logger class; rates are taken from
+    logger_sample_rates by name.
+    """
+    def __init__(self, name, level=logging.NOTSET):
+        super().__init__(name, level)
+        self.sample_rate = logger_sample_rates.get(name, 1)
+        self.sample_countdown = 1
+
+    def debug(self, msg, *args, **kwargs):
+        if not self.isEnabledFor(logging.DEBUG):
+            return
+        self.sample_countdown -= 1
+        if self.sample_countdown > 0:
+            return
+        self.sample_countdown = self.sample_rate
+        self._log(logging.DEBUG, msg, args, **kwargs)
+
+class Sampling_Filter(logging.Filter):
+    """
+    Logger filter keeping only 1 in sample_rate debug records, for loggers
+    created before enable_sampling(). Slower than Sampling_Logger, as the
+    record is already built.
+    """
+    def __init__(self, sample_rate):
+        super().__init__()
+        self.sample_rate = sample_rate
+        self.countdown = 1
+
+    def filter(self, record):
+        if record.levelno != logging.DEBUG:
+            return True
+        self.countdown -= 1
+        if self.countdown > 0:
+            return False
+        self.countdown = self.sample_rate
+        return True
+
+def enable_sampling(sample_rates):
+    """
+    Sample the debug records of the named loggers at the given rates.
+    Loggers created from here on are Sampling_Loggers; ones that already
+    exist get a Sampling_Filter.
+    """
+    logger_sample_rates.update(sample_rates)
+    logging.setLoggerClass(Sampling_Logger)
+    for name, rate in sample_rates.items():
+        logger = logging.Logger.manager.loggerDict.get(name)
+        if isinstance(logger, Sampling_Logger):
+            logger.sample_rate = rate
+            logger.sample_countdown = 1
+        elif isinstance(logger, logging.Logger):
+            for old_filter in [f for f in logger.filters if isinstance(f, Sampling_Filter)]:
+                logger.removeFilter(old_filter)
+            logger.addFilter(Sampling_Filter(rate))
+
+
+class Batching_Queue_Handler(QueueHandler):
+    """
+    QueueHandler that collects records and enqueues them in lists, from a
+    daemon thread of its own.
+
+    emit() only appends to the pending list, so the logging call skips the
+    message formatting, pickling and queue write of QueueHandler. Those
+    happen on the flush thread: when batch_size records are waiting, every
+    flush_interval seconds, or on flush(). Messages with args that may
+    change before then (anything but plain str/number/None values) are
+    formatted in emit().
+    """
+    def __init__(self, log_queue, batch_size=256, flush_interval=0.25,
+                 max_pending=20000, sample_rates=None):
+        super().__init__(log_queue)
+        self.batch_size = batch_size
+        self.flush_interval = flush_interval
+        self.max_pending = max_pending
+        if sample_rates:
+            enable_sampling(sample_rates)
+        # Appended by emit() and popped by flush(), both thread safe on a deque.
+        self.pending = deque()
+        self.dropped = 0
+        self.flush_lock = threading.Lock()
+        self.wake = threading.Event()
+        self.thread = threading.Thread(target=self._Run, name='Log_Batcher', daemon=True)
+        self.thread.start()
+
+    def emit(self, record):
+        pending = self.pending
+        if len(pending) >= self.max_pending:
+            self.dropped += 1
+            return
+        # Tracebacks must be captured before the frames go away.
+        if record.exc_info:
+            record = self.prepare(record)
+        elif record.args and not _immutable_args(record.args):
+            record.msg = record.getMessage()
+            record.args = None
+        pending.append(record)
+        if len(pending) >= self.batch_size:
+            self.wake.set()
+
+    def _Run(self):
+        while True:
+            self.wake.wait(self.flush_interval)
+            self.wake.clear()
+            self.flush()
+
+    def flush(self):
+        with self.flush_lock:
+            # emit() may keep appending; take only what is there now.
+            pending = self.pending
+            records = [pending.popleft() for _ in range(len(pending))]
+            if self.dropped:
+                dropped, self.dropped = self.dropped, 0
+                records.append(logging.makeLogRecord({
+                    'name': __name__, 'levelno': logging.WARNING, 'levelname': 'WARNING',
+                    'msg': f"Log buffer full, dropped {dropped} records"}))
+            if not records:
+                return
+            try:
+                self.enqueue([self.prepare(record) for record in records])
+            except Exception:
+                self.handleError(records[0])
+
+
+_immutable_types = (str, int, float, bool, bytes, type(None))
+
+def _immutable_args(args):
+    """True if formatting later can't differ from formatting now."""
+    # A single dict arg is kept by LogRecord as the args themselves.
+    if not isinstance(args, tuple):
+        return False
+    for arg in args:
+        if type(arg) not in _immutable_types:
+            return False
+    return True
+
+
+class Batch_Queue_Listener(QueueListener):
+    """
+    QueueListener that also accepts lists of records, and flushes its
+    handlers whenever the queue goes quiet for flush_interval.
+    """
+    def __init__(self, log_queue, *handlers, respect_handler_level=False, flush_interval=0.25):
+        super().__init__(log_queue, *handlers, respect_handler_level=respect_handler_level)
+        self.flush_interval = flush_interval
+
+    def dequeue(self, block):
+        while True:
+            try:
+                return self.queue.get(block, timeout=self.flush_interval)
+            except queue.Empty:
+                if not block:
+                    raise
+                for handler in self.handlers:
+                    handler.flush()
+
+    def handle(self, record):
+        if isinstance(record, list):
+            for item in record:
+                super().handle(item)
+        else:
+            super().handle(record)
+
+
+class Buffered_File_Handler(RotatingFileHandler):
+    """
+    RotatingFileHandler writing through a large buffer, and flushing at most
+    every flush_interval seconds instead of after every record. Tracks the
+    file size itself, instead of formatting each record twice and seeking
+    to check for rollover. Sizes are counted in encoded bytes, in the
+    encoding the file was opened with.
+    """
+    def __init__(self, filename, maxBytes=0, backupCount=0, flush_interval=0.25, buffer_size=1 << 16):
+        self.buffer_size = buffer_size
+        super().__init__(filename, maxBytes=maxBytes, backupCount=backupCount)
+        self.flush_interval = flush_interval
+        self.last_flush = time.monotonic()
+        self.bytes_written = self.stream.tell() if self.stream else 0
+
+    def _open(self):
+        stream = open(self.baseFilename, self.mode, buffering=self.buffer_size,
+                      encoding=self.encoding, errors=self.errors)
+        # Resolved here, as a None encoding means the locale's.
+        self.stream_encoding = stream.encoding
+        return stream
+
+    def emit(self, record):
+        try:
+            if self.stream is None:
+                self.stream = self._open()
+            msg = self.format(record) + self.terminator
+            size = len(msg.encode(self.stream_encoding, self.errors or 'strict'))
+            if self.maxBytes > 0 and self.bytes_written + size > self.maxBytes:
+                self.doRollover()
+                self.bytes_written = 0
+            if self.stream is None:
+                self.stream = self._open()
+            self.stream.write(msg)
+            self.bytes_written += size
+            now = time.monotonic()
+            if now - self.last_flush >= self.flush_interval:
+                self.last_flush = now
+                self.stream.flush()
+        except Exception:
+            self.handleError(record)
@@ -0,0 +1,181 @@
+from multiprocessing import Queue
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+import threading
+import logging
+import queue
+import time
+import sys
+import os
+from X4_Python_Pipe_Server.Classes import Metrics
+from . import logging_utils
+
+# Snapshots sent by module processes to the main process.
+metrics_queue = Queue()
+
+# (queue, interval) handed to module processes while exporting is on,
+# else None. See get_reporting_settings.
+reporting_settings = None
+
+def get_reporting_settings():
+    """Metrics settings to pass to a module process at creation."""
+    return reporting_settings
+
+def start_worker_reporting(name, settings):
+    """
+    In a module process: send this process's metrics to the main process
+    every interval seconds, from a daemon thread. Does nothing if settings
+    is None (exporting off).
+    """
+    if not settings:
+        return
+    report_queue, interval = settings
+
+    def run():
+        while True:
+            time.sleep(interval)
+            try:
+                report_queue.put((name, Metrics.registry.Snapshot()))
+            except (OSError, ValueError):
+                # Main process gone.
+                return
+    threading.Thread(target=run, name='Metrics_Reporter', daemon=True).start()
+
+def process_memory(pid):
+    """Resident memory of a process in bytes, or None if unavailable."""
+    try:
+        if sys.platform == 'win32':
+            import win32api
+            import win32con
+            import win32process
+            handle = win32api.OpenProcess(
+                win32con.PROCESS_QUERY_INFORMATION | win32con.PROCESS_VM_READ, False, pid)
+            try:
+                return win32process.GetProcessMemoryInfo(handle)['WorkingSetSize']
+            finally:
+                win32api.CloseHandle(handle)
+        with open(f"/proc/{pid}/statm") as file:
+            return int(file.read().split()[1]) * os.sysconf('SC_PAGE_SIZE')
+    except Exception:
+        return None
+
+def queue_depth(q):
+    """Approximate size of a multiprocessing queue; None where unsupported."""
+    try:
+        return q.qsize()
+    except NotImplementedError:
+        return None
+
+
+class Metrics_Exporter(threading.Thread):
+    """
+    Collects the metrics of the main process and its module processes and
+    exports them every interval seconds in the Prometheus text format: to
+    a file (written whole and renamed into place, as the node_exporter
+    textfile collector expects), and/or served at http://127.0.0.1:port/.
+
+    Creating the exporter turns on reporting for module processes created
+    afterwards. get_processes returns the current module processes (with
+    name, pid and is_alive()), whose liveness and memory are added.
+    """
+    def __init__(self, path=None, port=None, interval=10.0, get_processes=None):
+        global reporting_settings
+        super().__init__(name='Metrics_Exporter', daemon=True)
+        self.path = Path(path) if path else None
+        self.interval = interval
+        self.get_processes = get_processes or (lambda: [])
+        self.stop_event = threading.Event()
+        # Latest snapshot per module process name.
+        self.process_snapshots = {}
+        self.text = ''
+        self.logger = logging.getLogger(__name__)
+        reporting_settings = (metrics_queue, interval)
+
+        self.http_server = None
+        if port:
+            self.http_server = ThreadingHTTPServer(('127.0.0.1', port), self._Make_Handler())
+            threading.Thread(target=self.http_server.serve_forever,
+                             name='Metrics_HTTP', daemon=True).start()
+            self.logger.info(f"Serving metrics at http://127.0.0.1:{port}/metrics")
+        self.start()
+
+    def _Make_Handler(self):
+        exporter = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                body = exporter.text.encode('utf-8')
+                self.send_response(200)
+                self.send_header('Content-Type', 'text/plain; version=0.0.4; charset=utf-8')
+                self.send_header('Content-Length', str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, format, *args):
+                pass
+        return Handler
+
+    def run(self):
+        while not self.stop_event.wait(self.interval):
+            self.Export()
+
+    def Collect(self):
+        """
+        Gather all snapshots, keyed by process name, including health
+        gauges measured from here.
+        """
+        while True:
+            try:
+                name, snapshot = metrics_queue.get_nowait()
+            except queue.Empty:
+                break
+            self.process_snapshots[name] = snapshot
+
+        health = Metrics.Registry()
+        up = health.Gauge('x4_process_up', 'Whether the process is running.')
+        memory = health.Gauge('x4_process_memory_bytes', 'Resident memory of the process.')
+        depth = health.Gauge('x4_queue_depth', 'Items waiting in an interprocess queue.', ('queue',))
+
+        snapshots = {}
+        for process in list(self.get_processes()):
+            up.Labels().Set(1 if process.is_alive() else 0)
+            size = process_memory(process.pid) if process.is_alive() else None
+            if size is not None:
+                memory.Labels().Set(size)
+            snapshots[process.name] = self.process_snapshots.get(process.name, []) + health.Snapshot()
+            # Fresh series per process.
+            up.series.clear()
+            memory.series.clear()
+
+        up.Labels().Set(1)
+        size = process_memory(os.getpid())
+        if size is not None:
+            memory.Labels().Set(size)
+        for queue_name, q in [('log', logging_utils.log_queue), ('metrics', metrics_queue)]:
+            value = queue_depth(q)
+            if value is not None:
+                depth.Labels(queue=queue_name).Set(value)
+        snapshots['main'] = Metrics.registry.Snapshot() + health.Snapshot()
+        return snapshots
+
+    def Export(self):
+        """Collect and write out the metrics now."""
+        try:
+            self.text = Metrics.Render_Text(self.Collect())
+            if self.path:
+                temp_path = self.path.with_name(self.path.name + '.tmp')
+                temp_path.write_text(self.text, encoding='utf-8')
+                os.replace(temp_path, self.path)
+        except Exception as e:
+            self.logger.error(f"Metrics export failed: {e}")
+
+    def Close(self):
+        """Stop exporting, after a final export."""
+        global reporting_settings
+        reporting_settings = None
+        self.stop_event.set()
+        self.join(self.interval + 5)
+        self.Export()
+        if self.http_server is not None:
+            self.http_server.shutdown()
+            self.http_server.server_close()
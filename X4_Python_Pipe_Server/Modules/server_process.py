@@ -1,31 +1,54 @@
 from multiprocessing import Process, Event
 import logging
 import inspect
-from .logging_utils import setup_worker_logging, log_queue
+import time
+from .logging_utils import setup_worker_logging, get_worker_settings, log_queue
+from .metrics_exporter import start_worker_reporting, get_reporting_settings
+from X4_Python_Pipe_Server.Classes import Misc
+
+def Track_First_Message(name, requested_time):
+    """
+    Log how long after requested_time (a time.time() stamp from when the
+    module was announced) this process reads its first pipe message.
+    """
+    def report(message):
+        logger = logging.getLogger(__name__)
+        logger.info(f"{name}: time to first message: {(time.time() - requested_time) * 1000:.1f} ms")
+    Misc.first_read_callback = report
+
+def Run_Target(name, target_fn, stop_event):
+    """Call a module main function, passing stop_event if it takes an argument."""
+    logger = logging.getLogger(__name__)
+    sig = inspect.signature(target_fn)
+    try:
+        if len(sig.parameters) >= 1:
+            logger.debug(f"{name}: calling target with stop_event")
+            target_fn(stop_event)
+        else:
+            logger.debug(f"{name}: calling target without stop_event")
+            target_fn()
+    except Exception as e:
+        logger.error(f"Exception in {name}: {e}", exc_info=True)
+        raise
 
 class Server_Process(Process):
     """A process wrapper for running module main functions with graceful shutdown."""
     def __init__(self, target, name=None):
         super().__init__(target=self.run_with_stop, name=name, daemon=True)
         self.stop_event = Event()
+        # Passed along explicitly; a spawned child re-importing logging_utils
+        # would otherwise get a new queue that nothing listens to.
+        self.log_queue = log_queue
+        self.log_settings = get_worker_settings()
+        self.metrics_settings = get_reporting_settings()
         self._target_fn = target
+        self.requested_time = time.time()
 
     def run_with_stop(self):
-        setup_worker_logging(log_queue)
-        sig = inspect.signature(self._target_fn)
-        try:
-            if len(sig.parameters) >= 1:
-                logger = logging.getLogger(__name__)
-                logger.debug(f"{self.name}: calling target with stop_event")
-                self._target_fn(self.stop_event)
-            else:
-                logger = logging.getLogger(__name__)
-                logger.debug(f"{self.name}: calling target without stop_event")
-                self._target_fn()
-        except Exception as e:
-            logger = logging.getLogger(__name__)
-            logger.error(f"Exception in {self.name}: {e}", exc_info=True)
-            raise
+        setup_worker_logging(self.log_queue, self.log_settings)
+        Track_First_Message(self.name, self.requested_time)
+        start_worker_reporting(self.name, self.metrics_settings)
+        Run_Target(self.name, self._target_fn, self.stop_event)
 
     def Close(self):
         logger = logging.getLogger(__name__)
@@ -37,4 +60,4 @@ class Server_Process(Process):
         self.join(timeout)
         if self.is_alive():
             logger.warning(f"{self.name}: did not terminate in time; terminating forcefully")
-            self.terminate()
\ No newline at end of file
+            self.terminate()
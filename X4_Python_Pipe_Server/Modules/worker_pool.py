@@ -0,0 +1,179 @@
+from multiprocessing import Process, Event, Pipe
+from importlib import machinery
+import importlib
+import logging
+import time
+from .logging_utils import setup_worker_logging, get_worker_settings, log_queue
+from .server_process import Run_Target, Track_First_Message
+from .metrics_exporter import start_worker_reporting, get_reporting_settings
+
+# Imports done by every worker while it waits for a module, covering the
+# pipe server package and what the shipped modules use. Missing optional
+# packages are skipped.
+PREWARM_IMPORTS = [
+    'X4_Python_Pipe_Server',
+    'X4_Python_Pipe_Server.Classes',
+    'asyncio',
+    'json',
+    'threading',
+    'win32api',
+    'win32file',
+    'win32pipe',
+    'pynput.keyboard',
+]
+
+
+class Pool_Worker(Process):
+    """
+    A process started ahead of need, which imports PREWARM_IMPORTS and then
+    waits for the path of a module to run.
+
+    Offers Close()/Join() like Server_Process, so the server treats both
+    the same once a module is running.
+    """
+    def __init__(self, name=None, imports=None):
+        super().__init__(name=name, daemon=True)
+        self.stop_event = Event()
+        # Passed along explicitly; a spawned child re-importing logging_utils
+        # would otherwise get a new queue that nothing listens to.
+        self.log_queue = log_queue
+        self.log_settings = get_worker_settings()
+        self.metrics_settings = get_reporting_settings()
+        self.imports = PREWARM_IMPORTS if imports is None else imports
+        # Jobs are sent on parent_conn; child_conn goes with the process.
+        self.parent_conn, self.child_conn = Pipe()
+        self.module_name = None
+        self.ready = False
+
+    def run(self):
+        setup_worker_logging(self.log_queue, self.log_settings)
+        logger = logging.getLogger(__name__)
+        conn = self.child_conn
+
+        start = time.perf_counter()
+        for name in self.imports:
+            try:
+                importlib.import_module(name)
+            except ImportError as e:
+                logger.debug(f"{self.name}: skipped prewarm import {name}: {e}")
+        logger.debug(f"{self.name}: prewarmed in {(time.perf_counter() - start) * 1000:.1f} ms")
+        conn.send('ready')
+
+        # Block until given a module, or None when the pool shuts down.
+        job = conn.recv()
+        if job is None:
+            return
+        path, module_name, proc_name, requested_time = job
+        self.name = proc_name
+        Track_First_Message(proc_name, requested_time)
+        start_worker_reporting(proc_name, self.metrics_settings)
+
+        try:
+            module = machinery.SourceFileLoader(module_name, path).load_module()
+        except Exception as e:
+            logger.error(f"{proc_name}: failed to import {path}: {e}", exc_info=True)
+            return
+        logger.debug(f"{proc_name}: module running {(time.time() - requested_time) * 1000:.1f} ms after request")
+        Run_Target(proc_name, module.main, self.stop_event)
+
+    def Is_Ready(self):
+        """
+        True if the worker has finished prewarming.
+        """
+        if not self.ready and self.parent_conn.poll():
+            self.parent_conn.recv()
+            self.ready = True
+        return self.ready
+
+    def Assign(self, path, module_name, proc_name):
+        """
+        Hand the worker a module file to import and run.
+        """
+        self.module_name = module_name
+        self.name = proc_name
+        self.parent_conn.send((str(path), module_name, proc_name, time.time()))
+
+    def Close(self):
+        logger = logging.getLogger(__name__)
+        logger.info(f"{self.name}: signaling graceful shutdown")
+        self.stop_event.set()
+        # An unassigned worker is blocked on its job pipe.
+        if self.module_name is None:
+            try:
+                self.parent_conn.send(None)
+            except OSError:
+                pass
+
+    def Join(self, timeout=5.0):
+        logger = logging.getLogger(__name__)
+        self.join(timeout)
+        if self.is_alive():
+            logger.warning(f"{self.name}: did not terminate in time; terminating forcefully")
+            self.terminate()
+
+
+class Worker_Pool:
+    """
+    Keeps `size` prewarmed Pool_Workers idle, so an announced module starts
+    in an interpreter that has already paid for process spawn and the
+    common imports. Each module takes over its worker for good (module
+    servers run until shutdown), and a replacement is started right away.
+
+    With size 0, Run_Module() still works but always starts a cold worker.
+    """
+    def __init__(self, size=2, imports=None):
+        self.size = size
+        self.imports = imports
+        self.idle = []
+        self.spawned = 0
+        self.Refill()
+
+    def Refill(self):
+        """
+        Start workers until `size` are idle.
+        """
+        while len(self.idle) < self.size:
+            self.idle.append(self._Spawn())
+
+    def _Spawn(self):
+        self.spawned += 1
+        worker = Pool_Worker(name=f"Pool_Worker_{self.spawned}", imports=self.imports)
+        worker.start()
+        return worker
+
+    def Run_Module(self, path, module_name, proc_name):
+        """
+        Run a module's main() in a worker, preferring one that has
+        finished prewarming. Returns the worker, to be closed and joined
+        with the server's other processes.
+        """
+        worker = None
+        for candidate in self.idle:
+            if candidate.Is_Ready():
+                worker = candidate
+                break
+        if worker is None and self.idle:
+            # None ready yet; the oldest is closest to done.
+            worker = self.idle[0]
+        if worker is None:
+            worker = self._Spawn()
+        else:
+            self.idle.remove(worker)
+
+        warm = worker.Is_Ready()
+        worker_name = worker.name
+        worker.Assign(path, module_name, proc_name)
+        logging.getLogger(__name__).info(
+            f"Assigned {proc_name} to {worker_name} ({'prewarmed' if warm else 'still warming'})")
+        self.Refill()
+        return worker
+
+    def Close(self):
+        """
+        Stop all idle workers.
+        """
+        for worker in self.idle:
+            worker.Close()
+        for worker in self.idle:
+            worker.Join()
+        self.idle = []
@@ -0,0 +1,263 @@
+import sys
+import time
+import random
+import struct
+import asyncio
+import argparse
+import subprocess
+from pathlib import Path
+
+# Pipe_Load.py - Load Generation Script
+# Opens many client connections to pipe servers and drives them with
+# configurable message rates and sizes, reporting round trip latency and
+# the highest rate the servers sustain. Runs on Windows (named pipes) or
+# Linux (AF_UNIX sockets standing in for them).
+#
+# The target servers must echo each message back unchanged; --echo starts
+# such servers in a separate process. With several connections, each uses
+# its own pipe, '<pipe>_<index>', since pipes take one client at a time.
+#
+# Messages are sent open loop at their scheduled times, and latency is
+# measured from the scheduled time rather than the actual send, so a
+# server falling behind shows up as latency instead of a lower rate.
+
+# Add the root directory to sys.path
+root_dir = Path(__file__).resolve().parents[1]
+sys.path.insert(0, str(root_dir))
+
+from X4_Python_Pipe_Server.Classes import Async_Pipe_Server, Async_Pipe_Client
+from X4_Python_Pipe_Server.Classes.Stats import Percentiles
+
+# Binary protocol: u32 sequence number, then padding.
+_binary_header = struct.Struct('<I')
+# Text protocol: 'load:<seq>;' then padding, like the X4 side's messages.
+TEXT_PREFIX = b'load:'
+
+
+def Arrival_Times(pattern, rate, duration, burst, rng):
+    '''
+    Send offsets in seconds for one connection.
+    * constant: evenly spaced.
+    * bursty: groups of `burst` back to back, spaced to average `rate`.
+    * poisson: exponentially distributed gaps.
+    '''
+    times = []
+    if pattern == 'constant':
+        interval = 1.0 / rate
+        count = int(duration * rate)
+        times = [i * interval for i in range(count)]
+    elif pattern == 'bursty':
+        interval = burst / rate
+        for group in range(int(duration * rate / burst)):
+            times.extend([group * interval] * burst)
+    elif pattern == 'poisson':
+        now = rng.expovariate(rate)
+        while now < duration:
+            times.append(now)
+            now += rng.expovariate(rate)
+    else:
+        raise ValueError(f"Unknown rate pattern {pattern}")
+    return times
+
+
+def Message_Sizes(distribution, size, size_max, count, rng):
+    '''
+    Payload sizes in bytes for `count` messages.
+    * fixed: all `size`.
+    * uniform: between `size` and `size_max`.
+    * exponential: mean `size`, capped at `size_max`.
+    '''
+    if distribution == 'fixed':
+        return [size] * count
+    if distribution == 'uniform':
+        return [rng.randint(size, size_max) for _ in range(count)]
+    if distribution == 'exponential':
+        return [min(size_max, int(rng.expovariate(1.0 / size))) for _ in range(count)]
+    raise ValueError(f"Unknown size distribution {distribution}")
+
+
+def Encode(protocol, seq, size):
+    if protocol == 'binary':
+        header = _binary_header.pack(seq)
+        return header + bytes(max(0, size - len(header)))
+    header = TEXT_PREFIX + str(seq).encode() + b';'
+    return header + b'x' * max(0, size - len(header))
+
+
+def Decode(protocol, data):
+    '''
+    Sequence number of an echoed message.
+    '''
+    if protocol == 'binary':
+        return _binary_header.unpack_from(data)[0]
+    return int(data[len(TEXT_PREFIX) : data.index(b';')])
+
+
+class Load_Stats:
+    '''
+    Results of one load step, across all connections.
+    '''
+    def __init__(self):
+        self.sent = 0
+        self.received = 0
+        self.bytes_sent = 0
+        self.lost = 0
+        self.errors = 0
+        self.latencies = []
+
+
+async def Run_Connection(pipe_name, times, sizes, protocol, stats, start, drain_timeout):
+    '''
+    Drive one connection: a sender task following the schedule, and this
+    task matching echoes to sends.
+    '''
+    pipe = Async_Pipe_Client(pipe_name)
+    await pipe.connect()
+    # Scheduled send time per outstanding sequence number.
+    pending = {}
+    sender_done = asyncio.Event()
+
+    async def Sender():
+        try:
+            for seq, (offset, size) in enumerate(zip(times, sizes)):
+                scheduled = start + offset
+                delay = scheduled - time.perf_counter()
+                if delay > 0:
+                    await asyncio.sleep(delay)
+                data = Encode(protocol, seq, size)
+                pending[seq] = scheduled
+                await pipe.write_bytes(data)
+                stats.sent += 1
+                stats.bytes_sent += len(data)
+        finally:
+            sender_done.set()
+
+    sender = asyncio.create_task(Sender())
+    try:
+        while not (sender_done.is_set() and not pending):
+            try:
+                data = await asyncio.wait_for(pipe.read_bytes(),
+                    drain_timeout if sender_done.is_set() else None)
+            except asyncio.TimeoutError:
+                break
+            scheduled = pending.pop(Decode(protocol, data), None)
+            if scheduled is not None:
+                stats.latencies.append(time.perf_counter() - scheduled)
+                stats.received += 1
+    except ConnectionError:
+        stats.errors += 1
+    finally:
+        sender.cancel()
+        stats.lost += len(pending)
+        pipe.close()
+
+
+async def Run_Step(args, rate, seed):
+    '''
+    Run all connections at a total of `rate` messages per second for
+    args.duration seconds. Returns (stats, elapsed seconds).
+    '''
+    rng = random.Random(seed)
+    stats = Load_Stats()
+    schedules = []
+    for index in range(args.connections):
+        times = Arrival_Times(args.pattern, rate / args.connections, args.duration, args.burst, rng)
+        sizes = Message_Sizes(args.size_dist, args.size, args.size_max, len(times), rng)
+        schedules.append((Pipe_Name(args.pipe, index, args.connections), times, sizes))
+
+    # Connect everyone before the clock starts.
+    start = time.perf_counter() + 0.2
+    await asyncio.gather(*[
+        Run_Connection(name, times, sizes, args.protocol, stats, start, args.drain_timeout)
+        for name, times, sizes in schedules])
+    return stats, time.perf_counter() - start
+
+
+def Pipe_Name(base, index, connections):
+    return base if connections == 1 else f"{base}_{index}"
+
+
+def Report(rate, stats, elapsed):
+    latencies = sorted(stats.latencies)
+    throughput = stats.received / max(elapsed, 1e-9)
+    p50, p99, p999 = Percentiles(latencies, [0.5, 0.99, 0.999], is_sorted = True)
+    print(f"rate {rate:.0f}/s: {stats.sent} sent, {stats.received} echoed, {stats.lost} lost, "
+          f"{stats.errors} errors; {throughput:.0f} msgs/s, {stats.bytes_sent / max(elapsed, 1e-9) / 1e6:.2f} MB/s out; "
+          + f"rtt ms p50 {p50 * 1000:.3f}, p99 {p99 * 1000:.3f}, p999 {p999 * 1000:.3f}"
+          + (f", max {latencies[-1] * 1000:.3f}" if latencies else ''))
+    return throughput, p99
+
+
+async def Echo_Servers(base, connections):
+    '''
+    Echo servers for Run_Connection, reconnecting after each client.
+    '''
+    async def Echo(pipe_name):
+        pipe = Async_Pipe_Server(pipe_name)
+        while True:
+            await pipe.connect()
+            try:
+                while True:
+                    await pipe.write_bytes(await pipe.read_bytes())
+            except ConnectionError:
+                pass
+    await asyncio.gather(*[Echo(Pipe_Name(base, index, connections)) for index in range(connections)])
+
+
+def Load(args):
+    echo_proc = None
+    if args.echo:
+        echo_proc = subprocess.Popen([sys.executable, __file__, '--serve-echo',
+            '--pipe', args.pipe, '--connections', str(args.connections)])
+    try:
+        rate = args.rate
+        best = 0
+        for step in range(args.steps):
+            stats, elapsed = asyncio.run(Run_Step(args, rate, args.seed + step))
+            throughput, p99 = Report(rate, stats, elapsed)
+            sustained = (stats.lost == 0 and stats.errors == 0
+                         and throughput >= rate * 0.95 and p99 * 1000 <= args.p99_bound)
+            if not sustained:
+                break
+            best = throughput
+            rate *= args.ramp
+        if args.steps > 1:
+            print(f"max sustained throughput: {best:.0f} msgs/s "
+                  f"(p99 bound {args.p99_bound} ms, {args.connections} connections, {args.pattern})")
+    finally:
+        if echo_proc is not None:
+            echo_proc.terminate()
+            echo_proc.wait()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Synthetic load generator for pipe servers.')
+    parser.add_argument('--pipe', default = 'x4_load', help = 'Server pipe name (base name with several connections).')
+    parser.add_argument('-c', '--connections', type = int, default = 1)
+    parser.add_argument('-r', '--rate', type = float, default = 1000, help = 'Total messages per second.')
+    parser.add_argument('-d', '--duration', type = float, default = 2.0, help = 'Seconds per step.')
+    parser.add_argument('--pattern', choices = ['constant', 'bursty', 'poisson'], default = 'constant')
+    parser.add_argument('--burst', type = int, default = 10, help = 'Messages per burst (bursty).')
+    parser.add_argument('--size', type = int, default = 64, help = 'Message size, or mean size (exponential).')
+    parser.add_argument('--size-max', type = int, default = 4096)
+    parser.add_argument('--size-dist', choices = ['fixed', 'uniform', 'exponential'], default = 'fixed')
+    parser.add_argument('--protocol', choices = ['text', 'binary'], default = 'text')
+    parser.add_argument('--steps', type = int, default = 1,
+                        help = 'Rate steps; above 1, ramps the rate to find the max sustained throughput.')
+    parser.add_argument('--ramp', type = float, default = 2.0, help = 'Rate multiplier per step.')
+    parser.add_argument('--p99-bound', type = float, default = 50.0,
+                        help = 'p99 latency in ms above which a rate counts as not sustained.')
+    parser.add_argument('--drain-timeout', type = float, default = 2.0,
+                        help = 'Seconds to wait for outstanding echoes after the last send.')
+    parser.add_argument('--seed', type = int, default = 1)
+    parser.add_argument('--echo', action = 'store_true', help = 'Start local echo servers to load.')
+    parser.add_argument('--serve-echo', action = 'store_true', help = argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.serve_echo:
+        try:
+            asyncio.run(Echo_Servers(args.pipe, args.connections))
+        except KeyboardInterrupt:
+            pass
+    else:
+        Load(args)
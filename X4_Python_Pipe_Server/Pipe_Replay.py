@@ -0,0 +1,181 @@
+import sys
+import time
+import asyncio
+import argparse
+from collections import defaultdict
+from pathlib import Path
+
+# Pipe_Replay.py - Capture Replay Script
+# Replays pipe traffic recorded with --capture (or winpipe.set_capture) at
+# its original pacing or as fast as possible, for benchmarking servers and
+# reproducing sessions without running X4.
+#
+# Roles:
+# - client: stands in for X4. Sends the captured to-server messages, and
+#   waits for each captured response, timing it from the preceding send.
+# - server: stands in for a pipe server, answering with the captured
+#   responses.
+# - loopback: both of the above in one process, against each other, to
+#   measure the pipe layer itself.
+#
+# Pipes are replayed concurrently, each in capture order. Captured
+# responses are matched by count, not content, since replies often hold
+# times or ids that legitimately differ; differing contents are counted.
+
+# Add the root directory to sys.path
+root_dir = Path(__file__).resolve().parents[1]
+sys.path.insert(0, str(root_dir))
+
+from X4_Python_Pipe_Server.Classes import Async_Pipe_Server, Async_Pipe_Client
+from X4_Python_Pipe_Server.Classes.Pipe_Capture import Read_Captures
+from X4_Python_Pipe_Server.Classes.Stats import Percentiles
+
+
+class Replay_Stats:
+    '''
+    Counters and latencies gathered across all replayed pipes.
+    '''
+    def __init__(self):
+        self.sent = 0
+        self.received = 0
+        self.bytes_sent = 0
+        self.bytes_received = 0
+        self.mismatches = 0
+        # Seconds from a client send to the response.
+        self.latencies = []
+
+    def Report(self, label, elapsed):
+        latencies = sorted(self.latencies)
+        messages = self.sent + self.received
+        data = self.bytes_sent + self.bytes_received
+        elapsed = max(elapsed, 1e-9)
+        print(f"{label}: {self.sent} sent, {self.received} received in {elapsed:.3f} s; "
+              f"{messages / elapsed:.0f} msgs/s, {data / elapsed / 1e6:.2f} MB/s")
+        if latencies:
+            names = ['p50', 'p90', 'p99', 'p999']
+            values = Percentiles(latencies, [0.5, 0.9, 0.99, 0.999], is_sorted = True)
+            print("  response latency ms: " + ", ".join(
+                f"{name} {value * 1000:.3f}" for name, value in zip(names, values))
+                + f", max {latencies[-1] * 1000:.3f}")
+        if self.mismatches:
+            print(f"  {self.mismatches} received messages differ from the capture")
+
+
+async def Pace(start, offset, speed):
+    '''
+    Sleep until `offset` capture-seconds after start, scaled by speed.
+    A speed of 0 means no pacing.
+    '''
+    if speed:
+        delay = start + offset / speed - time.perf_counter()
+        if delay > 0:
+            await asyncio.sleep(delay)
+
+
+async def Replay_Pipe(pipe_name, records, role, stats, speed, first_time):
+    '''
+    Replay one pipe's records in the given role ('client' or 'server').
+    '''
+    sends_to_client = role == 'server'
+    if role == 'server':
+        pipe = Async_Pipe_Server(pipe_name)
+    else:
+        pipe = Async_Pipe_Client(pipe_name)
+
+    async with pipe:
+        await pipe.connect()
+        start = time.perf_counter()
+        last_send = None
+        for record in records:
+            if record.to_client == sends_to_client:
+                await Pace(start, (record.time_ns - first_time) / 1e9, speed)
+                await pipe.write_bytes(record.data)
+                last_send = time.perf_counter()
+                stats.sent += 1
+                stats.bytes_sent += len(record.data)
+            else:
+                data = await pipe.read_bytes()
+                if role == 'client' and last_send is not None:
+                    stats.latencies.append(time.perf_counter() - last_send)
+                    # Only the first response to a send is timed.
+                    last_send = None
+                stats.received += 1
+                stats.bytes_received += len(data)
+                if data != record.data:
+                    stats.mismatches += 1
+
+
+async def Replay(conversations, role, speed, suffix):
+    '''
+    Replay all pipes concurrently. Returns (stats, elapsed seconds) per
+    role that ran.
+    '''
+    first_time = min(records[0].time_ns for records in conversations.values())
+    roles = ['server', 'client'] if role == 'loopback' else [role]
+    results = {}
+    tasks = []
+    start = time.perf_counter()
+    for this_role in roles:
+        stats = results[this_role] = Replay_Stats()
+        for name, records in conversations.items():
+            tasks.append(Replay_Pipe(name + suffix, records, this_role, stats, speed, first_time))
+    await asyncio.gather(*tasks)
+    elapsed = time.perf_counter() - start
+    return {this_role: (stats, elapsed) for this_role, stats in results.items()}
+
+
+def Group_By_Pipe(records, pipe_filter = None):
+    '''
+    Split merged capture records into per-pipe lists, keeping order.
+    '''
+    conversations = defaultdict(list)
+    for record in records:
+        if pipe_filter and record.pipe not in pipe_filter:
+            continue
+        conversations[record.pipe].append(record)
+    return dict(conversations)
+
+
+def Print_Summary(conversations):
+    for name, records in sorted(conversations.items()):
+        to_client = sum(1 for record in records if record.to_client)
+        size = sum(len(record.data) for record in records)
+        duration = (records[-1].time_ns - records[0].time_ns) / 1e9
+        native = ' (native)' if any(record.native for record in records) else ''
+        print(f"{name}{native}: {len(records) - to_client} to server, {to_client} to client, "
+              f"{size} bytes over {duration:.3f} s")
+
+
+def Parse_Speed(value):
+    if value == 'fast':
+        return 0.0
+    if value == 'original':
+        return 1.0
+    return float(value)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Replay captured pipe traffic.')
+    parser.add_argument('captures', nargs = '+', help = 'Capture files (.x4cap); several are merged by time.')
+    parser.add_argument('--role', choices = ['client', 'server', 'loopback'], default = 'client')
+    parser.add_argument('--speed', default = 'original', type = Parse_Speed,
+                        help = "'original' pacing, 'fast' for no pacing, or a speedup factor.")
+    parser.add_argument('--pipe', action = 'append', help = 'Only replay this pipe (repeatable).')
+    parser.add_argument('--suffix', default = '',
+                        help = 'Appended to pipe names, to avoid clashing with a live server.')
+    parser.add_argument('--repeat', type = int, default = 1, help = 'Replay this many times.')
+    parser.add_argument('--summary', action = 'store_true', help = 'Only describe the capture.')
+    args = parser.parse_args()
+
+    conversations = Group_By_Pipe(Read_Captures(args.captures), args.pipe)
+    if not conversations:
+        print("No messages to replay.")
+        sys.exit(1)
+    Print_Summary(conversations)
+    if args.summary:
+        sys.exit(0)
+
+    for run in range(args.repeat):
+        results = asyncio.run(Replay(conversations, args.role, args.speed, args.suffix))
+        for role, (stats, elapsed) in results.items():
+            stats.Report(f"run {run + 1} {role}", elapsed)
@@ -0,0 +1,148 @@
+import sys
+import time
+import argparse
+from pathlib import Path
+
+# Series_Tool.py - Session Query Script
+# Summarizes, compares and inspects sessions recorded with
+# Classes/Series_Store.py (eg. by sn_measure_fps and sn_script_profiler).
+#
+# Examples:
+#   python Series_Tool.py list <sessions folder>
+#   python Series_Tool.py summary <session> --top 20 --sort sum
+#   python Series_Tool.py summary <session> --from 600 --to 1200
+#   python Series_Tool.py diff <session a> <session b> --match path_sum:
+#   python Series_Tool.py series <session> frame_ms
+#
+# --from/--to are seconds from the session start.
+
+# Add the root directory to sys.path
+root_dir = Path(__file__).resolve().parents[1]
+sys.path.insert(0, str(root_dir))
+
+from X4_Python_Pipe_Server.Classes.Series_Store import Series_Reader, INDEX_FILE
+
+SORT_KEYS = {
+    'name' : lambda item: item[0],
+    'count': lambda item: -item[1].count,
+    'sum'  : lambda item: -item[1].sum,
+    'mean' : lambda item: -item[1].mean,
+    'max'  : lambda item: -item[1].max,
+}
+
+
+def Time_Range(reader, args):
+    '''
+    Absolute (start, end) times from the --from/--to offsets.
+    '''
+    base = reader.start_time or 0
+    start = None if args.start is None else base + args.start
+    end = None if args.end is None else base + args.end
+    return start, end
+
+
+def Select(summaries, match):
+    if not match:
+        return summaries
+    return {name: summary for name, summary in summaries.items() if match in name}
+
+
+def List_Sessions(args):
+    for index_path in sorted(Path(args.folder).glob(f"*/{INDEX_FILE}")):
+        with Series_Reader(index_path.parent) as reader:
+            duration = (reader.end_time - reader.start_time) if reader.rows else 0
+            print(f"{index_path.parent.name}: {reader.rows} rows, {len(reader.names)} series, "
+                  f"{duration / 60:.1f} min")
+
+
+def Summary(args):
+    with Series_Reader(args.session) as reader:
+        start, end = Time_Range(reader, args)
+        summaries = Select(reader.Summarize(start, end), args.match)
+        items = sorted(summaries.items(), key = SORT_KEYS[args.sort])
+        if args.top:
+            items = items[:args.top]
+        print(f"{reader.path.name}: {len(summaries)} series")
+        print(f"{'series':<60} {'count':>9} {'mean':>12} {'min':>12} {'max':>12} {'sum':>14}")
+        for name, summary in items:
+            print(f"{name[-60:]:<60} {summary.count:>9} {summary.mean:>12.4g} "
+                  f"{summary.min:>12.4g} {summary.max:>12.4g} {summary.sum:>14.6g}")
+
+
+def Diff(args):
+    with Series_Reader(args.session_a) as reader_a, Series_Reader(args.session_b) as reader_b:
+        summaries_a = Select(reader_a.Summarize(*Time_Range(reader_a, args)), args.match)
+        summaries_b = Select(reader_b.Summarize(*Time_Range(reader_b, args)), args.match)
+    field = args.field
+
+    rows = []
+    for name in summaries_a.keys() | summaries_b.keys():
+        value_a = getattr(summaries_a[name], field) if name in summaries_a else None
+        value_b = getattr(summaries_b[name], field) if name in summaries_b else None
+        change = (value_b or 0) - (value_a or 0)
+        rows.append((name, value_a, value_b, change))
+    rows.sort(key = lambda row: -abs(row[3]))
+    if args.top:
+        rows = rows[:args.top]
+
+    print(f"{field} of {Path(args.session_a).name} -> {Path(args.session_b).name}")
+    print(f"{'series':<60} {'a':>12} {'b':>12} {'change':>12} {'%':>8}")
+    for name, value_a, value_b, change in rows:
+        percent = f"{change / value_a * 100:>7.1f}%" if value_a else f"{'new' if value_b is not None else '':>8}"
+        print(f"{name[-60:]:<60} {_Cell(value_a)} {_Cell(value_b)} {change:>12.4g} {percent}")
+
+
+def _Cell(value):
+    return f"{'-':>12}" if value is None else f"{value:>12.4g}"
+
+
+def Series(args):
+    with Series_Reader(args.session) as reader:
+        start, end = Time_Range(reader, args)
+        if args.name not in reader.ids:
+            print(f"No series {args.name!r} in {reader.path.name}")
+            sys.exit(1)
+        fractions = [0.5, 0.9, 0.99, 0.999]
+        summary = reader.Summarize(start, end, [args.name]).get(args.name)
+        if summary is None:
+            print(f"No samples of {args.name!r} in range")
+            return
+        percentiles = reader.Percentiles(args.name, fractions, start, end)
+        print(f"{args.name}: {summary.count} samples over {summary.last_time - summary.first_time:.1f} s; "
+              f"mean {summary.mean:.4g}, min {summary.min:.4g}, max {summary.max:.4g}")
+        print("  " + ", ".join(f"p{fraction * 100:g} {value:.4g}" for fraction, value in zip(fractions, percentiles)))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Query recorded measurement sessions.')
+    subparsers = parser.add_subparsers(dest = 'command', required = True)
+
+    def Add_Range(subparser):
+        subparser.add_argument('--from', dest = 'start', type = float, help = 'Seconds from session start.')
+        subparser.add_argument('--to', dest = 'end', type = float, help = 'Seconds from session start.')
+        subparser.add_argument('--match', help = 'Only series with names containing this.')
+        subparser.add_argument('--top', type = int, default = 30, help = 'Rows to show (0 for all).')
+
+    list_parser = subparsers.add_parser('list', help = 'List sessions in a folder.')
+    list_parser.add_argument('folder')
+
+    summary_parser = subparsers.add_parser('summary', help = 'Per-series aggregates of a session.')
+    summary_parser.add_argument('session')
+    summary_parser.add_argument('--sort', choices = list(SORT_KEYS), default = 'sum')
+    Add_Range(summary_parser)
+
+    diff_parser = subparsers.add_parser('diff', help = 'Compare per-series aggregates of two sessions.')
+    diff_parser.add_argument('session_a')
+    diff_parser.add_argument('session_b')
+    diff_parser.add_argument('--field', choices = ['count', 'sum', 'mean', 'min', 'max'], default = 'mean')
+    Add_Range(diff_parser)
+
+    series_parser = subparsers.add_parser('series', help = 'Percentiles of one series.')
+    series_parser.add_argument('session')
+    series_parser.add_argument('name')
+    Add_Range(series_parser)
+
+    args = parser.parse_args()
+    start = time.perf_counter()
+    {'list': List_Sessions, 'summary': Summary, 'diff': Diff, 'series': Series}[args.command](args)
+    print(f"({(time.perf_counter() - start) * 1000:.1f} ms)")
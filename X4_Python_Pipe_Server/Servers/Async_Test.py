@@ -0,0 +1,112 @@
+import sys
+import time
+import asyncio
+import argparse
+from pathlib import Path
+
+# Add the root directory to sys.path
+root_dir = Path(__file__).resolve().parents[2]  # Navigate up to X4_Python_Pipe_Server
+sys.path.insert(0, str(root_dir))
+
+# Absolute imports
+from X4_Python_Pipe_Server.Classes import Async_Pipe_Server, Async_Pipe_Client, Async_Server_Thread
+
+# Async_Test.py - Testing Script
+# Coroutine version of the Test1 key-value store, hosted many times over on
+# one Async_Server_Thread, with simulated clients that disconnect to check
+# restarts. Runs on Windows (named pipes) or Linux (AF_UNIX sockets).
+
+def Make_Server(pipe_name: str):
+    '''
+    Return a coroutine key-value store server on the given pipe.
+
+    The server handles:
+    - "write:[key]data" to store data
+    - "read:[key]" to retrieve data
+    - "close" to shut down
+    '''
+    async def main(stop_event: asyncio.Event):
+        data_store = {}
+        async with Async_Pipe_Server(pipe_name) as pipe:
+            await pipe.connect()
+            while not stop_event.is_set():
+                message = await pipe.read()
+                if message == 'close':
+                    break
+                elif message.startswith('write:'):
+                    key, value = message[6:].split(']', 1)
+                    data_store[key[1:]] = value
+                elif message.startswith('read:'):
+                    key = message[6:-1]
+                    await pipe.write(data_store.get(key, f"error: {key} not found"))
+    return main
+
+
+async def Run_Client(pipe_name: str, sessions: int, rounds: int):
+    '''
+    Mimic the x4 client: several sessions, each ending in a disconnect
+    that the host should answer with a server restart.
+    Returns the list of round trip times, in seconds.
+    '''
+    latencies = []
+    for session in range(sessions):
+        async with Async_Pipe_Client(pipe_name) as pipe:
+            await pipe.connect()
+            for i in range(rounds):
+                value = f"{session}.{i}"
+                start = time.perf_counter()
+                await pipe.write(f"write:[k]{value}")
+                await pipe.write("read:[k]")
+                response = await pipe.read()
+                latencies.append(time.perf_counter() - start)
+                if response != value:
+                    raise AssertionError(f"{pipe_name}: expected {value!r}, got {response!r}")
+    return latencies
+
+
+def test_servers(server_count: int = 200, sessions: int = 3, rounds: int = 20):
+    '''
+    Host server_count servers on one thread, drive them all concurrently
+    from a client loop in this thread, and report timings.
+    '''
+    host = Async_Server_Thread()
+    pipe_names = [f"x4_async_test_{i}" for i in range(server_count)]
+    for pipe_name in pipe_names:
+        host.Add_Server(Make_Server(pipe_name), name=pipe_name)
+
+    async def Run_Clients():
+        return await asyncio.gather(*[Run_Client(name, sessions, rounds) for name in pipe_names])
+
+    start = time.perf_counter()
+    results = asyncio.run(Run_Clients())
+    elapsed = time.perf_counter() - start
+
+    latencies = sorted(x for result in results for x in result)
+    status = host.Get_Status()
+    restart_delays = [x['last_restart_delay'] for x in status.values() if x['last_restart_delay'] is not None]
+    starts = sum(x['starts'] for x in status.values())
+
+    stop_start = time.perf_counter()
+    host.Close()
+    host.Join()
+    stop_time = time.perf_counter() - stop_start
+
+    print(f"servers: {server_count}, sessions each: {sessions}, round trips: {len(latencies)} in {elapsed:.2f}s")
+    print(f"round trip ms: p50 {latencies[len(latencies) // 2] * 1000:.3f}, "
+          f"p99 {latencies[int(len(latencies) * 0.99)] * 1000:.3f}")
+    print(f"server starts: {starts} (expected at least {server_count * sessions})")
+    if restart_delays:
+        print(f"restart ms: mean {sum(restart_delays) / len(restart_delays) * 1000:.3f}, "
+              f"max {max(restart_delays) * 1000:.3f}")
+    print(f"shutdown of all servers: {stop_time * 1000:.1f} ms")
+    if starts < server_count * sessions:
+        raise AssertionError("servers did not restart after each disconnect")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Async pipe server host test.')
+    parser.add_argument('-n', '--servers', type=int, default=200)
+    parser.add_argument('-s', '--sessions', type=int, default=3)
+    parser.add_argument('-r', '--rounds', type=int, default=20)
+    args = parser.parse_args()
+    test_servers(args.servers, args.sessions, args.rounds)
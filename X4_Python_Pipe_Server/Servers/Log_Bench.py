@@ -0,0 +1,107 @@
+import sys
+import time
+import logging
+import argparse
+import tempfile
+import subprocess
+from pathlib import Path
+from multiprocessing import Process, Queue
+
+# Add the root directory to sys.path
+root_dir = Path(__file__).resolve().parents[2]  # Navigate up to X4_Python_Pipe_Server
+sys.path.insert(0, str(root_dir))
+
+from X4_Python_Pipe_Server.Modules import logging_utils
+
+# Log_Bench.py - Testing Script
+# Measures logging overhead of a module process logging every pipe message
+# (as Pipe.read/write do at debug level), in the plain and batched modes.
+# Each mode runs in its own interpreter, as the main server would.
+
+def Producer(log_queue, settings, rate, seconds, results):
+    '''
+    Worker process: log one pipe-style debug record per message at the
+    given rate, plus an info record per 100, timing each logging call.
+    '''
+    logging_utils.setup_worker_logging(log_queue, settings)
+    logger = logging.getLogger('X4_Python_Pipe_Server.Classes.Pipe')
+    info_logger = logging.getLogger('Log_Bench')
+
+    interval = 1.0 / rate
+    count = int(rate * seconds)
+    call_times = []
+    start = time.perf_counter()
+    for i in range(count):
+        # Pace to the target rate.
+        target = start + i * interval
+        while time.perf_counter() < target:
+            pass
+        message = f"update;$fps:{i % 60};$gametime:{i * interval:.3f};"
+        call_start = time.perf_counter()
+        logger.debug("Read from pipe: %s", message)
+        if i % 100 == 0:
+            info_logger.info("Handled %d messages", i)
+        call_times.append(time.perf_counter() - call_start)
+    # The pacing loop spins, so process time says nothing; total up the
+    # logging calls instead.
+    logging_cpu = sum(call_times)
+    for handler in logging.getLogger().handlers:
+        handler.flush()
+    results.put((sorted(call_times), logging_cpu, count))
+
+
+def Run_Mode(mode, rate, seconds):
+    log_file = Path(tempfile.gettempdir()) / f"Log_Bench_{mode}.log"
+    for path in log_file.parent.glob(log_file.name + '*'):
+        path.unlink()
+    # Keep the console quiet; the file gets everything.
+    logging_utils.setup_main_logging(str(log_file), batched = (mode == 'batched'))
+    for handler in logging_utils.queue_listener.handlers:
+        if isinstance(handler, logging.StreamHandler) and not isinstance(handler, logging.FileHandler):
+            handler.setLevel(logging.CRITICAL)
+    logging_utils.queue_listener.respect_handler_level = True
+
+    results = Queue()
+    cpu_start = time.process_time()
+    proc = Process(target=Producer, args=(logging_utils.log_queue, logging_utils.get_worker_settings(), rate, seconds, results))
+    proc.start()
+    call_times, logging_cpu, count = results.get()
+    proc.join()
+    drain_start = time.perf_counter()
+    logging_utils.shutdown_logging()
+    drain_time = time.perf_counter() - drain_start
+    listener_cpu = time.process_time() - cpu_start
+
+    lines = sum(1 for _ in open(log_file, encoding='utf-8'))
+    n = len(call_times)
+    print(f"{mode:>8}: {count} msgs at {rate}/s; logging call us: "
+          f"mean {logging_cpu / n * 1e6:.2f}, p50 {call_times[n // 2] * 1e6:.2f}, "
+          f"p99 {call_times[int(n * 0.99)] * 1e6:.2f}, max {call_times[-1] * 1e6:.1f}; "
+          f"producer time in logging {logging_cpu / seconds * 100:.1f}%; "
+          f"listener cpu {listener_cpu / seconds * 100:.1f}%; drain {drain_time * 1000:.0f} ms; "
+          f"lines written {lines}")
+    return logging_cpu / seconds
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Logging overhead benchmark.')
+    parser.add_argument('--mode', choices = ['plain', 'batched'])
+    parser.add_argument('--rate', type = int, default = 10000)
+    parser.add_argument('--seconds', type = float, default = 2.0)
+    # Fail if the batched producer spends more than this fraction of its
+    # time in logging calls.
+    parser.add_argument('--bound', type = float, default = 0.05)
+    args = parser.parse_args()
+
+    if args.mode:
+        fraction = Run_Mode(args.mode, args.rate, args.seconds)
+        if args.mode == 'batched' and fraction > args.bound:
+            print(f"batched logging overhead {fraction * 100:.1f}% exceeds bound {args.bound * 100:.1f}%")
+            sys.exit(1)
+    else:
+        failed = False
+        for mode in ['plain', 'batched']:
+            failed |= subprocess.call([sys.executable, __file__, '--mode', mode,
+                '--rate', str(args.rate), '--seconds', str(args.seconds),
+                '--bound', str(args.bound)]) != 0
+        sys.exit(1 if failed else 0)
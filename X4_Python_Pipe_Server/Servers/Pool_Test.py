@@ -0,0 +1,78 @@
+import sys
+import time
+import asyncio
+import tempfile
+import multiprocessing
+from pathlib import Path
+
+# Add the root directory to sys.path
+root_dir = Path(__file__).resolve().parents[2]  # Navigate up to X4_Python_Pipe_Server
+sys.path.insert(0, str(root_dir))
+
+# Pool_Test.py - Testing Script
+# Compares module time-to-first-message when started in a cold worker
+# process versus a prewarmed one from the Worker_Pool. Uses spawn on every
+# platform, to match Windows.
+
+# Module started by the workers; serves one message on the given pipe.
+module_text = '''
+import asyncio
+from X4_Python_Pipe_Server.Classes import Async_Pipe_Server
+
+def main(stop_event):
+    async def serve():
+        async with Async_Pipe_Server(PIPE_NAME) as pipe:
+            await pipe.connect()
+            await pipe.read()
+    asyncio.run(serve())
+'''
+
+async def Send_First_Message(pipe_name):
+    '''
+    Mimic x4: connect to the module's pipe once it appears, send a message.
+    '''
+    from X4_Python_Pipe_Server.Classes import Async_Pipe_Client
+    async with Async_Pipe_Client(pipe_name) as pipe:
+        await pipe.connect(timeout = 30, interval = 0.002)
+        await pipe.write('ping')
+
+
+def test_pool(runs = 5):
+    from X4_Python_Pipe_Server.Modules.logging_utils import setup_main_logging, shutdown_logging
+    from X4_Python_Pipe_Server.Modules.worker_pool import Worker_Pool
+    setup_main_logging(str(Path(tempfile.gettempdir()) / 'Pool_Test.log'))
+
+    results = {}
+    for label, size in [('cold', 0), ('prewarmed', 1)]:
+        pool = Worker_Pool(size)
+        # Let the idle worker finish its imports, as it would while x4 loads.
+        time.sleep(3 if size else 0)
+        times = []
+        workers = []
+        for run in range(runs):
+            pipe_name = f"x4_pool_test_{label}_{run}"
+            path = Path(tempfile.gettempdir()) / f"{pipe_name}.py"
+            path.write_text(f"PIPE_NAME = {pipe_name!r}\n" + module_text)
+
+            start = time.perf_counter()
+            workers.append(pool.Run_Module(path, f"user_module_{path.name}", f"Proc_{pipe_name}"))
+            asyncio.run(Send_First_Message(pipe_name))
+            times.append(time.perf_counter() - start)
+            time.sleep(3 if size else 0)
+
+        for worker in workers:
+            worker.Close()
+            worker.Join()
+        pool.Close()
+        results[label] = times
+
+    for label, times in results.items():
+        times = sorted(times)
+        print(f"{label:>9}: time to first message ms: min {times[0] * 1000:.1f}, "
+              f"median {times[len(times) // 2] * 1000:.1f}, max {times[-1] * 1000:.1f}")
+    shutdown_logging()
+
+
+if __name__ == "__main__":
+    multiprocessing.set_start_method('spawn')
+    test_pool()
@@ -19,4 +19,9 @@ _Init()
 '''
 
 # Make available the pipes for easy import into dynamically loaded modules.
-from .Classes import Pipe_Server, Pipe_Client
+import sys
+from .Classes import Async_Pipe_Server, Async_Pipe_Client
+# Session measurement storage, shared by the profiling modules.
+from .Classes import Series_Writer, New_Session_Path, Percentiles
+if sys.platform == 'win32':
+    from .Classes import Pipe_Server, Pipe_Client
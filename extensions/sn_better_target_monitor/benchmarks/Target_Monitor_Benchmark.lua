@@ -0,0 +1,235 @@
+--[[
+Benchmark for the Target_Monitor text width cache and per-frame refresh.
+Run from the extension folder:
+    luajit benchmarks/Target_Monitor_Benchmark.lua
+
+Counts GetTextWidth calls per spec rebuild (init, or any settings change),
+and per Match_String_Length against the space-at-a-time padding loop it
+replaced, checking both pad to the same strings. GetTextWidth is stubbed
+with a made up proportional font, where runs of spaces grow slightly
+faster than linear (as observed in game).
+
+Then times monitor refreshes of a moving ship target, as the ego monitor
+does each frame (GetTargetMonitorDetails, then GetLiveData per
+placeholder), with the row layout and cell caches in use, and cleared
+every frame; both must give the same texts.
+Not part of the shipped extension.
+]]
+dofile("../sn_mod_support_apis/benchmarks/Host_Stubs.lua")
+
+-- Stubbed ffi, with a counting GetTextWidth.
+local width_calls = 0
+local function Stub_Text_Width(text, font, fontsize)
+    width_calls = width_calls + 1
+    local width = 0
+    local last = nil
+    for i = 1, #text do
+        local byte = string.byte(text, i)
+        if byte == 32 then
+            width = width + 0.28 + (last == 32 and 0.02 or 0)
+        else
+            width = width + 0.45 + (byte % 7) * 0.03
+        end
+        last = byte
+    end
+    if font == "Zekton Bold" then width = width * 1.08 end
+    return width * fontsize
+end
+package.loaded.ffi = {
+    cdef   = function() end,
+    new    = function() return {} end,
+    string = function(value) return tostring(value) end,
+    C = {
+        GetTextWidth = Stub_Text_Width,
+        GetLocalizedText = function(page, id, default) return default end,
+        GetCompSlotPlayerActionTriggeredConnection = function() return "" end,
+        GetOwnerDetails = function() return {factionID = "argon"} end,
+        GetComponentDetails = function() return {speed = 300 + math.random() * 5} end,
+        -- Target 20 km out, closing at 150 m/s; player at the origin.
+        GetObjectPositionInSector = function(id)
+            if id == 2 then return {x = 0, y = 0, z = 0} end
+            return {x = 20000 - Host.now * 150, y = 50, z = 10}
+        end,
+        GetPlayerObjectID = function() return 2 end,
+        GetComponentClass = function() return "ship_s" end,
+    },
+}
+
+-- Ui globals used at load and init.
+local texts = {[1] = "Hull", [2] = "Shield"}
+function ReadText(page, id) return texts[id] or ("text_"..id) end
+Color = setmetatable({}, {__index = function() return {r = 127, g = 195, b = 255, a = 100} end})
+Helper = {convertColorToText = function() return "\027#FFC8C800#" end}
+-- Ego monitor spec for a ship: 7 rows, placeholders between $.
+function GetTargetMonitorDetails()
+    local function Row(left, right)
+        return {left = {text = left}, right = {text = right}}
+    end
+    return {
+        header = {text = "Ship"},
+        text = {
+            Row("Info", "$revealpercent$%"),
+            Row("Command", "$aicommand$"),
+            Row("Action", "$aicommandaction$"),
+            Row("Hull", "$hullpercent$%"),
+            Row("Shield", "$shieldpercent$%"),
+            Row("Storage", "10 / 20"),
+            Row("Crew", "$crew$"),
+        },
+    }
+end
+local Ego_Details = GetTargetMonitorDetails
+function GetLiveData() return "50" end
+function ConvertIDTo64Bit(id) return id end
+local component_data = {shieldmax = 100, primarypurpose = "fight", shiptype = "fighter", shiptypename = "Fighter"}
+function GetComponentData(component, ...)
+    local values = {}
+    for i, field in ipairs({...}) do values[i] = component_data[field] end
+    return unpack(values)
+end
+function IsComponentClass(component, class) return class == "ship" end
+function IsComponentConstruction() return false end
+function IsComponentOperational() return true end
+function GetCurTime() return Host.now end
+function GetPlayerActivity() return "none" end
+function ConvertTimeString(seconds) return string.format("%d:%02d", math.floor(seconds / 60), math.floor(seconds % 60)) end
+function GetFactionData() return {r = 60, g = 20, b = 80, a = 100} end
+
+-- The support apis Library (filters), under its interface name.
+Host.Load("../sn_mod_support_apis/ui/Library.lua")
+Lua_Loader.define("extensions.sn_mod_support_apis.lua_interface", function(require)
+    return {Library = require("extensions.sn_mod_support_apis.ui.Library")}
+end)
+
+Host.Load("ui/Target_Monitor.lua")
+local L = Host.Require("extensions.sn_better_target_monitor.ui.Target_Monitor")
+
+
+-- The padding loop prior to the width cache, for comparison.
+local function Loop_Match_String_Length(A, B, font, prefix)
+    local GetTextWidth = package.loaded.ffi.C.GetTextWidth
+    if prefix then A = " "..A; B = " "..B else A = A.." "; B = B.." " end
+    local fontsize = 18
+    local a_width = GetTextWidth(A, font, fontsize)
+    local b_width = GetTextWidth(B, font, fontsize)
+    local new_short, current_width, target_width
+    if a_width < b_width then
+        new_short, current_width, target_width = A, a_width, b_width
+    else
+        new_short, current_width, target_width = B, b_width, a_width
+    end
+    local prior_width, prior_short = current_width, new_short
+    while current_width < target_width do
+        prior_width, prior_short = current_width, new_short
+        if prefix then new_short = " "..new_short else new_short = new_short.." " end
+        current_width = GetTextWidth(new_short, font, L.orig_defaults.textfontsize)
+    end
+    if math.abs(prior_width - target_width) < math.abs(current_width - target_width) then
+        new_short = prior_short
+    end
+    if a_width < b_width then return new_short, B else return A, new_short end
+end
+
+
+-- Spec rebuilds, as on init and each settings change.
+local function Rebuild()
+    Host.Fire("Target_Monitor.Set_Field", "hull_shield_bold")
+    Host.Fire("Target_Monitor.Set_Value", 1)
+end
+L.text_width.Clear()
+width_calls = 0
+Rebuild()
+print(string.format("GetTextWidth calls, first spec rebuild:   %d", width_calls))
+width_calls = 0
+Rebuild()
+print(string.format("GetTextWidth calls, later spec rebuilds:  %d", width_calls))
+
+-- Label pairs of differing lengths, as with other languages.
+math.randomseed(1)
+local letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+local function Random_Label()
+    local chars = {}
+    for i = 1, math.random(2, 24) do
+        local index = math.random(1, #letters)
+        chars[i] = string.sub(letters, index, index)
+    end
+    return table.concat(chars)
+end
+local pairs_list = {}
+for i = 1, 200 do
+    pairs_list[i] = {Random_Label(), Random_Label(), i % 2 == 0 and "Zekton" or "Zekton Bold", i % 3 == 0}
+end
+
+-- Same results as the loop.
+for _, args in ipairs(pairs_list) do
+    local a1, b1 = L.Match_String_Length(unpack(args))
+    local a2, b2 = Loop_Match_String_Length(unpack(args))
+    assert(a1 == a2 and b1 == b2, "padding differs for "..args[1].." / "..args[2])
+end
+print(string.format("%d label pairs pad the same as the loop", #pairs_list))
+
+local function Calls_Per_Pair(func)
+    width_calls = 0
+    for _, args in ipairs(pairs_list) do func(unpack(args)) end
+    return width_calls / #pairs_list
+end
+L.text_width.Clear()
+print(string.format("GetTextWidth calls per pair, loop:        %.1f", Calls_Per_Pair(Loop_Match_String_Length)))
+print(string.format("GetTextWidth calls per pair, cold cache:  %.1f", Calls_Per_Pair(L.Match_String_Length)))
+print(string.format("GetTextWidth calls per pair, warm cache:  %.1f", Calls_Per_Pair(L.Match_String_Length)))
+
+Host.Report("Match_String_Length, loop", Host.Time(function(i)
+    Loop_Match_String_Length(unpack(pairs_list[i % #pairs_list + 1]))
+end, 20000))
+Host.Report("Match_String_Length, warm cache", Host.Time(function(i)
+    L.Match_String_Length(unpack(pairs_list[i % #pairs_list + 1]))
+end, 20000))
+
+
+-- Monitor refreshes.
+print("")
+local placeholders = {}
+do
+    local spec = GetTargetMonitorDetails(10, "")
+    for _, row in ipairs(spec.text) do
+        for _, side in pairs(row) do
+            for name in string.gmatch(side.text, "%$([%w_]+)%$") do
+                placeholders[#placeholders + 1] = name
+            end
+        end
+    end
+end
+print(string.format("%d placeholders per refresh: %s", #placeholders, table.concat(placeholders, " ")))
+
+-- Run frames on a fresh target; returns seconds per frame and the texts.
+-- Texts of live cells only change every filter summary (a few frames).
+local function Refresh_Frames(component, frames, clear_caches)
+    Host.now = 100
+    math.randomseed(5)
+    local texts = {}
+    local elapsed = 0
+    for frame = 1, frames do
+        Host.now = Host.now + 1 / 60
+        local start = os.clock()
+        if clear_caches then L.Clear_Caches() end
+        local spec = GetTargetMonitorDetails(component, "")
+        for i, name in ipairs(placeholders) do
+            texts[#texts + 1] = GetLiveData(name, component, "")
+        end
+        elapsed = elapsed + os.clock() - start
+        texts[#texts + 1] = #spec.text
+    end
+    return elapsed / frames, texts
+end
+
+local frames = 3000
+local uncached_time, uncached_texts = Refresh_Frames(11, frames, true)
+local cached_time, cached_texts = Refresh_Frames(12, frames, false)
+for i = 1, #cached_texts do
+    assert(cached_texts[i] == uncached_texts[i], "text differs at "..i..": "
+        ..tostring(cached_texts[i]).." / "..tostring(uncached_texts[i]))
+end
+print(string.format("%d frames give the same texts with and without caches", frames))
+Host.Report("refresh, caches cleared every frame", uncached_time)
+Host.Report("refresh, cached", cached_time)
+Host.Report("  of which, stubbed ego GetTargetMonitorDetails", Host.Time(function() Ego_Details(12, "") end, frames))
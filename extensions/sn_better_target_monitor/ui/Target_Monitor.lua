@@ -185,6 +185,16 @@ local L = {
     --last_distance    = nil,
     last_update_time = nil,
 
+    -- Cached row layout of the current target; see Get_New_Rows.
+    row_layout = nil,
+    -- Seconds a row layout is reused before rechecking the target, to
+    -- catch class changes (eg. a construction finishing).
+    row_layout_lifetime = 1,
+    -- Cached text of live data cells, keyed by placeholder; see Get_Cell.
+    live_cells = {},
+    -- Brightened faction colors, keyed by faction id.
+    faction_colors = {},
+
     -- Note: next two are not currently used.
     -- Copy of messageID sent to SetSofttarget.
     last_softtarget_messageID = nil,
@@ -193,6 +203,8 @@ local L = {
 
     -- Link to T table below, for returning to require statements.
     text = nil,
+    -- Link to the Text_Width cache below.
+    text_width = nil,
 }
 
 local T = {
@@ -339,322 +351,9 @@ local T = {
 L.text = T
 
 ------------------------------------------------------------------------------
--- Support object for data smoothing.
--- TODO: move to the mod support apis, maybe.
-
-local Depth_Filter = {}
-
-function Depth_Filter.New ()
-  return {
-    -- List of samples.
-    -- This will fill up on first pass, then has static size afterwards
-    -- and just overwrites old samples.
-    samples = {},
-    -- Index of the next location to store. (1-based indexing.)
-    next = 1,
-    -- Depth of the list. Grows dynamically.
-    depth = 4,
-    -- Running sum of values.
-    sum = 0,
-    -- Current smoothed value. Note: float.
-    current = nil,
-    }
-end
-
--- Add a new sample, and return the current smoothed value.
--- Stores returned value in "current".
-function Depth_Filter.Smooth(filter, sample)
-
-    -- If at max depth, overwrite oldest.
-    if #filter.samples == filter.depth then
-        -- Subtract the to-be-replaced point.
-        filter.sum = filter.sum - filter.samples[filter.next]
-    end
-
-    -- Add the new sample.
-    filter.sum = filter.sum + sample
-    filter.samples[filter.next] = sample
-
-    -- Increment next, with rollover.
-    -- Note: 1-based indexing, so next goes from 1 to depth then rolls over.
-    filter.next = filter.next + 1
-    if filter.next > filter.depth then
-        filter.next = 1
-    end
-
-    -- TODO: this summation might not be entirely stable over time,
-    -- so every so many samples recompute the total sum.
-
-    -- Calculate the average.
-    filter.current = filter.sum / #filter.samples
-    return filter.current
-end
-
--- Change the depth of a filter, if signifcantly different.
-function Depth_Filter.Change_Depth(filter, new_depth)
-    -- To prevent excess changes when an object is around a depth
-    -- boundary, only update if the depth changed by a couple steps,
-    -- where one step is 2 (hence 4 for two steps).
-    if math.abs(new_depth - filter.depth) < 4 then
-        return
-    end
-    -- Safety against 0, negative, or just too large.
-    new_depth = math.floor(new_depth)
-    if new_depth <= 0 or new_depth > 100 then
-        DebugError("Change_Depth rejecting "..tostring(new_depth))
-        return
-    end
-
-    -- Build a new list, using existing oldest to newest points.
-    local new_samples = {}
-
-    -- There needs to be at least one point for the following to make sense.
-    if #filter.samples > 0 then
-        -- Points from the latter part of the filter, oldest to end.
-        -- If next == 1, then this gets everything.
-        for i = filter.next, #filter.samples do
-            -- TODO: if speed is important, t[#t+1] is 2x faster than table.insert
-            table.insert(new_samples, filter.samples[i])
-        end
-        -- Points from start of the filter, midway to newest.
-        -- Only if next != 1
-        if filter.next ~= 1 then
-            for i = 1, filter.next - 1 do
-                table.insert(new_samples, filter.samples[i])
-            end
-        end
-    end
-
-    -- If the new_depth is shorter than the known samples, take away
-    -- the oldest ones.
-    local samples_to_remove = #new_samples - new_depth
-    if samples_to_remove > 0 then
-        local pruned_samples = {}
-        for i = samples_to_remove + 1, #new_samples do
-            table.insert(pruned_samples, new_samples[i])
-        end
-        new_samples = pruned_samples
-    end
-
-    -- Swap the filter state.
-    filter.depth = new_depth
-    filter.samples = new_samples
-    -- Set the .next to the correct point.
-    filter.next = #new_samples + 1
-    if filter.next > filter.depth then
-        filter.next = 1
-    end
-
-    -- Compte a new current value.
-    Depth_Filter.Refresh_Sum(filter)
-end
-
--- Recompute the current sum and average.
-function Depth_Filter.Refresh_Sum(filter)
-    local sum = 0
-    for i, value in ipairs(filter.samples) do
-        sum = sum + value
-    end
-    filter.sum = sum
-    -- Reset current to nil if no samples.
-    if #filter.samples > 0 then
-        filter.current = filter.sum / #filter.samples
-    else
-        filter.current = nil
-    end
-end
-
--- Clear samples.
-function Depth_Filter.Clear(filter)
-    filter.samples = {}
-    filter.next    = 1
-    filter.sum     = 0
-    filter.current = nil
-end
-
-------------------------------------------------------------------------------
--- Alternate filter, time based instead of depth based.
--- This will be the new default.
-local Filter = {}
-
--- Make a new filter, set for "use_realtime" to base on realtime timeout,
--- eg. for cases where jitter is observed in paused games, else uses gametime.
-function Filter.New (use_realtime, default_update_period)
-    local data = {
-        use_realtime = use_realtime,
-        default_update_period = default_update_period,
-    }
-    Filter.Clear(data)
-    return data
-end
-
--- Init/clear the filter.
-function Filter.Clear(filter)
-
-    -- List of samples, where each is a sublist of [real_timestamp, game_timestamp, value].
-    -- This will grow dynamically as needed, but will not shrink.
-    -- Invalidated entries may be present with a nil timestamp, but all
-    -- entries will contain the sublists to be overwritten as needed.
-    filter.samples = {}
-
-    -- Index of the newest entry.
-    -- New samples will be stored after this (or at index 1 if this is
-    -- the last array index and index 1 is free).
-    -- Init to 0; logic works out for first insertion.
-    filter.newest = 0
-    -- Index of the oldest entry that is still valid, or if all are invalid,
-    -- then the index of the next entry expected to be added.
-    -- Anything older will have been invalidated (nil timestamp).
-    -- Init to 1; logic works out for first insertion.
-    filter.oldest = 1
-
-    -- Number of currently valid samples.
-    filter.valid_samples = 0
-
-    -- Time after which samples are dropped, in seconds (may be float).
-    -- (Speed will use this by default for now.)
-    filter.timeout = 0.2
-    -- Running sum of values.
-    filter.sum = 0
-
-    -- How frequently the resulting values are output to users.
-    -- This is used to regulate the ui update rate, since it doesn't need
-    -- to change every frame.
-    -- Can go with 1/10th of a second for now.
-    -- TODO: maybe tune based on distance.
-    filter.summary_period = filter.default_update_period
-    -- Time of the last summary update.
-    filter.last_summary_time = 0
-
-    -- Summary values, not updated every frame.
-    -- Current average value. Note: float.
-    filter.current = nil
-    -- The average delta from newest to oldest, or nil.
-    filter.delta = nil
-end
-
-
--- Add a new sample, and return the current average value.
--- Stores returned value in "current".
-function Filter.Update(filter, sample)
-    -- Convenience renaming.
-    local samples = filter.samples
-
-    -- Select the current time, from gametime or realtime.
-    local time
-    if filter.use_realtime then
-        time = GetCurRealTime()
-    else
-        time = GetCurTime()
-    end
-
-    -- Note how far back the filter should go; older entries should be dropped.
-    local cutoff_time = time - filter.timeout
-
-    -- Update invalidations, starting from the oldest entry.
-    -- Can only do this as long as at least one valid sample remains.
-    -- Update: when testing 2x job counts and the game performed at 5fps,
-    -- the refresh rate on the monitor dropped to where all samples were
-    -- timing out regularly. As a workaround, always keep a couple samples
-    -- regardless of timeout.
-    while filter.valid_samples > 2 do
-        -- Check the oldest timestamp.
-        if samples[filter.oldest][1] < cutoff_time then
-
-            -- Too old, invalidate and move to the next sample.
-            samples[filter.oldest][1] = nil
-            filter.sum = filter.sum - samples[filter.oldest][2]
-            filter.valid_samples = filter.valid_samples - 1
-
-            -- Inc with rollover.
-            filter.oldest = filter.oldest + 1
-            if filter.oldest > #samples then
-                filter.oldest = 1
-            end
-        else
-            -- Oldest is still valid, so stop looking.
-            break
-        end
-    end
-    
-    -- Set up the location for the new value.
-    local insert_index
-    -- Can reuse the newest+1 entry if it is present but invalid.
-    -- If newest is at the end of the array, try the first array location.
-    local post_newest = filter.newest + 1
-    if post_newest > #samples then
-        post_newest = 1
-    end
-    if samples[post_newest] and not samples[post_newest][1] then
-        insert_index = post_newest
-    -- Otherwise, if the newest is at the end of the array, can append
-    -- the new value to grow the array, or if the newest is in the middle,
-    -- can insert a location. Either way works the same.
-    else
-        insert_index = filter.newest + 1
-        -- Make a spot.
-        table.insert(samples, insert_index, nil)
-        -- Adjust the oldest index, if after this spot.
-        -- (The oldest could be before, if everything after this spot
-        -- has been invalidated, or this is at the end of the list.)
-        if filter.oldest >= insert_index then
-            filter.oldest = filter.oldest + 1
-        end
-    end
-
-    -- Store the new value.
-    samples[insert_index] = {time, sample}
-    filter.sum = filter.sum + sample
-    filter.valid_samples = filter.valid_samples + 1
-    filter.newest = insert_index
-    -- If this is the only valid sample, set it as oldest.
-    if filter.valid_samples == 1 then
-        filter.oldest = insert_index
-    end
-
-    -- Update the summary, if needed.
-    -- Based on real time.
-    local now = GetCurRealTime()
-    if now > filter.last_summary_time + filter.summary_period then
-        filter.last_summary_time = now
-
-        -- Calculate the average.
-        -- TODO: this summation might not be entirely stable over time,
-        -- so every so many samples recompute the total sum.
-        -- (This gets reset anyway when the player changes targets.)
-        filter.current = filter.sum / filter.valid_samples
-
-        -- Calculate the delta.
-        local old_sample = filter.samples[filter.oldest]
-        local new_sample = filter.samples[filter.newest]
-
-        -- Check for not having samples, or time not changing.
-        if filter.valid_samples == 0 or old_sample[1] == new_sample[1] then
-            filter.delta = nil
-        else
-            local time_delta  = new_sample[1] - old_sample[1]
-            local value_delta = new_sample[2] - old_sample[2]
-            filter.delta = value_delta / time_delta
-        end
-    end
-end
-
-
--- Change the timeout for the filter.
--- Sample updates occur after the next Update call.
-function Filter.Change_Timeout(filter, new_timeout)
-    -- Safety against 0, negative, or just too large.
-    if new_timeout <= 0 or new_timeout > 100 then
-        DebugError("Filter.Change_Timeout rejecting "..tostring(new_timeout))
-        return
-    end
-    filter.timeout = new_timeout
-end
-
--- Change how often the summary 'current' and 'delta' values recompute.
-function Filter.Change_Summary_Period(filter, new_period)
-    filter.summary_period = new_period
-end
+-- Data smoothing, from the support apis library.
+-- Time based filter; samples older than a timeout are dropped.
+local Filter = Lib.Time_Filter
 
 ------------------------------------------------------------------------------
 -- Setup functions, or helpers.
@@ -680,8 +379,8 @@ function L.Init_TargetMonitor()
     -- Speed is realtime, distance is gametime.
     -- Speed can update fast; distance will update slower to reduce jitter.
     -- TODO: maybe go back to a depth filter for speed, if good enough.
-    L.filter_speed      = Filter.New(true, 0.03)
-    L.filter_distance   = Filter.New(false, 0.1)
+    L.filter_speed      = Filter.new(true, 0.03)
+    L.filter_distance   = Filter.new(false, 0.1)
     
     -- Unused; this approach to distance capture didn't work out
     -- (patches never trigger).
@@ -711,6 +410,7 @@ function L.Handle_Event(signal, value)
             L.settings[L.md_field] = value
             -- Re-init specs, in case they depend on a changed setting.
             L.Init_Specs()
+            L.Clear_Caches()
         else
 
             DebugError("Unrecognized target monitor setting: "..tostring(L.md_field))
@@ -718,6 +418,28 @@ function L.Handle_Event(signal, value)
     end
 end
 
+-- Drop cached layouts and texts, eg. on target or settings change.
+function L.Clear_Caches()
+    L.row_layout = nil
+    for name, cell in pairs(L.live_cells) do
+        cell.key = nil
+        cell.text = nil
+    end
+    L.faction_colors = {}
+end
+
+-- Return the cache entry of a live data cell, a table with the display
+-- key (the cell's inputs, at display precision) and text of its last
+-- formatting. Callers reuse the text while their key is unchanged.
+function L.Get_Cell(name)
+    local cell = L.live_cells[name]
+    if cell == nil then
+        cell = {key = nil, text = nil}
+        L.live_cells[name] = cell
+    end
+    return cell
+end
+
 ------------------------------------------------------------------------------
 -- Generic text support functions.
 
@@ -813,10 +535,73 @@ function L.Brighten_Color(color, target_brightness)
     return new_color
 end
 
+------------------------------------------------------------------------------
+-- Support object for text widths.
+-- Each C.GetTextWidth is an ffi call, and font metrics don't change over
+-- a session, so widths are memoized. Tables are keyed by font, then
+-- fontsize, then string (or character).
+
+local Text_Width = {
+    -- Widths of whole strings.
+    strings = {},
+    -- Per-character advance: how much a string grows when one more of the
+    -- character is appended to a run of it.
+    advances = {},
+}
+
+-- Return the subtable for a font and size, making it if needed.
+local function Get_Font_Table(cache, font, fontsize)
+    local sizes = cache[font]
+    if sizes == nil then
+        sizes = {}
+        cache[font] = sizes
+    end
+    local by_text = sizes[fontsize]
+    if by_text == nil then
+        by_text = {}
+        sizes[fontsize] = by_text
+    end
+    return by_text
+end
+
+-- Width of a string, as GetTextWidth reports it.
+function Text_Width.Get(text, font, fontsize)
+    local by_text = Get_Font_Table(Text_Width.strings, font, fontsize)
+    local width = by_text[text]
+    if width == nil then
+        width = C.GetTextWidth(text, font, fontsize)
+        by_text[text] = width
+    end
+    return width
+end
+
+-- Advance of a character within a run of itself, eg. the width added by
+-- each extra space of padding.
+function Text_Width.Advance(char, font, fontsize)
+    local by_char = Get_Font_Table(Text_Width.advances, font, fontsize)
+    local advance = by_char[char]
+    if advance == nil then
+        advance = Text_Width.Get(char..char, font, fontsize)
+                - Text_Width.Get(char, font, fontsize)
+        by_char[char] = advance
+    end
+    return advance
+end
+
+-- Clear cached widths, eg. if fonts were changed.
+function Text_Width.Clear()
+    Text_Width.strings = {}
+    Text_Width.advances = {}
+end
+-- Link for export.
+L.text_width = Text_Width
+
 -- Given two strings, pad the shorter one with spaces until the strings roughly
 -- match in length.  Suffixes by default, unless "prefix" is true.
 -- Assumes standard font size.
 -- Pricision is limited to space width.
+-- The space count is estimated from the cached space advance, then
+-- stepped to the exact crossing point using cached widths.
 -- TODO: switch to Helper.standardFontMono instead of this logic, and just
 -- simply space to same string length.
 function L.Match_String_Length(A, B, font, prefix)
@@ -843,8 +628,8 @@ function L.Match_String_Length(A, B, font, prefix)
     local fontsize = 18
 
     -- Get the initial text widths.
-    local a_width     = C.GetTextWidth(A, font, fontsize)
-    local b_width     = C.GetTextWidth(B, font, fontsize)
+    local a_width     = Text_Width.Get(A, font, fontsize)
+    local b_width     = Text_Width.Get(B, font, fontsize)
 
     -- Determine the shorter string.
     local new_short
@@ -861,31 +646,51 @@ function L.Match_String_Length(A, B, font, prefix)
     end
 
     -- Pad the shortest string with spaces until reaching the target width.
-    -- Buffer the prior test point for selection later.
-    local debug_spaces_added = 0
+    -- Padded widths are measured at the standard text size.
+    local pad_fontsize = L.orig_defaults.textfontsize
+    local function Padded(spaces)
+        if prefix then
+            return string.rep(" ", spaces)..new_short
+        else
+            return new_short..string.rep(" ", spaces)
+        end
+    end
+    local function Padded_Width(spaces)
+        return Text_Width.Get(Padded(spaces), font, pad_fontsize)
+    end
+
+    -- Find the fewest spaces reaching the target, buffering the prior
+    -- point (one space fewer) for selection later.
+    local spaces_added = 0
     local prior_width    = current_width
-    local prior_short    = new_short
-    while current_width < target_width do
-        -- Save earlier results.
-        prior_width    = current_width
-        prior_short    = new_short
-        -- Add a space.
-        if prefix then 
-            new_short = " "..new_short 
-        else 
-            new_short = new_short.." "
+    if current_width < target_width then
+        local advance = Text_Width.Advance(" ", font, pad_fontsize)
+        local spaces = 1
+        if advance > 0 then
+            spaces = math.max(1, math.ceil(
+                (target_width - Text_Width.Get(new_short, font, pad_fontsize)) / advance))
+        end
+        -- Correct the estimate, in case spacing isn't quite linear.
+        while spaces > 1 and Padded_Width(spaces - 1) >= target_width do
+            spaces = spaces - 1
         end
-        -- Update width.
-        current_width = C.GetTextWidth(new_short, font, L.orig_defaults.textfontsize)
-        debug_spaces_added = debug_spaces_added + 1
+        while Padded_Width(spaces) < target_width do
+            spaces = spaces + 1
+        end
+        current_width = Padded_Width(spaces)
+        if spaces > 1 then
+            prior_width = Padded_Width(spaces - 1)
+        end
+        spaces_added = spaces
     end
 
     -- Switch back to the prior width if it was a closer match.
-    if math.abs(prior_width - target_width) < math.abs(current_width - target_width) then
-        new_short = prior_short
+    if spaces_added > 0
+    and math.abs(prior_width - target_width) < math.abs(current_width - target_width) then
         current_width = prior_width
-        debug_spaces_added = debug_spaces_added - 1
+        spaces_added = spaces_added - 1
     end
+    new_short = Padded(spaces_added)
     
     --[[
     Lib.Print_Table({
@@ -895,7 +700,7 @@ function L.Match_String_Length(A, B, font, prefix)
         b_width = b_width,
         new_short = new_short,
         new_width = current_width,
-        spaces = debug_spaces_added,
+        spaces = spaces_added,
     }, "Match_String_Length")
     ]]
 
@@ -1120,17 +925,25 @@ end
 -- past the 7th.
 -- TODO: maybe remove empty rows (left/right are empty).
 function L.Sanitize_Rows(row_list)
-    -- Since tables cannot be nicely traversed with nil entries,
-    -- sort the table keys first.
-    local keys = {}
-    for key in pairs(row_list) do
-        table.insert(keys, key)
+    -- Since tables cannot be nicely traversed with nil entries, find the
+    -- last index, then walk up to it. (Runs every refresh; this avoids
+    -- sorting the keys.)
+    local last = 0
+    for index in pairs(row_list) do
+        if index > last then
+            last = index
+        end
     end
-    table.sort(keys)
     local final = {}
-    for i, key in ipairs(keys) do
-        if #final < 7 then
-            table.insert(final, row_list[key])
+    local count = 0
+    for index = 1, last do
+        local row = row_list[index]
+        if row ~= nil then
+            count = count + 1
+            final[count] = row
+            if count == 7 then
+                break
+            end
         end
     end
     return final
@@ -1144,19 +957,73 @@ end
 -- Returns a list of row data, or nil if an unsupported object type.
 -- Also may update the targetdata table with some annotation,
 -- eg. if the target has a speed value.
+-- The layout of rows only depends on the target and settings, so it is
+-- built once per target (see Build_Row_Layout), and each refresh just
+-- fills in the original rows, which the ego function makes fresh.
 function L.Get_New_Rows(targetdata, original_rows, row_specs, col_specs)
+    local has_shields = GetComponentData(targetdata.component, "shieldmax") ~= 0
+    local has_reveal  = original_rows.reveal ~= nil
+    local now = GetCurRealTime()
+
+    local layout = L.row_layout
+    if layout == nil
+    or layout.component64 ~= targetdata.component64
+    or layout.row_specs   ~= row_specs
+    or layout.col_specs   ~= col_specs
+    or layout.has_shields ~= has_shields
+    or layout.has_reveal  ~= has_reveal
+    or now > layout.time + L.row_layout_lifetime
+    then
+        layout = L.Build_Row_Layout(targetdata, has_shields, has_reveal, row_specs, col_specs)
+        layout.component64 = targetdata.component64
+        layout.row_specs   = row_specs
+        layout.col_specs   = col_specs
+        layout.has_shields = has_shields
+        layout.has_reveal  = has_reveal
+        layout.time        = now
+        L.row_layout = layout
+    end
+
+    targetdata.has_speed = layout.has_speed
+    if layout.rows == nil then
+        return nil
+    end
+
+    -- Copy the layout, swapping original row names for the rows.
+    -- Missing original rows leave holes, which Sanitize_Rows skips.
+    local new_rows = {}
+    local count = #layout.rows
+    for i = 1, count do
+        local row = layout.rows[i]
+        if type(row) == "string" then
+            new_rows[i] = original_rows[row]
+        else
+            new_rows[i] = row
+        end
+    end
+    -- Append all unknown original rows.
+    for i, unknown in ipairs(original_rows.unknowns) do
+        new_rows[count + i] = unknown
+    end
+    return new_rows
+end
+
+-- Build the row layout for a target: a table with "rows", a list of row
+-- specs and names of original rows (eg. "command_0"), or nil if an
+-- unsupported object type; and "has_speed".
+function L.Build_Row_Layout(targetdata, has_shields, has_reveal, row_specs, col_specs)
     -- Convenience renaming.
     local component = targetdata.component
 
     -- Convenience renaming.
-    local orig  = original_rows
     local rows = row_specs
     local cols = col_specs
+    local has_speed = false
 
-    local has_shields = GetComponentData(component, "shieldmax") ~= 0
     -- Term for shields or blank if unshielded.
     local col_left_shield_blank = has_shields and cols.left.shield or ""
     
+    local cols_distance_delta, cols_right_eta
     -- Some of these objects don't work with the sector position lookup
     -- function.  Pending tweaks, adjust their distance/eta to be
     -- hidden.
@@ -1195,7 +1062,7 @@ function L.Get_New_Rows(targetdata, original_rows, row_specs, col_specs)
     then
         new_rows = {
             -- TODO: does this get too busy with player ship commanders?
-            Make_Row(cols.type, orig.reveal and cols.reveal or cols.commander),
+            Make_Row(cols.type, has_reveal and cols.reveal or cols.commander),
             -- Shield/hull in top left, distance/speed top right.
             Make_Row(col_left_shield_blank, cols_distance_delta),
             Make_Row(cols.left.hull,        cols.speed),
@@ -1204,13 +1071,13 @@ function L.Get_New_Rows(targetdata, original_rows, row_specs, col_specs)
             -- TODO: pack in crew, maybe storage (though that is trickier
             -- to put together, and may be too long).
             -- Continue with normal stuff.
-            orig.command_0,
-            orig.command_1,
-            orig.storage,
-            --orig.crew,
-            orig.building,
+            "command_0",
+            "command_1",
+            "storage",
+            --"crew",
+            "building",
         }
-        targetdata.has_speed = true
+        has_speed = true
     
     -- TODO: for this other stuff, also include a type field like ships,
     -- eg. 'station', 'gate', etc., since the standard ui doesn't indicate
@@ -1218,13 +1085,13 @@ function L.Get_New_Rows(targetdata, original_rows, row_specs, col_specs)
     -- which instead display a target sector.
     elseif IsComponentClass(component, "station") then
         new_rows = {
-            orig.reveal,
+            "reveal",
             Make_Row(col_left_shield_blank, cols_distance_delta),
             Make_Row(cols.left.hull,        ""),
             Make_Row("",                    cols_right_eta),
-            orig.command_0,
-            orig.command_1,
-            orig.building,
+            "command_0",
+            "command_1",
+            "building",
         }
         
     -- Some mines can move, so include speed.
@@ -1235,7 +1102,7 @@ function L.Get_New_Rows(targetdata, original_rows, row_specs, col_specs)
             Make_Row(cols.left.hull,        cols.speed),
             Make_Row("",                    cols_right_eta),
         }
-        targetdata.has_speed = true
+        has_speed = true
 
     -- Objects that can't move.
     elseif IsComponentClass(component, "asteroid")
@@ -1296,14 +1163,7 @@ function L.Get_New_Rows(targetdata, original_rows, row_specs, col_specs)
     end
 
 
-    if new_rows ~= nil then
-        -- Append all unknown original rows.
-        for i, unknown in ipairs(orig.unknowns) do
-            table.insert(new_rows, unknown)
-        end
-    end
-
-    return new_rows
+    return {rows = new_rows, has_speed = has_speed}
 end
 
 ------------------------------------------------------------------------------
@@ -1372,9 +1232,19 @@ function L.Patch_GetTargetMonitorDetails()
             -- so check for empty string.)
             local factionID_str = ffi.string(faction_details.factionID)
             if factionID_str and factionID_str ~= "" then
-                local faction_color = GetFactionData(factionID_str, "color")
-                if faction_color then
-                    full_spec.header.color = L.Brighten_Color(faction_color, L.faction_color_target_brightness)
+                -- Brighten once per faction.
+                local color = L.faction_colors[factionID_str]
+                if color == nil then
+                    local faction_color = GetFactionData(factionID_str, "color")
+                    if faction_color then
+                        color = L.Brighten_Color(faction_color, L.faction_color_target_brightness)
+                    else
+                        color = false
+                    end
+                    L.faction_colors[factionID_str] = color
+                end
+                if color then
+                    full_spec.header.color = color
                 end
             end
         end
@@ -1411,6 +1281,7 @@ function L.Patch_GetLiveData()
 
                 Filter.Clear(L.filter_speed)
                 Filter.Clear(L.filter_distance)
+                L.Clear_Caches()
                 --for key, filter in pairs(L.filters) do
                 --    Filter.Clear(filter)
                 --end
@@ -1450,7 +1321,13 @@ function L.Get_Speed(targetdata)
                                     targetdata.triggeredConnectionName)
     -- Get speed, with smoothing, since per-frame jitter has been observed.
     Filter.Update(L.filter_speed, componentDetails.speed)
-    return math.floor(L.filter_speed.current).." "..T.units["m/s"]
+    local speed = math.floor(L.filter_speed.current)
+    local cell = L.Get_Cell("speed")
+    if cell.key ~= speed then
+        cell.key  = speed
+        cell.text = speed.." "..T.units["m/s"]
+    end
+    return cell.text
 end
 
 ------------------------------------------------------------------------------
@@ -1575,7 +1452,7 @@ function L.Get_Distance(targetdata)
     local distance = L.filter_distance.current
     if distance then        
         -- Suffix it.
-        return L.Value_To_Rounded_Text(distance, T.units["m"], T.units["km"], false)
+        return L.Value_To_Rounded_Text(distance, T.units["m"], T.units["km"], false, L.Get_Cell("distance"))
     end
 
     return "..."
@@ -1606,9 +1483,15 @@ function L.Get_Relative_Speed(targetdata, suffix)
     -- To avoid distance lines getting too long, compress it to km/s if large.
     local ret_str
     if suffix then
-        ret_str = L.Value_To_Rounded_Text(rel_speed, T.units["m/s"], T.units["km/s"], true)
-    else 
-        ret_str = tostring(math.floor(value + 0.5)).." "..T.units["m/s"]
+        ret_str = L.Value_To_Rounded_Text(rel_speed, T.units["m/s"], T.units["km/s"], true,
+                                          L.Get_Cell("rel_speed_suffix"))
+    else
+        local cell = L.Get_Cell("rel_speed")
+        if cell.key ~= rel_speed then
+            cell.key  = rel_speed
+            cell.text = tostring(rel_speed).." "..T.units["m/s"]
+        end
+        ret_str = cell.text
     end
 
     return ret_str
@@ -1655,14 +1538,33 @@ function L.Get_ETA(targetdata)
         return "∞"
     end
 
-    -- Encode as a string.
-    return ConvertTimeString(eta, "%h:%M:%S")
+    -- Encode as a string; only whole seconds are shown.
+    local seconds = math.floor(eta)
+    local cell = L.Get_Cell("eta")
+    if cell.key ~= seconds then
+        cell.key  = seconds
+        cell.text = ConvertTimeString(seconds, "%h:%M:%S")
+    end
+    return cell.text
 end
 
 -- Encode a value as text, rounding off below the decimal, and if over
 -- 1000 then encoding as "X.Y ", and adding corresponding kilo suffix.
-function L.Value_To_Rounded_Text(value, units, kilounits, force_sign)
-    local ret_str
+-- If a live cell (from Get_Cell) is given, its text is reused while the
+-- rounded value is unchanged. A cell should always get the same units.
+function L.Value_To_Rounded_Text(value, units, kilounits, force_sign, cell)
+    -- Round to the displayed precision, counting in tenths of kilounits
+    -- when large. The text depends only on this key.
+    local kilo = value >= 1000
+    local key
+    if kilo then
+        key = math.floor(value / 100 + 0.5)
+    else
+        key = math.floor(value + 0.5)
+    end
+    if cell ~= nil and cell.key == key and cell.kilo == kilo then
+        return cell.text
+    end
 
     -- Maybe force a + sign.
     local fmt_pre
@@ -1672,11 +1574,19 @@ function L.Value_To_Rounded_Text(value, units, kilounits, force_sign)
         fmt_pre = "%"
     end
 
-    if value >= 1000 then
-        return string.format(fmt_pre..".1f %s", value/1000, kilounits)
+    local ret_str
+    if kilo then
+        ret_str = string.format(fmt_pre..".1f %s", key / 10, kilounits)
     else
-        return string.format(fmt_pre..".0f %s", value, units)
+        ret_str = string.format(fmt_pre.."d %s", key, units)
+    end
+
+    if cell ~= nil then
+        cell.key  = key
+        cell.kilo = kilo
+        cell.text = ret_str
     end
+    return ret_str
 end
 
 ------------------------------------------------------------------------------
@@ -1684,6 +1594,18 @@ end
 
 -- Returns a text string with the ship primary role and size.
 function L.getShipTypeText(targetdata)
+    -- Fixed for a target; live cells are cleared on target change.
+    local cell = L.Get_Cell("type")
+    if cell.key == targetdata.component64 then
+        return cell.text
+    end
+    cell.key  = targetdata.component64
+    cell.text = L.Build_Ship_Type_Text(targetdata)
+    return cell.text
+end
+
+-- Build the text for getShipTypeText.
+function L.Build_Ship_Type_Text(targetdata)
 
     -- Note: GetComponentData can be used for most of these fields, but
     -- equivelent is GetMacroData after extracting the component "macro"
@@ -1323,4 +1323,5 @@ L.Init_Hide_Modified()
 ------------------------------------------------------------------------------
 -- Final init.
 return nil,L.Init
-end)
\ No newline at end of file
+-- Eager: the body hooks help text events at ui load.
+end, {eager = true})
\ No newline at end of file
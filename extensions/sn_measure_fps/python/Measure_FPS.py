@@ -1,10 +1,13 @@
 '''
 Python side of measurement gathering.
 '''
-from X4_Python_Pipe_Server import Pipe_Server, Pipe_Client
+from X4_Python_Pipe_Server import Pipe_Server, Pipe_Client, Series_Writer, New_Session_Path
+from X4_Python_Pipe_Server.Classes.Stats import Nearest_Rank
 import time
 import threading
 import json
+from array import array
+from collections import deque
 from pathlib import Path
 
 this_dir = Path(__file__).resolve().parent
@@ -12,6 +15,10 @@ this_dir = Path(__file__).resolve().parent
 # Name of the pipe to use.
 pipe_name = 'x4_measure_fps'
 
+# Folder of recorded sessions, one subfolder per server run; query them
+# with X4_Python_Pipe_Server/Series_Tool.py.
+sessions_dir = this_dir.parent / 'sessions'
+
 # Flag to do a test run with the pipe client handled in python instead
 # of x4.
 test_python_client = 0
@@ -47,13 +54,30 @@ def main(args):
     # Goal here is to give a smoothed fps over time.
     fps_counter = FPS_Counter(window = 60)
 
+    # Frame time percentiles over sliding windows, fed by lua's per-frame
+    # batches, plus a whole-session histogram.
+    frame_windows = [Sliding_Histogram(seconds = 10), Sliding_Histogram(seconds = 60)]
+    frame_session = Frame_Histogram()
+
+    # Record everything for later comparison across sessions. Written out
+    # every couple seconds; frame batches are stamped back in time, so
+    # rows are held a few seconds to be sorted in.
+    store = Series_Writer(New_Session_Path(sessions_dir, 'fps'),
+                          flush_interval = 2, reorder_window = 5,
+                          info = {'module': 'sn_measure_fps'})
+
     # General dict of game state data, most recently sent.
     # 'fps','gametime', etc.
     state_data = {}
     
     while 1:        
         # Blocking wait for a message from x4.
-        message = pipe.Read()
+        # The server ends by being disconnected; write out the held rows.
+        try:
+            message = pipe.Read()
+        except BaseException:
+            store.Close()
+            raise
 
         if test_python_client:
             print(pipe_name + ' server got: ' + message)
@@ -95,6 +119,7 @@ def main(args):
                     # TODO: other stuff.
 
                 if print_fps:
+                    store.Append_Many({'fps': state_data['fps'], 'gametime': state_data['gametime']})
                     # Update the fps counter/smoother.
                     fps_counter.Update(state_data['gametime'], state_data['fps'])
                     # Print the smoothed value.
@@ -102,7 +127,25 @@ def main(args):
                                         
                 # Get the in-game systemtime.
                 #print('$systemtime (H,M,S): {}'.format(data['$systemtime']))
-                
+
+            # Batch of frame times from lua.
+            # Format: 'frames;<realtime the first frame began>;<ms>,<ms>,...;'
+            elif command == 'frames':
+                start_time, times = args.split(';')[0:2]
+                frame_time = float(start_time)
+                frame_times = [float(ms) for ms in times.split(',')]
+                # Store on the wall clock, ending the batch now.
+                wall_time = time.time() - sum(frame_times) / 1000
+                for ms in frame_times:
+                    frame_time += ms / 1000
+                    wall_time += ms / 1000
+                    for window in frame_windows:
+                        window.Record(frame_time, ms)
+                    frame_session.Record(ms)
+                    store.Append('frame_ms', ms, wall_time)
+                for window in frame_windows:
+                    window.Print()
+
             else:
                 print(f'Error: {pipe_name} unrecognized command: {command} in message {message}')
 
@@ -118,13 +161,165 @@ def main(args):
     return
 
 
+class Frame_Histogram:
+    '''
+    Streaming histogram of frame times, in the style of an HDR histogram:
+    log-linear buckets giving each value about 1.5% relative precision,
+    with counts in a fixed C array. Recording is O(1) and memory is fixed,
+    however many frames are seen.
+
+    * sub_bits
+      - Bits of linear sub-buckets per power of two; sets the precision.
+    * unit
+      - Smallest resolved value, in ms (default 1 microsecond).
+    * max_value
+      - Largest value tracked, in ms; larger values clamp to it.
+    '''
+    def __init__(self, sub_bits = 6, unit = 0.001, max_value = 16000):
+        self.sub_bits = sub_bits
+        self.sub_count = 1 << sub_bits
+        self.unit = unit
+        self.max_units = int(max_value / unit)
+        self.counts = array('L', bytes(array('L').itemsize * (self.Bucket(self.max_units) + 1)))
+        self.total = 0
+        self.max = 0.0
+        return
+
+    def Bucket(self, units):
+        '''
+        Bucket index for a value in units. Values below sub_count get one
+        bucket each; above, each power of two splits into sub_count/2
+        buckets.
+        '''
+        if units < self.sub_count:
+            return units
+        shift = units.bit_length() - self.sub_bits
+        return (shift << (self.sub_bits - 1)) + (units >> shift)
+
+    def Bucket_Value(self, index):
+        '''
+        Representative value in ms (the bucket midpoint) of a bucket.
+        '''
+        if index < self.sub_count:
+            return index * self.unit
+        half = self.sub_count >> 1
+        shift = index // half - 1
+        low = (index - shift * half) << shift
+        return (low + ((1 << shift) - 1) / 2) * self.unit
+
+    def Record(self, ms, count = 1):
+        units = min(int(ms / self.unit), self.max_units)
+        self.counts[self.Bucket(units)] += count
+        self.total += count
+        if ms > self.max:
+            self.max = ms
+        return
+
+    def Percentiles(self, fractions):
+        '''
+        Return values in ms at the given fractions (eg. 0.99), in one pass
+        over the buckets. Ranks are as Stats.Percentiles, to bucket precision.
+        '''
+        fractions = list(fractions)
+        if not self.total:
+            return [0.0 for _ in fractions]
+        targets = sorted((Nearest_Rank(self.total, fraction), i)
+                         for i, fraction in enumerate(fractions))
+        results = [0.0] * len(fractions)
+        seen = 0
+        next_target = 0
+        for index, count in enumerate(self.counts):
+            if not count:
+                continue
+            seen += count
+            while next_target < len(targets) and seen >= targets[next_target][0]:
+                results[targets[next_target][1]] = self.Bucket_Value(index)
+                next_target += 1
+            if next_target == len(targets):
+                break
+        return results
+
+
+class Sliding_Histogram:
+    '''
+    Frame_Histogram over the last `seconds`, kept as a ring of one
+    histogram per slot plus their running total. Recording touches one
+    slot and the total; expiring a slot subtracts it from the total, a
+    fixed cost per slot_seconds regardless of the frame rate.
+
+    * seconds
+      - Window length.
+    * slot_seconds
+      - Granularity at which old frames leave the window.
+    '''
+    def __init__(self, seconds = 10, slot_seconds = 1):
+        self.seconds = seconds
+        self.slot_seconds = slot_seconds
+        self.slots = [Frame_Histogram() for _ in range(int(seconds / slot_seconds))]
+        self.window = Frame_Histogram()
+        # Slot number (time // slot_seconds) of the newest slot.
+        self.current = None
+        # Per-slot max, so the window max can drop old spikes.
+        self.slot_max = [0.0] * len(self.slots)
+        return
+
+    def Advance(self, time):
+        '''
+        Expire slots older than the window, up to the given time.
+        '''
+        slot = int(time // self.slot_seconds)
+        if self.current is None:
+            self.current = slot
+            return
+        # Clear at most every slot once, even after a long gap.
+        for expired in range(self.current + 1, min(slot, self.current + len(self.slots)) + 1):
+            index = expired % len(self.slots)
+            old = self.slots[index]
+            if old.total:
+                window_counts = self.window.counts
+                for bucket, count in enumerate(old.counts):
+                    if count:
+                        window_counts[bucket] -= count
+                        old.counts[bucket] = 0
+                self.window.total -= old.total
+                old.total = 0
+            self.slot_max[index] = 0.0
+        if slot > self.current:
+            self.current = slot
+            self.window.max = max(self.slot_max)
+        return
+
+    def Record(self, time, ms):
+        '''
+        Record a frame time in ms, for a frame ending at the given time
+        in seconds. Times should not go backwards by more than a slot.
+        '''
+        self.Advance(time)
+        index = self.current % len(self.slots)
+        self.slots[index].Record(ms)
+        self.window.Record(ms)
+        if ms > self.slot_max[index]:
+            self.slot_max[index] = ms
+        return
+
+    def Print(self):
+        '''
+        Print a line of frame time percentiles over the window.
+        '''
+        window = self.window
+        p50, p90, p99, p999 = window.Percentiles([0.5, 0.9, 0.99, 0.999])
+        print('frame ms over {}s: p50 {:.2f}, p90 {:.2f}, p99 {:.2f}, p99.9 {:.2f}, max {:.2f} ({} frames)'.format(
+            self.seconds, p50, p90, p99, p999, window.max, window.total))
+        return
+
+
 class FPS_Counter:
     '''
     Stores fps samples, and produces a smoothed value over time, since
     the in-game count fluctuated wildely each second.
 
     * samples
-      - List of tuples of (gametime, fps count). Newest is first.
+      - Deque of tuples of (gametime, fps count). Newest is first.
     * running_sum
       - Sum of fps counts, to speed up averaging.
       - Samples are assumed to arrive at a regular rate, eg. every second,
@@ -135,7 +330,7 @@ class FPS_Counter:
       - Samples older than this window will be removed.
     '''
     def __init__(self, window = 5):
-        self.samples = []
+        self.samples = deque()
         self.running_sum = 0
         self.window = window
         return
@@ -144,19 +339,14 @@ class FPS_Counter:
         '''
         Record a new fps sample at the given gametime.
         '''
-        self.samples.insert(0, (gametime, fps))
+        self.samples.appendleft((gametime, fps))
         self.running_sum += fps
 
-        # Prune out old samples.
+        # Prune out old samples, from the old end.
         oldest = gametime - self.window
         samples = self.samples
-        # Go backwards, removing items until something is new enough.
-        for i in reversed(range(len(samples))):
-            if samples[i][0] < oldest:
-                self.running_sum -= samples[i][1]
-                samples.pop(-1)
-            else:
-                break
+        while samples[-1][0] < oldest:
+            self.running_sum -= samples.pop()[1]
         return
 
     def Get_FPS(self):
@@ -206,6 +396,13 @@ def Pipe_Client_Test():
         'update;$fps:26;$gametime:8;',
         ]
 
+    # Frame time batches, about a second each with a few stutters.
+    frame_time = 0
+    for batch in range(12):
+        times = [16.7] * 58 + [33.4, 120.0 if batch % 4 == 0 else 16.7]
+        messages.append('frames;{};{};'.format(frame_time, ','.join(str(x) for x in times)))
+        frame_time += sum(times) / 1000
+
     # Just transmit; expect no responses for now.
     for message in messages:
         pipe.Write(message)
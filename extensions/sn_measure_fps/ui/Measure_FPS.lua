@@ -1,6 +1,10 @@
 Lua_Loader.define("extensions.sn_measure_fps.ui.Measure_FPS",function(require)
 --[[
 Bounces fps sample data back to md.
+
+Also records the duration of every frame, through the time api's frame
+detector, and hands them to md in one batch per sample, for frame time
+percentiles on the python side.
 ]]
 
 local ffi = require("ffi")
@@ -14,12 +18,42 @@ ffi.cdef[[
     } FPSDetails;
     FPSDetails GetFPS();
 ]]
+local Time = require("extensions.sn_mod_support_apis.ui.time.Interface")
 
-L = {}
+L = {
+    -- Frame times in ms since the last batch, and how many are valid.
+    -- Entries are overwritten rather than cleared between batches.
+    frame_times = {},
+    frame_count = 0,
+    -- Cap on stored frames, should md stop asking for batches.
+    max_frames = 1200,
+    -- Real time of the last frame, and of the frame before the batch.
+    last_frame_time = nil,
+    batch_start_time = nil,
+    -- Gaps longer than this (loading, alt-tab) are not frame times.
+    max_frame_seconds = 5,
+}
 
 function Init()
     -- Sampler of current fps; gets called roughly once a second.
     RegisterEvent("Measure_FPS.Get_Sample", L.Get_Sample)
+    Time.Register_NewFrame_Callback(L.Record_Frame, nil, "Measure_FPS frame times")
+end
+
+-- Per-frame: store the time since the previous frame.
+function L.Record_Frame(now)
+    local last = L.last_frame_time
+    L.last_frame_time = now
+    if last == nil or now - last > L.max_frame_seconds then
+        -- Restart the batch at this frame.
+        L.frame_count = 0
+        L.batch_start_time = now
+        return
+    end
+    if L.frame_count >= L.max_frames then return end
+    local count = L.frame_count + 1
+    L.frame_times[count] = (now - last) * 1000
+    L.frame_count = count
 end
 
 -- Simple sampler, returning framerate and gametime.
@@ -28,7 +62,24 @@ function L.Get_Sample()
         gametime     = GetCurTime(),
         fps          = C.GetFPS().fps,
     })
+    L.Send_Frames()
+end
+
+-- Hand the frame times gathered since the last batch to md, as
+-- "<start realtime>;<ms>,<ms>,...;".
+function L.Send_Frames()
+    local count = L.frame_count
+    if count == 0 then return end
+    local times = L.frame_times
+    local parts = {}
+    for i = 1, count do
+        parts[i] = string.format("%.2f", times[i])
+    end
+    AddUITriggeredEvent("Measure_FPS", "Frames",
+        string.format("%.4f;%s;", L.batch_start_time, table.concat(parts, ",")))
+    L.frame_count = 0
+    L.batch_start_time = L.last_frame_time
 end
 
 return nil,Init
-end)
\ No newline at end of file
+end)
@@ -0,0 +1,182 @@
+--[[
+Benchmark for the Library smoothing filters, with many filters updated
+every frame at 60 Hz (as the target monitor does for speed and distance).
+Run from the extension folder:
+    luajit benchmarks/Filter_Benchmark.lua
+
+Compares Time_Filter against the table-per-sample filter it replaced,
+checking both give the same averages, and counts memory allocated while
+updating in steady state. Also checks running sum drift over a long run.
+]]
+dofile("benchmarks/Host_Stubs.lua")
+Host.Load("ui/Library.lua")
+local Lib = Host.Require("extensions.sn_mod_support_apis.ui.Library")
+local Time_Filter = Lib.Time_Filter
+local Depth_Filter = Lib.Depth_Filter
+
+-- Gametime follows realtime here.
+function GetCurTime() return Host.now end
+
+
+-- The target monitor filter prior to the library version, for comparison.
+local Old_Filter = {}
+function Old_Filter.New(use_realtime, default_update_period)
+    local filter = {use_realtime = use_realtime, default_update_period = default_update_period}
+    Old_Filter.Clear(filter)
+    return filter
+end
+function Old_Filter.Clear(filter)
+    filter.samples = {}
+    filter.newest = 0
+    filter.oldest = 1
+    filter.valid_samples = 0
+    filter.timeout = 0.2
+    filter.sum = 0
+    filter.summary_period = filter.default_update_period
+    filter.last_summary_time = 0
+    filter.current = nil
+    filter.delta = nil
+end
+function Old_Filter.Update(filter, sample)
+    local samples = filter.samples
+    local time = filter.use_realtime and GetCurRealTime() or GetCurTime()
+    local cutoff_time = time - filter.timeout
+    while filter.valid_samples > 2 and samples[filter.oldest][1] < cutoff_time do
+        samples[filter.oldest][1] = nil
+        filter.sum = filter.sum - samples[filter.oldest][2]
+        filter.valid_samples = filter.valid_samples - 1
+        filter.oldest = filter.oldest + 1
+        if filter.oldest > #samples then filter.oldest = 1 end
+    end
+    local insert_index
+    local post_newest = filter.newest + 1
+    if post_newest > #samples then post_newest = 1 end
+    if samples[post_newest] and not samples[post_newest][1] then
+        insert_index = post_newest
+    else
+        insert_index = filter.newest + 1
+        table.insert(samples, insert_index, nil)
+        if filter.oldest >= insert_index then filter.oldest = filter.oldest + 1 end
+    end
+    samples[insert_index] = {time, sample}
+    filter.sum = filter.sum + sample
+    filter.valid_samples = filter.valid_samples + 1
+    filter.newest = insert_index
+    if filter.valid_samples == 1 then filter.oldest = insert_index end
+    local now = GetCurRealTime()
+    if now > filter.last_summary_time + filter.summary_period then
+        filter.last_summary_time = now
+        filter.current = filter.sum / filter.valid_samples
+        local old_sample = samples[filter.oldest]
+        local new_sample = samples[filter.newest]
+        if old_sample[1] == new_sample[1] then
+            filter.delta = nil
+        else
+            filter.delta = (new_sample[2] - old_sample[2]) / (new_sample[1] - old_sample[1])
+        end
+    end
+end
+function Old_Filter.Change_Timeout(filter, new_timeout) filter.timeout = new_timeout end
+
+
+local filter_count = 1000
+local frame_count = 60 * 60
+math.randomseed(1)
+
+-- Per filter: a drifting value, and a timeout from the distance tiers.
+local timeouts = {0.1, 0.2, 0.4, 1.0, 2.0, 3.0}
+local bases = {}
+for i = 1, filter_count do bases[i] = math.random() * 100000 end
+
+local function Make(constructor, change_timeout)
+    local filters = {}
+    for i = 1, filter_count do
+        filters[i] = constructor(i % 2 == 0, 0.03)
+        change_timeout(filters[i], timeouts[i % #timeouts + 1])
+    end
+    return filters
+end
+
+-- Run frames over all filters; returns seconds per filter update.
+-- Frame times jitter around 60 Hz.
+local function Run(filters, update, frames, check)
+    local elapsed = 0
+    for frame = 1, frames do
+        Host.now = Host.now + (1 / 60) * (0.75 + math.random() * 0.5)
+        local start = os.clock()
+        for i = 1, filter_count do
+            update(filters[i], bases[i] + Host.now * 10 + math.random())
+        end
+        elapsed = elapsed + os.clock() - start
+        if check then check(frame) end
+    end
+    return elapsed / (frames * filter_count)
+end
+
+-- Same averages as the old filter, frame by frame.
+local old_filters = Make(Old_Filter.New, Old_Filter.Change_Timeout)
+local new_filters = Make(Time_Filter.new, Time_Filter.Change_Timeout)
+local checked = {}
+for i = 1, filter_count, 97 do checked[#checked + 1] = i end
+local seed_now = Host.now
+math.randomseed(2)
+local old_values = {}
+Run(old_filters, Old_Filter.Update, 600, function(frame)
+    local values = {}
+    for index, i in ipairs(checked) do values[index] = old_filters[i].current or false end
+    old_values[frame] = values
+end)
+Host.now = seed_now
+math.randomseed(2)
+local mismatches = 0
+Run(new_filters, Time_Filter.Update, 600, function(frame)
+    local values = old_values[frame]
+    for index, i in ipairs(checked) do
+        local old, new = values[index], new_filters[i].current or false
+        if (old == false) ~= (new == false)
+        or (old and math.abs(old - new) > 1e-9 * math.abs(old)) then
+            mismatches = mismatches + 1
+        end
+    end
+end)
+assert(mismatches == 0, "filters disagree "..mismatches.." times")
+print("Time_Filter averages match the old filter over 600 frames")
+
+-- Timing, from warmed up filters.
+print(string.format("%d filters at 60 Hz, %d s:", filter_count, frame_count / 60))
+Host.Report("  old filter, per update", Run(old_filters, Old_Filter.Update, frame_count))
+Host.Report("  Time_Filter, per update", Run(new_filters, Time_Filter.Update, frame_count))
+
+-- Memory allocated in steady state, with collection stopped.
+local function Allocated_Kb(filters, update)
+    collectgarbage("collect")
+    collectgarbage("stop")
+    local before = collectgarbage("count")
+    Run(filters, update, 600)
+    local after = collectgarbage("count")
+    collectgarbage("restart")
+    return after - before
+end
+print(string.format("  old filter, kB allocated per 10 s:   %10.1f", Allocated_Kb(old_filters, Old_Filter.Update)))
+print(string.format("  Time_Filter, kB allocated per 10 s:  %10.1f", Allocated_Kb(new_filters, Time_Filter.Update)))
+
+-- Running sum drift over a long session (an hour at 60 Hz) of large,
+-- noisy values, against an exact recomputation of the window.
+local depth = 50
+local filter = Depth_Filter.new(depth)
+local naive_sum, window = 0, {}
+math.randomseed(3)
+for i = 1, 60 * 60 * 60 do
+    local sample = 1e7 + math.random() * 0.001
+    filter:Smooth(sample)
+    -- The slot holds the sample leaving the window.
+    local slot = (i - 1) % depth + 1
+    if i > depth then naive_sum = naive_sum - window[slot] end
+    window[slot] = sample
+    naive_sum = naive_sum + sample
+end
+local exact = 0
+for i = 1, depth do exact = exact + (window[i] - 1e7) end
+exact = exact / depth + 1e7
+print(string.format("Depth_Filter average error after 216k samples: %.3g (uncompensated %.3g)",
+    math.abs(filter.current - exact), math.abs(naive_sum / depth - exact)))
@@ -0,0 +1,128 @@
+--[[
+Minimal stand-ins for the x4 ui globals, so api modules can be loaded and
+timed with a plain lua interpreter (luajit preferred, to match x4).
+Not part of the shipped extension.
+
+Usage, from the extension folder:
+    luajit benchmarks/<name>_Benchmark.lua
+
+Benchmarks dofile this, then Host.Load() the ui files they need in the
+same order as ui.xml.
+]]
+
+Host = {
+    -- Current value returned by GetCurRealTime.
+    now = 0,
+    -- Lua event handlers, keyed by event name (last registered wins).
+    events = {},
+    -- Player blackboard vars, keyed by name.
+    blackboard = {},
+    -- Exports and init functions of defined modules, keyed by name.
+    modules = {},
+    -- If true, DebugError prints; otherwise messages are just counted.
+    print_errors = false,
+    error_count = 0,
+}
+
+unpack = unpack or table.unpack
+
+-- Luajit's bit library, when run on lua 5.3+ (results wrap to signed
+-- 32-bit, as in luajit). Loaded from a string, so luajit can parse this.
+if bit == nil then
+    bit = load([[
+        local function tobit(x)
+            x = x & 0xFFFFFFFF
+            if x >= 0x80000000 then x = x - 0x100000000 end
+            return x
+        end
+        return {
+            tobit  = tobit,
+            band   = function(a, b) return tobit(a & b) end,
+            bor    = function(a, b) return tobit(a | b) end,
+            bxor   = function(a, b) return tobit(a ~ b) end,
+            bnot   = function(a) return tobit(~a) end,
+            lshift = function(a, n) return tobit(a << n) end,
+            rshift = function(a, n) return tobit((a & 0xFFFFFFFF) >> n) end,
+        }
+    ]])()
+end
+
+Lua_Loader = {}
+function Lua_Loader.define(name, module_function)
+    local function module_require(dep)
+        local module = Host.modules[dep]
+        if module ~= nil then
+            return module.exports, module.init
+        end
+        return require(dep)
+    end
+    local exports, init = module_function(module_require)
+    Host.modules[name] = {exports = exports, init = init}
+    return exports, init
+end
+
+-- Load a ui file relative to the extension folder.
+function Host.Load(path)
+    dofile(path)
+end
+
+-- Return the exports of a defined module, running its init once.
+function Host.Require(name)
+    local module = Host.modules[name]
+    if module == nil then
+        error("Host.Require: module not defined: "..tostring(name))
+    end
+    if module.init ~= nil and not module.initialized then
+        module.initialized = true
+        module.init()
+    end
+    return module.exports
+end
+
+-- Call a registered event handler, as x4 would for raise_lua_event.
+function Host.Fire(name, param)
+    local handler = Host.events[name]
+    if handler == nil then
+        error("Host.Fire: no handler for "..tostring(name))
+    end
+    return handler(name, param)
+end
+
+-- Run a function repeatedly, returning seconds per call.
+function Host.Time(func, iterations)
+    iterations = iterations or 1
+    local start = os.clock()
+    for i = 1, iterations do
+        func(i)
+    end
+    return (os.clock() - start) / iterations
+end
+
+function Host.Report(label, seconds)
+    print(string.format("%-48s %12.3f us", label, seconds * 1e6))
+end
+
+function GetCurRealTime() return Host.now end
+function DebugError(message)
+    Host.error_count = Host.error_count + 1
+    if Host.print_errors then print("DebugError: "..tostring(message)) end
+end
+function RegisterEvent(name, handler) Host.events[name] = handler end
+function UnregisterEvent(name, handler)
+    if Host.events[name] == handler then Host.events[name] = nil end
+end
+function SetScript(name, handler) Host.events[name] = handler end
+function RemoveScript(name, handler) UnregisterEvent(name, handler) end
+function AddUITriggeredEvent() end
+function CallEventScripts() end
+function ConvertStringTo64Bit(value) return tonumber(value) end
+
+function GetNPCBlackboard(_, key)
+    local value = Host.blackboard[key]
+    if type(value) ~= "table" then return value end
+    -- x4 returns a copy.
+    local copy = {}
+    for k, v in pairs(value) do copy[k] = v end
+    return copy
+end
+function SetNPCBlackboard(_, key, value) Host.blackboard[key] = value end
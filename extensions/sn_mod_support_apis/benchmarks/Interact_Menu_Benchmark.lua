@@ -0,0 +1,228 @@
+--[[
+Benchmark for the interact menu flag checks of registered (static)
+actions, with a few hundred actions checked on each menu open.
+Run from the extension folder:
+    luajit benchmarks/Interact_Menu_Benchmark.lua
+
+Compares the compiled bitmask checks against the string keyed flag
+table they replaced, checking both select the same actions over a set of
+made up targets. The reference has its disabled_conditions lookup fixed
+and its menu flags under their documented names, since the old code
+ignored both.
+]]
+dofile("benchmarks/Host_Stubs.lua")
+
+-- Made up targets, keyed by component id.
+local class_names = {"controllable", "destructible", "gate", "ship", "station"}
+local data_names  = {"isdock", "isdeployable", "isenemy", "isplayerowned", "assignedpilot"}
+local targets = {}
+math.randomseed(1)
+for component = 1, 40 do
+    local target = {classes = {}, data = {}}
+    for _, name in ipairs(class_names) do target.classes[name] = math.random() < 0.5 and 1 or 0 end
+    for _, name in ipairs(data_names) do target.data[name] = math.random() < 0.5 and 1 or nil end
+    target.operational = math.random() < 0.8
+    target.in_squad = math.random() < 0.2
+    target.show_interactions = math.random() < 0.5
+    target.has_pilot = math.random() < 0.5
+    target.selected = math.random() < 0.5 and {component} or {}
+    targets[component] = target
+end
+-- Component 0 is no target (eg. a mission).
+targets[0] = {classes = {}, data = {}, selected = {}}
+local target = targets[1]
+
+package.loaded.ffi = {
+    cdef = function() end,
+    C = {
+        GetPlayerID = function() return 1000 end,
+        IsComponentClass = function(component, name) return target.classes[name] or 0 end,
+        GetPlayerOccupiedShipID = function() return 3 end,
+        GetPlayerControlledShipID = function() return 3 end,
+        GetPlayerContainerID = function() return 0 end,
+    },
+}
+function GetComponentData(component, ...)
+    local values = {}
+    for i, name in ipairs({...}) do values[i] = target.data[name] end
+    return unpack(values, 1, select("#", ...))
+end
+function IsComponentOperational() return target.operational end
+
+-- Stand-in for the egosoft interact menu.
+local inserted = {}
+local menu = {
+    name = "InteractMenu",
+    componentSlot = {component = 1},
+    selectedplayerships = {},
+    playerSquad = {},
+    onUpdate = function() end,
+    draw = function() end,
+    display = function() end,
+    prepareActions = function() return false end,
+    insertInteractionContent = function(section, entry) inserted[#inserted + 1] = entry.helpOverlayID end,
+}
+Menus = {menu}
+Helper = {interactMenuCallbacks = {}}
+
+local function Select_Target(component)
+    target = targets[component]
+    menu.componentSlot.component = component
+    menu.showPlayerInteractions = target.show_interactions
+    menu.hasPlayerShipPilot = target.has_pilot
+    menu.selectedplayerships = target.selected
+    menu.playerSquad = {[component] = target.in_squad or nil}
+end
+
+Host.Load("ui/Library.lua")
+Host.Load("ui/time/Interface.lua")
+Host.Load("ui/Command_Bridge.lua")
+Host.Load("ui/interact_menu/Interface.lua")
+Host.Require("extensions.sn_mod_support_apis.ui.time.Interface")
+Host.Require("extensions.sn_mod_support_apis.ui.interact_menu.Interface")
+
+-- The module exports nothing; find its locals through the patched
+-- prepareActions.
+local L
+for i = 1, 20 do
+    local name, value = debug.getupvalue(menu.prepareActions, i)
+    if name == "L" then L = value break end
+end
+assert(L ~= nil, "interact menu locals not found")
+
+
+-- Register actions from md, with random conditions.
+local flag_names = {}
+for _, name in ipairs(L.flag_names) do flag_names[#flag_names + 1] = name end
+local function Random_Conditions(max_count)
+    local conditions = {}
+    for i = 1, math.random(0, max_count) do
+        local name = flag_names[math.random(1, #flag_names)]
+        if math.random() < 0.3 then name = "~"..name end
+        conditions[i] = name
+    end
+    return conditions
+end
+local action_count = 300
+local args_list = {}
+for i = 1, action_count do
+    args_list[i] = {
+        command = "Register_Action",
+        id = "action_"..i,
+        text = "Action "..i,
+        section = "main",
+        enabled_conditions = Random_Conditions(3),
+        disabled_conditions = Random_Conditions(2),
+    }
+end
+Host.blackboard["$interact_menu_args"] = args_list
+Host.Fire("Interact_Menu.Process_Command")
+assert(#L.static_actions_order == action_count)
+
+
+-- The string keyed flags prior to the bitsets, for comparison.
+local Old = {}
+local function tobool(value) return (value and value ~= 0) and true or false end
+function Old.Update_Flags()
+    local component = menu.componentSlot.component
+    local convertedComponent = ConvertStringTo64Bit(tostring(component))
+    local C = package.loaded.ffi.C
+    local flags = {}
+    if convertedComponent > 0 then
+        for key, name in pairs({
+            class_controllable = "controllable", class_destructible = "destructible",
+            class_gate = "gate", class_ship = "ship", class_station = "station",
+        }) do
+            flags[key] = tobool(C.IsComponentClass(component, name))
+        end
+        for key, name in pairs({
+            is_dock = "isdock", is_deployable = "isdeployable",
+            is_enemy = "isenemy", is_playerowned = "isplayerowned",
+        }) do
+            flags[key] = tobool(GetComponentData(convertedComponent, name))
+        end
+        flags["show_PlayerInteractions"]  = tobool(menu.showPlayerInteractions)
+        flags["has_PlayerShipPilot"]      = tobool(menu.hasPlayerShipPilot)
+        flags["is_operational"]           = tobool(IsComponentOperational(convertedComponent))
+        flags["have_selectedplayerships"] = #menu.selectedplayerships > 0
+        flags["has_pilot"]                = GetComponentData(convertedComponent, "assignedpilot") ~= nil
+        flags["in_playersquad"]           = tobool(menu.playerSquad[convertedComponent])
+        local player_occupied_ship = ConvertStringTo64Bit(tostring(C.GetPlayerOccupiedShipID()))
+        local player_piloted_ship  = ConvertStringTo64Bit(tostring(C.GetPlayerControlledShipID()))
+        flags["is_playeroccupiedship"]    = player_occupied_ship == convertedComponent
+        flags["player_is_piloting"]       = player_piloted_ship > 0
+        local negated_flags = {}
+        for key, value in pairs(flags) do negated_flags["~"..key] = not value end
+        for key, value in pairs(negated_flags) do flags[key] = value end
+    end
+    Old.flags = flags
+end
+function Old.Check_Flags(action)
+    if #action.enabled_conditions ~= 0 then
+        local match_found = false
+        for _, flag in ipairs(action.enabled_conditions) do
+            if Old.flags[flag] then match_found = true break end
+        end
+        if not match_found then return false end
+    end
+    for _, flag in ipairs(action.disabled_conditions) do
+        if Old.flags[flag] then return false end
+    end
+    return true
+end
+
+-- Ids of static actions that pass the flag checks on one menu open.
+local function Old_Selection()
+    Old.Update_Flags()
+    local selected = {}
+    for _, id in ipairs(L.static_actions_order) do
+        local action = L.static_actions[id]
+        if Old.Check_Flags(action) then selected[#selected + 1] = "interactmenu_"..id end
+    end
+    return selected
+end
+local function New_Selection()
+    inserted = {}
+    menu.prepareActions()
+    return inserted
+end
+
+-- Same selections, on every target.
+local total_selected = 0
+for component = 0, #targets do
+    Select_Target(component)
+    local old, new = Old_Selection(), New_Selection()
+    assert(#old == #new, "selection count differs on target "..component)
+    for i = 1, #old do
+        assert(old[i] == new[i], "selection differs on target "..component..": "..old[i].." / "..new[i])
+    end
+    total_selected = total_selected + #new
+end
+print(string.format("%d actions on %d targets select the same %d entries",
+    action_count, #targets + 1, total_selected))
+
+
+-- Timing of flag updates and checks per menu open.
+local opens = 2000
+local function Old_Open(i)
+    Select_Target(i % #targets + 1)
+    Old.Update_Flags()
+    for _, id in ipairs(L.static_actions_order) do Old.Check_Flags(L.static_actions[id]) end
+end
+local function New_Open(i)
+    Select_Target(i % #targets + 1)
+    L.Update_Flags()
+    for _, id in ipairs(L.static_actions_order) do L.Check_Flags(L.static_actions[id]) end
+end
+print(string.format("Per menu open, %d actions:", action_count))
+Host.Report("  string flags table", Host.Time(Old_Open, opens))
+Host.Report("  compiled bitmasks", Host.Time(New_Open, opens))
+Select_Target(1)
+Old.Update_Flags()
+L.Update_Flags()
+Host.Report("  of which Check_Flags, string flags, per action", Host.Time(function(i)
+    Old.Check_Flags(L.static_actions[L.static_actions_order[i % action_count + 1]])
+end, 200000))
+Host.Report("  of which Check_Flags, bitmasks, per action", Host.Time(function(i)
+    L.Check_Flags(L.static_actions[L.static_actions_order[i % action_count + 1]])
+end, 200000))
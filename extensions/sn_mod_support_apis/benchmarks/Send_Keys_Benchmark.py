@@ -0,0 +1,219 @@
+'''
+Benchmark for the Send_Keys combo matcher, with thousands of combos.
+Run from the extension folder:
+    python benchmarks/Send_Keys_Benchmark.py
+
+Times Update_Combos on a setkeys message (fresh and resent), and
+Process_Key_Events against a linear scan of all combos (the matcher
+prior to compiling combos into a trigger table), checking both give the
+same matches. Off windows, the win32/pynput/pipe imports are stubbed.
+Not part of the shipped extension.
+'''
+import sys
+import time
+import random
+import types
+import importlib.util
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parents[1] / 'python'))
+
+if sys.platform != 'win32':
+    # Scancodes without the extended bit, as MapVirtualKey would give.
+    def Map_Virtual_Key(vk, map_type):
+        for vkname, this_vk, extended, scancode, local_name in Send_Keys_Info:
+            if this_vk == vk:
+                return (scancode or 0) & 0x7F
+        return 0
+    Send_Keys_Info = []
+    stubs = {
+        'win32api'  : {'MapVirtualKey': Map_Virtual_Key},
+        'win32gui'  : {'GetWindowText': None, 'GetForegroundWindow': None},
+        'pynput'    : {'keyboard': None},
+        'X4_Python_Pipe_Server': {'Pipe_Server': None, 'Pipe_Client': None},
+        }
+    for name, attributes in stubs.items():
+        module = types.ModuleType(name)
+        module.__dict__.update(attributes)
+        sys.modules[name] = module
+
+    # The metrics registry and stats helpers are plain python; load them
+    # into the stub package.
+    classes_path = Path(__file__).resolve().parents[3] / 'X4_Python_Pipe_Server' / 'Classes'
+    classes = types.ModuleType('X4_Python_Pipe_Server.Classes')
+    sys.modules['X4_Python_Pipe_Server.Classes'] = classes
+    for module_name in ['Metrics', 'Stats']:
+        spec = importlib.util.spec_from_file_location(
+            'X4_Python_Pipe_Server.Classes.' + module_name, classes_path / (module_name + '.py'))
+        module = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(module)
+        setattr(classes, module_name, module)
+        sys.modules['X4_Python_Pipe_Server.Classes.' + module_name] = module
+    sys.modules['X4_Python_Pipe_Server'].Percentiles = classes.Stats.Percentiles
+
+    # Send_Keys checks the platform at import; its key table is needed
+    # by the stub before Key_Init runs, so pull it from the source.
+    source = (Path(__file__).resolve().parents[1] / 'python' / 'Send_Keys.py').read_text()
+    table_start = source.index('key_info_list = [')
+    table = source[table_start:source.index('\n    ]\n', table_start) + 6]
+    namespace = {}
+    exec(table, namespace)
+    Send_Keys_Info.extend(namespace['key_info_list'])
+
+    platform = sys.platform
+    sys.platform = 'win32'
+    import Send_Keys
+    sys.platform = platform
+else:
+    import Send_Keys
+
+Send_Keys.verbosity = 0
+
+
+class Event:
+    '''
+    Stand-in for Key_Event.
+    '''
+    def __init__(self, code, pressed):
+        self.code = code
+        self.pressed = pressed
+
+
+def Linear_Process(processor, key_buffer, state):
+    '''
+    Linear scan matcher, checking every combo on every event.
+    State is (keys_down set, {combo: active}).
+    '''
+    keys_down, active = state
+    matched_combo_names = []
+    mod_keys = Send_Keys.mod_key_scancode_list
+    for key_event in key_buffer:
+        key = key_event.code
+        if key not in processor.key_bits:
+            continue
+        if key_event.pressed:
+            keys_down.add(key)
+        else:
+            keys_down.discard(key)
+
+        mod_flags = 0
+        for index, mod_key in enumerate(mod_keys):
+            if mod_key in keys_down:
+                mod_flags += (1 << index)
+
+        for combo in processor.key_combo_list:
+            held = False
+            if combo.mod_flags == mod_flags:
+                held = all(x in keys_down for x in combo.key_codes)
+            was_active = active.get(combo, False)
+            if not held and not was_active:
+                continue
+            triggered = held and key == combo.key_codes[-1]
+            if triggered:
+                event = 'onPress' if not was_active else 'onRepeat'
+                active[combo] = True
+            elif held:
+                event = None
+            else:
+                event = 'onRelease' if was_active else None
+                active[combo] = False
+            if combo.event == event:
+                matched_combo_names.append(combo.name)
+    return matched_combo_names
+
+
+def Make_Message(count, rng):
+    '''
+    A setkeys message body with count random combos: a main key, maybe a
+    second key, and 0-3 modifiers, generic or sided.
+    '''
+    names = [x for x in Send_Keys.name_to_scancode_dict
+             if not x.startswith(('shift', 'alt', 'ctrl'))]
+    modifiers = ['shift', 'alt', 'ctrl', 'shift_l', 'ctrl_r', 'alt_l']
+    combos = set()
+    while len(combos) < count:
+        keys = rng.sample(modifiers, rng.choice([0, 1, 1, 2, 3]))
+        keys += rng.sample(names, rng.choice([1, 1, 2]))
+        event = rng.choice(['onPress', 'onPress', 'onRepeat', 'onRelease'])
+        combos.add('$' + ' '.join(keys) + ' ' + event)
+    return ';'.join(sorted(combos)) + ';', sorted(combos)
+
+
+def Make_Events(count, rng, combos):
+    '''
+    Key events typing some of the combos: press the keys in order, maybe
+    repeat the last, release in random order; with stray keys between.
+    '''
+    scancodes = Send_Keys.name_to_scancode_dict
+    events = []
+    while len(events) < count:
+        if rng.random() < 0.2:
+            code = rng.choice(list(scancodes.values()))
+            events += [Event(code, True), Event(code, False)]
+            continue
+        keys = rng.choice(combos)[1:].rsplit(' ', 1)[0].split()
+        codes = [scancodes[x + rng.choice(['_l', '_r'])] if x in ('shift', 'alt', 'ctrl')
+                 else scancodes[x] for x in keys]
+        events += [Event(x, True) for x in codes]
+        events += [Event(codes[-1], True)] * rng.choice([0, 0, 1, 3])
+        rng.shuffle(codes)
+        events += [Event(x, False) for x in codes]
+    return events
+
+
+def Report(label, seconds):
+    print(f'{label:<45} {seconds * 1e6:>10.2f} us')
+
+
+def Run(combo_count, event_count = 20000):
+    rng = random.Random(combo_count)
+    message, combos = Make_Message(combo_count, rng)
+    events = Make_Events(event_count, rng, combos)
+    print(f'{combo_count} combo strings:')
+
+    processor = Send_Keys.Key_Combo_Processor()
+    start = time.perf_counter()
+    processor.Update_Combos(message)
+    Report('  Update_Combos, fresh', time.perf_counter() - start)
+    print(f'  ({len(processor.key_combo_list)} combos after left/right expansion)')
+
+    # X4 resends every combo when any change; add one more.
+    resend = message + '$a b c onPress;'
+    start = time.perf_counter()
+    processor.Update_Combos(resend)
+    Report('  Update_Combos, resent', time.perf_counter() - start)
+    processor.Update_Combos(message)
+
+    # Feed in listener sized chunks.
+    chunks = [events[i : i + 8] for i in range(0, len(events), 8)]
+
+    start = time.perf_counter()
+    matched = []
+    for chunk in chunks:
+        matched += processor.Process_Key_Events(chunk)
+    Report('  Process_Key_Events, per event', (time.perf_counter() - start) / len(events))
+
+    # Linear scan gets slow; use fewer events.
+    linear_count = max(1, len(chunks) * 2000 // combo_count)
+    state = (set(), {})
+    start = time.perf_counter()
+    linear_matched = []
+    for chunk in chunks[:linear_count]:
+        linear_matched += Linear_Process(processor, chunk, state)
+    linear_events = sum(len(x) for x in chunks[:linear_count])
+    Report('  linear scan, per event', (time.perf_counter() - start) / linear_events)
+
+    # Check the matches agree, replaying the same events on a fresh state.
+    check = Send_Keys.Key_Combo_Processor()
+    check.Update_Combos(message)
+    check_matched = []
+    for chunk in chunks[:linear_count]:
+        check_matched += check.Process_Key_Events(chunk)
+    assert check_matched == linear_matched, 'matcher disagrees with linear scan'
+    print(f'  {len(matched)} matches over {len(events)} events; '
+          f'{len(check_matched)} agree with the linear scan')
+
+
+if __name__ == '__main__':
+    for combo_count in [10, 100, 1000, 5000]:
+        Run(combo_count)
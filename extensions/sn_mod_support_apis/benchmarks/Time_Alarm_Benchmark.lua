@@ -0,0 +1,92 @@
+--[[
+Benchmark for the Time api alarm heap, with 10k concurrent alarms.
+Run from the extension folder:
+    luajit benchmarks/Time_Alarm_Benchmark.lua
+]]
+dofile("benchmarks/Host_Stubs.lua")
+Host.Load("ui/Library.lua")
+Host.Load("ui/time/Interface.lua")
+local Time = Host.Require("extensions.sn_mod_support_apis.ui.time.Interface")
+
+local alarm_count = 10000
+local frame_time = 1 / 60
+local fired = 0
+local function on_alarm() fired = fired + 1 end
+
+-- Advance one frame; returns seconds spent in the frame handlers.
+local function step()
+    Host.now = Host.now + frame_time
+    local start = os.clock()
+    Host.Fire("onUpdate")
+    return os.clock() - start
+end
+
+math.randomseed(1)
+
+-- Time alarms spread over the next 60 seconds.
+local set_cost = Host.Time(function(i)
+    Time.Set_Alarm("alarm_"..i, 1 + math.random() * 59, on_alarm)
+end, alarm_count)
+Host.Report("Set_Alarm, 10k pending", set_cost)
+
+-- Frames with nothing due.
+local idle = 0
+for i = 1, 50 do idle = idle + step() end
+Host.Report("idle frame, 10k pending", idle / 50)
+assert(fired == 0)
+
+-- Run until everything fired.
+local busy, frames = 0, 0
+while fired < alarm_count do
+    busy = busy + step()
+    frames = frames + 1
+end
+Host.Report(string.format("frame firing ~%d alarms", math.floor(alarm_count / frames)), busy / frames)
+
+-- Cancellation.
+for i = 1, alarm_count do
+    Time.Set_Alarm("alarm_"..i, 100, on_alarm)
+end
+local cancel_cost = Host.Time(function(i)
+    Time.Cancel_Alarm("alarm_"..i)
+end, alarm_count)
+Host.Report("Cancel_Alarm, 10k pending", cancel_cost)
+
+-- Frame alarms, plus repeating ones, all concurrent.
+fired = 0
+local periodic_fired = 0
+local function on_periodic() periodic_fired = periodic_fired + 1 end
+for i = 1, alarm_count do
+    Time.Set_Frame_Alarm("frame_"..i, math.random(1, 600), on_alarm)
+end
+for i = 1, 100 do
+    Time.Set_Alarm("periodic_"..i, 0.5, on_periodic, 0.5)
+end
+local total, frames = 0, 0
+for i = 1, 600 do
+    total = total + step()
+    frames = frames + 1
+end
+Host.Report("frame, 10k frame alarms + 100 periodic", total / frames)
+print(string.format("frame alarms fired %d of %d, periodic fires %d",
+    fired, alarm_count, periodic_fired))
+assert(fired == alarm_count)
+
+-- Alarms due in the same frame, where an earlier callback cancels or
+-- replaces later ones.
+for i = 1, 100 do Time.Cancel_Alarm("periodic_"..i) end
+local calls = {}
+local function on_due(id) calls[#calls + 1] = id end
+Time.Set_Alarm("due_1", 0.001, function(id)
+    on_due(id)
+    Time.Cancel_Alarm("due_2")
+    Time.Cancel_Frame_Alarm("due_frame")
+    Time.Set_Alarm("due_3", 10, on_due)
+end)
+Time.Set_Alarm("due_2", 0.002, on_due)
+Time.Set_Alarm("due_3", 0.003, on_due)
+Time.Set_Frame_Alarm("due_frame", 1, on_due)
+step()
+step()
+assert(#calls == 1 and calls[1] == "due_1", "cancelled alarms fired: "..table.concat(calls, ","))
+print("Alarms cancelled by an earlier callback of the same frame don't fire")
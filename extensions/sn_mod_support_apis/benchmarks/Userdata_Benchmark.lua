@@ -0,0 +1,155 @@
+--[[
+Benchmark for userdata syncing between md and lua, with a mod saving
+many settings in one frame.
+Run from the extension folder:
+    luajit benchmarks/Userdata_Benchmark.lua
+
+Compares md writes posted as a batch against the two-call handshake
+they replaced (one full blackboard read per key), checking both leave
+the same lua userdata. Then checks lua writes reach the blackboard once,
+at the next frame, and that a flush doesn't drop pending md writes.
+The blackboard stub copies tables deeply, as x4 converts them.
+]]
+dofile("benchmarks/Host_Stubs.lua")
+
+local function Deep_Copy(value)
+    if type(value) ~= "table" then return value end
+    local copy = {}
+    for k, v in pairs(value) do copy[k] = Deep_Copy(v) end
+    return copy
+end
+-- Counts full userdata reads, and all writes.
+local blackboard_reads, blackboard_writes = 0, 0
+function GetNPCBlackboard(_, key)
+    if key == "$__MOD_USERDATA" then blackboard_reads = blackboard_reads + 1 end
+    return Deep_Copy(Host.blackboard[key])
+end
+function SetNPCBlackboard(_, key, value)
+    blackboard_writes = blackboard_writes + 1
+    Host.blackboard[key] = Deep_Copy(value)
+end
+package.loaded.ffi = {
+    cdef = function() end,
+    C = {GetPlayerID = function() return 1000 end},
+}
+
+-- Userdata of other mods, a few hundred entries.
+__MOD_USERDATA = {}
+for i = 1, 20 do
+    local owner = {}
+    for j = 1, 20 do owner["setting_"..j] = {value = j, name = "text "..j} end
+    __MOD_USERDATA["mod_"..i] = owner
+end
+
+Host.Load("ui/Library.lua")
+Host.Load("ui/time/Interface.lua")
+Host.Load("ui/Command_Bridge.lua")
+Host.Load("ui/userdata/Interface.lua")
+Host.Require("extensions.sn_mod_support_apis.ui.time.Interface")
+local Userdata = Host.Require("extensions.sn_mod_support_apis.ui.userdata.Interface")
+
+local function Step_Frame()
+    Host.now = Host.now + 1 / 60
+    Host.Fire("onUpdate")
+end
+
+
+-- Md side of a Write: update the blackboard copy, then tell lua.
+local function MD_Write(owner, key, value)
+    local md_userdata = Host.blackboard["$__MOD_USERDATA"]
+    md_userdata[owner] = md_userdata[owner] or {}
+    md_userdata[owner][key] = value
+end
+local function MD_Post(owner, key, value)
+    local args = Host.blackboard["$userdata_args"] or {}
+    args[#args + 1] = {command = "Update", owner = owner, key = key, value = value}
+    Host.blackboard["$userdata_args"] = args
+    Host.Fire("Userdata.Process_Command")
+end
+
+-- The two-call handshake prior to batching, for comparison.
+local Old = {}
+local old_owner
+function Old.Userdata_Update(_, param)
+    if old_owner == nil then
+        old_owner = param
+    else
+        local key = param
+        local md_userdata = GetNPCBlackboard(1000, "$__MOD_USERDATA")
+        local value = md_userdata[old_owner]
+        if key ~= nil then value = value[key] end
+        Old.userdata[old_owner] = Old.userdata[old_owner] or {}
+        Old.userdata[old_owner][key] = value
+        old_owner = nil
+    end
+end
+
+local key_count = 200
+local function Settings(round)
+    local settings = {}
+    for i = 1, key_count do settings[i] = {"bench_mod", "key_"..i, {value = i * round, name = "bench "..i}} end
+    return settings
+end
+
+-- Same lua userdata from both.
+Old.userdata = Deep_Copy(__MOD_USERDATA)
+for _, setting in ipairs(Settings(1)) do
+    MD_Write(unpack(setting))
+    Old.Userdata_Update(nil, setting[1])
+    Old.Userdata_Update(nil, setting[2])
+    MD_Post(unpack(setting))
+end
+for i = 1, key_count do
+    local old = Old.userdata.bench_mod["key_"..i]
+    local new = Userdata.Read_Userdata("bench_mod", "key_"..i)
+    assert(old.value == new.value and old.name == new.name, "userdata differs at key_"..i)
+end
+print(string.format("%d md writes leave the same lua userdata", key_count))
+
+local rounds = 20
+local old_reads = blackboard_reads
+Host.Report(string.format("md writes of %d keys, handshake", key_count), Host.Time(function(round)
+    for _, setting in ipairs(Settings(round)) do
+        MD_Write(unpack(setting))
+        Old.Userdata_Update(nil, setting[1])
+        Old.Userdata_Update(nil, setting[2])
+    end
+end, rounds))
+old_reads = (blackboard_reads - old_reads) / rounds
+local new_reads = blackboard_reads
+Host.Report(string.format("md writes of %d keys, batched", key_count), Host.Time(function(round)
+    for _, setting in ipairs(Settings(round)) do MD_Write(unpack(setting)) end
+    -- As md would: every change posted, lua signalled per change.
+    local args = {}
+    for i, setting in ipairs(Settings(round)) do
+        args[i] = {command = "Update", owner = setting[1], key = setting[2], value = setting[3]}
+    end
+    Host.blackboard["$userdata_args"] = args
+    for i = 1, key_count do Host.Fire("Userdata.Process_Command") end
+end, rounds))
+new_reads = (blackboard_reads - new_reads) / rounds
+print(string.format("Userdata blackboard reads per %d keys: handshake %d, batched %d", key_count, old_reads, new_reads))
+
+
+-- Lua writes flush once, at the next frame.
+blackboard_writes = 0
+for i = 1, key_count do Userdata.Write_Userdata("lua_mod", "key_"..i, i) end
+assert(blackboard_writes == 0 and Host.blackboard["$__MOD_USERDATA"].lua_mod == nil)
+Step_Frame()
+assert(blackboard_writes == 1, "expected one flush, got "..blackboard_writes)
+assert(Host.blackboard["$__MOD_USERDATA"].lua_mod.key_5 == 5)
+Step_Frame()
+assert(blackboard_writes == 1)
+print(string.format("%d lua writes flushed to the blackboard in %d write", key_count, blackboard_writes))
+
+-- An md write still pending at the flush survives it.
+Userdata.Write_Userdata("lua_mod", "key_1", "lua")
+MD_Write("md_mod", "key_1", "md")
+local args = Host.blackboard["$userdata_args"] or {}
+args[#args + 1] = {command = "Update", owner = "md_mod", key = "key_1", value = "md"}
+Host.blackboard["$userdata_args"] = args
+Step_Frame()
+assert(Host.blackboard["$__MOD_USERDATA"].md_mod.key_1 == "md")
+assert(Host.blackboard["$__MOD_USERDATA"].lua_mod.key_1 == "lua")
+assert(Userdata.Read_Userdata("md_mod", "key_1") == "md")
+print("Pending md writes are kept through a lua flush")
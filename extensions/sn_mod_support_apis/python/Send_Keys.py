@@ -26,8 +26,8 @@ since long running callbacks can cause problems with new input capture.
 import sys
 import time
 import threading
-import copy
-from collections import defaultdict
+import itertools
+from collections import deque
 
 # This will be specific to windows for now.
 if not sys.platform == 'win32':
@@ -37,7 +37,8 @@ if not sys.platform == 'win32':
 import win32api
 
 from pynput import keyboard
-from X4_Python_Pipe_Server import Pipe_Server, Pipe_Client
+from X4_Python_Pipe_Server import Pipe_Server, Pipe_Client, Percentiles
+from X4_Python_Pipe_Server.Classes import Metrics
 # Can use this to know if x4 has focus.
 from win32gui import GetWindowText, GetForegroundWindow
 
@@ -47,6 +48,19 @@ pipe_name = 'x4_keys'
 # Verbosity level of console window messages.
 verbosity = 1
 
+# Max messages sent to x4 but not yet acked. Matches made while the window
+# is full wait, with repeats of a waiting combo coalesced, and go out
+# together once x4 catches up.
+window_size = 4
+
+# Seconds after which an unacked message is given up on, so a lost ack
+# doesn't stall keys.
+ack_timeout = 10
+
+# Seconds between key latency printouts (at verbosity 1+), when keys
+# were acked since the last one.
+latency_report_interval = 60
+
 # Expected window title, for when this captures keys.
 # Normally x4, but changes for python testing.
 # For python, there may be a path prefix, so this will just check the
@@ -59,7 +73,8 @@ def main(args):
     Entry function for this server.
 
     This will transmit key presses to x4, and x4 will return acks as it
-    processes them. Total keys in flight will be limited.
+    processes them. Messages are numbered, and at most window_size are in
+    flight; see Key_Sender.
 
     Uses pynput for key capture. For a little extra security, pynput
     will ignore keys while x4 lacks focus.
@@ -90,6 +105,9 @@ def main(args):
     # Set up a key combo processor.
     combo_processor = Key_Combo_Processor()
 
+    # Sending of matched combos, and their latency tracking.
+    key_sender = Key_Sender()
+
     # Note: x4 will sometimes send non-ack messages to the pipe, and there
     # is no way to know when they will arrive other than testing it.
     # This cannot be done in one thread with blocking Reads/Writes.
@@ -140,12 +158,17 @@ def main(args):
             # key events, eg. when keys are held down).
             message = pipe.Read()
             while message != None:
-                print('Received: ' + message)
+                if verbosity >= 2 or not message.startswith('ack'):
+                    print('Received: ' + message)
 
                 # Ignore pings; they were just testing the pipe.
                 if message == 'ping':
                     pass
 
+                # Acks of sent messages, up to the given sequence number.
+                elif message.startswith('ack'):
+                    key_sender.Ack(message)
+
                 # Update the key list.
                 elif message.startswith('setkeys:'):
                     # Toss the prefix.
@@ -173,29 +196,16 @@ def main(args):
                     print('Processing: {}'.format(key_buffer))
 
                 # Process the keys, updating what is pressed and getting any
-                # matched combos.
-                matched_combos = combo_processor.Process_Key_Events(key_buffer)
-
-                # Only send messages if there was a match; x4 4.0 started
-                # sometimes going into an error loop (on ~25% of reloads)
-                # where all key presses with empty messages caused a pipe
-                # error. TODO: maybe track down the intermittent problem
-                # more specifically.
-                if matched_combos:
-                    # Lump into a single message, to reduce overhead on the x4
-                    # side (since it limits signals per frame and can lag when
-                    # handling key repetitions).
-                    # Note: this doesn't put the '$' back for now, since that
-                    # is easier to add in x4 than remove afterwards.
-                    message = ';'.join(matched_combos)
-
-                    # Debug printout.
-                    if verbosity >= 1:
-                        for combo in matched_combos:
-                            print('Sending: ' + combo)
-
-                    # Transmit to x4.
-                    pipe.Write(message)
+                # matched combos, along with when their keys were captured.
+                capture_times = []
+                matched_combos = combo_processor.Process_Key_Events(key_buffer, capture_times)
+                key_sender.Queue(matched_combos, capture_times)
+
+            # Send whatever is waiting, if the window allows.
+            key_sender.Send(pipe)
+            key_sender.Check_Timeouts()
+            if verbosity >= 1:
+                key_sender.Periodic_Report()
 
 
             # General pause between checks.
@@ -215,6 +225,7 @@ def main(args):
     finally:
         # Stop the listener when an error occurs, eg. x4 closing.
         keyboard_listener.Stop()
+        key_sender.Print_Latency()
     return
 
 
@@ -242,15 +253,208 @@ def Pipe_Client_Test():
         ]) + ';'
     pipe.Write(keys)
 
-    # Capture a few characters.
+    # Capture a few characters, acking each message by its sequence number.
     for _ in range(50):
         char = pipe.Read()
         print(f'test received: {char}')
-        pipe.Write('ack')
+        pipe.Write('ack:' + char.split(';', 1)[0].replace('seq:', ''))
             
     return
 
 
+class Latency_Tracker:
+    '''
+    Recent latencies of one stage of key handling, for percentile reports,
+    also recorded to the exported metrics histogram.
+
+    * label
+      - String, name of the stage, eg. 'capture to ack'.
+    * samples
+      - Deque of the latest latencies, in seconds.
+    * count
+      - Int, total latencies recorded.
+    '''
+    def __init__(self, label, max_samples = 1000):
+        self.label = label
+        self.samples = deque(maxlen = max_samples)
+        self.count = 0
+        self.metric = key_latency_seconds.Labels(stage = label)
+        return
+
+    def Record(self, seconds):
+        self.samples.append(seconds)
+        self.count += 1
+        self.metric.Observe(seconds)
+        return
+
+    def Percentiles(self, fractions):
+        '''
+        Return latencies at the given fractions (eg. 0.99) of the recent
+        samples, nearest rank.
+        '''
+        return Percentiles(self.samples, fractions)
+
+    def Print(self):
+        '''
+        Print a line of latency percentiles, in ms.
+        '''
+        p50, p90, p99, top = self.Percentiles([0.5, 0.9, 0.99, 1.0])
+        print('key latency ms, {}: p50 {:.1f}, p90 {:.1f}, p99 {:.1f}, max {:.1f} (last {} of {})'.format(
+            self.label, p50 * 1000, p90 * 1000, p99 * 1000, top * 1000,
+            len(self.samples), self.count))
+        return
+
+
+class Key_Sender:
+    '''
+    Sends matched combos to x4 over a sliding window: each message starts
+    with a sequence number, "seq:<n>;", and x4 acks with "ack:<n>" once
+    it has processed all messages up to n (lua batches these to one ack
+    per frame). At most window_size messages are in flight; matches made
+    meanwhile wait in a queue, and go out as a single message when the
+    window opens.
+
+    While waiting, repeat events of a combo already queued are coalesced,
+    so a key held down through an x4 stall doesn't replay a backlog of
+    repeats afterwards.
+
+    Attributes:
+    * next_seq
+      - Int, sequence number of the next message.
+    * queue
+      - List of [combo name, capture time] waiting to be sent.
+    * queued_repeats
+      - Set of repeat combo names in the queue.
+    * in_flight
+      - Deque of (seq, send time, capture times) of sent, unacked
+        messages, oldest first.
+    * coalesced
+      - Int, count of repeat events dropped by coalescing.
+    * timed_out
+      - Int, count of messages given up on after ack_timeout.
+    * capture_latency
+      - Latency_Tracker from key capture to ack.
+    * x4_latency
+      - Latency_Tracker from message send to ack.
+    '''
+    def __init__(self):
+        self.next_seq = 1
+        self.queue = []
+        self.queued_repeats = set()
+        self.in_flight = deque()
+        self.coalesced = 0
+        self.timed_out = 0
+        self.capture_latency = Latency_Tracker('capture to ack')
+        self.x4_latency = Latency_Tracker('send to ack')
+        self.last_report_time = time.perf_counter()
+        self.last_report_count = 0
+        return
+
+    def Queue(self, names, capture_times):
+        '''
+        Queue matched combo names, with the capture times of the key
+        events that matched them.
+        '''
+        for name, capture_time in zip(names, capture_times):
+            if name.endswith(' onRepeat'):
+                # The waiting entry keeps its older capture time.
+                if name in self.queued_repeats:
+                    self.coalesced += 1
+                    continue
+                self.queued_repeats.add(name)
+            self.queue.append([name, capture_time])
+        return
+
+    def Send(self, pipe):
+        '''
+        Send everything queued as one message, if the window has room.
+        '''
+        if not self.queue or len(self.in_flight) >= window_size:
+            return
+
+        # Lump into a single message, to reduce overhead on the x4
+        # side (since it limits signals per frame and can lag when
+        # handling key repetitions).
+        # Note: this doesn't put the '$' back for now, since that
+        # is easier to add in x4 than remove afterwards.
+        # Only send messages if there was a match; x4 4.0 started
+        # sometimes going into an error loop (on ~25% of reloads)
+        # where all key presses with empty messages caused a pipe
+        # error. TODO: maybe track down the intermittent problem
+        # more specifically.
+        seq = self.next_seq
+        self.next_seq += 1
+        names = [x[0] for x in self.queue]
+        message = 'seq:{};'.format(seq) + ';'.join(names)
+
+        # Debug printout.
+        if verbosity >= 1:
+            for name in names:
+                print('Sending: ' + name)
+
+        # Transmit to x4.
+        pipe.Write(message)
+        self.in_flight.append((seq, time.perf_counter(), [x[1] for x in self.queue]))
+        self.queue = []
+        self.queued_repeats.clear()
+        return
+
+    def Ack(self, message):
+        '''
+        Handle an "ack:<n>" message, retiring messages up to n. A bare
+        "ack" retires the oldest message.
+        '''
+        now = time.perf_counter()
+        if message == 'ack':
+            seq = self.in_flight[0][0] if self.in_flight else 0
+        else:
+            seq = int(message.split(':', 1)[1])
+
+        while self.in_flight and self.in_flight[0][0] <= seq:
+            _, send_time, capture_times = self.in_flight.popleft()
+            self.x4_latency.Record(now - send_time)
+            for capture_time in capture_times:
+                self.capture_latency.Record(now - capture_time)
+        return
+
+    def Check_Timeouts(self):
+        '''
+        Give up on messages unacked for over ack_timeout, eg. if an ack
+        was lost, so the window reopens.
+        '''
+        now = time.perf_counter()
+        while self.in_flight and now - self.in_flight[0][1] > ack_timeout:
+            seq = self.in_flight.popleft()[0]
+            self.timed_out += 1
+            print('No ack for key message {} after {} s; dropping it from the window'.format(seq, ack_timeout))
+        return
+
+    def Periodic_Report(self):
+        '''
+        Print latencies every latency_report_interval, when keys were
+        acked since the last report.
+        '''
+        now = time.perf_counter()
+        if (now - self.last_report_time >= latency_report_interval
+        and self.capture_latency.count != self.last_report_count):
+            self.Print_Latency()
+            self.last_report_time = now
+            self.last_report_count = self.capture_latency.count
+        return
+
+    def Print_Latency(self):
+        '''
+        Print latency percentiles, and window stats.
+        '''
+        if not self.capture_latency.count:
+            return
+        self.capture_latency.Print()
+        self.x4_latency.Print()
+        print('key messages: {} sent, {} in flight, {} timed out; {} repeats coalesced'.format(
+            self.next_seq - 1, len(self.in_flight), self.timed_out, self.coalesced))
+        return
+
+
 
 class Key_Event:
     '''
@@ -269,10 +473,13 @@ class Key_Event:
         by windows, adding 0x80 for extended keys.
     * pressed
       - Bool, if True the key was pressed, else the key was released.
+    * time
+      - Float, perf_counter time when the event was captured.
     '''
     def __init__(self, key_object, scancode, pressed = None):
         self.code = scancode
         self.pressed = pressed
+        self.time = time.perf_counter()
 
         # The key vk is either in 'vk' or 'value.vk'.
         # TODO: special handling for numpad_enter; maybe pick name
@@ -436,6 +643,12 @@ class Key_Combo:
       - Int, 1-hot vector signifying which modifier keys are used in
         this combo.
       - Ordering of bits depends on order of "_mod_keys" list.
+    * key_mask
+      - Int, bits of all keys in this combo, per scancode_bit_dict.
+        The low bits are the mod_flags.
+    * index
+      - Int, position in the processor's key_combo_list, used to report
+        matches in list order.
     * active
       - Bool, if this combo is currently active: was pressed and has not
         yet been released.
@@ -445,15 +658,14 @@ class Key_Combo:
         self.key_codes = key_codes
         self.event = event
         self.active = False
-
-        # Set modifier flags here.
-        # Code; starts at 0, gets bits set.
-        self.mod_flags = 0
-        # Check each modifier.
-        for index, mod_key in enumerate(mod_key_scancode_list):
-            if mod_key in key_codes:
-                # Set a bit for this position.
-                self.mod_flags += (1 << index)
+        self.index = 0
+
+        # Set key bits here; modifiers have the low bits, so their
+        # flags can be masked out.
+        self.key_mask = 0
+        for code in key_codes:
+            self.key_mask |= scancode_bit_dict[code]
+        self.mod_flags = self.key_mask & mod_key_mask
         return
 
 
@@ -463,28 +675,51 @@ class Key_Combo_Processor:
     the combos to look for, and checking captured key presses for
     matches to these combos.
 
+    Combos are compiled into a table keyed by (trigger key, held modifier
+    flags), so a key event only looks at the few combos it can trigger,
+    plus whichever combos are currently active (to catch releases),
+    regardless of how many combos are registered.
+
     Atteributes:
     * key_combo_list
       - List of Key_Combo objects being checked.
-    * keys_in_combos
-      - List of key scancodes involved in the combos, along with all
-        modifier keys, to be used for filtering out don't-care events.
+    * key_bits
+      - Dict of scancode: bit (from scancode_bit_dict), for every key
+        involved in the combos along with all modifier keys. Keys not
+        present are don't-cares and get filtered out.
+    * trigger_table
+      - Dict of (scancode, mod_flags): list of Key_Combos whose last key
+        is that scancode and whose modifiers are exactly those flags.
+    * active_combos
+      - Set of Key_Combos currently active.
     * keys_down
-      - List of scancodes that were pressed but not released yet.
+      - Set of scancodes that were pressed but not released yet.
+    * keys_down_mask
+      - Int, keys_down as bits of key_bits.
+    * compiled_combos
+      - Dict of combo message: (event name, list of scancode lists), caching
+        Compile_Combo work across "setkeys:" messages, which resend
+        all combos whenever any change.
     '''
     def __init__(self):
         # Recorded combos.
         self.key_combo_list = []
-        
-        # Set of keycodes involved in any combos, and modifiers.
-        self.keys_in_combos = set()
 
-        # Set of keys (Key or KeyCode) in a pressed state.
+        # Bits of keycodes involved in any combos, and modifiers.
+        self.key_bits = {}
+
+        # Compiled lookups.
+        self.trigger_table = {}
+        self.active_combos = set()
+        self.compiled_combos = {}
+
+        # Set of keys (scancodes) in a pressed state.
         # Updated when key_buffer is processed.
         # Note: only tracks keys of interest to the combos. Assumes combos
         # will not be changing often enough to worry about tracking unused
         # keys that might be used in the future.
         self.keys_down = set()
+        self.keys_down_mask = 0
         return
 
     def Reset_State(self):
@@ -493,10 +728,12 @@ class Key_Combo_Processor:
         listener has stopped, which will cause state to be invalid.
         '''
         # Set all combos as inactive.
-        for combo in self.key_combo_list:
+        for combo in self.active_combos:
             combo.active = False
+        self.active_combos.clear()
         # Clear held keys.
         self.keys_down.clear()
+        self.keys_down_mask = 0
         return
 
 
@@ -509,37 +746,53 @@ class Key_Combo_Processor:
         # Don't reuse old combos; each message should be a fully complete
         # list of currently desired combos.
         self.key_combo_list.clear()
-        self.keys_in_combos.clear()
+        self.trigger_table.clear()
+        self.active_combos.clear()
 
-        # If all key/combos have been cleared, the rest of the message is blank.
-        if not message:
-            return
+        # Include modifiers always, left/right variations.
+        self.key_bits = {code: scancode_bit_dict[code] for code in mod_key_scancode_list}
 
-        # Expect each key combo to be prefixed with '$' and end with
-        #  ';'.  Can separate on ';$', ignoring first and last char.
-        # Note: any '$' or ';' in the combo itself is fine, since they
-        #  will always be required to be space separated, and so won't
-        #  get matched here.
-        combos_requested = message[1:-1].split(';$')
-        
-        # Compile message strings to codes.
-        for combo_string in combos_requested:
-            # Collect the combo groups; each combo_string may make multiple,
-            #  in cases where ambiguous modifier keys are uniquified
-            #  (eg. 'ctrl' to 'ctrl_r' and 'ctrl_l' versions).
-            # Skip any with errors.
-            try:
-                self.key_combo_list += self.Compile_Combo(combo_string)
-            except Exception as ex:
-                print('Error when handling combo {}, exception: {}'.format(combo_string, ex))
-                continue
+        # If all key/combos have been cleared, the rest of the message is blank.
+        if message:
+            # Expect each key combo to be prefixed with '$' and end with
+            #  ';'.  Can separate on ';$', ignoring first and last char.
+            # Note: any '$' or ';' in the combo itself is fine, since they
+            #  will always be required to be space separated, and so won't
+            #  get matched here.
+            combos_requested = message[1:-1].split(';$')
+
+            # Compile message strings to codes.
+            for combo_string in combos_requested:
+                # Collect the combo groups; each combo_string may make multiple,
+                #  in cases where ambiguous modifier keys are uniquified
+                #  (eg. 'ctrl' to 'ctrl_r' and 'ctrl_l' versions).
+                # Skip any with errors.
+                try:
+                    self.key_combo_list += self.Compile_Combo(combo_string)
+                except Exception as ex:
+                    print('Error when handling combo {}, exception: {}'.format(combo_string, ex))
+                    continue
 
-        # Update the list of keys to watch.
-        for combo in self.key_combo_list:
-            self.keys_in_combos.update(combo.key_codes)
-        # Include modifiers always, left/right variations.
-        self.keys_in_combos.update(mod_key_scancode_list)
+        # Update the keys to watch, and index the combos by trigger key
+        # (the last key) and modifiers.
+        key_bits = self.key_bits
+        trigger_table = self.trigger_table
+        for index, combo in enumerate(self.key_combo_list):
+            combo.index = index
+            for code in combo.key_codes:
+                key_bits[code] = scancode_bit_dict[code]
+            trigger = (combo.key_codes[-1], combo.mod_flags)
+            combos = trigger_table.get(trigger)
+            if combos is None:
+                trigger_table[trigger] = [combo]
+            else:
+                combos.append(combo)
 
+        # Drop held keys no longer of interest.
+        self.keys_down = set(x for x in self.keys_down if x in key_bits)
+        self.keys_down_mask = 0
+        for code in self.keys_down:
+            self.keys_down_mask |= key_bits[code]
         return
 
 
@@ -552,12 +805,26 @@ class Key_Combo_Processor:
         Returns a list of Key_Combo objects.
         Throws an exception on unrecognized key names.
         '''
+        # Reuse prior translations; only the Key_Combo objects (which
+        # hold state) are made fresh.
+        compiled = self.compiled_combos.get(combo_msg)
+        if compiled is None:
+            compiled = self.compiled_combos[combo_msg] = self.Translate_Combo(combo_msg)
+        event_name, scancodes_list = compiled
+        return [Key_Combo(combo_msg, scancodes, event_name) for scancodes in scancodes_list]
+
+
+    def Translate_Combo(self, combo_msg):
+        '''
+        Support function for Compile_Combo, doing the translation.
+        Returns a tuple of (event name, list of scancode lists).
+        '''
         # Pick off the suffixed event type.
         combo_string, event_name = combo_msg.rsplit(' ', 1)
         # Check it; skip if bad.
         if event_name not in ['onPress', 'onRelease', 'onRepeat']:
-            print('Unrecognized event for combo: {}',format(combo_msg))
-            return []
+            print('Unrecognized event for combo: {}'.format(combo_msg))
+            return event_name, []
 
         # Process egosoft keycodes.
         # Aim is to unify their format with generic key combo strings, so
@@ -567,54 +834,38 @@ class Key_Combo_Processor:
         else:
             # Break out the requested keys by spacing.
             key_name_list = combo_string.split()
-    
 
+        # Map names to scancodes.
+        # Skip empty key names, which may be the result of double
+        # spacing in the message.
         # For generic shift-alt-ctrl, uniquify them into left/right
-        # versions. This could potentially generate up to 6 sub-combos
+        # versions. This could potentially generate up to 8 sub-combos
         # if all such keys are used.
         # Note: scancodes are not duplicated between left/right keys, so
         # this shouldn't have a danger of creating duplicate code combos.
-        # Process combo_names into a new list of lists.
-        # Seed this with a single empty list.
-        key_name_list_list = [[]]
+        # Unrecognized entries will have a dict key lookup error.
+        options = []
         for key_name in key_name_list:
+            if not key_name:
+                continue
             if key_name in ['shift','alt','ctrl']:
-
-                # Duplicate the existing groups.
-                l_combos = copy.deepcopy(key_name_list_list)
-                r_combos = copy.deepcopy(key_name_list_list)
-
-                # Append uniquified names.
-                for groups, suffix in zip([l_combos, r_combos], ['_l','_r']):
-                    for group in groups:
-                        group.append(key_name + suffix)
-                # Stick the new groups together again.
-                key_name_list_list = l_combos + r_combos
+                options.append((name_to_scancode_dict[key_name + '_l'],
+                                name_to_scancode_dict[key_name + '_r']))
             else:
-                # Add the name to all groups.
-                for group in key_name_list_list:
-                    group.append(key_name)
-                
+                options.append((name_to_scancode_dict[key_name],))
 
-        # Handle the key name to combo mapping.
-        combo_list = []
-        for key_name_list in key_name_list_list:
-    
-            # Map names to scancodes.
-            # Skip empty key names, which may be the result of double
-            # spacing in the message.
-            # Unrecognized entries will have a dict key lookup error.
-            scancodes = [name_to_scancode_dict[x]
-                            for x in key_name_list if x]
+        # Pick every left/right combination. Product is taken over the
+        # reversed options so that the earliest modifier varies fastest,
+        # keeping the historical ordering of sub-combos.
+        # Combos without keys are dropped.
+        scancodes_list = [list(reversed(codes))
+                          for codes in itertools.product(*reversed(options))
+                          if codes]
+        return event_name, scancodes_list
 
-            # Pack into a Key_Combo and record.
-            combo_list.append(Key_Combo(combo_msg, scancodes, event_name))
 
-        return combo_list
 
-
-
-    def Process_Key_Events(self, key_buffer):
+    def Process_Key_Events(self, key_buffer, capture_times = None):
         '''
         Processes raw key presses/releases captured into key_buffer,
         updating keys_down and matching to combos in combo_specs.
@@ -623,8 +874,13 @@ class Key_Combo_Processor:
 
         * key_buffer
           - List of Keys that were captured since the last processing.
+        * capture_times
+          - Optional list; the capture time of the key event that matched
+            each returned combo is appended to it.
         '''
         matched_combo_names = []
+        key_bits = self.key_bits
+        active_combos = self.active_combos
     
         # Loop over the key events in recorded order.
         for key_event in key_buffer:
@@ -633,9 +889,10 @@ class Key_Combo_Processor:
             key = key_event.code
         
             # If key is not of interest, ignore it.
-            if key not in self.keys_in_combos:
+            bit = key_bits.get(key)
+            if bit is None:
                 if verbosity >= 3:
-                    print(f'Keycode {key} not in {self.keys_in_combos}')
+                    print(f'Keycode {key} not in {set(key_bits)}')
                 continue
 
             # Update pressed/released state.
@@ -644,76 +901,49 @@ class Key_Combo_Processor:
             # checking the combos to simplify following logic.
             if key_event.pressed:
                 self.keys_down.add(key)
-            elif key in self.keys_down:
-                self.keys_down.remove(key)
+                self.keys_down_mask |= bit
+            else:
+                self.keys_down.discard(key)
+                self.keys_down_mask &= ~bit
+            keys_down_mask = self.keys_down_mask
             if verbosity >= 3:
                 print('Keys down: {}'.format(self.keys_down if self.keys_down else ''))
 
-
-            # The first pass logic will group combos into those
-            # matched, held, unheld.
-            # - Held: keys all pressed, other modifiers unpressed, but last key
-            #   is not the latest key (should have had a press event earlier).
-            # - Matched: as Held, but last key is the latest key.
-            # - Unheld: everything else.
-            # Checking these categories against the prior held combos will
-            #  determine which ones are pressed (newly held), repeated
-            #  (already held), released (no longer held).
-            combos_held    = []
-            combos_matched = []
-            combos_unheld  = []
-
-        
-            # Get which modifier keys are currently held, and their
-            #  corresponding category code.
-            mod_flags = 0
-            # Check each modifier.
-            for index, mod_key in enumerate(mod_key_scancode_list):
-                if mod_key in self.keys_down:
-                    # Add a 1-hot bit.
-                    mod_flags += (1 << index)
-
-
-            # Check the combos for state updates.
-            for combo in self.key_combo_list:
-
-                # Determine if this combo is currently held.
-                held = False
-                # Make sure the mod_flags match.
-                if combo.mod_flags == mod_flags:
-                    # Check all keys being pressed.
-                    held = all(x in self.keys_down for x in combo.key_codes)
-
-                # Common case: not held and was not active, so idle.
-                # Quick checking this, though somewhat redundant with
-                # logic below.
-                if not held and not combo.active:
+            # A combo is held when all its keys are pressed and no other
+            # modifiers are. When held and the latest key is its last key,
+            # it is triggered: newly pressed if not already active, else
+            # repeated. Active combos no longer held are released.
+            # Held combos that weren't triggered are ignored.
+            mod_flags = keys_down_mask & mod_key_mask
+            matched = []
+
+            # Check active combos for release.
+            if active_combos:
+                for combo in list(active_combos):
+                    if combo.mod_flags != mod_flags or combo.key_mask & ~keys_down_mask:
+                        combo.active = False
+                        active_combos.discard(combo)
+                        if combo.event == 'onRelease':
+                            matched.append(combo)
+
+            # Check the combos this key can trigger.
+            for combo in self.trigger_table.get((key, mod_flags), ()):
+                if combo.key_mask & ~keys_down_mask:
                     continue
-
-                # Determine if this combo is being triggered, eg. the last
-                # combo key was pressed.
-                triggered = held and key == combo.key_codes[-1]
-
-                # Determine event trigger to match, and update combo active
-                # state.
-                if triggered:
-                    # Was newly pressed if not already active, else it is
-                    # being repeated.
-                    event = 'onPress' if not combo.active else 'onRepeat'
-                    combo.active = True
-                elif held:
-                    # Being held, but not a new trigger, so this can
-                    # be ignored.
-                    event = None
-                else:
-                    # Was released if it was formerly active.
-                    event = 'onRelease' if combo.active else None
-                    combo.active = False
-
-                # If the event matches what the combo is looking for, then
-                # can signal it back to x4.
+                event = 'onRepeat' if combo.active else 'onPress'
+                combo.active = True
+                active_combos.add(combo)
                 if combo.event == event:
-                    matched_combo_names.append(combo.name)
+                    matched.append(combo)
+
+            # Signal in combo list order, to be consistent regardless of
+            # which check found them.
+            if len(matched) > 1:
+                matched.sort(key = lambda x: x.index)
+            for combo in matched:
+                matched_combo_names.append(combo.name)
+            if matched and capture_times is not None:
+                capture_times.extend([key_event.time] * len(matched))
 
         return matched_combo_names
 
@@ -995,6 +1225,16 @@ name_to_scancode_dict = {}
 # List of modifier key scancodes, left and right versions.
 mod_key_scancode_list = None
 
+# Exported latency of key handling, by stage.
+key_latency_seconds = Metrics.registry.Histogram(
+    'x4_hotkey_latency_seconds', 'Latency of hotkey events, by stage.', ('stage',))
+
+# Dict mapping scancodes to a 1-hot bit, for held key bitmasks.
+# Modifiers get the low bits, in mod_key_scancode_list order, so that
+# masking with mod_key_mask gives the modifier flags.
+scancode_bit_dict = {}
+mod_key_mask = 0
+
 
 def Key_Init():
     '''
@@ -1046,6 +1286,13 @@ def Key_Init():
     global mod_key_scancode_list
     mod_key_scancode_list = [name_to_scancode_dict[x] for x in [
         'alt_l','alt_r','ctrl_l','ctrl_r','shift_l','shift_r',]]
+
+    # Assign key bits, modifiers first.
+    global mod_key_mask
+    for scancode in mod_key_scancode_list + sorted(scancode_to_name_dict):
+        if scancode not in scancode_bit_dict:
+            scancode_bit_dict[scancode] = 1 << len(scancode_bit_dict)
+    mod_key_mask = (1 << len(mod_key_scancode_list)) - 1
     return
 
 Key_Init()
@@ -3,8 +3,14 @@ Python side of the time api.
 This provides actual realtime timer support, which will work within
 a single frame (which is otherwise not possible with X4's internal
 timer).
+
+Timers are named, so any number of scripts can time themselves at once,
+and each keeps statistics over its measurements. Lua sends the commands
+of a frame together in one message, each stamped with lua's performance
+counter time, so timings don't include the pipe delay.
 '''
-from X4_Python_Pipe_Server import Pipe_Server, Pipe_Client
+from X4_Python_Pipe_Server import Pipe_Server, Pipe_Client, Percentiles
+from collections import deque
 import time
 import threading
 
@@ -39,9 +45,8 @@ def main(args):
     # Wait for client.
     pipe.Connect()
 
-    # Var to hold the last tic time.
-    last_tic = 0
-           
+    # Named timers and their stats.
+    timers = Timer_Service()
 
     while 1:        
         # Blocking wait for a message from x4.
@@ -59,13 +64,19 @@ def main(args):
             # Return current time.
             pipe.Write(time.perf_counter())
 
+        # Single tic/toc, on an unnamed timer.
         elif message == 'tic':
-            # Record current time in prep for toc.
-            last_tic = time.perf_counter()
+            timers.Get('').Tic(time.perf_counter())
 
         elif message == 'toc':
             # Return time since the tic.
-            pipe.Write(time.perf_counter() - last_tic)
+            pipe.Write(timers.Get('').Toc(time.perf_counter()) or 0)
+
+        # Batch of commands; a single reply covers any results.
+        elif ':' in message:
+            reply = timers.Process_Batch(message)
+            if reply:
+                pipe.Write(reply)
 
         else:
             print('Error:' + pipe_name + ' unrecognized command: ' + message)
@@ -93,4 +104,169 @@ def Pipe_Client_Test():
             response = pipe.Read()
             print(pipe_name + ' client got: ' + response)
 
-    return
\ No newline at end of file
+    # Overlapping named timers, batched as lua would send them.
+    for i in range(5):
+        now = time.perf_counter()
+        pipe.Write(f'tic:{now}:outer;tic:{now}:inner_{i % 2}')
+        now = time.perf_counter()
+        pipe.Write(f'toc:{now}:inner_{i % 2};toc:{now + 0.001}:outer;get::now')
+        print(pipe_name + ' client got: ' + pipe.Read())
+    pipe.Write('stats::outer;stats::inner_0;print::')
+    print(pipe_name + ' client got: ' + pipe.Read())
+
+    return
+
+
+class Timer:
+    '''
+    A named timer, with statistics over its measurements.
+
+    Attributes:
+    * start
+      - Time of the pending tic, or None.
+    * count, total, min, max
+      - Over all measurements.
+    * samples
+      - Deque of the latest measurements, for percentiles.
+    '''
+    def __init__(self, max_samples = 1000):
+        self.start = None
+        self.samples = deque(maxlen = max_samples)
+        self.Reset()
+        return
+
+    def Reset(self):
+        '''
+        Clear the statistics; a pending tic is kept.
+        '''
+        self.count = 0
+        self.total = 0.0
+        self.min = None
+        self.max = None
+        self.samples.clear()
+        return
+
+    def Tic(self, now):
+        self.start = now
+        return
+
+    def Toc(self, now):
+        '''
+        Record and return the seconds since the tic, or None if there
+        was no tic. The tic is consumed.
+        '''
+        if self.start is None:
+            return None
+        seconds = now - self.start
+        self.start = None
+
+        self.count += 1
+        self.total += seconds
+        if self.min is None or seconds < self.min:
+            self.min = seconds
+        if self.max is None or seconds > self.max:
+            self.max = seconds
+        self.samples.append(seconds)
+        return seconds
+
+    def Percentiles(self, fractions):
+        '''
+        Return measurements at the given fractions (eg. 0.99) of the
+        recent samples, nearest rank.
+        '''
+        return Percentiles(self.samples, fractions)
+
+    def Summary(self):
+        '''
+        Returns a list of count, mean, min, max, p50, p90, p99.
+        '''
+        if not self.count:
+            return [0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0]
+        return [self.count, self.total / self.count, self.min, self.max] + self.Percentiles([0.5, 0.9, 0.99])
+
+
+class Timer_Service:
+    '''
+    Named timers, driven by batched command messages.
+
+    A batch is semicolon separated commands of the form
+    "<command>:<stamp>:<name>". The stamp is the client's time in seconds
+    when it issued the command; if blank, the time the batch arrived is
+    used. Timings should use stamps from one clock throughout. Names go
+    last, so may hold ':' but not ';'.
+
+    Commands:
+    * tic: start the named timer.
+    * toc: stop it, recording the measurement; replies with seconds.
+    * get: replies with the server perf_counter time.
+    * stats: replies with count,mean,min,max,p50,p90,p99 of the timer.
+    * reset: clear the timer's statistics.
+    * print: print all timer statistics to the console (name ignored).
+
+    Replies are "<command>:<name>:<value>", semicolon separated, one
+    message per batch.
+    '''
+    def __init__(self):
+        self.timers = {}
+        return
+
+    def Get(self, name):
+        timer = self.timers.get(name)
+        if timer is None:
+            timer = self.timers[name] = Timer()
+        return timer
+
+    def Process_Batch(self, message):
+        '''
+        Run the commands of a batch message. Returns the reply string, or
+        None if no command produced a result.
+        '''
+        arrival = time.perf_counter()
+        replies = []
+        for command_string in message.split(';'):
+            if not command_string:
+                continue
+            try:
+                command, stamp, name = command_string.split(':', 2)
+                now = float(stamp) if stamp else arrival
+
+                if command == 'tic':
+                    self.Get(name).Tic(now)
+
+                elif command == 'toc':
+                    seconds = self.Get(name).Toc(now)
+                    if seconds is None:
+                        print('Error: ' + pipe_name + ' toc without tic for timer: ' + name)
+                        seconds = 0
+                    replies.append(f'toc:{name}:{seconds}')
+
+                elif command == 'get':
+                    replies.append(f'get:{name}:{arrival}')
+
+                elif command == 'stats':
+                    summary = self.Get(name).Summary()
+                    replies.append(f'stats:{name}:' + ','.join(str(x) for x in summary))
+
+                elif command == 'reset':
+                    self.Get(name).Reset()
+
+                elif command == 'print':
+                    self.Print()
+
+                else:
+                    print('Error: ' + pipe_name + ' unrecognized command: ' + command_string)
+
+            except ValueError:
+                print('Error: ' + pipe_name + ' malformed command: ' + command_string)
+
+        return ';'.join(replies) if replies else None
+
+    def Print(self):
+        '''
+        Print a table of timer statistics, in ms, most total time first.
+        '''
+        print(f"{'timer':<40} {'count':>8} {'mean':>10} {'min':>10} {'max':>10} {'p50':>10} {'p90':>10} {'p99':>10}")
+        for name, timer in sorted(self.timers.items(), key = lambda x: -x[1].total):
+            count, *values = timer.Summary()
+            print(f'{name[-40:]:<40} {count:>8} ' + ' '.join(f'{x * 1000:>10.3f}' for x in values))
+        return
\ No newline at end of file
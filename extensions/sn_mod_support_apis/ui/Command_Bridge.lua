@@ -0,0 +1,180 @@
+Lua_Loader.define("extensions.sn_mod_support_apis.ui.Command_Bridge",function(require)
+--[[
+Shared md->lua command bridge, used by the api Interfaces that receive
+complex args through a player blackboard list.
+
+Behavior:
+    MD appends an args table to a blackboard list (eg. "$pipe_api_args")
+    and raises a Process_Command lua event, once per command. MD may queue
+    up many commands in a frame before lua gets to run.
+
+    On the first signal, the bridge reads the whole blackboard list once,
+    clears the md var by writing nil, and then processes every pending
+    command in order. Later signals from the same md burst find nothing
+    pending and return immediately.
+
+    The local queue is dequeued by advancing a head index, so a flood of
+    commands (eg. menu building) costs linear time overall, instead of
+    the quadratic cost of repeated table.remove(queue, 1).
+
+    Each command is dispatched on its "command" field through a per-api
+    table of handler functions. Commands without a matching handler go
+    to the optional fallback function. Handlers are pcalled individually,
+    so one bad command doesn't suppress those queued behind it.
+
+Example:
+    local Command_Bridge = require("extensions.sn_mod_support_apis.ui.Command_Bridge")
+    L.bridge = Command_Bridge.new({
+        name = "Named_Pipes",
+        blackboard_var = "$pipe_api_args",
+        commands = {
+            Read  = function(args) ... end,
+            Write = function(args) ... end,
+        },
+        -- Optional; called on each args table before dispatch.
+        prepare = function(args) ... end,
+        -- Optional; called for unrecognized commands.
+        fallback = function(args) ... end,
+    })
+    RegisterEvent("pipeProcessCommand", function() L.bridge:Dispatch(L.player_id) end)
+]]
+
+-- Table holding the bridge class.
+local L = {}
+
+local Bridge = {}
+Bridge.__index = Bridge
+
+-- Create a new bridge from a spec table, as in the example above.
+function L.new(spec)
+    if type(spec.blackboard_var) ~= "string" then
+        error("Command_Bridge.new requires a blackboard_var string")
+    end
+    local bridge = {
+        name           = spec.name or spec.blackboard_var,
+        blackboard_var = spec.blackboard_var,
+        commands       = spec.commands or {},
+        prepare        = spec.prepare,
+        fallback       = spec.fallback,
+
+        -- Pending args, stored in queue[head..tail].
+        queue = {},
+        head  = 1,
+        tail  = 0,
+
+        -- Flag, true while the dispatch loop is running, to catch any
+        -- handler that triggers a nested dispatch.
+        dispatching = false,
+    }
+    return setmetatable(bridge, Bridge)
+end
+
+-- Add or replace the handler for a command name.
+function Bridge:Set_Handler(command, handler)
+    self.commands[command] = handler
+end
+
+-- Number of commands still pending locally.
+function Bridge:Pending()
+    return self.tail - self.head + 1
+end
+
+-- Drop any pending commands, and clear the md var.
+-- Intended for init/reload, when stale args may be left over.
+function Bridge:Reset(player_id)
+    self.queue = {}
+    self.head  = 1
+    self.tail  = 0
+    if player_id ~= nil then
+        SetNPCBlackboard(player_id, self.blackboard_var, nil)
+    end
+end
+
+-- Move the md blackboard list onto the local queue, and clear the md var.
+-- Returns the number of args pulled.
+function Bridge:Pull(player_id)
+    -- Args are attached to the player component object.
+    local args_list = GetNPCBlackboard(player_id, self.blackboard_var)
+    if args_list == nil then
+        return 0
+    end
+
+    local queue = self.queue
+    local tail = self.tail
+    for i = 1, #args_list do
+        tail = tail + 1
+        queue[tail] = args_list[i]
+    end
+    self.tail = tail
+
+    -- Clear the md var by writing nil. MD will recreate a list when
+    -- needed to pass more args.
+    SetNPCBlackboard(player_id, self.blackboard_var, nil)
+    return #args_list
+end
+
+-- Pop the next pending args table, or nil if empty.
+function Bridge:Next()
+    local head = self.head
+    if head > self.tail then
+        return nil
+    end
+    local args = self.queue[head]
+    self.queue[head] = nil
+    self.head = head + 1
+    return args
+end
+
+-- Run a single args table through prepare and the dispatch table.
+function Bridge:Process(args)
+    if self.prepare ~= nil then
+        self.prepare(args)
+    end
+    local handler = self.commands[args.command] or self.fallback
+    if handler == nil then
+        error("unknown command: "..tostring(args.command))
+    end
+    handler(args)
+end
+
+-- Pull everything md has posted, then process all pending commands.
+-- Safe to call on every Process_Command signal; returns the number of
+-- commands handled.
+function Bridge:Dispatch(player_id)
+    -- Player not known yet (eg. still loading); md args stay on the
+    -- blackboard until a later signal.
+    if player_id == nil then
+        return 0
+    end
+    -- A handler that somehow triggers another dispatch only appends to
+    -- the queue; the running loop will pick those commands up.
+    if self.dispatching then
+        self:Pull(player_id)
+        return 0
+    end
+    self.dispatching = true
+
+    self:Pull(player_id)
+
+    local count = 0
+    local args = self:Next()
+    while args ~= nil do
+        local success, message = pcall(self.Process, self, args)
+        if not success then
+            DebugError(string.format(
+                '%s: command "%s" produced error: %s',
+                self.name, tostring(args.command), tostring(message)))
+        end
+        count = count + 1
+        args = self:Next()
+    end
+
+    -- Queue is empty; rewind the indices so they don't grow forever.
+    self.head = 1
+    self.tail = 0
+    self.dispatching = false
+    return count
+end
+
+return L
+end)
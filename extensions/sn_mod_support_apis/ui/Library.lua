@@ -314,5 +314,328 @@ function FIFO.Is_Empty(fifo)
     return is_empty
 end
 
+
+-- Binary min-heap of entry tables, ordered by entry.key, with ties broken
+-- by insertion order.
+-- Each entry records its current position in entry.heap_index, so it can
+-- be removed in O(log n) without searching.
+-- Note: no debug printouts here, since this sits on per-frame paths.
+local Heap = {}
+Heap.__index = Heap
+L.Heap = Heap
+
+function Heap.new()
+    return setmetatable({size = 0, count = 0}, Heap)
+end
+
+-- Returns true if entry a should be above entry b.
+local function heap_less(a, b)
+    if a.key ~= b.key then
+        return a.key < b.key
+    end
+    return a.heap_seq < b.heap_seq
+end
+
+local function heap_set(heap, index, entry)
+    heap[index] = entry
+    entry.heap_index = index
+end
+
+function Heap:Sift_Up(index)
+    local entry = self[index]
+    while index > 1 do
+        local parent_index = math.floor(index / 2)
+        local parent = self[parent_index]
+        if not heap_less(entry, parent) then break end
+        heap_set(self, index, parent)
+        index = parent_index
+    end
+    heap_set(self, index, entry)
+end
+
+function Heap:Sift_Down(index)
+    local size = self.size
+    local entry = self[index]
+    while true do
+        local child_index = index * 2
+        if child_index > size then break end
+        local child = self[child_index]
+        -- Pick the smaller of the two children.
+        if child_index < size and heap_less(self[child_index + 1], child) then
+            child_index = child_index + 1
+            child = self[child_index]
+        end
+        if not heap_less(child, entry) then break end
+        heap_set(self, index, child)
+        index = child_index
+    end
+    heap_set(self, index, entry)
+end
+
+-- Add an entry; its key field must already be set.
+function Heap:Push(entry)
+    self.count = self.count + 1
+    entry.heap_seq = self.count
+    self.size = self.size + 1
+    heap_set(self, self.size, entry)
+    self:Sift_Up(self.size)
+end
+
+-- Return the smallest entry without removing it, or nil if empty.
+function Heap:Peek()
+    return self[1]
+end
+
+-- Remove and return the smallest entry, or nil if empty.
+function Heap:Pop()
+    local top = self[1]
+    if top ~= nil then
+        self:Remove(top)
+    end
+    return top
+end
+
+-- Remove a specific entry, if it is in this heap.
+-- Returns true if removed.
+function Heap:Remove(entry)
+    local index = entry.heap_index
+    if index == nil or self[index] ~= entry then
+        return false
+    end
+    local size = self.size
+    local last = self[size]
+    self[size] = nil
+    self.size = size - 1
+    entry.heap_index = nil
+    if index ~= size then
+        heap_set(self, index, last)
+        -- Replacement may need to move either way.
+        self:Sift_Down(index)
+        self:Sift_Up(last.heap_index)
+    end
+    return true
+end
+
+function Heap:Is_Empty()
+    return self.size == 0
+end
+
+
+-- Smoothing filters, for noisy values sampled every frame (eg. speeds).
+-- Samples live in preallocated parallel arrays used as rings, so updates
+-- make no tables. Running sums use Kahan compensation, so they don't
+-- drift and never need a full rescan.
+-- Note: no debug printouts here, since these sit on per-frame paths.
+
+-- Add value to the filter's compensated running sum.
+local function kahan_add(filter, value)
+    local y = value - filter.sum_error
+    local t = filter.sum + y
+    filter.sum_error = (t - filter.sum) - y
+    filter.sum = t
+end
+
+
+-- Moving average over the last "depth" samples.
+-- Fields: current (average, or nil if no samples).
+local Depth_Filter = {}
+Depth_Filter.__index = Depth_Filter
+L.Depth_Filter = Depth_Filter
+
+-- Make a filter with the given starting depth (default 4), allowing
+-- depths up to max_depth (default 100).
+function Depth_Filter.new(depth, max_depth)
+    local filter = setmetatable({
+        capacity = max_depth or 100,
+        depth = depth or 4,
+        values = {},
+        }, Depth_Filter)
+    for i = 1, filter.capacity do
+        filter.values[i] = 0
+    end
+    filter:Clear()
+    return filter
+end
+
+-- Drop all samples; storage is kept.
+function Depth_Filter:Clear()
+    -- Samples taken so far; the newest is at ring position
+    -- (total - 1) % capacity + 1.
+    self.total = 0
+    -- Samples currently averaged, up to depth.
+    self.count = 0
+    self.sum = 0
+    self.sum_error = 0
+    self.current = nil
+end
+
+-- Add a new sample, and return the current smoothed value.
+function Depth_Filter:Smooth(sample)
+    local capacity = self.capacity
+    if self.count == self.depth then
+        -- Drop the oldest averaged sample.
+        kahan_add(self, -self.values[(self.total - self.count) % capacity + 1])
+    else
+        self.count = self.count + 1
+    end
+    self.total = self.total + 1
+    self.values[(self.total - 1) % capacity + 1] = sample
+    kahan_add(self, sample)
+    self.current = self.sum / self.count
+    return self.current
+end
+
+-- Change the depth. Shrinking drops the oldest samples from the sum;
+-- growing keeps the current samples, and fills with new ones.
+-- Samples are not moved, just reindexed.
+function Depth_Filter:Change_Depth(new_depth)
+    -- To prevent excess changes when an object is around a depth
+    -- boundary, only update if the depth changed by a couple steps,
+    -- where one step is 2 (hence 4 for two steps).
+    if math.abs(new_depth - self.depth) < 4 then
+        return
+    end
+    new_depth = math.floor(new_depth)
+    if new_depth <= 0 or new_depth > self.capacity then
+        DebugError("Depth_Filter.Change_Depth rejecting "..tostring(new_depth))
+        return
+    end
+    local capacity = self.capacity
+    while self.count > new_depth do
+        kahan_add(self, -self.values[(self.total - self.count) % capacity + 1])
+        self.count = self.count - 1
+    end
+    self.depth = new_depth
+    if self.count > 0 then
+        self.current = self.sum / self.count
+    end
+end
+
+
+-- Moving average over samples from the last "timeout" seconds, with the
+-- average rate of change over them. Summaries update at most once per
+-- summary_period (realtime), to limit ui churn.
+-- Fields: current (average, or nil), delta (change per second, or nil).
+local Time_Filter = {}
+Time_Filter.__index = Time_Filter
+L.Time_Filter = Time_Filter
+
+-- Make a filter, set for "use_realtime" to time samples by realtime,
+-- eg. for values that jitter while paused, else by gametime.
+-- Capacity is the starting ring size (default 64); it doubles if more
+-- samples than that fall within the timeout.
+function Time_Filter.new(use_realtime, default_update_period, capacity)
+    local filter = setmetatable({
+        use_realtime = use_realtime,
+        default_update_period = default_update_period,
+        capacity = capacity or 64,
+        times = {},
+        values = {},
+        }, Time_Filter)
+    for i = 1, filter.capacity do
+        filter.times[i] = 0
+        filter.values[i] = 0
+    end
+    filter:Clear()
+    return filter
+end
+
+-- Drop all samples, and reset timeout and summary period; storage is kept.
+function Time_Filter:Clear()
+    -- Ring position of the oldest sample, and count of samples.
+    self.oldest = 1
+    self.count = 0
+    self.sum = 0
+    self.sum_error = 0
+    -- Seconds after which samples are dropped, though at least two
+    -- samples are always kept.
+    self.timeout = 0.2
+    self.summary_period = self.default_update_period
+    self.last_summary_time = 0
+    self.current = nil
+    self.delta = nil
+end
+
+-- Double the ring size, unwrapping samples to the front.
+-- Only happens while warming up to the sample rate.
+function Time_Filter:Grow()
+    local old_capacity = self.capacity
+    local times, values = self.times, self.values
+    local new_times, new_values = {}, {}
+    for i = 0, self.count - 1 do
+        local index = (self.oldest - 1 + i) % old_capacity + 1
+        new_times[i + 1] = times[index]
+        new_values[i + 1] = values[index]
+    end
+    self.capacity = old_capacity * 2
+    for i = self.count + 1, self.capacity do
+        new_times[i] = 0
+        new_values[i] = 0
+    end
+    self.times, self.values = new_times, new_values
+    self.oldest = 1
+end
+
+-- Add a new sample, updating "current" and "delta" if the summary is due.
+function Time_Filter:Update(sample)
+    local time
+    if self.use_realtime then
+        time = GetCurRealTime()
+    else
+        time = GetCurTime()
+    end
+
+    -- Drop samples past the timeout, oldest first.
+    -- Always keep a couple samples regardless, so that low framerates
+    -- (where every sample times out) still give values.
+    local cutoff_time = time - self.timeout
+    local times, values = self.times, self.values
+    while self.count > 2 and times[self.oldest] < cutoff_time do
+        kahan_add(self, -values[self.oldest])
+        self.oldest = self.oldest % self.capacity + 1
+        self.count = self.count - 1
+    end
+
+    -- Store the new sample after the newest.
+    if self.count == self.capacity then
+        self:Grow()
+        times, values = self.times, self.values
+    end
+    local newest = (self.oldest - 1 + self.count) % self.capacity + 1
+    times[newest] = time
+    values[newest] = sample
+    self.count = self.count + 1
+    kahan_add(self, sample)
+
+    -- Update the summary, if needed, based on real time.
+    local now = GetCurRealTime()
+    if now > self.last_summary_time + self.summary_period then
+        self.last_summary_time = now
+        self.current = self.sum / self.count
+
+        local time_delta = time - times[self.oldest]
+        if time_delta == 0 then
+            self.delta = nil
+        else
+            self.delta = (sample - values[self.oldest]) / time_delta
+        end
+    end
+end
+
+-- Change the timeout; samples are dropped on the next Update.
+function Time_Filter:Change_Timeout(new_timeout)
+    -- Safety against 0, negative, or just too large.
+    if new_timeout <= 0 or new_timeout > 100 then
+        DebugError("Time_Filter.Change_Timeout rejecting "..tostring(new_timeout))
+        return
+    end
+    self.timeout = new_timeout
+end
+
+-- Change how often the summary 'current' and 'delta' values recompute.
+function Time_Filter:Change_Summary_Period(new_period)
+    self.summary_period = new_period
+end
+
 return L
 end)
\ No newline at end of file
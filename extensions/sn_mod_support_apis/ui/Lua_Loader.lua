@@ -55,6 +55,23 @@ an early ready signal, which resolves before the normal ready.
 - Back end of frame, priority lua files load, and api signals standard Ready.
 - Next frame, md cues which listen to Ready may signal to load their lua.
 
+Modules made with Lua_Loader.define are lazy: defining only records the
+module function, and its body and init run on the first require (or
+Lua_Loader.Load) of that module. Modules with side effects that must
+happen at ui load can opt out:
+    Lua_Loader.define("my.module", function(require) ... end, {eager = true})
+Modules here with such bodies, and so eager:
+- sn_mod_support_apis named_pipes.Interface (starts its init)
+- sn_extra_game_options Custom_Options (hooks help text events)
+Other mods defining modules whose bodies register events or patch menus
+should add {eager = true}, else that work waits for the first require.
+
+Per-module body and init times are recorded (excluding any dependencies
+they pull in), and can be printed to the debug log from md with:
+    <raise_lua_event name="'Lua_Loader.Print_Profile'"/>
+or from lua with Lua_Loader.Print_Profile(). Lua_Loader.Get_Profile()
+returns the same data as a table.
+
 TODO: allow for more md arguments, including specifying dependendencies
 which are resolved at this level (eg. store and delay the require until
 all dependencies are met).
@@ -66,6 +83,53 @@ local modules = {}
 
 local isDebug = false -- Set to false in production to disable debug messages
 
+-- Modules are executed lazily by default: define() only records the
+-- module function, and its body runs on the first require (or Load).
+-- Set false to run every module body at define time, as before.
+Lua_Loader.lazy = true
+
+-- Order in which modules were first defined, for the profile report.
+local module_order = {}
+
+-- Forward declaration; runs a pending module body.
+local Execute_Module
+
+-- High resolution clock for the load profile, in seconds.
+-- Prefers the windows performance counter through ffi, falling back on
+-- os.clock, and lastly the (once per frame) engine time.
+local function Make_Profile_Clock()
+    local success, ffi = pcall(require, "ffi")
+    if success and type(ffi) == "table" then
+        -- May error if already declared elsewhere; that's fine.
+        pcall(ffi.cdef, [[
+            int QueryPerformanceCounter(int64_t* lpPerformanceCount);
+            int QueryPerformanceFrequency(int64_t* lpFrequency);
+        ]])
+        local clock_success, clock = pcall(function()
+            local counter = ffi.new("int64_t[1]")
+            ffi.C.QueryPerformanceFrequency(counter)
+            local period = 1 / tonumber(counter[0])
+            return function()
+                ffi.C.QueryPerformanceCounter(counter)
+                return tonumber(counter[0]) * period
+            end
+        end)
+        if clock_success then
+            return clock
+        end
+    end
+    if os ~= nil and os.clock ~= nil then
+        return os.clock
+    end
+    return GetCurRealTime
+end
+local Profile_Clock = Make_Profile_Clock()
+
+-- Time spent in nested module bodies/inits during the current one, so
+-- that reported times exclude dependencies that ran inside them.
+local nested_load_time = 0
+local nested_init_time = 0
+
 local function Send_Priority_Ready()
     --DebugError("LUA Loader API: Signalling 'Lua_Loader, Priority_Ready'")
    if isDebug then DebugError("[Lua_Loader] Send_Priority_Ready: Signalling Priority_Ready") end -- Debug: Log Priority_Ready signal
@@ -109,6 +173,11 @@ local function Lua_Loader_Require_Helper(name, methodName, requestorName)
         return false
     end
 
+    -- First require of a lazy module; run its body now.
+    if module.status == "pending" then
+        Execute_Module(name, module)
+    end
+
     local status = module.status
    if isDebug then DebugError("[Lua_Loader] Lua_Loader_Require_Helper: Module " .. tostring(name) .. " status: " .. tostring(status)) end -- Debug: Log module status
 
@@ -222,6 +291,8 @@ local function Init()
    if isDebug then DebugError("[Lua_Loader] Init: Registered Lua_Loader.Send_Priority_Ready event") end -- Debug: Log Priority_Ready event registration
     RegisterEvent("Lua_Loader.Send_Ready", Send_Ready)
    if isDebug then DebugError("[Lua_Loader] Init: Registered Lua_Loader.Send_Ready event") end -- Debug: Log Ready event registration
+    -- Startup profile printout, on md request.
+    RegisterEvent("Lua_Loader.Print_Profile", Lua_Loader.Print_Profile)
     -- Also call the function once on ui reload itself, to catch /reloadui
     -- commands while the md is running.
     -- Only triggers priority ready; md will then signal Send_Ready for
@@ -262,7 +333,14 @@ function Lua_Loader.require(name)
     return success, exports, init
 end
 
-function Lua_Loader.define(name, moduleFunction)
+-- Define a module.
+-- The module function is given a require function, and returns the
+-- module exports and an optional init function.
+-- Options is an optional table:
+--   eager: if true, run the module body now instead of on first require;
+--          for modules with load-time side effects.
+-- Lazy modules return nothing here; eager modules return exports, init.
+function Lua_Loader.define(name, moduleFunction, options)
    if isDebug then DebugError("[Lua_Loader] define: Defining module: " .. tostring(name)) end -- Debug: Log module definition start
     if type(name) ~= "string" then
        if isDebug then DebugError("[Lua_Loader] define: Invalid module name type: " .. tostring(type(name))) end -- Debug: Log invalid name type
@@ -272,10 +350,18 @@ function Lua_Loader.define(name, moduleFunction)
        if isDebug then DebugError("[Lua_Loader] define: Invalid module function type: " .. tostring(type(moduleFunction))) end -- Debug: Log invalid function type
         error("Invalid call to Lua_Loader.define(). Given moduleFunction must be a function but is '"..type(moduleFunction).."''")
     end
+    if options ~= nil and type(options) ~= "table" then
+        error("Invalid call to Lua_Loader.define(). Given options must be nil or a table but is '"..type(options).."''")
+    end
 
     local module = modules[name]
     if module ~= nil then
             DebugError("Redefining the module '"..name.."'") 
+        -- The replaced definition would have run under eager loading;
+        -- keep that behavior for anything relying on its side effects.
+        if module.status == "pending" then
+            pcall(Execute_Module, name, module)
+        end
     elseif package ~= nil then
         if IsReserved(name) then
            DebugError("Redefining the build-in module '"..name.."'")
@@ -283,16 +369,36 @@ function Lua_Loader.define(name, moduleFunction)
     elseif IsWhitelistedInProtectedUI(name) then
        DebugError("Redefining the build-in module '"..name.."'")
     end
-    
+    if module == nil then
+        table.insert(module_order, name)
+    end
+
     module = {
-        status = "executing",
+        status = "pending",
+        moduleFunction = moduleFunction,
+        eager = options ~= nil and options.eager == true,
         exports = nil,
         init = nil,
+        -- Profile data, in seconds; nil until measured.
+        load_time = nil,
+        init_time = nil,
     }
-   if isDebug then DebugError("[Lua_Loader] define: Created module entry for: " .. tostring(name) .. ", status: executing") end -- Debug: Log module entry creation
+   if isDebug then DebugError("[Lua_Loader] define: Created module entry for: " .. tostring(name) .. ", status: pending") end -- Debug: Log module entry creation
 
     modules[name] = module
 
+    if module.eager or not Lua_Loader.lazy then
+        return Execute_Module(name, module)
+    end
+end
+
+-- Run the body of a pending module, filling in its exports and init.
+-- Returns exports, init.
+Execute_Module = function(name, module)
+    local moduleFunction = module.moduleFunction
+    module.moduleFunction = nil
+    module.status = "executing"
+
     local ambientName = name
     local dependencies = nil
     local moduleFunctionRan = false
@@ -328,7 +434,14 @@ function Lua_Loader.define(name, moduleFunction)
         return exports, init
     end
 
+    -- Time the body, excluding any dependency bodies it pulls in.
+    local outer_nested = nested_load_time
+    nested_load_time = 0
+    local start = Profile_Clock()
     local success, exports, initFunction = pcall(moduleFunction, moduleRequire)
+    local elapsed = Profile_Clock() - start
+    module.load_time = elapsed - nested_load_time
+    nested_load_time = outer_nested + elapsed
    if isDebug then DebugError("[Lua_Loader] define: Module function execution for " .. tostring(name) .. " succeeded: " .. tostring(success)) end -- Debug: Log module function execution
     
     -- Prevent future 'require' from attempting to update the dependency list.
@@ -339,7 +452,7 @@ function Lua_Loader.define(name, moduleFunction)
         module.status = "faulted"
         module.exports = exports
        if isDebug then DebugError("[Lua_Loader] define: Failed to define module " .. tostring(name) .. ", error: " .. tostring(exports)) end -- Debug: Log module definition failure
-        error("Failed to define module '"..name.."' due because of the following error: "..exports)
+        error("Failed to define module '"..name.."' due because of the following error: "..tostring(exports))
     end
 
     if initFunction ~= nil and type(initFunction) ~= "function" then
@@ -362,7 +475,17 @@ function Lua_Loader.define(name, moduleFunction)
                     end
                 end
                 if initFunction ~= nil and type(initFunction) == "function" then
-                    initFunction()
+                    -- Time the init, excluding inits it triggers.
+                    local outer_nested = nested_init_time
+                    nested_init_time = 0
+                    local start = Profile_Clock()
+                    local success, err = pcall(initFunction)
+                    local elapsed = Profile_Clock() - start
+                    module.init_time = elapsed - nested_init_time
+                    nested_init_time = outer_nested + elapsed
+                    if not success then
+                        error(err, 0)
+                    end
                    if isDebug then DebugError("[Lua_Loader] define: Initialized module: " .. tostring(name)) end -- Debug: Log module initialization
                 end
                 initialized = true
@@ -379,6 +502,55 @@ function Lua_Loader.define(name, moduleFunction)
     return exports, init
 end
 
+-- Returns a list of per-module profile entries, in definition order:
+--   {name, status, eager, load_time, init_time}
+-- Times are in seconds, nil if that step has not run. Modules still
+-- "pending" were never required.
+function Lua_Loader.Get_Profile()
+    local profile = {}
+    for _, name in ipairs(module_order) do
+        local module = modules[name]
+        table.insert(profile, {
+            name      = name,
+            status    = module.status,
+            eager     = module.eager,
+            load_time = module.load_time,
+            init_time = module.init_time,
+        })
+    end
+    return profile
+end
+
+-- Print the load profile to the debug log, costliest modules first.
+local function Print_Profile()
+    local profile = Lua_Loader.Get_Profile()
+    local total_load, total_init, pending = 0, 0, 0
+    for _, entry in ipairs(profile) do
+        total_load = total_load + (entry.load_time or 0)
+        total_init = total_init + (entry.init_time or 0)
+        if entry.status == "pending" then
+            pending = pending + 1
+        end
+    end
+    table.sort(profile, function(a, b)
+        return (a.load_time or 0) + (a.init_time or 0) > (b.load_time or 0) + (b.init_time or 0)
+    end)
+
+    local lines = {string.format(
+        "Lua_Loader profile: %d modules (%d never required), load %.3f ms, init %.3f ms",
+        #profile, pending, total_load * 1000, total_init * 1000)}
+    for _, entry in ipairs(profile) do
+        table.insert(lines, string.format("  %8s ms load, %8s ms init, %-9s%s %s",
+            entry.load_time and string.format("%.3f", entry.load_time * 1000) or "-",
+            entry.init_time and string.format("%.3f", entry.init_time * 1000) or "-",
+            entry.status,
+            entry.eager and " (eager)" or "",
+            entry.name))
+    end
+    DebugError(table.concat(lines, "\n"))
+end
+Lua_Loader.Print_Profile = Print_Profile
+
 -- This script kicks everything off, so we actually need to run its init now.
 Init()
 DebugError("[Lua_Loader] Script: Initialization complete") -- Debug: Log script initialization complete
\ No newline at end of file
@@ -53,6 +53,7 @@ to reduce file sizes.
     -- Imports.
     local Lib = require("extensions.sn_mod_support_apis.ui.Library")
     local Time = require("extensions.sn_mod_support_apis.ui.time.Interface")
+    local Pipes = require("extensions.sn_mod_support_apis.ui.named_pipes.Pipes")
     local T = require("extensions.sn_mod_support_apis.ui.Text")
     -- Reuse the config table from simple menu api.
     local Tables = require("extensions.sn_mod_support_apis.ui.simple_menu.Tables")
@@ -82,7 +83,15 @@ to reduce file sizes.
         -- Id to use for the alarm.
         alarm_id = "hotkey_directinput_timeout",
         -- If input currently disabled. Used to suppress some excess signals.
-        alarm_pending = false
+        alarm_pending = false,
+
+        -- Pipe the python server listens on; matches the md $Pipe_Name.
+        pipe_name = "x4_keys",
+        -- Highest message sequence number processed, to ack.
+        ack_seq = nil,
+        -- Frame alarm id for sending the ack, and if one is pending.
+        ack_alarm_id = "hotkey_ack",
+        ack_pending = false
     }
 
     -- Proxy for the gameoptions menu, linked further below.
@@ -214,6 +223,10 @@ to reduce file sizes.
         if isDebug then
             DebugError("[Hotkey.Interface] Process_Message: Split message into " .. tostring(#events) .. " events")
         end -- Debug: Log event splitting
+        -- A leading "seq:<n>" numbers the message, to be acked.
+        if events[1] and string.sub(events[1], 1, 4) == "seq:" then
+            L.Queue_Ack(tonumber(string.sub(table.remove(events, 1), 5)))
+        end
         -- Add '$' prefixes and return.
         for i, event in ipairs(events) do
             events[i] = "$" .. event
@@ -230,6 +243,27 @@ to reduce file sizes.
         end -- Debug: Log handle_events signal
     end
 
+    -- Ack messages up to the given sequence number. Acks are cumulative,
+    -- so all messages processed in a frame share one ack, sent next frame.
+    function L.Queue_Ack(seq)
+        if seq == nil then return end
+        if L.ack_seq == nil or seq > L.ack_seq then
+            L.ack_seq = seq
+        end
+        if not L.ack_pending then
+            L.ack_pending = true
+            Time.Set_Frame_Alarm(L.ack_alarm_id, 1, L.Send_Ack)
+        end
+    end
+
+    function L.Send_Ack()
+        L.ack_pending = false
+        Pipes.Schedule_Write(L.pipe_name, L.ack_alarm_id, string.format("ack:%d", L.ack_seq))
+        if isDebug then
+            DebugError("[Hotkey.Interface] Send_Ack: Acked through message " .. tostring(L.ack_seq))
+        end -- Debug: Log ack
+    end
+
     -- Handle md pipe connection status update. Param is 0 or 1.
     function L.Update_Connection_Status(_, connected)
         if isDebug then
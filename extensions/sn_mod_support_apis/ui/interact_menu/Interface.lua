@@ -189,6 +189,7 @@ local debugger = {
 }
 local Lib = require("extensions.sn_mod_support_apis.ui.Library")
 local Time = require("extensions.sn_mod_support_apis.ui.time.Interface")
+local Command_Bridge = require("extensions.sn_mod_support_apis.ui.Command_Bridge")
 
 
 
@@ -206,8 +207,8 @@ local L = {
     -- by a frame.
     delaying_menu = false,
 
-    -- List of queued command args.
-    queued_args = {},
+    -- Command_Bridge holding queued command args.
+    bridge = nil,
 
     -- Table of custom actions, keyed by id.
     -- Old style: perpetual actions loaded at startup.
@@ -219,8 +220,11 @@ local L = {
     static_actions_order = {},
     temp_actions_order = {},
 
-    -- Current table of target object flags.
-    flags = nil,
+    -- Bitset of target object flags that are true, and of those known
+    -- to be false (for '~' negated conditions). Both are 0 when there is
+    -- no target component.
+    flag_set = 0,
+    flag_clear = 0,
 }
 
 -- Convenience link to the egosoft interact menu.
@@ -241,88 +245,90 @@ function L.Init()
 end
 
 
--- Extract blackboard args.
-function L.Get_Next_Args()
-
-    -- If the list of queued args is empty, grab more from md.
-    if #L.queued_args == 0 then
-    
-        -- Args are attached to the player component object.
-        local args_list = GetNPCBlackboard(L.player_id, "$interact_menu_args")
-        
-        -- Loop over it and move entries to the queue.
-        for i, v in ipairs(args_list) do
-            table.insert(L.queued_args, v)
-        end
-        
-        -- Clear the md var by writing nil.
-        SetNPCBlackboard(L.player_id, "$interact_menu_args", nil)
-    end
-    
-    -- Pop the first table entry.
-    local args = table.remove(L.queued_args, 1)
-
-    return args
-end
-
 -- Process a command sent from md.
+-- All commands queued by md are handled on the first signal.
 function L.Handle_Process_Command(_, param)
-    local args = L.Get_Next_Args()
-    
+    L.bridge:Dispatch(L.player_id)
+end
+
+-- Debug printout of each command's args, ahead of dispatch.
+function L.Prepare_Args(args)
     if debugger.verbose then
         Lib.Print_Table(args, "Command_Args")
     end
+end
 
-    -- Process command.
-    -- Old version, perpetual action with flag checks.
-    if args.command == "Register_Action" then
-        -- If not seen yet, record the id ordering.
-        if L.static_actions[args.id] == nil then
-            table.insert(L.static_actions_order, args.id)
-        end
-        L.static_actions[args.id] = args
-
-    -- New version, single-use action.
-    elseif args.command == "Add_Action" then
-        -- If not seen yet, record the id ordering.
-        if L.temp_actions[args.id] == nil then
-            table.insert(L.temp_actions_order, args.id)
-        end
-        L.temp_actions[args.id] = args
+-- Handlers for md commands, keyed by command name.
+L.commands = {}
 
-    -- Update fields of an existing action.
-    elseif args.command == "Update_Action" then
+-- Old version, perpetual action with flag checks.
+function L.commands.Register_Action(args)
+    -- If not seen yet, record the id ordering.
+    if L.static_actions[args.id] == nil then
+        table.insert(L.static_actions_order, args.id)
+    end
+    L.Compile_Conditions(args)
+    L.static_actions[args.id] = args
+end
 
-        -- Check temp and static actions.
-        local action = nil
-        if L.temp_actions[args.id] ~= nil then
-            action = L.temp_actions[args.id]
-        elseif L.static_actions[args.id] ~= nil then
-            action = L.static_actions[args.id]
-        else
-            DebugError("Interact API: Update_Action has unmatched id: "..tostring(args.id))
-        end
+-- New version, single-use action.
+function L.commands.Add_Action(args)
+    -- If not seen yet, record the id ordering.
+    if L.temp_actions[args.id] == nil then
+        table.insert(L.temp_actions_order, args.id)
+    end
+    L.temp_actions[args.id] = args
+end
 
-        -- Copy over fields.
-        for field, value in pairs(args) do
-            -- Skip the id (though should be harmless to modify).
-            if field ~= "id" then
-                action[field] = value
-            end
-        end
+-- Update fields of an existing action.
+function L.commands.Update_Action(args)
 
-    -- Change any settings. If name doesn't match a setting, it will
-    -- be recorded but just not used.
-    elseif args.command == "Update_Settings" then
-        -- Convert 0 to false.
-        local value = args.value
-        if value == 0 then value = false end
-        L.settings[args.setting] = value
+    -- Check temp and static actions.
+    local action = nil
+    if L.temp_actions[args.id] ~= nil then
+        action = L.temp_actions[args.id]
+    elseif L.static_actions[args.id] ~= nil then
+        action = L.static_actions[args.id]
     else
-        DebugError("Interact API: Unrecognized command: "..tostring(args.command))
+        DebugError("Interact API: Update_Action has unmatched id: "..tostring(args.id))
+        return
     end
+
+    -- Copy over fields.
+    for field, value in pairs(args) do
+        -- Skip the id (though should be harmless to modify).
+        if field ~= "id" then
+            action[field] = value
+        end
+    end
+    -- Recompile flag checks, in case conditions were changed.
+    if L.static_actions[args.id] == action then
+        L.Compile_Conditions(action)
+    end
+end
+
+-- Change any settings. If name doesn't match a setting, it will
+-- be recorded but just not used.
+function L.commands.Update_Settings(args)
+    -- Convert 0 to false.
+    local value = args.value
+    if value == 0 then value = false end
+    L.settings[args.setting] = value
+end
+
+function L.Unknown_Command(args)
+    DebugError("Interact API: Unrecognized command: "..tostring(args.command))
 end
 
+-- Reader for "$interact_menu_args".
+L.bridge = Command_Bridge.new({
+    name           = "Interact API",
+    blackboard_var = "$interact_menu_args",
+    commands       = L.commands,
+    prepare        = L.Prepare_Args,
+    fallback       = L.Unknown_Command,
+})
+
 
 -- Patch the egosoft menu to insert custom actions.
 function L.Init_Patch_Menu()
@@ -693,8 +699,48 @@ local function tobool(value)
     end
 end
 
--- Returns a table of flag values (true/false) that can be referenced by
--- user actions to determine when they show.
+-- Luajit bit ops, for the flag bitsets.
+local band, bor, bnot, lshift = bit.band, bit.bor, bit.bnot, bit.lshift
+
+-- Names of flags that user actions can check, each given one bit of
+-- the flag bitsets (so at most 32 flags). Order is otherwise arbitrary.
+L.flag_names = {
+    -- Component class.
+    "class_controllable",
+    "class_destructible",
+    "class_gate",
+    "class_ship",
+    "class_station",
+    -- Component data.
+    "is_dock",
+    "is_deployable",
+    "is_enemy",
+    "is_playerowned",
+    -- Inherited from the menu.
+    "show_PlayerInteractions",
+    "has_PlayerShipPilot",
+    -- Misc.
+    "is_operational",
+    "have_selectedplayerships",
+    "has_pilot",
+    "in_playersquad",
+    -- Player related.
+    "is_playeroccupiedship",
+    "player_is_piloting",
+}
+-- Bit of each flag, keyed by name, and the bits of all flags.
+L.flag_bits = {}
+L.all_flag_bits = 0
+for index, name in ipairs(L.flag_names) do
+    L.flag_bits[name] = lshift(1, index - 1)
+    L.all_flag_bits = bor(L.all_flag_bits, L.flag_bits[name])
+end
+-- Name used for in_playersquad in the md documentation.
+L.flag_bits["is_inplayersquad"] = L.flag_bits["in_playersquad"]
+
+
+-- Fills the bitsets of flag values that can be referenced by user
+-- actions to determine when they show.
 -- Note: mostly depricated in favor of md-side checks.
 function L.Update_Flags(component)
 
@@ -705,52 +751,49 @@ function L.Update_Flags(component)
     --local component64 = ConvertIDTo64Bit(component) -- Errors
     local convertedComponent = ConvertStringTo64Bit(tostring(component))
 
-    local flags = {}
+    local bits = L.flag_bits
+    local flag_set = 0
+    -- Set a flag's bit if its value is true.
+    local function Set(name, value)
+        if value then
+            flag_set = bor(flag_set, bits[name])
+        end
+    end
 
     -- Verify the component still exists (get occasional log messages
     -- if not). Also, this is 0 when eg. opening a menu on a mission.
     if convertedComponent > 0 then
 
         -- Component class checks.
-        for key, name in pairs({
-            class_controllable = "controllable",
-            class_destructible = "destructible",
-            class_gate         = "gate", 
-            class_ship         = "ship", 
-            class_station      = "station",
-        }) do
-            -- Note: C.IsComponentClass returns 0 for false, so needs cleanup.
-            flags[key] = tobool(C.IsComponentClass(component, name))
-        end
-
-        -- Component data checks.
+        -- Note: C.IsComponentClass returns 0 for false, so needs cleanup.
+        Set("class_controllable", tobool(C.IsComponentClass(component, "controllable")))
+        Set("class_destructible", tobool(C.IsComponentClass(component, "destructible")))
+        Set("class_gate"        , tobool(C.IsComponentClass(component, "gate")))
+        Set("class_ship"        , tobool(C.IsComponentClass(component, "ship")))
+        Set("class_station"     , tobool(C.IsComponentClass(component, "station")))
+
+        -- Component data checks, in one lookup.
         -- TODO: more complicated logic, eg. shiptype and purpose comparisons
         -- to different possibilities.
-        for key, name in pairs({
-            is_dock        = "isdock",
-            is_deployable  = "isdeployable",
-            is_enemy       = "isenemy",
-            is_playerowned = "isplayerowned", 
-        }) do
-            flags[key] = tobool(GetComponentData(convertedComponent, name))
-        end
+        local isdock, isdeployable, isenemy, isplayerowned, assignedpilot = GetComponentData(
+            convertedComponent, "isdock", "isdeployable", "isenemy", "isplayerowned", "assignedpilot")
+        Set("is_dock"       , tobool(isdock))
+        Set("is_deployable" , tobool(isdeployable))
+        Set("is_enemy"      , tobool(isenemy))
+        Set("is_playerowned", tobool(isplayerowned))
 
         -- Special flags inherited from the menu.
-        for key, name in pairs({
-            show_PlayerInteractions = "showPlayerInteractions", 
-            has_PlayerShipPilot     = "hasPlayerShipPilot",
-        }) do
-            flags[name] = tobool(menu.showPlayerInteractions)
-        end
+        Set("show_PlayerInteractions", tobool(menu.showPlayerInteractions))
+        Set("has_PlayerShipPilot"    , tobool(menu.hasPlayerShipPilot))
 
         -- Misc stuff.
-        flags["is_operational"]         = tobool(IsComponentOperational(convertedComponent))
+        Set("is_operational"          , tobool(IsComponentOperational(convertedComponent)))
         -- TODO: IsUnit tosses failed-to-retrieve-controllable log messages
         -- sometimes; maybe figure out how to suppress.
-        --flags["is_unit"]                = tobool(C.IsUnit(convertedComponent))
-        flags["have_selectedplayerships"] = #menu.selectedplayerships > 0
-        flags["has_pilot"]              = GetComponentData(convertedComponent, "assignedpilot") ~= nil
-        flags["in_playersquad"]         = tobool(menu.playerSquad[convertedComponent])
+        --Set("is_unit"                 , tobool(C.IsUnit(convertedComponent)))
+        Set("have_selectedplayerships", #menu.selectedplayerships > 0)
+        Set("has_pilot"               , assignedpilot ~= nil)
+        Set("in_playersquad"          , tobool(menu.playerSquad[convertedComponent]))
 
 
         -- Player related flags.
@@ -758,8 +801,8 @@ function L.Update_Flags(component)
         local player_piloted_ship  = ConvertStringTo64Bit(tostring(C.GetPlayerControlledShipID()))
         local playercontainer      = ConvertStringTo64Bit(tostring(C.GetPlayerContainerID()))
 
-        flags["is_playeroccupiedship"]  = player_occupied_ship == convertedComponent
-        flags["player_is_piloting"]     = player_piloted_ship > 0
+        Set("is_playeroccupiedship", player_occupied_ship == convertedComponent)
+        Set("player_is_piloting"   , player_piloted_ship > 0)
 
         -- Do stuff with player component checks.
         -- Side note: ego code checks playercontainer ~= 0 ahead of the conversion
@@ -772,31 +815,62 @@ function L.Update_Flags(component)
             -- TODO: check if player location is dockable, etc.
         end
 
+        -- Every flag not set is known false, for negated conditions.
+        L.flag_set = flag_set
+        L.flag_clear = band(bnot(flag_set), L.all_flag_bits)
 
-        -- For every flag, also offer the negated version.
-        -- Do in two steps; can't modify the original table in the loop without
-        -- new entries showing up in the same loop (eg. multiple ~~~flags).
-        local negated_flags = {}
-        for key, value in pairs(flags) do
-            negated_flags["~"..key] = not value
-        end
-        for key, value in pairs(negated_flags) do
-            flags[key] = value
-        end
-    
         if debugger.verbose then
             -- Debug printout.
+            local flags = {}
+            for _, name in ipairs(L.flag_names) do
+                flags[name] = band(flag_set, bits[name]) ~= 0
+            end
             Lib.Print_Table(flags, "flags")
         end
+    else
+        -- No flags are known, so neither plain nor negated ones match.
+        L.flag_set = 0
+        L.flag_clear = 0
     end
+end
 
-    L.flags = flags
+
+-- Returns masks of the flag bits in a condition list, of those that
+-- match when true and those that match when false ('~' prefixed).
+-- Unknown flags are reported, and never match.
+function L.Compile_Masks(conditions, action_id)
+    local set_mask, clear_mask = 0, 0
+    for _, flag in ipairs(conditions) do
+        local name, negated = flag, false
+        if string.sub(flag, 1, 1) == "~" then
+            name, negated = string.sub(flag, 2), true
+        end
+        local flag_bit = L.flag_bits[name]
+        if flag_bit == nil then
+            DebugError("Interact API: Unknown flag '"..tostring(flag).."' in conditions for action "..tostring(action_id))
+        elseif negated then
+            clear_mask = bor(clear_mask, flag_bit)
+        else
+            set_mask = bor(set_mask, flag_bit)
+        end
+    end
+    return set_mask, clear_mask
+end
+
+-- Compile the condition lists of a registered action into flag masks,
+-- so that checking it on menu open is a few bit ops.
+function L.Compile_Conditions(action)
+    local enabled_conditions  = action.enabled_conditions or {}
+    local disabled_conditions = action.disabled_conditions or {}
+    action.has_enabled_conditions = #enabled_conditions ~= 0
+    action.enabled_set, action.enabled_clear = L.Compile_Masks(enabled_conditions, action.id)
+    action.disabled_set, action.disabled_clear = L.Compile_Masks(disabled_conditions, action.id)
 end
 
 
--- Check an action against the current flags
+-- Check an action against the current flags, using its compiled masks.
 -- Note: mostly depricated in favor of md-side checks.
-function L.Check_Flags(action, flags)
+function L.Check_Flags(action)
 
     if debugger.verbose then
         Lib.Print_Table(action.enabled_conditions, "enabled_conditions")
@@ -806,36 +880,25 @@ function L.Check_Flags(action, flags)
         Lib.Print_Table(action.disabled_conditions, "disabled_conditions")
     end
 
-    -- If there are requirements, check those.
-    if #action.enabled_conditions ~= 0 then
-        local match_found = false
-        -- Only need one to match.
-        for i, flag in ipairs(action.enabled_conditions) do
-            if L.flags[flag] then
-                match_found = true
-                break
-            end
-        end
-        -- If no match, failure.
-        if not match_found then 
-            if debugger.verbose then
-                DebugError("Interact API: Enable condition not matched for action "..action.id)
-            end
-            return false 
+    local flag_set, flag_clear = L.flag_set, L.flag_clear
+
+    -- If there are requirements, only need one to match.
+    if action.has_enabled_conditions
+    and band(flag_set, action.enabled_set) == 0
+    and band(flag_clear, action.enabled_clear) == 0 then
+        if debugger.verbose then
+            DebugError("Interact API: Enable condition not matched for action "..action.id)
         end
+        return false 
     end
 
-    -- If there are blacklisted flags, check those.
-    if #action.disabled_conditions ~= 0 then
-        -- Failure on any match.
-        for i, flag in ipairs(action.disabled_conditions) do
-            if L.flags[flag_req] then
-                if debugger.verbose then
-                    DebugError("Interact API: Disable condition matched for action "..action.id)
-                end
-                return false
-            end
+    -- Failure on any blacklisted flag match.
+    if band(flag_set, action.disabled_set) ~= 0
+    or band(flag_clear, action.disabled_clear) ~= 0 then
+        if debugger.verbose then
+            DebugError("Interact API: Disable condition matched for action "..action.id)
         end
+        return false
     end
 
     -- If here, should be good to go.
@@ -46,8 +46,9 @@ Behavior:
   blackboard var $pipe_api_args.
 - A Process_Command signal may accompany multiple command args due to
   md->lua latency in a frame.
-- Each Process_Command will consume only one command args entry, just in
-  case ordering of these lua signals matters relative to something elsewhere.
+- The first Process_Command of a batch consumes all pending command args,
+  in order, through the shared Command_Bridge; the remaining signals of
+  that batch are no-ops.
 
 
 Other lua modules may use this api to access pipes as well. Behavior is
@@ -87,11 +88,12 @@ writing and reading functions are shown here.
     local Lib = require("extensions.sn_mod_support_apis.ui.named_pipes.Library")
     local Pipes = require("extensions.sn_mod_support_apis.ui.named_pipes.Pipes")
     local Print_Table = require("extensions.sn_mod_support_apis.ui.Library").Print_Table
+    local Command_Bridge = require("extensions.sn_mod_support_apis.ui.Command_Bridge")
 
     -- Table of local functions or data.
     local L = {
-        -- Any command arguments not yet processed.
-        queued_args = {},
+        -- Command_Bridge holding any command arguments not yet processed.
+        bridge = nil,
         -- Fields holding booleans.
         bool_fields = {'continuous'}
     }
@@ -130,7 +132,7 @@ writing and reading functions are shown here.
             end
 
             -- 3) clear leftover args
-            SetNPCBlackboard(L.player_id, "$pipe_api_args", nil)
+            L.bridge:Reset(L.player_id)
             if isDebug then
                 DebugError("[Pipes.Interface] Init: Cleared pipe_api_args from player blackboard")
             end
@@ -161,112 +163,123 @@ writing and reading functions are shown here.
         end
     end
 
-    -- Get args from the player blackboard, and return the next entry.
-    function L.Get_Next_Args()
-        -- If the list of queued args is empty, grab more from md.
-        if #L.queued_args == 0 then
-            if isDebug then DebugError("[Pipes.Interface] Get_Next_Args: Queued args empty, fetching from blackboard") end -- Debug: Log fetching args
-            -- Args are attached to the player component object.
-            local args_list = GetNPCBlackboard(L.player_id, "$pipe_api_args")
-
-            -- Loop over it and move entries to the queue.
-            for i, v in ipairs(args_list) do
-                table.insert(L.queued_args, v)
-            end
-            if isDebug then DebugError("[Pipes.Interface] Get_Next_Args: Fetched " .. tostring(#args_list) .. " args from blackboard") end -- Debug: Log number of args fetched
-
-            -- Clear the md var by writing nil.
-            SetNPCBlackboard(L.player_id, "$pipe_api_args", nil)
-            if isDebug then DebugError("[Pipes.Interface] Get_Next_Args: Cleared pipe_api_args from blackboard") end -- Debug: Log blackboard clearing
-        end
-        -- if isDebug then DebugError("num args: "..tostring(#L.queued_args))
-
-        -- Pop the first table entry.
-        local args = table.remove(L.queued_args, 1)
-        if isDebug then DebugError("[Pipes.Interface] Get_Next_Args: Popped args: " .. Print_Table(args)) end -- Debug: Log popped args
-
-        -- Check args for any 0 entries on bool fields, convert to false.
+    -- Convert any 0 entries on bool fields to false.
+    function L.Prepare_Args(args)
         for _, field in ipairs(L.bool_fields) do
             if args[field] == 0 then
                 args[field] = false
-                if isDebug then DebugError("[Pipes.Interface] Get_Next_Args: Converted field " .. field .. " to false for args") end -- Debug: Log boolean conversion
+                if isDebug then DebugError("[Pipes.Interface] Prepare_Args: Converted field " .. field .. " to false for args") end -- Debug: Log boolean conversion
             end
         end
 
-        return args
+        if Lib.debug.print_to_log then
+            Print_Table(args, "Pipes.Interface.Process_Command args")
+        end
     end
 
     -- Generic command handler.
-    -- When this is signalled, there may be multiple commands queued.
+    -- When this is signalled, there may be multiple commands queued;
+    -- all of them are processed here, and later signals for the same
+    -- batch find nothing pending.
     function L.Process_Command()
-        local args = L.Get_Next_Args()
-        if isDebug then DebugError("[Pipes.Interface] Process_Command: Processing command: " .. tostring(args.command) .. ", pipe: " .. tostring(args.pipe_name) .. ", access_id: " .. tostring(args.access_id)) end -- Debug: Log command processing start
+        local count = L.bridge:Dispatch(L.player_id)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Processed " .. tostring(count) .. " commands") end -- Debug: Log batch size
+    end
 
-        if Lib.debug.print_to_log then
-            Print_Table(args, "Pipes.Interface.Process_Command args")
+    -- Per-command handlers, keyed by command name.
+    L.commands = {}
+
+    function L.commands.Read(args)
+        Pipes.Schedule_Read(args.pipe_name, args.access_id, args.continuous)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Scheduled read for pipe: " .. tostring(args.pipe_name) .. ", access_id: " .. tostring(args.access_id) .. ", continuous: " .. tostring(args.continuous)) end -- Debug: Log read scheduling
+    end
+
+    function L.commands.Write(args)
+        Pipes.Schedule_Write(args.pipe_name, args.access_id, args.message)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Scheduled write for pipe: " .. tostring(args.pipe_name) .. ", access_id: " .. tostring(args.access_id) .. ", message: " .. tostring(args.message)) end -- Debug: Log write scheduling
+    end
+
+    function L.commands.WriteSpecial(args)
+        -- Handle special commands.
+        -- Note: if the command not recognized, it just gets sent as-is.
+        if args.message == "package.path" then
+            -- Want to write out the current package.path.
+            args.message = "package.path:" .. package.path
+            if isDebug then DebugError("[Pipes.Interface] Process_Command: Modified WriteSpecial message to: " .. tostring(args.message)) end -- Debug: Log WriteSpecial message modification
+        end
+        -- Pass to the scheduler.
+        Pipes.Schedule_Write(args.pipe_name, args.access_id, args.message)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Scheduled WriteSpecial for pipe: " .. tostring(args.pipe_name) .. ", access_id: " .. tostring(args.access_id) .. ", message: " .. tostring(args.message)) end -- Debug: Log WriteSpecial scheduling
+    end
+
+    function L.commands.CancelReads(args)
+        Pipes.Deschedule_Reads(args.pipe_name)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Cancelled reads for pipe: " .. tostring(args.pipe_name)) end -- Debug: Log read cancellation
+    end
+
+    function L.commands.CancelWrites(args)
+        Pipes.Deschedule_Writes(args.pipe_name)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Cancelled writes for pipe: " .. tostring(args.pipe_name)) end -- Debug: Log write cancellation
+    end
+
+    function L.commands.Check(args)
+        -- Check if a pipe is connected.
+        local success = pcall(Pipes.Connect_Pipe, args.pipe_name)
+        -- Translate to strings that match read/write returns.
+        local message
+        if success then
+            message = "SUCCESS"
+        else
+            message = "ERROR"
+        end
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Check pipe: " .. tostring(args.pipe_name) .. ", result: " .. tostring(message)) end -- Debug: Log check result
+        -- Send back to md.
+        if type(args.callback) == "string" then
+            Lib.Raise_Signal('pipeCheck_complete_' .. args.callback, message)
+            if isDebug then DebugError("[Pipes.Interface] Process_Command: Raised signal pipeCheck_complete_" .. tostring(args.callback) .. " with message: " .. tostring(message)) end -- Debug: Log check signal
         end
+    end
 
-        if args.command == "Read" then
-            Pipes.Schedule_Read(args.pipe_name, args.access_id, args.continuous)
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Scheduled read for pipe: " .. tostring(args.pipe_name) .. ", access_id: " .. tostring(args.access_id) .. ", continuous: " .. tostring(args.continuous)) end -- Debug: Log read scheduling
-
-        elseif args.command == "Write" then
-            Pipes.Schedule_Write(args.pipe_name, args.access_id, args.message)
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Scheduled write for pipe: " .. tostring(args.pipe_name) .. ", access_id: " .. tostring(args.access_id) .. ", message: " .. tostring(args.message)) end -- Debug: Log write scheduling
-
-        elseif args.command == "WriteSpecial" then
-            -- Handle special commands.
-            -- Note: if the command not recognized, it just gets sent as-is.
-            if args.message == "package.path" then
-                -- Want to write out the current package.path.
-                args.message = "package.path:" .. package.path
-                if isDebug then DebugError("[Pipes.Interface] Process_Command: Modified WriteSpecial message to: " .. tostring(args.message)) end -- Debug: Log WriteSpecial message modification
-            end
-            -- Pass to the scheduler.
-            Pipes.Schedule_Write(args.pipe_name, args.access_id, args.message)
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Scheduled WriteSpecial for pipe: " .. tostring(args.pipe_name) .. ", access_id: " .. tostring(args.access_id) .. ", message: " .. tostring(args.message)) end -- Debug: Log WriteSpecial scheduling
-
-        elseif args.command == "CancelReads" then
-            Pipes.Deschedule_Reads(args.pipe_name)
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Cancelled reads for pipe: " .. tostring(args.pipe_name)) end -- Debug: Log read cancellation
-
-        elseif args.command == "CancelWrites" then
-            Pipes.Deschedule_Writes(args.pipe_name)
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Cancelled writes for pipe: " .. tostring(args.pipe_name)) end -- Debug: Log write cancellation
-
-        elseif args.command == "Check" then
-            -- Check if a pipe is connected.
-            local success = pcall(Pipes.Connect_Pipe, args.pipe_name)
-            -- Translate to strings that match read/write returns.
-            local message
-            if success then
-                message = "SUCCESS"
-            else
-                message = "ERROR"
-            end
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Check pipe: " .. tostring(args.pipe_name) .. ", result: " .. tostring(message)) end -- Debug: Log check result
-            -- Send back to md.
-            if type(args.callback) == "string" then
-                L.Raise_Signal('pipeCheck_complete_' .. args.callback, message)
-                if isDebug then DebugError("[Pipes.Interface] Process_Command: Raised signal pipeCheck_complete_" .. tostring(args.callback) .. " with message: " .. tostring(message)) end -- Debug: Log check signal
-            end
+    function L.commands.Close(args)
+        Pipes.Close_Pipe(args.pipe_name)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Closed pipe: " .. tostring(args.pipe_name)) end -- Debug: Log pipe closure
+    end
 
-        elseif args.command == "Close" then
-            Pipes.Close_Pipe(args.pipe_name)
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Closed pipe: " .. tostring(args.pipe_name)) end -- Debug: Log pipe closure
+    function L.commands.SuppressPausedReads(args)
+        Pipes.Set_Suppress_Paused_Reads(args.pipe_name, true)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Enabled suppress paused reads for pipe: " .. tostring(args.pipe_name)) end -- Debug: Log suppress enable
+    end
 
-        elseif args.command == "SuppressPausedReads" then
-            Pipes.Set_Suppress_Paused_Reads(args.pipe_name, true)
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Enabled suppress paused reads for pipe: " .. tostring(args.pipe_name)) end -- Debug: Log suppress enable
+    function L.commands.UnsuppressPausedReads(args)
+        Pipes.Set_Suppress_Paused_Reads(args.pipe_name, false)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Disabled suppress paused reads for pipe: " .. tostring(args.pipe_name)) end -- Debug: Log suppress disable
+    end
 
-        elseif args.command == "UnsuppressPausedReads" then
-            Pipes.Set_Suppress_Paused_Reads(args.pipe_name, false)
-            if isDebug then DebugError("[Pipes.Interface] Process_Command: Disabled suppress paused reads for pipe: " .. tostring(args.pipe_name)) end -- Debug: Log suppress disable
+    function L.commands.SetCapture(args)
+        local ok, err = Pipes.Set_Capture(args.path)
+        if not ok then
+            DebugError("[Pipes.Interface] SetCapture failed: " .. tostring(err))
         end
     end
 
+    -- Unknown commands were silently ignored before; keep that, but log.
+    function L.Unknown_Command(args)
+        if isDebug then DebugError("[Pipes.Interface] Process_Command: Unrecognized command: " .. tostring(args.command)) end
+    end
+
+    -- Blackboard reader and dispatcher for md commands.
+    L.bridge = Command_Bridge.new({
+        name           = "Pipes.Interface",
+        blackboard_var = "$pipe_api_args",
+        commands       = L.commands,
+        prepare        = L.Prepare_Args,
+        fallback       = L.Unknown_Command,
+    })
+
     -- Immediately initialize so the interface starts up on require()
     L.Init()
 
     return Pipes, L.Init
-end)
\ No newline at end of file
+-- Eager: the body starts polling for the player, as pipes may be used
+-- before md loads this module.
+end, {eager = true})
\ No newline at end of file
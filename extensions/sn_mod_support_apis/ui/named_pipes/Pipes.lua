@@ -16,6 +16,7 @@ Lua_Loader.define("extensions.sn_mod_support_apis.ui.named_pipes.Pipes", functio
       Set_Suppress_Paused_Reads(pipe_name, bool)
       Flush_Pipe(pipe_name)
       Is_Connected(pipe_name)
+      Set_Capture(file_path or nil)
 
     Internals:
       - Uses winpipe.open_pipe, winpipe.peek_pipe, file:read_pipe(), file:write_pipe()
@@ -225,6 +226,24 @@ Lua_Loader.define("extensions.sn_mod_support_apis.ui.named_pipes.Pipes", functio
         end
     end
 
+    ------------------------------------------------------------------------------
+    -- Public API Functions
+    ------------------------------------------------------------------------------
+    -- --------------------------------------------------------------------------
+    -- Public: Record all pipe traffic to a binary capture file, for replay
+    -- with the python server's Pipe_Replay.py; nil stops capturing.
+    -- Returns true on success, or nil and an error message (including when
+    -- the loaded winpipe dll predates capture support).
+    -- --------------------------------------------------------------------------
+    function M.Set_Capture(path)
+        if not winpipe.set_capture then
+            return nil, "winpipe dll has no capture support"
+        end
+        local ok, err = winpipe.set_capture(path)
+        if isDebug then DebugError("[Pipes] Set_Capture: " .. tostring(path) .. " -> " .. tostring(ok or err)) end -- Debug: Log capture change
+        return ok, err
+    end
+
     ------------------------------------------------------------------------------
     -- IO Scheduling
     ------------------------------------------------------------------------------
@@ -271,7 +290,7 @@ Lua_Loader.define("extensions.sn_mod_support_apis.ui.named_pipes.Pipes", functio
         M._reading = true
         if isDebug then DebugError("[Pipes] Poll_For_Reads: Started read polling") end -- Debug: Log start of read polling
 
-        Time.Register_NewFrame_Callback(function()
+        M._read_handle = Time.Register_NewFrame_Callback(function()
             local more = false
             for name, p in pairs(M.pipes) do
                 if p.suppress_reads_when_paused and ffi.C.IsGamePaused() then
@@ -314,11 +333,11 @@ Lua_Loader.define("extensions.sn_mod_support_apis.ui.named_pipes.Pipes", functio
             end
 
             if not more then
-                Time.Unregister_NewFrame_Callback(M.Poll_For_Reads)
+                Time.Unregister_NewFrame_Callback(M._read_handle)
                 M._reading = false
                 if isDebug then DebugError("[Pipes] Poll_For_Reads: Stopped read polling") end -- Debug: Log end of read polling
             end
-        end)
+        end, 0, "Pipes reads")
     end
 
     ------------------------------------------------------------------------------
@@ -334,7 +353,7 @@ Lua_Loader.define("extensions.sn_mod_support_apis.ui.named_pipes.Pipes", functio
         M._writing = true
         if isDebug then DebugError("[Pipes] Poll_For_Writes: Started write polling") end -- Debug: Log start of write polling
 
-        Time.Register_NewFrame_Callback(function()
+        M._write_handle = Time.Register_NewFrame_Callback(function()
             local more = false
             for name, p in pairs(M.pipes) do
                 if not p.write_file then
@@ -365,11 +384,11 @@ Lua_Loader.define("extensions.sn_mod_support_apis.ui.named_pipes.Pipes", functio
             end
 
             if not more then
-                Time.Unregister_NewFrame_Callback(M.Poll_For_Writes)
+                Time.Unregister_NewFrame_Callback(M._write_handle)
                 M._writing = false
                 if isDebug then DebugError("[Pipes] Poll_For_Writes: Stopped write polling") end -- Debug: Log end of write polling
             end
-        end)
+        end, 0, "Pipes writes")
     end
 
     -- Return the public API
@@ -34,6 +34,9 @@ local Options_Menu = require("extensions.sn_mod_support_apis.ui.simple_menu.Opti
 -- Import the standalone menu handler.
 local Standalone_Menu = require("extensions.sn_mod_support_apis.ui.simple_menu.Standalone_Menu")
 
+-- Shared md->lua args reader.
+local Command_Bridge = require("extensions.sn_mod_support_apis.ui.Command_Bridge")
+
 
 -- Set up any used ffi functions.
 local ffi = require("ffi")
@@ -100,6 +103,15 @@ local L = {}
 
 local function Init()
 
+    -- Reader for "$simple_menu_args"; every command goes through the
+    -- delay routing, which picks the actual handler.
+    L.bridge = Command_Bridge.new({
+        name           = "Simple Menu API",
+        blackboard_var = "$simple_menu_args",
+        prepare        = L.Prepare_Args,
+        fallback       = L.Route_Command,
+    })
+
     -- MD triggered events.
     RegisterEvent("Simple_Menu.Process_Command", L.Handle_Process_Command)
     
@@ -117,7 +129,7 @@ end
 -------------------------------------------------------------------------------
 -- MD/lua event handling.
 
--- Read the next args table from md and return them.
+-- Prepare an args table read from md.
 --[[
 Behavior:
     MD may queue up many signals in a frame before lua has a chance to
@@ -128,58 +140,32 @@ Behavior:
     table. However, lua cannot write back an edited table with one set of
     args removed, since SetNPCBlackboard will only write a table (not list).
     
-    So, this function will store the list of args locally, and overwrite
-    the blackboard with nil, deleting the var. MD will recreate a list when
-    needed to pass more args.
+    So, the Command_Bridge will store the list of args locally, and
+    overwrite the blackboard with nil, deleting the var. MD will recreate
+    a list when needed to pass more args. All pending args are handled on
+    the first signal of a batch.
 
     Note: "none" entries in md convert to lua nil, and hence will not
     show up in the args table.
 ]]
-function L.Get_Next_Args()
-
-    -- If the list of queued args is empty, grab more from md.
-    if #menu_data.queued_args == 0 then
-    
-        -- Args are attached to the player component object.
-        local args_list = GetNPCBlackboard(L.player_id, "$simple_menu_args")
-        
-        -- Loop over it and move entries to the queue.
-        for i, v in ipairs(args_list) do
-            table.insert(menu_data.queued_args, v)
-        end
-        
-        -- Clear the md var by writing nil.
-        SetNPCBlackboard(L.player_id, "$simple_menu_args", nil)
-    end
-    
-    -- Pop the first table entry.
-    local args = table.remove(menu_data.queued_args, 1)
-    
-    -- Debug printout of passed args; kinda messy.
-    -- Note: printouts will fail when v is a table; todo: maybe revisit and
-    -- cleanup properly.
-    --DebugError("Args received:")
-    --for k,v in pairs(args) do
-    --    DebugError(""..k.." type = "..type(v))
-    --    if type(v) ~= "userdata" then
-    --        DebugError(""..k.." = "..v)
-    --    end
-    --end
-
+function L.Prepare_Args(args)
     -- Support the user giving strings matching Helper or Color consts,
     -- replacing them here.
     Lib.Replace_Helper_Args(args)
     Lib.Replace_Color_Args(args)
-
-    return args
 end
 
 
 -- Handle command events coming in.
 -- Param unused currently.
 function L.Handle_Process_Command(_, param)
-    local args = L.Get_Next_Args()
-    
+    L.bridge:Dispatch(L.player_id)
+end
+
+
+-- Route a single command, either running it now or delaying it until
+-- the standalone menu frame is ready.
+function L.Route_Command(args)
     if menu_data.delay_commands == false
     -- These commands are never delayed.
     or args.command == "Create_Menu"
@@ -197,11 +183,12 @@ end
 
 -- Process all of the delayed events, in order.
 function L.Process_Delayed_Commands()
-    -- Loop until the list is empty; each iteration removes one event.
-    while #menu_data.queued_events ~= 0 do
-        -- Process the next event.
-        local args = table.remove(menu_data.queued_events, 1)
-        L.Process_Command(args)
+    -- Swap in a fresh list first, so anything queued while processing
+    -- lands in the new list instead of this loop.
+    local events = menu_data.queued_events
+    menu_data.queued_events = {}
+    for i = 1, #events do
+        L.Process_Command(events[i])
     end
 end
 -- This will attach to the standalone menu, which calls it when it
@@ -56,9 +56,6 @@ T.menu_data = {
     delay_commands = false,
     -- Queue for the above delays.
     queued_events = {},
-    
-    -- Queue of arg tables sent from md, consumed as commands are processed.
-    queued_args = {},
 
     -- Table of default widget properties to apply on top of the generic
     -- ones below.
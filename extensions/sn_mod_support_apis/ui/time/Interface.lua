@@ -25,23 +25,46 @@ TODO: maybe find a more reliable way to detect frame change when paused.
 
 Other lua modules may require() this module to access these api functions:
 
-* Register_NewFrame_Callback(function)
+* Register_NewFrame_Callback(function, [priority], [name])
   - Sets the function to be called on every frame.
   - Detects frame changes through two methods:
     - onUpdate events (sometimes have gaps)
     - MD signals (when not paused)
   - Some frames may be missed while the game is paused.
   - Callback function is given the current engine time.
-* Unregister_NewFrame_Callback(function)
+  - Optional priority; lower values run earlier. Default 0.
+  - Optional name, used in cost reports.
+  - Returns a handle for unregistering.
+  - Registering during a frame callback takes effect next frame.
+* Unregister_NewFrame_Callback(function or handle)
   - Remove a per-frame callback function that was registered.
-* Set_Alarm(id, time, function)
+  - Safe to call from inside any frame callback.
+* Set_Frame_Callback_Profiling(enabled)
+  - Turns per-callback cpu time measurement on or off.
+* Get_Frame_Callback_Report([top])
+  - Returns a list of {name, priority, calls, frame_time, total_time,
+    max_time} for the registered callbacks, most costly last frame
+    first, and the summed callback time of the last frame.
+* Set_Alarm(id, time, function, [period])
   - Sets a single-fire alarm to trigger after the given time elapses.
   - Callback function is called with args: (id, alarm_time), where the
     alarm_time is the original scheduled time of the alarm, which will
     generally be sometime earlier than the current time (due to frame
     boundaries).
-* Set_Frame_Alarm(id, frames, function)
+  - Setting an alarm with the id of a pending alarm replaces it.
+  - Optional period, in seconds; the alarm will repeat at this interval
+    until cancelled. Fires at most once per frame.
+  - Returns the realtime the alarm is scheduled for.
+* Set_Frame_Alarm(id, frames, function, [period_frames])
   - As above, but measures time in frame switches.
+* Cancel_Alarm(id)
+  - Cancels a pending time alarm. Returns true if one was found.
+* Cancel_Frame_Alarm(id)
+  - Cancels a pending frame alarm. Returns true if one was found.
+* Get_Precise_Time()
+  - Returns the high resolution clock time in seconds, using the
+    performance counter where available. Unlike engine time, this
+    advances within a frame. Only differences are meaningful.
 
 An MD ui event is raised on every frame, which MD cues may listen to.
 This differs from a cue firing every 1ms in that this works when paused.
@@ -82,18 +105,39 @@ Commands:
 - printTimer (id)
   - Prints the time on the timer to the debug log.
 - tic (id)
-  - Starts a fresh timer at time 0.
+  - Starts a fresh timer at time 0, named by id.
   - Intended as a convenient 1-shot timing solution.
+  - Timed in python with the performance counter; any number of named
+    timers may run at once.
 - toc (id)
   - Stops the timer associated with tic, returns the time measured,
     and prints the time to the debug log.
-- setAlarm (id:delay)
+  - The time is measured from when the tic and toc were raised; the
+    result arrives a frame or two later.
+  - Each measurement is added to statistics kept for the id.
+- getTimerStats (id)
+  - Returns statistics over all toc measurements of the id's timer, as
+    a comma separated string of "count,mean,min,max,p50,p90,p99", in
+    seconds. Percentiles cover the latest 1000 measurements.
+- resetTimerStats (id)
+  - Clears the statistics of the id's timer.
+- printTimerStats
+  - Prints a table of statistics for all timers to the python console.
+- setAlarm (id:delay[:period])
   - Sets an alarm to fire after a certain delay, in seconds.
   - Arguments are a concantenated string, colon separated.
   - Detect the alarm using event_ui_triggered.
   - Returns the realtime the alarm was set for, for convenience in
     creating clocks or similar.
+  - Optional period, in seconds, makes the alarm repeat until cancelled.
   - Note: precision based on game framerate.
+- cancelAlarm (id)
+  - Cancels a pending alarm, repeating or not.
+- profileCallbacks (1/0)
+  - Turns lua frame callback cost measurement on or off.
+- printCallbackReport (count)
+  - Prints the most costly lua frame callbacks of the last frame to the
+    debug log. Count is optional.
 
 
 - Example: get engine time.
@@ -141,6 +185,9 @@ Commands:
   ```
 ]]
 
+-- Shared library, for the alarm heap.
+local Lib = require("extensions.sn_mod_support_apis.ui.Library")
+
 -- Table of data/functions to export to other lua modules on require.
 local E = {}
 
@@ -153,25 +200,54 @@ local L = {
 
     -- Last frame update engine time.
     last_frame_time = 0,
-    -- Lua functions registered to be called every frame.
+    -- Records of lua functions registered to be called every frame,
+    -- sorted by priority; see the registry section below.
     frame_callbacks = {},
+    -- Records keyed by their callback function.
+    callback_records = {},
+    -- Records added during dispatch, to be inserted afterward.
+    pending_callbacks = {},
+    -- Count of records flagged removed but still in the list.
+    callbacks_removed = 0,
+    -- Flag, true if the list needs re-sorting by priority.
+    callbacks_need_sort = false,
+    -- Flag, true while callbacks are being called.
+    dispatching_callbacks = false,
+    -- Running count of registrations, for stable ordering.
+    callback_count = 0,
+    -- Flag, if true then callback run times are measured.
+    profile_callbacks = false,
+    -- Summed callback time of the last profiled frame.
+    callbacks_frame_time = 0,
     
     -- Table of timers, keyed by id.
     -- Subtables have the fields: {last_start, total, running}
     timers = {},
 
-    -- Table of alarms scheduled. Values are the realtime the alarm
-    -- will go off. Keyed by id.
+    -- Count of frames detected, used as the frame alarm clock.
+    frame_count = 0,
+
+    -- Table of alarm entries scheduled, keyed by id.
+    -- Entries have fields {id, key, callback, period}, where key is the
+    -- realtime the alarm will go off, and callback is nil for md alarms
+    -- (which are signalled instead).
     alarms = {},
-    -- As above, but holding 2-element lists with 
-    -- {realtime when alarm set up, pending frames until alarm}.
-    frame_alarms = {},
+    -- Min-heap of the above entries, ordered by key.
+    alarm_heap = Lib.Heap.new(),
 
-    -- Table of lua callbacks per id, for alarms.
-    -- These are used for the lua interface alarms, which use callback
-    -- functions instead of signals.
-    -- Key ids should match those in "alarms" or "frame_alarms" above.
-    alarm_callbacks = {},
+    -- As above, but for frame alarms, where key is the frame_count the
+    -- alarm will go off. Entries also record {start_time, frames}.
+    frame_alarms = {},
+    frame_alarm_heap = Lib.Heap.new(),
+    -- Frame alarms registered but not yet counting (key not known yet),
+    -- with their count.
+    new_frame_alarms = {},
+    new_frame_alarms_count = 0,
+
+    -- Scratch lists of entries and their keys fired by a poll, reused
+    -- between frames.
+    fired_entries = {},
+    fired_keys = {},
     }
 
 
@@ -184,6 +260,9 @@ function Init()
     RegisterEvent("Time.resetTimer"   , L.Reset_Timer)
     RegisterEvent("Time.printTimer"   , L.Print_Timer)
     RegisterEvent("Time.setAlarm"     , L.Set_Alarm)
+    RegisterEvent("Time.cancelAlarm"  , L.MD_Cancel_Alarm)
+    RegisterEvent("Time.profileCallbacks", L.MD_Profile_Callbacks)
+    RegisterEvent("Time.printCallbackReport", L.Print_Callback_Report)
 
     -- Misc
     RegisterEvent("Time.MD_New_Frame" , L.New_Frame_Detector)
@@ -312,7 +391,7 @@ end
 -- Start the alarm poller, if not started yet.
 function L.Start_Alarm_Polling()
     if not L.checking_alarms then
-        E.Register_NewFrame_Callback(L.Poll_For_Alarm)
+        E.Register_NewFrame_Callback(L.Poll_For_Alarm, 0, "Time alarms")
         L.checking_alarms = true
         if L.debug then
             DebugError("Time.Set_Alarm started polling")
@@ -321,7 +400,42 @@ function L.Start_Alarm_Polling()
 end
 
 
+-- Schedule a time based alarm entry, replacing any prior alarm with
+-- the same id.
+-- Period is optional; if a positive number, the alarm repeats.
+function L.Schedule_Alarm(id, time, callback, period)
+    L.Cancel_Alarm(id)
+    if period ~= nil and not (period > 0) then
+        period = nil
+    end
+    local entry = {
+        id       = id,
+        key      = GetCurRealTime() + time,
+        callback = callback,
+        period   = period,
+    }
+    L.alarms[id] = entry
+    L.alarm_heap:Push(entry)
+
+    -- Start polling if not already.
+    L.Start_Alarm_Polling()
+    return entry.key
+end
+
+
+-- Remove a pending time based alarm, if present.
+-- Returns true if an alarm was cancelled.
+function L.Cancel_Alarm(id)
+    local entry = L.alarms[id]
+    if entry == nil then return false end
+    L.alarms[id] = nil
+    L.alarm_heap:Remove(entry)
+    return true
+end
+
+
 -- Set up a new time based alarm, from md.
+-- Input is "id:delay", or "id:delay:period" for a repeating alarm.
 function L.Set_Alarm(_, id_time)
     if L.debug then
         DebugError("Time.Set_Alarm got: "..tostring(id_time))
@@ -330,31 +444,49 @@ function L.Set_Alarm(_, id_time)
     -- Split the input to separate id and time.
     local id, time = L.Split_String(id_time)
 
+    -- Check for an optional repeat period.
+    local period = nil
+    if string.find(time, ":") then
+        time, period = L.Split_String(time)
+        period = tonumber(period)
+    end
+
     -- Time should be a number; may have decimal.
     time = tonumber(time)
 
-    -- Schedule the alarm.
-    L.alarms[id] = GetCurRealTime() + time
+    -- Schedule the alarm; no callback, so md is signalled.
+    L.Schedule_Alarm(id, time, nil, period)
+end
 
-    -- Start polling if not already.
-    L.Start_Alarm_Polling()
+
+-- Cancel a time based alarm, from md.
+function L.MD_Cancel_Alarm(_, id)
+    L.Cancel_Alarm(id)
 end
 
 
 -- Lua callable, with lua callback, time based alarm.
-function E.Set_Alarm(id, time, callback)
-    -- Schedule the alarm.
-    L.alarms[id] = GetCurRealTime() + time
-    -- Record the callback.
-    L.alarm_callbacks[id] = callback
-    
-    -- Start polling if not already.
-    L.Start_Alarm_Polling()
+-- If period is given, the alarm repeats every period seconds until
+-- cancelled.
+function E.Set_Alarm(id, time, callback, period)
+    return L.Schedule_Alarm(id, time, callback, period)
+end
+
+
+-- Lua callable, cancel a time based alarm.
+function E.Cancel_Alarm(id)
+    return L.Cancel_Alarm(id)
 end
 
 
 -- Lua callable, alarm based on frame count.
-function E.Set_Frame_Alarm(id, frames, callback)
+-- If period_frames is given, the alarm repeats every that many frames
+-- until cancelled.
+function E.Set_Frame_Alarm(id, frames, callback, period_frames)
+    E.Cancel_Frame_Alarm(id)
+    if period_frames ~= nil and not (period_frames >= 1) then
+        period_frames = nil
+    end
 
     -- Schedule the alarm for some frames in the future.
     -- Note: New_Frame_Detector may have already run this frame, or may have
@@ -363,101 +495,145 @@ function E.Set_Frame_Alarm(id, frames, callback)
     -- will need to have an extra +1 offset. While it can be determined
     -- if it already ran, it cannot be determined if it will run.
     -- The solution: record the current real time, and frames remaining;
-    -- the polling loop will count down frames, but only once the original
-    -- time has passed (eg. not on the same frame as registered).
-    L.frame_alarms[id] = {GetCurRealTime(), frames}
+    -- the polling loop will start counting frames, but only once the
+    -- original time has passed (eg. not on the same frame as registered).
+    -- At that point the due frame is known, and the alarm moves into
+    -- the frame heap.
+    local entry = {
+        id         = id,
+        key        = nil,
+        callback   = callback,
+        period     = period_frames,
+        start_time = GetCurRealTime(),
+        frames     = math.max(1, frames),
+    }
+    L.frame_alarms[id] = entry
+    L.new_frame_alarms_count = L.new_frame_alarms_count + 1
+    L.new_frame_alarms[L.new_frame_alarms_count] = entry
 
-    -- Record the callback.
-    L.alarm_callbacks[id] = callback    
     -- Start polling if not already.
     L.Start_Alarm_Polling()
 end
 
 
+-- Lua callable, cancel a frame based alarm.
+function E.Cancel_Frame_Alarm(id)
+    local entry = L.frame_alarms[id]
+    if entry == nil then return false end
+    L.frame_alarms[id] = nil
+    -- Entries not yet in the heap are skipped when resolved.
+    entry.cancelled = true
+    L.frame_alarm_heap:Remove(entry)
+    return true
+end
+
+
+-- Move any new frame alarms into the frame heap, once time has advanced
+-- past the frame they were registered on.
+function L.Resolve_New_Frame_Alarms(now)
+    local list = L.new_frame_alarms
+    local count = L.new_frame_alarms_count
+    local kept = 0
+    for i = 1, count do
+        local entry = list[i]
+        list[i] = nil
+        if entry.cancelled then
+            -- Dropped.
+        elseif entry.start_time ~= now then
+            -- This frame is the first one counted.
+            entry.key = L.frame_count + entry.frames - 1
+            L.frame_alarm_heap:Push(entry)
+        else
+            -- Still on the registration frame; check again next frame.
+            kept = kept + 1
+            list[kept] = entry
+        end
+    end
+    L.new_frame_alarms_count = kept
+end
+
+
+-- Pop every heap entry due at or before the limit into the fired lists,
+-- rescheduling repeating entries. Entries stay registered until fired.
+-- Returns the new count of fired entries.
+function L.Collect_Due(heap, limit, count)
+    local fired = L.fired_entries
+    local fired_keys = L.fired_keys
+    local entry = heap:Peek()
+    while entry ~= nil and entry.key <= limit do
+        heap:Pop()
+        count = count + 1
+        fired[count] = entry
+        fired_keys[count] = entry.key
+
+        if entry.period ~= nil then
+            -- Keep the original phase, but never schedule into the past
+            -- (eg. after a long stall); at most one fire per poll.
+            local next_key = entry.key + entry.period
+            if next_key <= limit then
+                next_key = limit + entry.period
+            end
+            entry.key = next_key
+            heap:Push(entry)
+        end
+        entry = heap:Peek()
+    end
+    return count
+end
+
+
 -- Alarm polling, called once each frame while alarms are active,
 -- possibly skipping the first frame the first alarm was scheduled.
+-- When nothing is due, this is just a couple heap peeks.
 function L.Poll_For_Alarm()
     local now = GetCurRealTime()
 
-    -- List of ids who's alarms fired this check.
-    local ids_to_remove = {}
-    -- Flag to indicate there is an alarm that didn't fire yet.
-    local alarms_still_pending = false
-
-    -- Check all alarms for triggers.
-    for id, time in pairs(L.alarms) do
+    if L.new_frame_alarms_count > 0 then
+        L.Resolve_New_Frame_Alarms(now)
+    end
 
-        if now >= time then
-            -- Time reached.
+    -- Gather everything due before calling out, so that callbacks which
+    -- set new alarms don't get picked up in this same pass.
+    local time_count = L.Collect_Due(L.alarm_heap, now, 0)
+    local total_count = L.Collect_Due(L.frame_alarm_heap, L.frame_count, time_count)
+
+    local fired = L.fired_entries
+    local fired_keys = L.fired_keys
+    for i = 1, total_count do
+        local entry = fired[i]
+        local id = entry.id
+        fired[i] = nil
+        local ids = i <= time_count and L.alarms or L.frame_alarms
+        if ids[id] ~= entry then
+            -- Cancelled or replaced by an earlier callback of this pass.
+        elseif i <= time_count then
+            if entry.period == nil then ids[id] = nil end
             -- Send back the id and the time that was scheduled, not the
             -- current time, so that alarms can be chained to make clocks.
             -- Use a lua callback if known, else an MD signal.
-            if L.alarm_callbacks[id] ~= nil then
-                pcall(L.alarm_callbacks[id], id, time)
+            if entry.callback ~= nil then
+                pcall(entry.callback, id, fired_keys[i])
             else
-                L.Raise_Signal(id, time)
+                L.Raise_Signal(id, fired_keys[i])
             end
-
-            -- Note this id for list removal.
-            table.insert(ids_to_remove, id)
-
         else
-            -- Note the alarm didn't fire.
-            alarms_still_pending = true
-        end
-    end
-    -- Remove any alarms that fired.
-    for i, id in ipairs(ids_to_remove) do
-        L.alarms[id] = nil
-    end
-
-    -- Check all frame alarms.
-    ids_to_remove = {}
-    for id, alarm_data in pairs(L.frame_alarms) do
-
-        -- Unpack the alarm data.
-        local alarm_start_time, pending_frames = unpack(alarm_data)
-
-        -- If time has advanced since the alarm was set up, count down
-        -- a frame.
-        if alarm_start_time ~= now then
-
-            -- If this was the last frame, trigger the alarm.
-            if pending_frames == 1 then
-                -- Frame reached.
-                -- Send back the id only; frame count doesn't make sense.
-                -- Use a lua callback if known, else an MD signal.
-                if L.alarm_callbacks[id] ~= nil then
-                    pcall(L.alarm_callbacks[id], id)
-                else
-                    L.Raise_Signal(id)
-                end
-
-                -- Note this id for list removal.
-                table.insert(ids_to_remove, id)
-                
-                if L.debug then
-                    DebugError("Time Alarm triggered: "..tostring(id))
-                end
+            if entry.period == nil then ids[id] = nil end
+            -- Send back the id only; frame count doesn't make sense.
+            if entry.callback ~= nil then
+                pcall(entry.callback, id)
             else
-                -- Otherwise count down the frames.
-                alarm_data[2] = alarm_data[2] - 1
-                -- Note the alarm didn't fire.
-                alarms_still_pending = true
+                L.Raise_Signal(id)
+            end
+            if L.debug then
+                DebugError("Time Alarm triggered: "..tostring(id))
             end
-        else
-            -- Note the alarm didn't fire.
-            alarms_still_pending = true
         end
     end
-    -- Remove any alarms that fired.
-    for i, id in ipairs(ids_to_remove) do
-        L.frame_alarms[id] = nil
-    end
-
 
     -- If no alarms remaining, stop polling.
-    if not alarms_still_pending then
+    if L.alarm_heap:Is_Empty()
+    and L.frame_alarm_heap:Is_Empty()
+    and L.new_frame_alarms_count == 0 then
         --RemoveScript("onUpdate", L.Poll_For_Alarm)
         E.Unregister_NewFrame_Callback(L.Poll_For_Alarm)
         L.checking_alarms = false
@@ -500,48 +676,302 @@ function L.New_Frame_Detector()
 
     -- Update recorded time.
     L.last_frame_time = now
+    L.frame_count = L.frame_count + 1
 
     -- Signal MD listeners, returning time for convenience.
     L.Raise_Signal("Frame_Advanced", now)
 
     -- Handle any callback functions.
-    for i, callback in ipairs(L.frame_callbacks) do
-        success, message = pcall(callback, now)
-        if not success then
-            DebugError("Frame Callback function error: "..tostring(message))
+    L.Run_Frame_Callbacks(now)
+end
+
+
+------------------------------------------------------------------------------
+-- Frame callback registry.
+--[[
+    Each registered callback gets a record, which doubles as the handle
+    returned to the user:
+        {callback, priority, name, order, removed,
+         calls, total_time, frame_time, max_time}
+    Records are kept in a list sorted by (priority, order).
+
+    Removal just flags the record (O(1)); flagged records are skipped, and
+    swept out of the list after the next dispatch.
+    Adding appends to the list (O(1)) when the priority sorts last, which
+    is the normal case; otherwise the list is re-sorted once before the
+    next dispatch. Adds made while dispatching are held until the
+    dispatch finishes, so they first run on the following frame.
+]]
+
+-- High resolution clock, in seconds, for callback cost accounting.
+-- GetCurRealTime only updates once per frame, so it cannot time
+-- individual callbacks. Prefer the windows performance counter through
+-- ffi, falling back to os.clock, and lastly the engine time.
+function L.Init_Precise_Clock()
+    local success, ffi = pcall(require, "ffi")
+    if success and type(ffi) == "table" then
+        -- May error if another module already declared these.
+        pcall(ffi.cdef, [[
+            int QueryPerformanceCounter(int64_t* lpPerformanceCount);
+            int QueryPerformanceFrequency(int64_t* lpFrequency);
+        ]])
+        local counter = nil
+        local success, clock = pcall(function()
+            counter = ffi.new("int64_t[1]")
+            ffi.C.QueryPerformanceFrequency(counter)
+            local period = 1 / tonumber(counter[0])
+            return function()
+                ffi.C.QueryPerformanceCounter(counter)
+                return tonumber(counter[0]) * period
+            end
+        end)
+        if success then
+            return clock
+        end
+    end
+    if os ~= nil and os.clock ~= nil then
+        return os.clock
+    end
+    return GetCurRealTime
+end
+L.precise_clock = L.Init_Precise_Clock()
+
+-- Lua callable, current time of the high resolution clock, in seconds.
+function E.Get_Precise_Time()
+    return L.precise_clock()
+end
+
+
+-- Derive a readable name for a callback without one.
+function L.Callback_Name(callback)
+    if debug ~= nil and debug.getinfo ~= nil then
+        local success, info = pcall(debug.getinfo, callback, "S")
+        if success and info and info.short_src then
+            return info.short_src..":"..tostring(info.linedefined)
+        end
+    end
+    return tostring(callback)
+end
+
+
+-- Bring the callback list up to date: drop removed records, append
+-- adds held during dispatch, and re-sort if needed.
+function L.Apply_Callback_Changes()
+    local list = L.frame_callbacks
+
+    if L.callbacks_removed > 0 then
+        local kept = 0
+        for i = 1, #list do
+            local record = list[i]
+            list[i] = nil
+            if not record.removed then
+                kept = kept + 1
+                list[kept] = record
+            end
+        end
+        L.callbacks_removed = 0
+    end
+
+    local pending = L.pending_callbacks
+    for i = 1, #pending do
+        local record = pending[i]
+        pending[i] = nil
+        if not record.removed then
+            L.Insert_Callback_Record(record)
+        end
+    end
+
+    if L.callbacks_need_sort then
+        table.sort(list, function(a, b)
+            if a.priority ~= b.priority then
+                return a.priority < b.priority
+            end
+            return a.order < b.order
+        end)
+        L.callbacks_need_sort = false
+    end
+end
+
+
+-- Append a record to the callback list, flagging a sort if it doesn't
+-- belong at the end.
+function L.Insert_Callback_Record(record)
+    local list = L.frame_callbacks
+    local last = list[#list]
+    if last ~= nil and last.priority > record.priority then
+        L.callbacks_need_sort = true
+    end
+    list[#list + 1] = record
+end
+
+
+-- Call every registered callback, in priority order.
+function L.Run_Frame_Callbacks(now)
+    if L.callbacks_need_sort then
+        L.Apply_Callback_Changes()
+    end
+
+    L.dispatching_callbacks = true
+    local list = L.frame_callbacks
+    local profile = L.profile_callbacks
+    local clock = L.precise_clock
+    local frame_total = 0
+
+    for i = 1, #list do
+        local record = list[i]
+        -- Skip callbacks removed earlier this frame.
+        if not record.removed then
+            local start
+            if profile then start = clock() end
+
+            local success, message = pcall(record.callback, now)
+            if not success then
+                DebugError("Frame Callback function error ("..record.name.."): "..tostring(message))
+            end
+
+            if profile then
+                local elapsed = clock() - start
+                record.calls = record.calls + 1
+                record.frame_time = elapsed
+                record.total_time = record.total_time + elapsed
+                if elapsed > record.max_time then
+                    record.max_time = elapsed
+                end
+                frame_total = frame_total + elapsed
+            end
         end
     end
+    L.dispatching_callbacks = false
+    L.callbacks_frame_time = frame_total
+
+    if L.callbacks_removed > 0 or #L.pending_callbacks > 0 then
+        L.Apply_Callback_Changes()
+    end
 end
 
+
 -- Lua api function for users to register a callback function.
-function E.Register_NewFrame_Callback(callback)
+-- Optional priority: lower values run earlier in the frame; default 0.
+-- Optional name, used in cost reports.
+-- Returns a handle which can be given to Unregister_NewFrame_Callback.
+function E.Register_NewFrame_Callback(callback, priority, name)
     if type(callback) ~= "function" then
         DebugError("Register_Frame_Callback got a non-function: "..type(callback))
         return
     end
-    -- Ignore if already registered.
-    for index, value in ipairs(L.frame_callbacks) do
-        if value == callback then
-            return
-        end
+    -- Ignore if already registered; return the existing handle.
+    local record = L.callback_records[callback]
+    if record ~= nil then
+        return record
     end
-    table.insert(L.frame_callbacks, callback)
+
+    L.callback_count = L.callback_count + 1
+    record = {
+        callback   = callback,
+        priority   = priority or 0,
+        name       = name or L.Callback_Name(callback),
+        order      = L.callback_count,
+        removed    = false,
+        calls      = 0,
+        total_time = 0,
+        frame_time = 0,
+        max_time   = 0,
+    }
+    L.callback_records[callback] = record
+
+    if L.dispatching_callbacks then
+        table.insert(L.pending_callbacks, record)
+    else
+        L.Insert_Callback_Record(record)
+    end
+    return record
 end
 
 -- Lua api function to remove a frame callback.
+-- Accepts either the callback function or the handle from registering.
 function E.Unregister_NewFrame_Callback(callback)
-    if type(callback) ~= "function" then
-        DebugError("Register_Frame_Callback got a non-function: "..type(callback))
+    local record
+    if type(callback) == "function" then
+        record = L.callback_records[callback]
+    elseif type(callback) == "table" and callback.callback ~= nil then
+        record = callback
+    else
+        DebugError("Unregister_Frame_Callback got a non-function: "..type(callback))
+        return
+    end
+    if record == nil or record.removed then
         return
     end
-    -- Search for it and remove.
-    for index, value in ipairs(L.frame_callbacks) do
-        if value == callback then
-            -- This will edit the table directly, so don't keep looping.
-            table.remove(L.frame_callbacks, index)
-            break
+
+    record.removed = true
+    if L.callback_records[record.callback] == record then
+        L.callback_records[record.callback] = nil
+    end
+    -- The record is swept out of the list after the next dispatch.
+    L.callbacks_removed = L.callbacks_removed + 1
+end
+
+
+-- Enable or disable per-callback cost accounting. Costs two clock
+-- reads per callback per frame while enabled.
+function E.Set_Frame_Callback_Profiling(enabled)
+    L.profile_callbacks = enabled and true or false
+end
+
+
+-- Returns a list of callback cost entries, most expensive last frame
+-- first, each a table of:
+--   {name, priority, calls, frame_time, total_time, max_time}
+-- Times are in seconds. Optional top limits the list length.
+-- The second return is the summed callback time of the last frame.
+function E.Get_Frame_Callback_Report(top)
+    local report = {}
+    for _, record in ipairs(L.frame_callbacks) do
+        if not record.removed then
+            table.insert(report, {
+                name       = record.name,
+                priority   = record.priority,
+                calls      = record.calls,
+                frame_time = record.frame_time,
+                total_time = record.total_time,
+                max_time   = record.max_time,
+            })
+        end
+    end
+    table.sort(report, function(a, b) return a.frame_time > b.frame_time end)
+    if top ~= nil then
+        for i = #report, top + 1, -1 do
+            report[i] = nil
         end
     end
+    return report, L.callbacks_frame_time
+end
+
+
+-- Print the callback cost report to the debug log, from md.
+-- Param is an optional count of entries to print.
+function L.Print_Callback_Report(_, top)
+    if not L.profile_callbacks then
+        DebugError("Time: frame callback profiling is off; enable with Time.profileCallbacks")
+    end
+    local report, frame_total = E.Get_Frame_Callback_Report(tonumber(top))
+    local lines = {string.format(
+        "Frame callbacks: %d, last frame total: %.3f ms",
+        #report, frame_total * 1000)}
+    for i, entry in ipairs(report) do
+        table.insert(lines, string.format(
+            "  %2d: %8.3f ms last, %8.3f ms max, %10.3f ms total, %6d calls, prio %s: %s",
+            i, entry.frame_time * 1000, entry.max_time * 1000,
+            entry.total_time * 1000, entry.calls,
+            tostring(entry.priority), entry.name))
+    end
+    DebugError(table.concat(lines, "\n"))
+end
+
+
+-- Turn profiling on or off from md; param 1/0.
+function L.MD_Profile_Callbacks(_, enabled)
+    E.Set_Frame_Callback_Profiling(enabled ~= 0 and enabled ~= false)
 end
 
 return E,Init
@@ -4,24 +4,43 @@ Python pipe interface functions.
 Split into a separate file so that the pipe api can import the general
 frame update functions, and this can import the pipe api, without
 an import loop.
+
+Commands are stamped with the performance counter when md raises them,
+collected over the frame, and sent as one pipe message at the next
+frame, so timings don't include any pipe or frame delay and a frame of
+many tic/toc calls costs a single write. Replies come back through the
+md Time_API server reader, also batched, and are split here into one
+ui event per id.
 ]]
 
--- TODO: conditionally include pipes api. For now hardcode.
-local pipes_api = require("extensions.sn_mod_support_apis.ui.time.Interface")
+local Time = require("extensions.sn_mod_support_apis.ui.time.Interface")
+local Pipes = require("extensions.sn_mod_support_apis.ui.named_pipes.Pipes")
 
 -- Table of local functions and data.
 local L = {
     debug = false,
     -- Name of the pipe for higher precision timing.
     pipe_name = 'x4_time',
+    -- Commands waiting for the next flush, and their count.
+    batch = {},
+    batch_count = 0,
+    -- Frame alarm id used to flush the batch.
+    flush_alarm_id = "pipe_time_flush",
+    -- If md was asked to start its pipe reader.
+    reader_requested = false,
     }
-    
+
 
 function Init()
-    -- Pipe interfacing functions.    
-    RegisterEvent("Time.getSystemTime", L.Get_System_Time)
-    RegisterEvent("Time.tic"          , L.Tic)
-    RegisterEvent("Time.toc"          , L.Toc)
+    -- Pipe interfacing functions.
+    RegisterEvent("Time.getSystemTime"   , L.Get_System_Time)
+    RegisterEvent("Time.tic"             , L.Tic)
+    RegisterEvent("Time.toc"             , L.Toc)
+    RegisterEvent("Time.getTimerStats"   , L.Get_Timer_Stats)
+    RegisterEvent("Time.resetTimerStats" , L.Reset_Timer_Stats)
+    RegisterEvent("Time.printTimerStats" , L.Print_Timer_Stats)
+    -- Replies from python, passed on by md.
+    RegisterEvent("Time.Process_Pipe_Reply", L.Process_Pipe_Reply)
 end
 
 -- Raise an event for md to capture.
@@ -30,55 +49,94 @@ function L.Raise_Signal(name, return_value)
 end
 
 
-function L.Get_System_Time(_, id)
-    -- Send a request to the pipe api. Optimistically assume the server
-    -- is running. Ignore result.
-    pipes_api.Schedule_Write(L.pipe_name, nil, 'get')
-
-    -- Read the response, providing a callback function.
-    pipes_api.Schedule_Read(
-        L.pipe_name, 
-        function(message)
-            -- Punt on errors for now.
-            if message ~= 'ERROR' then
+-- Queue a command for the next flush, stamped with the current time.
+-- Commands are "<command>:<stamp>:<id>"; ids go last, so may hold
+-- colons, but not semicolons (the batch separator).
+function L.Queue(command, id, stamp)
+    if stamp then
+        stamp = string.format("%.9f", Time.Get_Precise_Time())
+    else
+        stamp = ""
+    end
+    L.batch_count = L.batch_count + 1
+    L.batch[L.batch_count] = command..":"..stamp..":"..tostring(id or "")
+
+    if L.batch_count == 1 then
+        -- The md reader loop runs only once timing is in use.
+        if not L.reader_requested then
+            L.reader_requested = true
+            L.Raise_Signal("Start_Pipe_Reader")
+        end
+        Time.Set_Frame_Alarm(L.flush_alarm_id, 1, L.Flush)
+    end
+end
+
+-- Send all queued commands as one message.
+function L.Flush()
+    local message = table.concat(L.batch, ";", 1, L.batch_count)
+    L.batch = {}
+    L.batch_count = 0
+    if L.debug then
+        DebugError("Pipe_Time sending: "..message)
+    end
+    -- Optimistically assume the server is running. Ignore result.
+    Pipes.Schedule_Write(L.pipe_name, "time_batch", message)
+end
+
+
+-- Handle a batched reply: "<command>:<id>:<value>" separated by ';'.
+function L.Process_Pipe_Reply(_, message)
+    if message == nil or message == "ERROR" then
+        DebugError("Time pipe read failed; pipe not connected.")
+        return
+    end
+    for reply in string.gmatch(message, "[^;]+") do
+        local command, id, value = string.match(reply, "^(%a+):(.*):([^:]*)$")
+        if command == nil then
+            DebugError("Time pipe reply not understood: "..reply)
+        else
+            if command == "toc" then
                 -- Put the time in the log.
-                DebugError(string.format("Request id '%s' system time: %f seconds", id, message))
-                -- Return to md.
-                L.Raise_Signal(id, message)
-            else
-                DebugError("Time.Get_System_Time failed; pipe not connected.")
+                DebugError(string.format("Toc id '%s': %f seconds", id, tonumber(value) or 0))
+            elseif L.debug then
+                DebugError(string.format("Request id '%s' %s: %s", id, command, value))
             end
+            -- Return to md.
+            L.Raise_Signal(id, value)
         end
-        )
+    end
+end
+
+
+function L.Get_System_Time(_, id)
+    -- Uses the server time on arrival, so no stamp.
+    L.Queue("get", id, false)
 end
 
 
 function L.Tic(_, id)
-    -- Send a request to the pipe api.
-    pipes_api.Schedule_Write(L.pipe_name, nil, 'tic')
+    L.Queue("tic", id, true)
 end
 
 
 function L.Toc(_, id)
-    -- Send a request to the pipe api.
-    pipes_api.Schedule_Write(L.pipe_name, nil, 'toc')
-    
-    -- Read the response, providing a callback function.
-    pipes_api.Schedule_Read(
-        L.pipe_name, 
-        function(message)
-            -- Punt on errors for now.
-            if message ~= 'ERROR' then
-                -- Put the time in the log.
-                DebugError(string.format("Toc id '%s': %f seconds", id, message))
-                -- Return to md.
-                L.Raise_Signal(id, message)
-            else
-                DebugError("Time.Toc failed; pipe not connected.")
-            end
-        end
-        )
+    L.Queue("toc", id, true)
+end
+
+
+function L.Get_Timer_Stats(_, id)
+    L.Queue("stats", id, false)
+end
+
+
+function L.Reset_Timer_Stats(_, id)
+    L.Queue("reset", id, false)
+end
+
+
+function L.Print_Timer_Stats()
+    L.Queue("print", "", false)
 end
 
 return nil,Init
-end)
\ No newline at end of file
+end)
@@ -8,6 +8,15 @@ Lua_Loader.define("extensions.sn_mod_support_apis.ui.userdata.Interface",functio
 
     A reference to this user data will be stored in a player blackboard var,
     for convenient access from md.
+
+    Syncing between the two copies is batched:
+    - MD writes its blackboard copy directly, and posts each owner/key
+      change (with its value) through a command bridge. All changes
+      posted in a frame are applied here in one pass, on the first signal.
+    - Lua writes mark the userdata dirty, and the whole table is copied
+      to the blackboard once at the next frame, however many keys were
+      written. Pending md changes are applied first, so the copy never
+      drops md writes lua hasn't seen yet.
 ]]
 -- Set up any used ffi functions.
 local ffi = require("ffi")
@@ -21,10 +30,20 @@ ffi.cdef[[
 __MOD_USERDATA = __MOD_USERDATA or {}
 
 local Lib = require("extensions.sn_mod_support_apis.ui.Library")
+local Time = require("extensions.sn_mod_support_apis.ui.time.Interface")
+local Command_Bridge = require("extensions.sn_mod_support_apis.ui.Command_Bridge")
 
 -- Local functions/data.
 local L = {
     player_id = nil,
+
+    -- Command_Bridge holding md updates not yet applied.
+    bridge = nil,
+
+    -- If lua wrote userdata since the last blackboard flush.
+    dirty = false,
+    -- Frame alarm id used to flush lua writes.
+    flush_alarm_id = "userdata_flush",
 }
 
 function L.Init()
@@ -48,43 +67,74 @@ function L.Init()
             __MOD_USERDATA = md_userdata
         end
     end
+    -- Apply any md updates posted before the reload that lua missed,
+    -- ahead of copying back over the blackboard.
+    L.bridge:Dispatch(player_id)
     --DebugError("Copying __MOD_USERDATA to player blackboard")
     SetNPCBlackboard(player_id, "$__MOD_USERDATA", __MOD_USERDATA)
 
-    -- Listen for md Userdata update signal.
-    RegisterEvent("Userdata.Update", L.Userdata_Update)
+    -- Listen for md Userdata update signals.
+    RegisterEvent("Userdata.Process_Command", L.Handle_Process_Command)
 
     -- Signal md that userdata is ready.
     AddUITriggeredEvent("Userdata", "Ready")
 end
 
--- Updates requested by md will be done in two calls for param passing,
--- first call passing owner, second passing key (or nil).
--- This will trigger the matching entry in the blackboard var to be copied
--- over to the userdata (a safe way to update without impacting other
--- tables that lua may be using).
-local owner
-function L.Userdata_Update(_, param)
-    -- First call stores owner.
-    if owner == nil then
-        owner = param
-    else
-        -- Second call gets key.
-        local key = param
-        -- Look up the data from the blackboard.
-        local md_userdata = GetNPCBlackboard(L.player_id, "$__MOD_USERDATA")
-        --DebugError("Attempting to update from md userdata["..tostring(owner).."]["..tostring(key).."]")
-        local value = md_userdata[owner]
-        if key ~= nil then
-            value = value[key]
+
+-- Apply all updates md has posted.
+-- Later signals from the same md burst find nothing pending.
+function L.Handle_Process_Command(_, param)
+    L.bridge:Dispatch(L.player_id)
+end
+
+-- Handlers for md commands, keyed by command name.
+L.commands = {}
+
+-- Copy an md change to the local version. The value comes with the
+-- args, so the blackboard copy isn't read back.
+-- Args: owner, optional key, value (nil to remove).
+function L.commands.Update(args)
+    --DebugError("Updating from md userdata["..tostring(args.owner).."]["..tostring(args.key).."]")
+    L.Set_Value(args.owner, args.key, args.value)
+end
+
+function L.Unknown_Command(args)
+    DebugError("Userdata API: Unrecognized command: "..tostring(args.command))
+end
+
+-- Reader for "$userdata_args".
+L.bridge = Command_Bridge.new({
+    name           = "Userdata API",
+    blackboard_var = "$userdata_args",
+    commands       = L.commands,
+    fallback       = L.Unknown_Command,
+})
+
+
+-- Write a value into the local userdata, without any md sync.
+-- If the key is nil, the value replaces the owner entry.
+function L.Set_Value(owner, key, value)
+    -- TODO: validate string owner/key (or nil key).
+    if key ~= nil then
+        -- Init an owner table if not yet present.
+        if __MOD_USERDATA[owner] == nil then
+            __MOD_USERDATA[owner] = {}
         end
-        -- Write to the local version.
-        L.Write_Userdata(owner, key, value)
-        -- Clear the owner arg.
-        owner = nil
+        __MOD_USERDATA[owner][key] = value
+    else
+        __MOD_USERDATA[owner] = value
     end
 end
 
+-- Copy lua writes to the md blackboard, once per frame with writes.
+function L.Flush()
+    if not L.dirty then return end
+    -- Apply md writes still pending, so they aren't overwritten.
+    L.bridge:Dispatch(L.player_id)
+    SetNPCBlackboard(L.player_id, "$__MOD_USERDATA", __MOD_USERDATA)
+    L.dirty = false
+end
+
 -- Function for reading user data that was saved.
 -- Arg1: owner name (string), unique to a given modder/mod.
 -- Arg2: optional key (string or number), a subfield to access in the owner table.
@@ -111,20 +161,14 @@ end
 -- Arg2: key (string or number), a subfield to access in the owner table.
 -- Arg3 (or arg2 with no key): value to be written.
 -- If the value is nil, the key (or owner) entry will be removed.
+-- The md copy is updated at the next frame, together with any other
+-- writes made this frame.
 function L.Write_Userdata(owner, key, value)
-    -- TODO: validate string owner/key (or nil key).
-    if key ~= nil then
-        -- Init an owner table if not yet present.
-        if __MOD_USERDATA[owner] == nil then
-            __MOD_USERDATA[owner] = {}
-        end
-        __MOD_USERDATA[owner][key] = value
-    else
-        __MOD_USERDATA[owner] = value
+    L.Set_Value(owner, key, value)
+    if not L.dirty then
+        L.dirty = true
+        Time.Set_Frame_Alarm(L.flush_alarm_id, 1, L.Flush)
     end
-    -- TODO: maybe update the blackboard with these changes, if lua and md
-    -- will support sharing the same fields. For now assume they are separate.
-    --SetNPCBlackboard(L.player_id, "$__MOD_USERDATA", __MOD_USERDATA)
 end
 
 local exports = {
@@ -7,14 +7,26 @@ The X4 Customizer is assumed to be 3 directories up in a X4_Customizer folder.
 To tune behavior, see settings.json.
 '''
 
+import os
+import re
 import sys
+import json
+import hashlib
+import multiprocessing
+from concurrent.futures import ProcessPoolExecutor
+from concurrent.futures.process import BrokenProcessPool
 from lxml import etree
-from lxml.etree import Element
 from pathlib import Path
 import configparser
 this_file = Path(__file__).resolve()
 this_dir = this_file.parent
 
+# Per-file annotation lives in its own module, importable by workers.
+if str(this_dir) not in sys.path:
+    sys.path.append(str(this_dir))
+import Script_Annotation
+from Script_Annotation import Annotate_Text, time_format
+
 # When run directly, set up the customizer import.
 if __name__ == '__main__':
     # Set up the customizer import.
@@ -28,8 +40,25 @@ if __name__ == '__main__':
 from Plugins import *
 from Framework import Transform_Wrapper, Load_File, Load_Files
 
-# The systime print format to use.
-time_format = '%Y-%j-%H-%M-%S'
+# Interned timestamp events, keyed by (section_name, location_name,
+# path_bound), holding the integer id the scripts send to lua.
+# Ids start at 1, in order of annotation.
+event_ids = {}
+# Keys of event_ids, by id - 1.
+event_keys = []
+
+# Lua path bound codes.
+bound_codes = {'entry': 1, 'mid': 2, 'exit': 3}
+
+# Events per string in the generated event table, to keep each string
+# constant modest.
+event_table_chunk_size = 1000
+
+# Annotated scripts from earlier runs, reused for unchanged scripts.
+annotation_cache_dir = this_dir / 'annotation_cache'
+
+# Matches the event id in an annotated raise_lua_event param.
+event_param_re = re.compile(r'''(name="'Script_Profiler\.Record_Event'"\s+param="')(\d+),''')
 
 
 def Run():
@@ -53,6 +82,19 @@ def Run():
     if config['General']['x4_path']:
         Settings(path_to_x4_folder = config['General']['x4_path'])
 
+    # Start ids over for this run.
+    event_ids.clear()
+    event_keys.clear()
+
+    # Annotation workers; 0 for one per cpu. A frozen customizer exe
+    # can't start python workers, so annotates in process.
+    workers = config['General'].getint('annotation_workers', fallback = 0) or os.cpu_count() or 1
+    if getattr(sys, 'frozen', False):
+        workers = 1
+    cache = None
+    if config['General'].getboolean('annotation_cache', fallback = True):
+        cache = Annotation_Cache(annotation_cache_dir)
+
     # Evaluate the patterns to collect all files.
     game_files = []
     for field, pattern in config['Scripts'].items():
@@ -80,8 +122,13 @@ def Run():
             md_files.append(file)
             
     # Hand off to helper functions.
-    Annotate_Scripts(ai_files, style = 'ai')
-    Annotate_Scripts(md_files, style = 'md')
+    Annotate_Scripts(ai_files, style = 'ai', workers = workers, cache = cache)
+    Annotate_Scripts(md_files, style = 'md', workers = workers, cache = cache)
+    if cache:
+        cache.Prune()
+
+    # Lua needs the table matching the ids in the annotated scripts.
+    Write_Event_Table()
 
     # Ensure any extensions being modified are set as dependencies.
     Update_Content_XML_Dependencies()
@@ -89,297 +136,162 @@ def Run():
     return
 
 
-def Get_First_Source_Line(node):
-    'Returns a sourceline int, or empty string, the first for a node.'
-    return node.sourceline if node.sourceline else ''
-
-def Get_Last_Source_Line(node):
+def Intern_Event(section_name, location_name, path_bound):
     '''
-    Returns a sourceline int, or empty string, the last for a node or children.
-    This will handle, eg. do_all nodes with many children.
+    Returns the integer id for a timestamp event, assigning the next id
+    if the event is new.
     '''
-    sourceline = None
-    for subnode in node.iter():
-        if subnode.sourceline and (not sourceline or subnode.sourceline > sourceline):
-            sourceline = subnode.sourceline
-    return str(sourceline) if sourceline else ''
-
-
-def Insert_Timestamp(
-        section_name,
-        location_name,
-        path_bound,
-        node,
-        op,
-    ):
+    key = (section_name, location_name, path_bound)
+    event_id = event_ids.get(key)
+    if event_id == None:
+        event_keys.append(key)
+        event_id = event_ids[key] = len(event_keys)
+    return event_id
+
+
+def Write_Event_Table():
     '''
-    Inserts a new timestamp node, a raise_lua_event sending player.systemtime.
-
-    * section_name
-      - String declaring the file and possibly the section of interest.
-      - Time deltas for paths will only be collected in matching section_names.
-      - The section shouldn't have un-annotated entry or exit points, except
-        to immediately evaluated subfunctions (libs).
-    * location_name
-      - Descriptive name of the location, typically including line number.
-    * path_bound 
-      - One of "entry"/"mid"/"exit", based on if this is known to start
-        or exit a section, with mid points optional.
-    * node
-      - Element to act as the base for the annocation insertion.
-    * op
-      - One of "before"/"after"/"firstchild"/"lastchild", where to insert
-        the annotation.
-    * new_node
-      - Created new node, inserted, provided for any debug reference.
+    Write ui/Event_Table.lua, giving lua the section, path_bound and
+    location of each event id. Sections are listed once; events are packed
+    into long strings of "{section index} {bound code} {location}" lines,
+    unpacked by Script_Profiler.lua at load.
     '''
-    # Signal lua, appending the time of the event.
-    new_node = etree.fromstring(f''' <raise_lua_event 
-        name  = "'Script_Profiler.Record_Event'"
-        param = "'{section_name},{location_name},{path_bound},' + player.systemtime.{{'{time_format}'}} "
-        />''')
-
-    # Handle insertion.
-    if op == 'before':
-        node.addprevious(new_node)
-    elif op == 'after':
-        node.addnext(new_node)
-        # addnext moves the tail, and hence node_id; fix it here.
-        if new_node.tail != None:
-            node.tail = new_node.tail
-            new_node.tail = None
-    elif op == 'firstchild':
-        node.insert(0, new_node)
-    elif op == 'lastchild':
-        node.append(new_node)
-    assert new_node.tail == None
+    section_ids = {}
+    lines = []
+    for (section_name, location_name, path_bound) in event_keys:
+        if section_name not in section_ids:
+            section_ids[section_name] = len(section_ids) + 1
+        lines.append(f'{section_ids[section_name]} {bound_codes[path_bound]} {location_name}\n')
+
+    text = ['Lua_Loader.define("extensions.sn_script_profiler.ui.Event_Table",function(require)',
+            '--[[',
+            'Generated by Modify_Scripts.py; ids match the annotated scripts.',
+            ']]',
+            'return {',
+            '    sections = {',
+            ]
+    for section_name in section_ids:
+        text.append(f'        "{section_name}",')
+    text.append('    },')
+    text.append('    events = {')
+    for start in range(0, len(lines), event_table_chunk_size):
+        text.append('[=[')
+        text.append(''.join(lines[start : start + event_table_chunk_size]) + ']=],')
+    text.append('    },')
+    text.append('}')
+    text.append('end)')
+
+    with open(this_dir / 'ui' / 'Event_Table.lua', 'w') as file:
+        file.write('\n'.join(text) + '\n')
     return
 
 
-def Get_MD_Block_Name(node):
+class Annotation_Cache:
+    '''
+    Annotated scripts from earlier runs, one json file per cache key.
+    Entries not used by a run are deleted by Prune() at its end.
+
+    * folder
+      - Path of the cache folder.
+    * used
+      - Set of keys read or written this run.
+    '''
+    # Annotation code, so that changes to it invalidate old entries.
+    version = hashlib.sha256(Path(Script_Annotation.__file__).read_bytes()).hexdigest()
+
+    def __init__(self, folder):
+        self.folder = folder
+        self.used = set()
+        self.folder.mkdir(exist_ok = True)
+
+    def Key(self, *fields):
+        '''
+        Returns the cache key of an annotation's inputs.
+        '''
+        return hashlib.sha256(json.dumps([self.version, *fields]).encode()).hexdigest()
+
+    def Get(self, key):
+        '''
+        Returns the cached (annotated text, event keys), or None.
+        '''
+        try:
+            entry = json.loads((self.folder / f'{key}.json').read_text(encoding = 'utf-8'))
+        except (OSError, ValueError):
+            return None
+        self.used.add(key)
+        return entry['text'], [tuple(x) for x in entry['keys']]
+
+    def Put(self, key, text, keys):
+        self.used.add(key)
+        (self.folder / f'{key}.json').write_text(json.dumps({'text': text, 'keys': keys}), encoding = 'utf-8')
+
+    def Prune(self):
+        for path in self.folder.glob('*.json'):
+            if path.stem not in self.used:
+                path.unlink()
+
+
+def Annotate_All(jobs, workers):
     '''
-    For md xml nodes, return their parent cue or lib name.
+    Returns Annotate_Text results for a list of its argument tuples, in
+    order. Spreads them across worker processes when there are several,
+    falling back to annotating here if the pool can't run.
+
+    Workers are always spawned (the only option on windows), so other
+    platforms run the same path. Spawned workers import this script as
+    __mp_main__, which is why Run() is skipped in child processes.
     '''
-    # Search parents upward until a match.
-    test_node = node.getparent()
-    while 1:
-        if test_node.tag in ['cue', 'library']:
-            return test_node.get('name')
-        test_node = test_node.getparent()
-        if test_node == None:
-            return ''
+    if workers > 1 and len(jobs) > 1:
+        try:
+            with ProcessPoolExecutor(max_workers = min(workers, len(jobs)),
+                                     mp_context = multiprocessing.get_context('spawn')) as pool:
+                return list(pool.map(Annotate_Text, *zip(*jobs),
+                                     chunksize = max(1, len(jobs) // (workers * 4))))
+        except (BrokenProcessPool, OSError) as ex:
+            print(f'Annotation workers failed ({ex}); annotating in process.')
+    return [Annotate_Text(*job) for job in jobs]
 
 
 @Transform_Wrapper()
-def Annotate_Scripts(files, style):
+def Annotate_Scripts(files, style, workers = 1, cache = None):
     '''
-    For every ai script, add timestamps at entry, exit, and blocking nodes.
+    Add profiling timestamps to md or ai scripts (see
+    Script_Annotation.Annotate_Root), renumbering the file-local event
+    ids into the global ids of this run.
 
-    Note: while libraries can potentially be called directly without the
-    caller being full interrupted, they will be treated as fully separate
-    blocks, since ai libraries may have blocking actions and not return
-    right away, and md libraries may be used as cue templates and not
-    just as include_actions calls.
+    Scripts whose text, line numbers and annotation code match an
+    Annotation_Cache entry reuse it; the rest are annotated across
+    worker processes.
     '''
-    # All normal blocking nodes (return to this script when done), and
-    # places where scope moves to a different action block with its
-    # own start/end.
-    # These will get wrapped with an exit point before, entry point after.
-    if style == 'ai':
-        interrupts = [
-            # Blocking actions (explicitly tagged)
-            'dock_masstraffic_drone',
-            'execute_custom_trade',
-            'execute_trade',
-            'move_approach_path',
-            'move_docking',
-            'move_undocking',
-            'move_gate',
-            'move_navmesh',
-            'move_strafe',
-            'move_target_points',
-            'move_waypoints',
-            'move_to',
-            'detach_from_masstraffic',
-            'run_script',
-            'run_order_script',
-            'wait_for_prev_script',
-            'wait',
-
-            # The following are not tagged as blocking, but do cause control
-            # flow change or similar.
-            # Created orders appear to run right away.
-            'create_order',
-            # May not block, but starts a new action block.
-            'include_interrupt_actions',
-            'run_interrupt_script',
-            # This command suggests it will exit an interrupt block to
-            # go to a label. Unclear in documentation, but it may have a
-            # delay before continuing at the label, so treat as blocking.
-            'abort_called_scripts',
-            # Since labels can be jumped to, possible after a delay from
-            # abort_called_scripts, can be extra safe by treating all labels
-            # as potential entry points (and hence set as exit points for
-            # the prior path).
-            'label',
-            # This means resumes also need to be treated as path endpoints.
-            'resume',
-        ]
-    else:
-        # TODO: alternative to sticking endpoints on these, instead set a
-        # global flag that suppresses path start/end in the callees.
-        interrupts = [
-            'include_actions',
-            'run_actions',
-            'signal_cue_instantly',
-            # Signalling objects will also instantly activate cues listening
-            # to that object being signalled.
-            'signal_objects',
-            ]
-        
+    # Snapshot every script as text, with its original line numbers.
+    jobs = []
     for game_file in files:
         xml_root = game_file.Get_Root()
         file_name = game_file.name.replace('.xml','')
-
-        for tag in interrupts:
-            nodes = xml_root.xpath(".//{}".format(tag))
-            if not nodes:
-                continue
-
-            # All of these nodes need timestamps on both sides.
-            for node in nodes:
-
-                # Pick out the entry/exit lines for annotation.
-                # (Do these nodes even have children?  Maybe; be safe.)
-                first_line = Get_First_Source_Line(node)
-                last_line  = Get_Last_Source_Line(node)
-
-                # Note: if this node is inside a do_any block, cannot easily
-                # slot in timestamps. Either timestampe the parent do_any,
-                # which can lead to other do_any children going unmeasured, or
-                # nest this node in a do_all, transfer any weight property
-                # to the do_all, and put the timestamping inside the do_all.
-                if node.getparent().tag == 'do_any':
-                    do_all = Element('do_all')
-                    if node.get('weight'):
-                        do_all.set('weight', node.get('weight'))
-                        del(node.attrib['weight'])
-                    node.getparent().replace(node, do_all)
-                    do_all.append(node)
-                    assert do_all.tail == None
-                    # Switch to the do_all for further logic.
-                    node = do_all
-
-                # For md, get the parent cue/lib name to add to
-                # the location.
-                block_name = ''
-                if style == 'md':
-                    block_name = Get_MD_Block_Name(node)
-                    if block_name:
-                        block_name += ' '
-
-                # Above the node exits a path; below the node enters a path.
-                # TODO: add {block_name} to the section name, once confident
-                # that it won't lead to accidents on missing entry/exit points,
-                # for a cleaner printout.
-                Insert_Timestamp(
-                    f'{style}.{file_name}', 
-                    f'{block_name}{node.tag} exit {first_line}',
-                    'exit', node, 'before')
-                Insert_Timestamp(
-                    f'{style}.{file_name}', 
-                    f'{block_name}{node.tag} entry {last_line}', 
-                    'entry' , node, 'after')
-                
-
-        # Special exit points; aiscript only.
-        # Script can hard-return with a return node.
-        for tag in ['return']:
-            nodes = xml_root.xpath(".//{}".format(tag))
-            if not nodes:
-                continue
-
-            # Just timestamp the visit.
-            for node in nodes:
-                first_line = Get_First_Source_Line(node)
-                Insert_Timestamp(
-                    f'{style}.{file_name}', 
-                    f'{node.tag} exit {first_line}', 
-                    'exit', node, 'before')
-
-
-        # TODO:
-        # Possible mid points:
-        # -label
-        # -resume
-        # 
-
-        # Blocks of actions can show up in:
-        # -attention (one actions child)
-        # -libraries (multiple actions children possible, each named)
-        # -interrupts (may or may not have an actions block)
-        # -handler (one block of actions, no name on this or handler)
-        # -on_attentionchange (in theory; no examples seen)
-        # Of these, all but libraries should start/end paths.
-        
-        # "init" blocks also have actions, though not labelled as such.
-        # "on_abort" is similar.
-        for tag in ['actions','init','on_abort']:
-            nodes = xml_root.xpath(f'.//{tag}')
-
-            for node in nodes:
-                # Skip if empty.
-                if len(node) == 0:
-                    continue
-
-                # Pick out the entry/exit lines for annotation.
-                first_line = Get_First_Source_Line(node[0])
-                last_line  = Get_Last_Source_Line(node[-1])
-                
-                # For md, get the parent cue/lib name to add to
-                # the location.
-                block_name = ''
-                if style == 'md':
-                    block_name = Get_MD_Block_Name(node)
-                    if block_name:
-                        block_name += ' '
-                        
-                # TODO: add {block_name} to the section name.
-                Insert_Timestamp(
-                    f'{style}.{file_name}', 
-                    f'{block_name}{node.tag} entry {first_line}', 
-                    'entry', node, 'firstchild')
-                Insert_Timestamp(
-                    f'{style}.{file_name}', 
-                    f'{block_name}{node.tag} exit {last_line}', 
-                    'exit' , node, 'lastchild')
-
-
-        # Cleanup pass to clear out cases where path entry/exit points are
-        # right next to each other.
-        nodes_to_delete = []
-        for node in xml_root.xpath('''.//raise_lua_event[@name="'Script_Profiler.Record_Event'"]'''):
-
-            # Look for entry followed by exit.
-            if ',entry,' not in node.get('param'):
-                continue
-
-            next_node = node.getnext()
-
-            if (next_node == None
-            or next_node.tag != 'raise_lua_event'
-            or next_node.get('name') != "'Script_Profiler.Record_Event'"
-            or ',exit,' not in next_node.get('param')):
-                continue
-
-            # Entry before exit should always be redundant.
-            nodes_to_delete.append(node)
-            nodes_to_delete.append(next_node)
-
-        for node in nodes_to_delete:
-            node.getparent().remove(node)
-
-        game_file.Update_Root(xml_root)
+        text = etree.tostring(xml_root, encoding = 'unicode')
+        sourcelines = [node.sourceline for node in xml_root.iter()]
+        jobs.append((text, sourcelines, style, file_name))
+
+    results = [None] * len(jobs)
+    keys = [None] * len(jobs)
+    if cache:
+        for index, job in enumerate(jobs):
+            keys[index] = cache.Key(*job)
+            results[index] = cache.Get(keys[index])
+
+    missing = [index for index, result in enumerate(results) if result is None]
+    print(f'Annotating {len(missing)} of {len(jobs)} {style} scripts ({len(jobs) - len(missing)} cached)')
+    for index, result in zip(missing, Annotate_All([jobs[index] for index in missing], workers)):
+        results[index] = result
+        if cache:
+            cache.Put(keys[index], *result)
+
+    # Global ids are assigned in file order, as when annotating serially.
+    for game_file, (text, file_event_keys) in zip(files, results):
+        global_ids = [Intern_Event(*key) for key in file_event_keys]
+        text = event_param_re.sub(
+            lambda match: f'{match.group(1)}{global_ids[int(match.group(2)) - 1]},', text)
+        game_file.Update_Root(etree.fromstring(text))
     return
 
 
@@ -485,5 +397,9 @@ def Test_Time_Deformatter():
 
     return
 
-# Run this script.
-Run()
\ No newline at end of file
+# Run this script, whether run directly or loaded by the customizer
+# (as a user_module_*), but not in spawned annotation workers, which
+# import the parent's main script again as __mp_main__. Workers are
+# named before that import, so check the process name.
+if multiprocessing.current_process().name == 'MainProcess':
+    Run()
\ No newline at end of file
@@ -0,0 +1,372 @@
+'''
+Script annotation for profiling, one file at a time.
+Used by Modify_Scripts.py, and kept free of customizer imports so that
+worker processes can import it to annotate scripts in parallel.
+'''
+from lxml import etree
+from lxml.etree import Element
+
+# The systime print format to use.
+time_format = '%Y-%j-%H-%M-%S'
+
+
+class File_Events:
+    '''
+    Timestamp events of one file, with ids local to the file (from 1),
+    renumbered into global ids by Modify_Scripts.py.
+
+    * keys
+      - List of (section_name, location_name, path_bound), by id - 1.
+    * ids
+      - Dict, keyed by the above tuple, holding the id.
+    '''
+    def __init__(self):
+        self.keys = []
+        self.ids = {}
+
+    def Intern(self, section_name, location_name, path_bound):
+        '''
+        Returns the id for a timestamp event, assigning the next id if new.
+        '''
+        key = (section_name, location_name, path_bound)
+        event_id = self.ids.get(key)
+        if event_id == None:
+            self.keys.append(key)
+            event_id = self.ids[key] = len(self.keys)
+        return event_id
+
+    def Bound(self, event_id):
+        '''
+        Returns the path_bound of an id, or None if unknown.
+        '''
+        if not 0 < event_id <= len(self.keys):
+            return None
+        return self.keys[event_id - 1][2]
+
+
+def Get_First_Source_Line(node):
+    'Returns a sourceline int, or empty string, the first for a node.'
+    return node.sourceline if node.sourceline else ''
+
+def Get_Last_Source_Line(node):
+    '''
+    Returns a sourceline int, or empty string, the last for a node or children.
+    This will handle, eg. do_all nodes with many children.
+    '''
+    sourceline = None
+    for subnode in node.iter():
+        if subnode.sourceline and (not sourceline or subnode.sourceline > sourceline):
+            sourceline = subnode.sourceline
+    return str(sourceline) if sourceline else ''
+
+
+def Insert_Timestamp(
+        section_name,
+        location_name,
+        path_bound,
+        node,
+        op,
+        events,
+    ):
+    '''
+    Inserts a new timestamp node, a raise_lua_event sending player.systemtime.
+
+    * section_name
+      - String declaring the file and possibly the section of interest.
+      - Time deltas for paths will only be collected in matching section_names.
+      - The section shouldn't have un-annotated entry or exit points, except
+        to immediately evaluated subfunctions (libs).
+    * location_name
+      - Descriptive name of the location, typically including line number.
+    * path_bound 
+      - One of "entry"/"mid"/"exit", based on if this is known to start
+        or exit a section, with mid points optional.
+    * node
+      - Element to act as the base for the annocation insertion.
+    * op
+      - One of "before"/"after"/"firstchild"/"lastchild", where to insert
+        the annotation.
+    * events
+      - File_Events of the file, assigning the event id.
+    * new_node
+      - Created new node, inserted, provided for any debug reference.
+    '''
+    # Signal lua with the interned event id, appending the time of the event.
+    event_id = events.Intern(section_name, location_name, path_bound)
+    new_node = etree.fromstring(f''' <raise_lua_event 
+        name  = "'Script_Profiler.Record_Event'"
+        param = "'{event_id},' + player.systemtime.{{'{time_format}'}} "
+        />''')
+
+    # Handle insertion.
+    if op == 'before':
+        node.addprevious(new_node)
+    elif op == 'after':
+        node.addnext(new_node)
+        # addnext moves the tail, and hence node_id; fix it here.
+        if new_node.tail != None:
+            node.tail = new_node.tail
+            new_node.tail = None
+    elif op == 'firstchild':
+        node.insert(0, new_node)
+    elif op == 'lastchild':
+        node.append(new_node)
+    assert new_node.tail == None
+    return
+
+
+def Get_Event_Bound(node, events):
+    '''
+    For a timestamp raise_lua_event node, return its path_bound, or None
+    if not recognized.
+    '''
+    param = node.get('param')
+    if param == None:
+        return None
+    event_id = param.split(',', 1)[0].strip(" '")
+    if not event_id.isdigit():
+        return None
+    return events.Bound(int(event_id))
+
+
+def Get_MD_Block_Name(node):
+    '''
+    For md xml nodes, return their parent cue or lib name.
+    '''
+    # Search parents upward until a match.
+    test_node = node.getparent()
+    while 1:
+        if test_node.tag in ['cue', 'library']:
+            return test_node.get('name')
+        test_node = test_node.getparent()
+        if test_node == None:
+            return ''
+
+
+def Annotate_Root(xml_root, style, file_name):
+    '''
+    Add timestamps at entry, exit, and blocking nodes of one md or ai
+    script, interning their events in a File_Events, which is returned.
+
+    Note: while libraries can potentially be called directly without the
+    caller being full interrupted, they will be treated as fully separate
+    blocks, since ai libraries may have blocking actions and not return
+    right away, and md libraries may be used as cue templates and not
+    just as include_actions calls.
+    '''
+    events = File_Events()
+
+    # All normal blocking nodes (return to this script when done), and
+    # places where scope moves to a different action block with its
+    # own start/end.
+    # These will get wrapped with an exit point before, entry point after.
+    if style == 'ai':
+        interrupts = [
+            # Blocking actions (explicitly tagged)
+            'dock_masstraffic_drone',
+            'execute_custom_trade',
+            'execute_trade',
+            'move_approach_path',
+            'move_docking',
+            'move_undocking',
+            'move_gate',
+            'move_navmesh',
+            'move_strafe',
+            'move_target_points',
+            'move_waypoints',
+            'move_to',
+            'detach_from_masstraffic',
+            'run_script',
+            'run_order_script',
+            'wait_for_prev_script',
+            'wait',
+
+            # The following are not tagged as blocking, but do cause control
+            # flow change or similar.
+            # Created orders appear to run right away.
+            'create_order',
+            # May not block, but starts a new action block.
+            'include_interrupt_actions',
+            'run_interrupt_script',
+            # This command suggests it will exit an interrupt block to
+            # go to a label. Unclear in documentation, but it may have a
+            # delay before continuing at the label, so treat as blocking.
+            'abort_called_scripts',
+            # Since labels can be jumped to, possible after a delay from
+            # abort_called_scripts, can be extra safe by treating all labels
+            # as potential entry points (and hence set as exit points for
+            # the prior path).
+            'label',
+            # This means resumes also need to be treated as path endpoints.
+            'resume',
+        ]
+    else:
+        # TODO: alternative to sticking endpoints on these, instead set a
+        # global flag that suppresses path start/end in the callees.
+        interrupts = [
+            'include_actions',
+            'run_actions',
+            'signal_cue_instantly',
+            # Signalling objects will also instantly activate cues listening
+            # to that object being signalled.
+            'signal_objects',
+            ]
+        
+
+    for tag in interrupts:
+        nodes = xml_root.xpath(".//{}".format(tag))
+        if not nodes:
+            continue
+
+        # All of these nodes need timestamps on both sides.
+        for node in nodes:
+
+            # Pick out the entry/exit lines for annotation.
+            # (Do these nodes even have children?  Maybe; be safe.)
+            first_line = Get_First_Source_Line(node)
+            last_line  = Get_Last_Source_Line(node)
+
+            # Note: if this node is inside a do_any block, cannot easily
+            # slot in timestamps. Either timestampe the parent do_any,
+            # which can lead to other do_any children going unmeasured, or
+            # nest this node in a do_all, transfer any weight property
+            # to the do_all, and put the timestamping inside the do_all.
+            if node.getparent().tag == 'do_any':
+                do_all = Element('do_all')
+                if node.get('weight'):
+                    do_all.set('weight', node.get('weight'))
+                    del(node.attrib['weight'])
+                node.getparent().replace(node, do_all)
+                do_all.append(node)
+                assert do_all.tail == None
+                # Switch to the do_all for further logic.
+                node = do_all
+
+            # For md, get the parent cue/lib name to add to
+            # the location.
+            block_name = ''
+            if style == 'md':
+                block_name = Get_MD_Block_Name(node)
+                if block_name:
+                    block_name += ' '
+
+            # Above the node exits a path; below the node enters a path.
+            # TODO: add {block_name} to the section name, once confident
+            # that it won't lead to accidents on missing entry/exit points,
+            # for a cleaner printout.
+            Insert_Timestamp(
+                f'{style}.{file_name}', 
+                f'{block_name}{node.tag} exit {first_line}',
+                'exit', node, 'before', events)
+            Insert_Timestamp(
+                f'{style}.{file_name}', 
+                f'{block_name}{node.tag} entry {last_line}', 
+                'entry' , node, 'after', events)
+            
+
+    # Special exit points; aiscript only.
+    # Script can hard-return with a return node.
+    for tag in ['return']:
+        nodes = xml_root.xpath(".//{}".format(tag))
+        if not nodes:
+            continue
+
+        # Just timestamp the visit.
+        for node in nodes:
+            first_line = Get_First_Source_Line(node)
+            Insert_Timestamp(
+                f'{style}.{file_name}', 
+                f'{node.tag} exit {first_line}', 
+                'exit', node, 'before', events)
+
+
+    # TODO:
+    # Possible mid points:
+    # -label
+    # -resume
+    # 
+
+    # Blocks of actions can show up in:
+    # -attention (one actions child)
+    # -libraries (multiple actions children possible, each named)
+    # -interrupts (may or may not have an actions block)
+    # -handler (one block of actions, no name on this or handler)
+    # -on_attentionchange (in theory; no examples seen)
+    # Of these, all but libraries should start/end paths.
+    
+    # "init" blocks also have actions, though not labelled as such.
+    # "on_abort" is similar.
+    for tag in ['actions','init','on_abort']:
+        nodes = xml_root.xpath(f'.//{tag}')
+
+        for node in nodes:
+            # Skip if empty.
+            if len(node) == 0:
+                continue
+
+            # Pick out the entry/exit lines for annotation.
+            first_line = Get_First_Source_Line(node[0])
+            last_line  = Get_Last_Source_Line(node[-1])
+            
+            # For md, get the parent cue/lib name to add to
+            # the location.
+            block_name = ''
+            if style == 'md':
+                block_name = Get_MD_Block_Name(node)
+                if block_name:
+                    block_name += ' '
+                    
+            # TODO: add {block_name} to the section name.
+            Insert_Timestamp(
+                f'{style}.{file_name}', 
+                f'{block_name}{node.tag} entry {first_line}', 
+                'entry', node, 'firstchild', events)
+            Insert_Timestamp(
+                f'{style}.{file_name}', 
+                f'{block_name}{node.tag} exit {last_line}', 
+                'exit' , node, 'lastchild', events)
+
+
+    # Cleanup pass to clear out cases where path entry/exit points are
+    # right next to each other.
+    nodes_to_delete = []
+    for node in xml_root.xpath('''.//raise_lua_event[@name="'Script_Profiler.Record_Event'"]'''):
+
+        # Look for entry followed by exit.
+        if Get_Event_Bound(node, events) != 'entry':
+            continue
+
+        next_node = node.getnext()
+
+        if (next_node == None
+        or next_node.tag != 'raise_lua_event'
+        or next_node.get('name') != "'Script_Profiler.Record_Event'"
+        or Get_Event_Bound(next_node, events) != 'exit'):
+            continue
+
+        # Entry before exit should always be redundant.
+        nodes_to_delete.append(node)
+        nodes_to_delete.append(next_node)
+
+    for node in nodes_to_delete:
+        node.getparent().remove(node)
+
+    return events
+
+
+def Annotate_Text(text, sourcelines, style, file_name):
+    '''
+    Annotate one script given as xml text, eg. in a worker process.
+    Returns (annotated xml text, event keys by local id - 1).
+
+    * sourcelines
+      - List of the original line number of every node of the parsed text,
+        in document order, since the text was serialized from a tree loaded
+        elsewhere and line numbers go into the location names.
+    '''
+    xml_root = etree.fromstring(text)
+    for node, sourceline in zip(xml_root.iter(), sourcelines):
+        if sourceline:
+            node.sourceline = sourceline
+    events = Annotate_Root(xml_root, style, file_name)
+    return etree.tostring(xml_root, encoding = 'unicode'), events.keys
@@ -0,0 +1,267 @@
+'''
+Exports of recorded profiler sessions.
+'''
+import sys
+import json
+import argparse
+from pathlib import Path
+
+# Profile_Export.py - Profile Export Script
+# Converts sessions recorded by Script_Profiler.py (in its sessions_dir)
+# into inputs for common profile viewers:
+#
+# * folded: folded stacks, one line per path, eg.
+#     md;SN_Some_Mod;Some_Cue;actions entry 12 > actions exit 30 1234
+#   for flamegraph.pl, inferno or speedscope. Weights are path time in
+#   microseconds, path visits, or event counts.
+# * trace: Chrome trace_event JSON, for chrome://tracing or Perfetto. Each
+#   report becomes one average frame, with per-frame path times nested by
+#   script file and cue, so changes over a session can be scrolled through.
+# * diff: folded stacks of two sessions side by side (difffolded.pl
+#   format, for flamegraph.pl's differential graphs), each normalized per
+#   second of game time, plus a table of the largest changes.
+#
+# Examples:
+#   python Profile_Export.py folded <session> -o profile.folded
+#   python Profile_Export.py trace <session> -o profile.json
+#   python Profile_Export.py diff <old session> <new session> -o diff.folded
+#
+# --from/--to are seconds from the session start.
+
+# Add the root directory to sys.path
+root_dir = Path(__file__).resolve().parents[3]
+sys.path.insert(0, str(root_dir))
+
+from X4_Python_Pipe_Server.Classes.Series_Store import Series_Reader
+
+# Per weight: series prefix, and scale from stored value to output units.
+WEIGHTS = {
+    'time'  : ('path_ms:'    , 1000),
+    'visits': ('path_visits:', 1),
+    'events': ('event_count:', 1),
+    }
+
+# Trace process ids per script style.
+STYLE_PIDS = {'md': 1, 'ai': 2}
+
+
+def Block_Name(location):
+    '''
+    Cue/lib name at the start of a location, '[<block> ]<tag> <bound> <line>',
+    or '' if there is none (eg. aiscripts).
+    '''
+    words = location.rsplit(' ', 3)
+    return words[0] if len(words) == 4 else ''
+
+
+def Stack(name, event = False):
+    '''
+    Stack frames of a path name, '<style>.<file>,<start>,<end>', as
+    [style, file, block, '<start> > <end>']; or of an event name,
+    '<style>.<file>,<location>', as [style, file, block, location].
+    The block frame is left out when not named.
+    '''
+    section, locations = name.split(',', 1)
+    style, file_name = section.split('.', 1) if '.' in section else ('', section)
+    locations = [locations] if event else locations.split(',', 1)
+
+    frames = [style, file_name]
+    block = Block_Name(locations[0])
+    if block and all(location.startswith(block + ' ') for location in locations):
+        frames.append(block)
+        locations = [location[len(block) + 1:] for location in locations]
+    frames.append(' > '.join(locations))
+    # Semicolons separate frames in the folded format.
+    return [frame.replace(';', ':') for frame in frames if frame]
+
+
+def Time_Range(reader, args):
+    '''
+    Absolute (start, end) times from the --from/--to offsets.
+    '''
+    base = reader.start_time or 0
+    start = None if args.start is None else base + args.start
+    end = None if args.end is None else base + args.end
+    return start, end
+
+
+def Load_Stacks(reader, weight, start = None, end = None, per_second = False):
+    '''
+    Returns a dict of folded stack string: total weight over the time
+    range, optionally per second of profiled game time.
+    '''
+    prefix, scale = WEIGHTS[weight]
+    summaries = reader.Summarize(start, end)
+    if per_second:
+        timespan = summaries['path_timespan'].sum if 'path_timespan' in summaries else 0
+        if not timespan:
+            raise ValueError(f'{reader.path.name} has no profiled timespan to normalize by')
+        scale /= timespan
+
+    stacks = {}
+    for name, summary in summaries.items():
+        if not name.startswith(prefix):
+            continue
+        stack = ';'.join(Stack(name[len(prefix):], event = weight == 'events'))
+        stacks[stack] = stacks.get(stack, 0) + summary.sum * scale
+    return stacks
+
+
+def Open_Output(path):
+    return open(path, 'w', encoding = 'utf-8') if path else sys.stdout
+
+
+def Folded(args):
+    with Series_Reader(args.session) as reader:
+        stacks = Load_Stacks(reader, args.weight, *Time_Range(reader, args), per_second = args.per_second)
+    file = Open_Output(args.output)
+    for stack, value in sorted(stacks.items()):
+        value = round(value)
+        if value > 0:
+            file.write(f'{stack} {value}\n')
+    if args.output:
+        file.close()
+        print(f'Wrote {len(stacks)} stacks to {args.output}')
+
+
+def Reports(reader, start = None, end = None):
+    '''
+    Yields per report in the time range: (time, timespan, frames, path
+    times in ms by path name). Report samples share one timestamp.
+    '''
+    report_times, timespans = reader.Values('path_timespan', start, end)
+    frames_by_time = dict(zip(*reader.Values('path_frames', start, end)))
+    names, series, values = reader.names, reader.series, reader.values
+    for report_time, timespan in zip(report_times, timespans):
+        path_ms = {}
+        for row in range(*reader.Row_Range(report_time, report_time)):
+            name = names[series[row]]
+            if name.startswith('path_ms:'):
+                path_ms[name[len('path_ms:'):]] = values[row]
+        yield report_time, timespan, int(frames_by_time.get(report_time, 0)), path_ms
+
+
+def Trace_Slices(node, name, ts, pid, events):
+    '''
+    Add complete ('X') events for a tree node and its children, laid out
+    back to back from ts, largest first. Returns the node duration.
+    '''
+    children = node[1]
+    if not children:
+        duration = node[0]
+    else:
+        duration = 0
+        for child_name, child in sorted(children.items(), key = lambda x: -x[1][0]):
+            duration += Trace_Slices(child, child_name, ts + duration, pid, events)
+    if name is not None:
+        events.append({'name': name, 'ph': 'X', 'ts': ts, 'dur': duration, 'pid': pid, 'tid': 1})
+    return duration
+
+
+def Trace(args):
+    '''
+    Write a Chrome trace with one average frame per report: the report's
+    path times divided by its frame count, nested as file > block > path.
+    Frames are laid out back to back, with a gap, in report order.
+    '''
+    events = [{'name': 'process_name', 'ph': 'M', 'pid': pid, 'args': {'name': f'{style} scripts'}}
+              for style, pid in STYLE_PIDS.items()]
+    ts = 0.0
+    count = 0
+    with Series_Reader(args.session) as reader:
+        base = reader.start_time or 0
+        for report_time, timespan, frames, path_ms in Reports(reader, *Time_Range(reader, args)):
+            count += 1
+            # Older sessions lack frame counts; show the whole interval.
+            per_frame = 1 / frames if frames else 1
+            frame_us = timespan * 1e6 * per_frame
+
+            # Build the stack tree per style: node = [duration us, children].
+            trees = {}
+            for path, ms in path_ms.items():
+                stack = Stack(path)
+                node = trees.setdefault(stack[0], [0, {}])
+                for frame in stack[1:]:
+                    node = node[1].setdefault(frame, [0, {}])
+                node[0] += ms * 1000 * per_frame
+
+            span = frame_us
+            for style, tree in trees.items():
+                pid = STYLE_PIDS.get(style, len(STYLE_PIDS) + 1)
+                script_us = Trace_Slices(tree, None, ts, pid, events)
+                span = max(span, script_us)
+                events.append({'name': f'Report {count} frame', 'ph': 'X', 'ts': ts, 'dur': max(frame_us, script_us),
+                               'pid': pid, 'tid': 1, 'args': {
+                                   'session seconds': round(report_time - base, 1),
+                                   'frames': frames, 'timespan': timespan,
+                                   'script ms per frame': script_us / 1000}})
+            events.append({'name': 'fps', 'ph': 'C', 'ts': ts, 'pid': 0,
+                           'args': {'fps': frames / timespan if timespan else 0}})
+            # Leave a tenth of a frame between frames.
+            ts += span * 1.1
+
+    with Open_Output(args.output) as file:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, file)
+    print(f'Wrote {count} report frames, {len(events)} events, to {args.output}')
+
+
+def Diff(args):
+    with Series_Reader(args.session_a) as reader_a, Series_Reader(args.session_b) as reader_b:
+        stacks_a = Load_Stacks(reader_a, args.weight, *Time_Range(reader_a, args), per_second = True)
+        stacks_b = Load_Stacks(reader_b, args.weight, *Time_Range(reader_b, args), per_second = True)
+
+    rows = []
+    for stack in stacks_a.keys() | stacks_b.keys():
+        value_a = stacks_a.get(stack, 0)
+        value_b = stacks_b.get(stack, 0)
+        rows.append((stack, value_a, value_b, value_b - value_a))
+
+    if args.output:
+        with open(args.output, 'w', encoding = 'utf-8') as file:
+            for stack, value_a, value_b, _ in sorted(rows):
+                file.write(f'{stack} {round(value_a)} {round(value_b)}\n')
+        print(f'Wrote {len(rows)} stacks to {args.output}')
+
+    units = {'time': 'us/s', 'visits': 'visits/s', 'events': 'events/s'}[args.weight]
+    rows.sort(key = lambda row: -abs(row[3]))
+    if args.top:
+        rows = rows[:args.top]
+    print(f'{args.weight} ({units}) of {Path(args.session_a).name} -> {Path(args.session_b).name}')
+    print(f"{'path':<90} {'a':>10} {'b':>10} {'change':>10} {'%':>8}")
+    for stack, value_a, value_b, change in rows:
+        percent = f'{change / value_a * 100:>7.1f}%' if value_a else f"{'new':>8}"
+        print(f'{stack.replace(";", " ")[-90:]:<90} {value_a:>10.1f} {value_b:>10.1f} {change:>+10.1f} {percent}')
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description = 'Export recorded script profiler sessions.')
+    subparsers = parser.add_subparsers(dest = 'command', required = True)
+
+    def Add_Common(subparser, weight = True):
+        subparser.add_argument('-o', '--output', help = 'Output file (default: print).')
+        subparser.add_argument('--from', dest = 'start', type = float, help = 'Seconds from session start.')
+        subparser.add_argument('--to', dest = 'end', type = float, help = 'Seconds from session start.')
+        if weight:
+            subparser.add_argument('--weight', choices = list(WEIGHTS), default = 'time',
+                                   help = 'Path time (us), path visits, or event counts.')
+
+    folded_parser = subparsers.add_parser('folded', help = 'Folded stacks for flame graphs.')
+    folded_parser.add_argument('session')
+    folded_parser.add_argument('--per-second', action = 'store_true',
+                               help = 'Divide by the profiled game time.')
+    Add_Common(folded_parser)
+
+    trace_parser = subparsers.add_parser('trace', help = 'Chrome trace_event JSON, one frame per report.')
+    trace_parser.add_argument('session')
+    Add_Common(trace_parser, weight = False)
+
+    diff_parser = subparsers.add_parser('diff', help = 'Compare two sessions, per second of game time.')
+    diff_parser.add_argument('session_a')
+    diff_parser.add_argument('session_b')
+    diff_parser.add_argument('--top', type = int, default = 30, help = 'Changes to list (0 for all).')
+    Add_Common(diff_parser)
+
+    args = parser.parse_args()
+    if args.command == 'trace' and not args.output:
+        parser.error('trace needs an --output file')
+    {'folded': Folded, 'trace': Trace, 'diff': Diff}[args.command](args)
@@ -1,8 +1,9 @@
 '''
 Python side of measurement gathering.
 '''
-from X4_Python_Pipe_Server import Pipe_Server, Pipe_Client
+from X4_Python_Pipe_Server import Pipe_Server, Pipe_Client, Series_Writer, New_Session_Path
 import time
+import heapq
 import threading
 import json
 from pathlib import Path
@@ -38,8 +39,19 @@ def main(args):
 
     # Extract values.
     report_file_name = config['Server']['report_file']
+    sessions_dir = config['Server'].get('sessions_dir', '').strip()
     # TODO: others
 
+    # Session store of all reports, or None if disabled.
+    # Reports are infrequent, so each is written out as it arrives.
+    store = None
+    if sessions_dir:
+        store = Series_Writer(New_Session_Path(main_dir / sessions_dir, 'profile'),
+                              info = {'module': 'sn_script_profiler'})
+
+    # Reports are appended to this file as they arrive.
+    report = Report_Stream(main_dir / report_file_name)
+
     # Set up the pipe and connect to x4.
     # Increase the size above default a bunch, since messages can be
     # close to 60kB, and two are sent close together.
@@ -80,6 +92,10 @@ def main(args):
 
     # General dict of game state data, most recently sent.
     state_data = {}
+
+    # Names of interned lua event ids, '{section_name},{location_name}',
+    # sent once per id ahead of counts using it.
+    event_names = Event_Names()
     
     while 1:        
         # Blocking wait for a message from x4.
@@ -112,6 +128,8 @@ def main(args):
                     # Explicitly handle cases, for casting and clarity.
                     if key == 'path_metrics_timespan':
                         state_data['path_metrics_timespan'] = float(value)
+                    elif key == 'path_metrics_frames':
+                        state_data['path_metrics_frames'] = int(value)
 
                     # TODO: other stuff.
 
@@ -149,9 +167,22 @@ def main(args):
                         
                 # Print the scripts, if any recorded.
                 for counter in ai_counters.values():
+                    counter.Commit()
                     counter.Print(20)
+                if store:
+                    for prefix, counter in ai_counters.items():
+                        counter.Store(store, prefix)
+                    store.Flush()
+
+            # Names for new event ids.
+            elif command == 'event_names':
+                # Split, toss the last blank.
+                for kv_pair in args.split(';')[0:-1]:
+                    key, value = kv_pair.split(':', 1)
+                    event_names.Set(key, value)
 
             # Event counters switched to lumping everything in one command.
+            # Keys are event ids.
             elif command == 'event_counts':
                 counter = ai_counters['event_counts']
                 counter.Clear()
@@ -160,8 +191,12 @@ def main(args):
                 kv_pairs = args.split(';')[0:-1]
                 for kv_pair in kv_pairs:
                     key, value = kv_pair.split(':')
-                    counter.Set(key, value)
+                    counter.Set(event_names.Event(key), value)
+                counter.Commit()
                 counter.Print(20)
+                if store:
+                    counter.Store(store, 'event_count')
+                    store.Flush()
                 
 
             # Path times are more complex.
@@ -174,9 +209,11 @@ def main(args):
                     tracker.Clear()
                 
                 # Split, toss the last blank.
+                # Keys are '{start event id}-{end event id}'.
                 kv_pairs = args.split(';')[0:-1]
                 for kv_pair in kv_pairs:
                     key, value = kv_pair.split(':')
+                    key = event_names.Path(key)
                     # Separate based on key starting with 'ai' or 'md'.
                     if key[0] == 'a':
                         path_metrics['ai'].Set(key, value)
@@ -201,17 +238,25 @@ def main(args):
                 #print(f"Metrics gathered over {state_data['path_metrics_timespan']} seconds")
                 for tracker in path_metrics.values():
                     tracker.Set_Timespan(state_data['path_metrics_timespan'])
+                    tracker.Commit()
 
                 for tracker in path_metrics.values():
                     tracker.Print(20)
+                if store:
+                    # One timestamp for the whole report, so exports can
+                    # group its samples (see Profile_Export.py).
+                    now = time.time()
+                    store.Append_Many([
+                        ('path_timespan', state_data['path_metrics_timespan']),
+                        ('path_frames'  , state_data.get('path_metrics_frames', 0)),
+                        ], now)
+                    for tracker in path_metrics.values():
+                        tracker.Store(store, now)
+                    store.Flush()
 
-                # TODO: maybe accumulate metrics across multiple calls.
-                
-                # Write results to a file.
-                # TODO: collect data together from the trackers and state,
-                # and regulate how often it dumps (to avoid excessive
-                # writes during quick iterative testing).
-                Write_Report(ai_counters, path_metrics, report_file_name)
+                # Append this interval, and the running totals, to the
+                # report file.
+                report.Write(list(ai_counters.values()) + list(path_metrics.values()))
 
 
             else:
@@ -230,100 +275,234 @@ def main(args):
 
 
 
+class Event_Names:
+    '''
+    Names of the integer event ids used by lua.
+
+    * names
+      - Dict, keyed by id string, holding (section_name, location_name).
+    * paths
+      - Dict, keyed by path id string '{start id}-{end id}', holding the
+        path name '{section_name},{start location},{end location}'.
+    '''
+    def __init__(self):
+        self.names = {}
+        self.paths = {}
+
+    def Set(self, id, name):
+        '''
+        Record the '{section_name},{location_name}' name of an id.
+        '''
+        self.names[id] = tuple(name.split(',', 1))
+
+    def _Get(self, id):
+        # Names normally arrive first; fall back to the raw id, eg. if
+        # the server restarted mid game.
+        return self.names.get(id) or ('unknown', f'id {id}')
+
+    def Event(self, id):
+        '''
+        Event name of an id: '{section_name},{location_name}'.
+        '''
+        return ','.join(self._Get(id))
+
+    def Path(self, path_id):
+        '''
+        Path name of a '{start id}-{end id}' pair:
+        '{section_name},{start location},{end location}'.
+        '''
+        name = self.paths.get(path_id)
+        if name is None:
+            start_id, end_id = path_id.split('-')
+            section_name, start_location = self._Get(start_id)
+            name = f'{section_name},{start_location},{self._Get(end_id)[1]}'
+            # Only cache once both names are known.
+            if start_id in self.names and end_id in self.names:
+                self.paths[path_id] = name
+        return name
+
+
 class Count_Storage:
     '''
-    Track the counts of things of some sort.
+    Track the counts of things of some sort, for the latest reporting
+    interval and cumulatively across all intervals.
 
     * type
       - String, descriptive type of what's being counted, eg. command or action.
     * counts
-      - Dict, keyed by entry name, holding the entry count.
+      - Dict, keyed by entry name, holding the entry count of the latest interval.
+    * totals
+      - Dict, keyed by entry name, holding the count summed over all intervals.
+    * interval_total, total
+      - Floats, sum of all counts in the latest interval, and overall.
+    * top
+      - Int, how many of the highest totals are kept ranked in leaders.
+    * leaders
+      - List of entry names with the highest totals, highest first.
     '''
-    def __init__(self, type = ''):
+    def __init__(self, type = '', top = 20):
         self.type = type
         self.counts = {}
+        self.totals = {}
+        self.interval_total = 0
+        self.total = 0
+        self.top = top
+        self.leaders = []
 
     def Clear(self):
+        '''
+        Start a new interval. Totals are kept.
+        '''
         self.counts.clear()
 
     def Set(self, name, count):
-        self.counts[name] = float(count)
+        '''
+        Record the interval count of an entry. Counts of ids sharing a name
+        (eg. unknown ids) are summed.
+        '''
+        self.counts[name] = self.counts.get(name, 0) + float(count)
+
+    def Store(self, store, prefix):
+        '''
+        Append the counts to a Series_Writer, as '<prefix>:<name>'.
+        '''
+        store.Append_Many((f'{prefix}:{name}', count) for name, count in self.counts.items())
 
     def Apply_Offset(self, offset):
         # Adjust all entries directly.
         for key in self.counts:
             self.counts[key] += offset
 
-    def Print(self, top = 5):
+    def Commit(self):
         '''
-        Prints the top 5 (or however many) most frequent counts.
-        Does nothing if no counts known.
+        Add the interval counts to the totals, and update the leaders.
+        Call once per interval, after all Set()s.
+        Totals never decrease, so only entries counted this interval can
+        overtake a leader; the work is proportional to the interval size,
+        not to every entry ever seen.
+        '''
+        totals = self.totals
+        for name, count in self.counts.items():
+            totals[name] = totals.get(name, 0) + count
+        self.interval_total = sum(self.counts.values())
+        self.total += self.interval_total
+
+        candidates = set(self.leaders)
+        candidates.update(self.counts)
+        self.leaders = heapq.nlargest(self.top, candidates, key = totals.__getitem__)
+
+    def Top(self, top, cumulative = False):
+        '''
+        Returns a list of (name, count) of the highest counts, for the
+        latest interval or cumulative.
+        '''
+        if not cumulative:
+            return heapq.nlargest(top, self.counts.items(), key = lambda x: x[1])
+        if top <= self.top:
+            return [(name, self.totals[name]) for name in self.leaders[:top]]
+        # Asked for more than is tracked; rank everything.
+        return heapq.nlargest(top, self.totals.items(), key = lambda x: x[1])
+
+    def Format(self, top = 5, cumulative = False):
         '''
-        if not self.counts:
-            return
+        Returns text listing the top 5 (or however many) most frequent
+        counts, or an empty string if no counts known.
+        '''
+        counts       = self.totals if cumulative else self.counts
+        total_counts = self.total  if cumulative else self.interval_total
+        if not counts:
+            return ''
 
-        total_counts = sum(self.counts.values())
-        msg = self.type + 's: {}\n'.format(total_counts)
-        msg += self.type + ' counts (top {})\n'.format(top)
+        label = self.type + (' total' if cumulative else '')
+        msg = label + 's: {}\n'.format(total_counts)
+        msg += label + ' counts (top {})\n'.format(top)
 
-        lines = []
-        remaining = top
-        for name, count in sorted(self.counts.items(), key = lambda x: x[1], reverse = True):
+        for name, count in self.Top(top, cumulative):
             # Give spacing so the printout aligns somewhat.
-            lines.append('{:<55}:{:6.0f} ({:.2f}%)'.format(
+            msg += '  {:<55}:{:6.0f} ({:.2f}%)\n'.format(
                 name, 
                 count,
-                count / total_counts * 100))
-            remaining -= 1
-            if not remaining:
-                break
-            
-        for line in lines:
-            msg += '  '+line+'\n'
-        print(msg)
+                (count / total_counts * 100) if total_counts else 0)
+        return msg
+
+    def Print(self, top = 5, cumulative = False):
+        '''
+        Prints the top 5 (or however many) most frequent counts.
+        Does nothing if no counts known.
+        '''
+        msg = self.Format(top, cumulative)
+        if msg:
+            print(msg)
         return
 
 
 class Path_Metrics:
     '''
-    Storage specifically for path metrics.
-    TODO: track time interval of first to last metric sample, add
-    compute for time per second and time per frame.
+    Storage specifically for path metrics, for the latest reporting
+    interval and cumulatively across all intervals.
+    TODO: compute time per frame.
     
     * metrics
-      - Dict, keyed by entry name, holding the metrics sent over.
+      - Dict, keyed by entry name, holding the metrics of the latest interval.
       - Expected metrics: min, max, sum, count.
+    * totals
+      - Dict, keyed by entry name, holding the metrics combined over all
+        intervals.
     * timespan
       - Float, period over which samples were gathered, in seconds.
       - May mismatch with the undelying metrics units (eg. 100 ns).
+    * total_timespan
+      - Float, timespan summed over all intervals.
+    * interval_sum, total_sum
+      - Sum of all entry sums in the latest interval, and overall, in 100 ns.
+    * top
+      - Int, how many of the highest total sums are kept ranked in leaders.
+    * leaders
+      - List of entry names with the highest total sums, highest first.
     '''
-    def __init__(self, type = ''):
+    def __init__(self, type = '', top = 20):
         self.type = type
         self.metrics = {}
+        self.totals = {}
         self.timespan = 0
+        self.total_timespan = 0
+        self.interval_sum = 0
+        self.total_sum = 0
+        self.top = top
+        self.leaders = []
 
     def Clear(self):
+        '''
+        Start a new interval. Totals are kept.
+        '''
         self.metrics.clear()
 
     def Set(self, name, metrics_str):
         '''
         Takes a comma separated string with expected metric ordering:
         sum, min, max, count (ints), comma separated.
-        Overwrites any possible prior metrics.
-        TODO: support for summing with prior metrics.
+        Combines with any prior metrics of this name in this interval.
         '''
-        sum, min, max, count = metrics_str.split(',')
+        total, low, high, count = (int(x) for x in metrics_str.split(','))
+        # Paths sharing a name (eg. of unknown ids) are combined.
+        prior = self.metrics.get(name)
+        if prior is not None:
+            total += prior['sum']
+            low    = min(low, prior['min'])
+            high   = max(high, prior['max'])
+            count += prior['count']
         self.metrics[name] = {
-            'sum'   : int(sum), 
-            'min'   : int(min), 
-            'max'   : int(max), 
-            'count' : int(count),
+            'sum'   : total, 
+            'min'   : low, 
+            'max'   : high, 
+            'count' : count,
             }
 
     def Apply_Offset(self, offset):
         '''
         Apply a universal offset to the metrics.  min/max modified by offset,
-        sum modified 'count' times of the offset. Affects all entries.
+        sum modified 'count' times of the offset. Affects all entries of
+        the interval.
         No entry allowed to go below 0.
         '''
         for key in self.metrics:
@@ -332,6 +511,17 @@ class Path_Metrics:
             entry['max'] = max(0, entry['max'] + offset)
             entry['sum'] = max(0, entry['sum'] + offset * entry['count'])
 
+    def Store(self, store, timestamp = None):
+        '''
+        Append the metrics to a Series_Writer: per entry, total time in ms
+        ('path_ms:<name>') and visits ('path_visits:<name>').
+        '''
+        samples = []
+        for name, metrics in self.metrics.items():
+            samples.append((f'path_ms:{name}', metrics['sum'] / 10000))
+            samples.append((f'path_visits:{name}', metrics['count']))
+        store.Append_Many(samples, timestamp)
+
     def Set_Timespan(self, timespan):
         '''
         Set the timespan over which samples were collected.
@@ -339,48 +529,75 @@ class Path_Metrics:
         '''
         self.timespan = timespan
 
-    # -Removed; expecting to do a higher level unified json dump instead.
-    #def Dump(self):
-    #    '''
-    #    Dump metrics to a json file, using the current 'type' name,
-    #    in this file's directory.
-    #    '''
-    #    with open(this_dir / f"{self.type.replace(' ','_')}.json", 'w') as file:
-    #        json.dump(self.metrics, indent = 2)
-
-    def Print(self, top = 5):
+    def Commit(self):
         '''
-        Prints the top 5 (or however many) highest metrics, by sum.
-        Does nothing if no metrics known.
+        Combine the interval metrics into the totals, and update the
+        leaders. Call once per interval, after offsets and timespan are set.
+        As with Count_Storage, only entries seen this interval can
+        overtake a leader, so the work is proportional to the interval size.
+        '''
+        totals = self.totals
+        for name, metrics in self.metrics.items():
+            entry = totals.get(name)
+            if entry is None:
+                totals[name] = dict(metrics)
+            else:
+                entry['sum']   += metrics['sum']
+                entry['min']   = min(entry['min'], metrics['min'])
+                entry['max']   = max(entry['max'], metrics['max'])
+                entry['count'] += metrics['count']
+        self.total_timespan += self.timespan
+        self.interval_sum = sum(x['sum'] for x in self.metrics.values())
+        self.total_sum += self.interval_sum
+
+        candidates = set(self.leaders)
+        candidates.update(self.metrics)
+        self.leaders = heapq.nlargest(self.top, candidates, key = lambda x: totals[x]['sum'])
+
+    def Top(self, top, cumulative = False):
         '''
-        if not self.metrics:
-            return
+        Returns a list of (name, metrics) of the highest sums, for the
+        latest interval or cumulative.
+        '''
+        if not cumulative:
+            return heapq.nlargest(top, self.metrics.items(), key = lambda x: x[1]['sum'])
+        if top <= self.top:
+            return [(name, self.totals[name]) for name in self.leaders[:top]]
+        # Asked for more than is tracked; rank everything.
+        return heapq.nlargest(top, self.totals.items(), key = lambda x: x[1]['sum'])
+
+    def Format(self, top = 5, cumulative = False):
+        '''
+        Returns text listing the top 5 (or however many) highest metrics,
+        by sum, or an empty string if no metrics known.
+        '''
+        metrics_dict    = self.totals if cumulative else self.metrics
+        timespan        = self.total_timespan if cumulative else self.timespan
+        # Total sum across all, in 100ns.
+        total_sum_100ns = self.total_sum if cumulative else self.interval_sum
+        if not metrics_dict:
+            return ''
 
-        # Compute total sum across all, in 100ns.
-        total_sum_100ns = sum(x['sum'] for x in self.metrics.values())
         # Convert to seconds.
         total_sum_s = total_sum_100ns / 10000000
 
         # Line with how many paths were recoreded.
         msg = '\n'
-        msg += self.type + 's: {} entries\n'.format(len(self.metrics))
+        msg += self.type + ('s (total)' if cumulative else 's') + ': {} entries\n'.format(len(metrics_dict))
         # Timespan of the gathering, and how much contribution all
         # entries make to this (discounting offet adjustment).
         msg += ' Timespan: {:.2f} seconds; contribution of entries: {:.2f} ({:.2f}%)\n'.format(
-            self.timespan,
+            timespan,
             total_sum_s,
-            total_sum_s / self.timespan * 100,
+            (total_sum_s / timespan * 100) if timespan else 0,
             )
         msg += ' Top {}:\n'.format(top)
-        
 
-        lines = []
-        remaining = top
-        # Sort by sum, high to low.
-        for name, metrics in sorted(self.metrics.items(), key = lambda x: x[1]['sum'], reverse = True):
+        # Sorted by sum, high to low.
+        for name, metrics in self.Top(top, cumulative):
             # Give spacing so the printout aligns somewhat.
             # (These tend to be floats due to the offset adjustment.)
-            lines.append('{:<80}:{:6.0f} ({:.2f}%) ({:.1f} to {:.1f}, {} visits)'.format(
+            msg += '  {:<80}:{:6.0f} ({:.2f}%) ({:.1f} to {:.1f}, {} visits)\n'.format(
                 name, 
                 metrics['sum'],
                 # Percent of all sums.
@@ -388,27 +605,59 @@ class Path_Metrics:
                 metrics['min'],
                 metrics['max'],
                 metrics['count'],
-                ))
-            remaining -= 1
-            if not remaining:
-                break
-            
-        for line in lines:
-            msg += '  '+line+'\n'
-        print(msg)
+                )
+        return msg
+
+    def Print(self, top = 5, cumulative = False):
+        '''
+        Prints the top 5 (or however many) highest metrics, by sum.
+        Does nothing if no metrics known.
+        '''
+        msg = self.Format(top, cumulative)
+        if msg:
+            print(msg)
         return
 
 
-def Write_Report(
-        ai_counters, 
-        path_metrics, 
-        report_file_name
-    ):
+class Report_Stream:
     '''
-    Do some analysis of results, and write the profile to a file.
+    Profile report file, appended to as reports arrive. Each report adds
+    the interval and cumulative rankings of every tracker; nothing already
+    written is rewritten, so a report costs only its own text.
+
+    * path
+      - Path of the report file.
+    * top
+      - Int, entries listed per ranking.
+    * count
+      - Int, reports written so far this session.
     '''
-    # TODO
-
+    def __init__(self, path, top = 20):
+        self.path = path
+        self.top = top
+        self.count = 0
+        self.file = open(path, 'a', encoding = 'utf-8')
+        self.file.write('=== Profiling session started {} ===\n'.format(
+            time.strftime('%Y-%m-%d %H:%M:%S')))
+        self.file.flush()
+
+    def Write(self, trackers):
+        '''
+        Append a report of the given Count_Storage and Path_Metrics
+        trackers, and flush it to disk.
+        '''
+        self.count += 1
+        parts = ['\n--- Report {} at {} ---\n'.format(self.count, time.strftime('%H:%M:%S'))]
+        for tracker in trackers:
+            for cumulative in (False, True):
+                text = tracker.Format(self.top, cumulative)
+                if text:
+                    parts.append(text + '\n')
+        self.file.write(''.join(parts))
+        self.file.flush()
+
+    def Close(self):
+        self.file.close()
 
 
 def Pipe_Client_Test():
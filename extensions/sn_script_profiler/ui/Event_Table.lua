@@ -0,0 +1,11 @@
+Lua_Loader.define("extensions.sn_script_profiler.ui.Event_Table",function(require)
+--[[
+Generated by Modify_Scripts.py; ids match the annotated scripts.
+]]
+return {
+    sections = {
+    },
+    events = {
+    },
+}
+end)
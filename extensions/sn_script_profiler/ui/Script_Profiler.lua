@@ -5,13 +5,22 @@ Lua side of performance profiling.
 AI/MD timestamped events will be sent here for processing.
 
 Event message format:
+    {event_id},{formatted_time}
+or, for events not annotated by Modify_Scripts.py:
     {section_name},{location_name},{path_bound},{formatted_time}
 Where:
+    event_id is an integer from the Event_Table generated by Modify_Scripts.py,
+    which gives the section, location and path_bound of each id.
     section_name includes the file name and cue/lib name (if relevant).
     location_name is some descriptive term, likely including line number.
     path_bound is one of "entry","mid","exit".
     formatted_time has the format: {year}-{day}-{hour}-{minute}-{second}
 
+Named events are interned on first sight into new ids, so all tracking
+below is indexed by integer id. Id names are sent to python once per
+pipe connection, only for ids in the counts being reported, ahead of
+those counts.
+
 Events represent specific points in the code being visited by scripts.
 Lua code will track two aspects of events:
 - Number of times each event is seen.
@@ -57,30 +66,60 @@ ffi.cdef[[
 -- Inherited lua stuff from support apis.
 local Lib   = require("extensions.sn_mod_support_apis.lua_interface").Library
 local Pipes = require("extensions.sn_mod_support_apis.lua_interface").Pipes
+local Time  = require("extensions.sn_mod_support_apis.ui.time.Interface")
+local Event_Table = require("extensions.sn_script_profiler.ui.Event_Table")
 
 -- Table of local functions and data.
 local L = {
     debug = true,
 
-    -- Table of prior seen events, keyed by section_name, with data subtable.
+    -- Interned events, by event id: section index, path bound code,
+    -- and location name.
+    event_sections  = {},
+    event_bounds    = {},
+    event_locations = {},
+    -- Event id, keyed by "{section_name},{location_name},{bound code}",
+    -- for interning named events.
+    event_ids = {},
+    -- Section names by section index, and section index by name.
+    section_names = {},
+    section_ids   = {},
+    -- Event ids whose names python has, on the current pipe connection.
+    names_sent = {},
+    -- Limit on the size of each event_names message, well under the
+    -- python side pipe buffer (256 kB).
+    names_message_limit = 32 * 1024,
+    -- Name of the pipe to python.
+    pipe_name = "x4_script_profile",
+
+    -- Path bound codes by name, and names by code.
+    bound_codes = {entry = 1, mid = 2, exit = 3},
+    bound_names = {"entry", "mid", "exit"},
+
+    -- Prior seen event per section index: event id, time, and engine_time.
     -- Eg. a given cue will show up separately from a lib it calls, so this
     -- can hold both the cue entry and the lib entry.
-    -- Subtables include section_name (redundant), location, path_bound, time,
-    -- engine_time, message.
     -- This will not record "exit" path_bounds, as those will clear entries
     -- instead.
-    prior_events = {},
+    prior_ids          = {},
+    prior_times        = {},
+    prior_engine_times = {},
 
-    -- Table, keyed by script and event name, with the number of occurrences.
+    -- Table, keyed by event id, with the number of occurrences.
     event_counts = {},
 
-    -- Table, keyed by script name and pairs of event names, with a subtable
-    -- holding: 'sum' (across all visits), 'min', 'max', 'count' (visits).
+    -- Table, keyed by path (start event id * path_key_scale + end event id),
+    -- with a subtable holding: 'sum' (across all visits), 'min', 'max',
+    -- 'count' (visits).
     path_times = {},
+    path_key_scale = math.pow(2, 24),
 
     -- Game time when paths started gathering, since last reset or clear.
     path_gather_start_time = nil,
 
+    -- Frames drawn since paths started gathering, for per-frame times.
+    frame_count = 0,
+
     -- Point at which the timer rolls over.
     -- Based on the exe edit limiting the fundamental timer to 32-bits.
     rollover = math.pow(2, 32),
@@ -96,41 +135,115 @@ function Init()
     -- "year,day,hour,minute,second"
     -- format, where a "second" is actually 100 ns.
     RegisterEvent("Script_Profiler.Record_Event", L.Record_Event)
+
+    Time.Register_NewFrame_Callback(L.Count_Frame, nil, "Script_Profiler frame count")
+
+    L.Load_Event_Table()
     
     L.path_gather_start_time = GetCurTime()
 end
 
+function L.Count_Frame()
+    L.frame_count = L.frame_count + 1
+end
+
+-- Seed the interned events from the generated Event_Table.
+-- Events are packed as lines of "{section index} {bound code} {location}".
+function L.Load_Event_Table()
+    for index, section_name in ipairs(Event_Table.sections) do
+        L.section_names[index] = section_name
+        L.section_ids[section_name] = index
+    end
+    local id = 0
+    for _, chunk in ipairs(Event_Table.events) do
+        for section_str, bound_str, location in string.gmatch(chunk, "(%d+) (%d) ([^\n]*)\n") do
+            id = id + 1
+            local section = tonumber(section_str)
+            local bound = tonumber(bound_str)
+            L.event_sections[id]  = section
+            L.event_bounds[id]    = bound
+            L.event_locations[id] = location
+            L.event_ids[L.section_names[section]..","..location..","..bound] = id
+        end
+    end
+end
+
+-- Returns the id of a named event, interning it if new.
+-- Returns nil for an unknown path_bound.
+function L.Intern_Event(section_name, location, path_bound)
+    local bound = L.bound_codes[path_bound]
+    if bound == nil then
+        return nil
+    end
+    local key = section_name..","..location..","..bound
+    local id = L.event_ids[key]
+    if id == nil then
+        local section = L.section_ids[section_name]
+        if section == nil then
+            section = #L.section_names + 1
+            L.section_names[section] = section_name
+            L.section_ids[section_name] = section
+        end
+        id = #L.event_sections + 1
+        L.event_sections[id]  = section
+        L.event_bounds[id]    = bound
+        L.event_locations[id] = location
+        L.event_ids[key] = id
+    end
+    return id
+end
+
+-- Readable name of an event id, for error messages.
+function L.Event_Name(id)
+    return L.section_names[L.event_sections[id]]..","..L.event_locations[id]..","..L.bound_names[L.event_bounds[id]]
+end
+
 -- Send collacted data straight to the pipe.
 function L.Send_Script_Info()
 
-    -- Transmit the time elapsed since paths started gathering.
+    -- A new connection (first use, or after a disconnect, eg. a server
+    -- restart) starts without any names.
+    if not Pipes.Is_Connected(L.pipe_name) then
+        L.names_sent = {}
+    end
+
+    -- Transmit the time elapsed since paths started gathering, and the
+    -- frames drawn in that time.
     -- TODO: if server restarted, somehow this transmits to the new server,
     -- then causes it to shut down and restart. why??
-    Pipes.Schedule_Write("x4_script_profile", nil, string.format(
-        "update;path_metrics_timespan:%f;", GetCurTime() - L.path_gather_start_time))
+    Pipes.Schedule_Write(L.pipe_name, nil, string.format(
+        "update;path_metrics_timespan:%f;path_metrics_frames:%d;",
+        GetCurTime() - L.path_gather_start_time, L.frame_count))
     
+    -- Names of event ids python hasn't seen, before any counts use them.
+    L.Send_Event_Names()
+
     -- Collect the data into a big string for python side processing.
     -- To maybe speed this up, put substrings into a bit list, then
     -- use table.concat to join them.
     -- General format: command;key:value;key:value;...
+    -- Keys are event ids, or for paths "{start id}-{end id}".
     for i, field in ipairs({"event_counts", "path_times"}) do
         -- Skip transmit if nothing was recorded.
         local send = false
         local str_table = {field..";"}
         for key, value in pairs(L[field]) do
+            local key_str, value_str = key, value
             -- path_times need more work to break out sum/min/max/count;
             -- do those with comma separation.
             if field == "path_times" then
-                value = string.format("%d,%d,%d,%d", value.sum, value.min, value.max, value.count)
+                local start_id = math.floor(key / L.path_key_scale)
+                key_str = string.format("%d-%d", start_id, key - start_id * L.path_key_scale)
+                value_str = string.format("%d,%d,%d,%d", value.sum, value.min, value.max, value.count)
             end
-            table.insert(str_table, key..":"..value..";")
+            table.insert(str_table, key_str..":"..value_str..";")
             send = true
         end
         if send then
             local message = table.concat(str_table)
             DebugError("Sending "..field..", items: "..#str_table..", size: "..string.len(message))
             -- No callback for now.
-            Pipes.Schedule_Write("x4_script_profile", nil, message)
+            Pipes.Schedule_Write(L.pipe_name, nil, message)
         end
         -- Clear old info (for now).
         L[field] = {}
@@ -138,6 +251,7 @@ function L.Send_Script_Info()
 
     -- Reset the timer.
     L.path_gather_start_time = GetCurTime()
+    L.frame_count = 0
 
     --Lib.Print_Table(L.event_counts, "event_counts")
     --Lib.Print_Table(L.path_times, "path_times")
@@ -151,40 +265,86 @@ function L.Send_Script_Info()
 
 end
 
+-- Send names of the event ids in the current counts that python doesn't
+-- have yet, split into messages under names_message_limit.
+-- Format: event_names;id:{section_name},{location_name};...
+function L.Send_Event_Names()
+    local names_sent = L.names_sent
+    local header = "event_names;"
+    local str_table = {header}
+    local size = #header
+
+    local function Add(id)
+        if names_sent[id] then return end
+        names_sent[id] = true
+        local entry = id..":"..L.section_names[L.event_sections[id]]..","..L.event_locations[id]..";"
+        if size + #entry > L.names_message_limit and #str_table > 1 then
+            Pipes.Schedule_Write(L.pipe_name, nil, table.concat(str_table))
+            str_table = {header}
+            size = #header
+        end
+        table.insert(str_table, entry)
+        size = size + #entry
+    end
+
+    for id in pairs(L.event_counts) do
+        Add(id)
+    end
+    for key in pairs(L.path_times) do
+        local start_id = math.floor(key / L.path_key_scale)
+        Add(start_id)
+        Add(key - start_id * L.path_key_scale)
+    end
+    if #str_table > 1 then
+        Pipes.Schedule_Write(L.pipe_name, nil, table.concat(str_table))
+    end
+end
+
 -- TODO: maybe manually count frames elapsed per second, for aid in
 -- precisely saying how much script compute time was taken per frame.
 
 -- Event recorder.
 function L.Record_Event(_, message)
 
-    -- Break up message on commas.
-    local section_name, location, path_bound, time_string = unpack(Lib.Split_String_Multi(message, ","))
+    -- Interned events: {event_id},{time}
+    local id, year, day, hour, minute, second = string.match(message, "^(%d+),(%d+)-(%d+)-(%d+)-(%d+)-(%d+)$")
+    if id ~= nil then
+        id = tonumber(id)
+    else
+        -- Named events: {section_name},{location},{path_bound},{time}
+        local section_name, location, path_bound
+        section_name, location, path_bound, year, day, hour, minute, second = string.match(message,
+            "^([^,]*),([^,]*),(%a+),(%d+)-(%d+)-(%d+)-(%d+)-(%d+)$")
+        if section_name ~= nil then
+            id = L.Intern_Event(section_name, location, path_bound)
+        end
+    end
+    local section = L.event_sections[id]
+    if section == nil then
+        DebugError("Error: Unrecognized event message: "..tostring(message))
+        return
+    end
+    local bound = L.event_bounds[id]
 
     -- Print the first few for debugging.
     local print_this = false
     if L.debug then
         if L.messages_printed == nil then L.messages_printed = 0 end
-        -- Normally md runs first; quick hack: look for "a" to check ai.
-        if L.messages_printed < 10 then-- and string.sub(section_name, 1, 1) == "a" then
+        if L.messages_printed < 10 then
             print_this = true
             L.messages_printed = L.messages_printed + 1
         end
     end
 
     if print_this then
-        DebugError("Perf Message: "..tostring(message))
+        DebugError("Perf Message: "..tostring(message).." ("..L.Event_Name(id)..")")
     end
 
-    -- Add to event counter. Events named after section and location.
-    local event_name = section_name .. "," .. location
-    if L.event_counts[event_name] == nil then
-        L.event_counts[event_name] = 1
-    else
-        L.event_counts[event_name] = L.event_counts[event_name] + 1
-    end
+    -- Add to event counter.
+    L.event_counts[id] = (L.event_counts[id] or 0) + 1
 
     -- Convert the time string to a time.
-    local time = L.Deformat_Time(time_string)
+    local time = L.Deformat_Time(year, day, hour, minute, second)
     
     if print_this then
         DebugError("Deformatted time: "..tostring(time))
@@ -192,19 +352,16 @@ function L.Record_Event(_, message)
 
     -- Track the frame time.
     local engine_time = GetCurRealTime()
-    --if print_this then
-    --    DebugError("engine_time: "..tostring(engine_time))
-    --end
     -- Convenience renaming.
-    local prior_event = L.prior_events[section_name]
+    local prior_id = L.prior_ids[section]
 
     -- Error check: there should be no prior recorded event left over
     -- from an earlier frame.
-    if prior_event ~= nil and prior_event.engine_time ~= engine_time then
-        DebugError("Error: Leftover non-exit event from earlier frame: "..tostring(prior_event.message))
+    if prior_id ~= nil and L.prior_engine_times[section] ~= engine_time then
+        DebugError("Error: Leftover non-exit event from earlier frame: "..L.Event_Name(prior_id))
         -- Clear it for safety, to avoid accidental cross-frame matching.
-        L.prior_events[section_name] = nil
-        prior_event = nil
+        L.prior_ids[section] = nil
+        prior_id = nil
     end
 
     -- TODO: maybe a way to detect if a prior event was from a different
@@ -212,34 +369,33 @@ function L.Record_Event(_, message)
 
     -- Error check: if not entry, then there should be a prior event (entry
     -- or mid, but don't need to check it).
-    if path_bound ~= "entry" and prior_event == nil then
-        DebugError("Error: Non-entry event with no prior event match: "..tostring(message))
+    if bound ~= 1 and prior_id == nil then
+        DebugError("Error: Non-entry event with no prior event match: "..L.Event_Name(id))
     end
 
     -- Error check: if this is entry, there shouldn't be a prior unclosed entry.
-    if path_bound == "entry" and prior_event ~= nil and prior_event.path_bound == "entry" then
-        DebugError("Error: Entry event with unclosed prior entry, this: "..tostring(message).."   prior: "..tostring(prior_event.message))
+    if bound == 1 and prior_id ~= nil and L.event_bounds[prior_id] == 1 then
+        DebugError("Error: Entry event with unclosed prior entry, this: "..L.Event_Name(id).."   prior: "..L.Event_Name(prior_id))
     end
 
-    -- Check if there is a prior recorded event matching this section_name,
+    -- Check if there is a prior recorded event matching this section,
     -- eg. an md cue entry for this exit.
-    if path_bound ~= "entry" and prior_event ~= nil then
+    if bound ~= 1 and prior_id ~= nil then
     
-        -- Path will be the section_name, start location, end location,
-        -- comma separated.
-        local path = section_name .. "," .. prior_event.location .. "," .. location
+        -- Path will be the prior and this event ids, packed in one number.
+        local path = prior_id * L.path_key_scale + id
 
         -- Get the time delta.
         -- This may have rolled over, so put in a little extra care.
         local time_delta
-        local prior_time = prior_event.time
+        local prior_time = L.prior_times[section]
         if time >= prior_time then
             time_delta = time - prior_time
         -- The numbers should diverge wildly at this point; if not,
         -- something went wrong somewhere.
         -- This check looks for the numbers being with half a rollover still.
         else if time + L.rollover_halved >= prior_time then
-            DebugError(string.format("Bad time delta; prior %d, new %d (%s)", prior_time, time, time_string))
+            DebugError(string.format("Bad time delta; prior %d, new %d (%s)", prior_time, time, message))
             -- Ignore this contribution.
             time_delta = nil
         else
@@ -250,11 +406,11 @@ function L.Record_Event(_, message)
 
         if time_delta ~= nil then        
             if print_this then
-                DebugError("Path "..path.." Time delta: "..tostring(time_delta))
+                DebugError("Path "..L.Event_Name(prior_id).." to "..L.Event_Name(id).." Time delta: "..tostring(time_delta))
             end
 
             -- Update the table of metrics.
-            metrics = L.path_times[path]
+            local metrics = L.path_times[path]
             if metrics == nil then
                 L.path_times[path] = {
                     sum   = time_delta, 
@@ -276,27 +432,21 @@ function L.Record_Event(_, message)
     end
 
     -- Record this as the prior event for the next event.
-    -- If this was a path exit, clear the prior_event.
-    if path_bound ~= "exit" then
-        L.prior_events[section_name] = {
-            message = message,
-            section_name = section_name,
-            location = location,
-            path_bound = path_bound,
-            time = time,
-            engine_time = engine_time,
-            }
+    -- If this was a path exit, clear the prior event.
+    if bound ~= 3 then
+        L.prior_ids[section]          = id
+        L.prior_times[section]        = time
+        L.prior_engine_times[section] = engine_time
     else
-        L.prior_events[section_name] = nil
+        L.prior_ids[section] = nil
     end
 end
 
--- Convert a formatted time string to a time number.
+-- Convert formatted time fields to a time number.
 -- Returns number of elapsed time units (which depends on timer scaling).
 -- Nominally, these will return 100ns units.
-function L.Deformat_Time(time_string)
-    -- Format: {year}-{day}-{hour}-{minute}-{second}
-    local year_str, day_str, hour_str, minute_str, second_str = unpack(Lib.Split_String_Multi(time_string, "-"))
+function L.Deformat_Time(year_str, day_str, hour_str, minute_str, second_str)
+    -- Fields of format: {year}-{day}-{hour}-{minute}-{second}
 
     -- These aren't really seconds, but 100 ns units, though don't
     -- worry about that at the moment.